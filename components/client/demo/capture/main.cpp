@@ -32,9 +32,12 @@ public:
 
   void on_connection_closed() override { std::cout << "connection closed" << std::endl; }
 
-  void on_payload(const std::string& type, const void* payload, const std::size_t payload_size) override
+  void on_payload(const std::string& type,
+                  const void* payload,
+                  const std::size_t payload_size,
+                  const proto::protocol_version version) override
   {
-    proto::decode_payload(type, payload, payload_size, *this);
+    proto::decode_payload(type, payload, payload_size, *this, version);
   }
 
   void visit_monochrome_camera_frame_event(const proto::camera_frame_event& ev) override
@@ -32,9 +32,12 @@ public:
 
   void on_connection_closed() override { std::cout << "connection closed" << std::endl; }
 
-  void on_payload(const std::string& type, const void* payload, const std::size_t payload_size) override
+  void on_payload(const std::string& type,
+                  const void* payload,
+                  const std::size_t payload_size,
+                  const proto::protocol_version version) override
   {
-    proto::decode_payload(type, payload, payload_size, *this);
+    proto::decode_payload(type, payload, payload_size, *this, version);
   }
 
   void visit_monochrome_camera_frame_event(const proto::camera_frame_event& ev) override
@@ -66,6 +69,10 @@ public:
 
   void visit_temperature_update(const float temperature, const std::uint64_t time, const std::uint32_t) override {}
 
+  void visit_microphone_level(float, float, const float*, std::uint32_t, std::uint64_t, std::uint32_t) override {}
+
+  void visit_microphone_event(bool, std::uint64_t, std::uint32_t) override {}
+
   auto visit_unknown_payload(const std::string& type, const void* payload, const std::size_t payload_size)
     -> bool override
   {
@@ -115,6 +122,8 @@ main(int argc, char** argv)
 
   connection->add_observer(&obs);
 
+  connection->set_subscriptions(proto::subscription_pcm);
+
   connection->connect(ip, 5100);
 
   connection->notify_ready();
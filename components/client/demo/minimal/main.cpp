@@ -19,7 +19,10 @@ public:
 
   void on_connection_closed() override { std::cout << "connection closed" << std::endl; }
 
-  void on_payload(const std::string& type, const void* payload, const std::size_t payload_size) override
+  void on_payload(const std::string& type,
+                  const void* payload,
+                  const std::size_t payload_size,
+                  const sentinel::proto::protocol_version) override
   {
     std::cout << "received message of payload type '" << type << "'." << std::endl;
   }
@@ -8,6 +8,8 @@
 
 #include <uv.h>
 
+#include <sentinel/proto.h>
+
 namespace sentinel::client {
 
 class observer
@@ -33,7 +35,37 @@ public:
 
   virtual void on_connection_closed() = 0;
 
-  virtual void on_payload(const std::string& type, const void* payload, std::size_t payload_size) = 0;
+  /**
+   * @brief Called with each message from the server.
+   *
+   * @param version The framing of the messages that are nested in the payload (such as the one in a timed message),
+   *                which is the protocol version that was in use when the message was read. It has to be passed along to
+   *                @ref proto::decode_payload.
+   * */
+  virtual void on_payload(const std::string& type,
+                          const void* payload,
+                          std::size_t payload_size,
+                          proto::protocol_version version) = 0;
+
+  /**
+   * @brief Called when the server replies to a protocol version request, before any message in the new framing.
+   *
+   * @param version The version that the server chose, which may be older than the requested one.
+   * */
+  virtual void on_protocol_version(proto::protocol_version /* version */) {}
+
+  /**
+   * @brief Called when the sequence numbers of a message type skip ahead, which means that the server dropped
+   *        messages of that type. This is only called with protocol version 2.
+   *
+   * @param type The type string of the messages that were missed.
+   *
+   * @param count The number of messages that were missed.
+   *
+   * @param conflatable Whether or not the messages of this type replace each other. If they do, missing some of them is
+   *                    expected when the client is slower than the server.
+   * */
+  virtual void on_messages_missed(const std::string& /* type */, std::uint32_t /* count */, bool /* conflatable */) {}
 };
 
 class connection
@@ -59,6 +91,26 @@ public:
 
   virtual void connect(const char* ip, int port) = 0;
 
+  /**
+   * @brief Sets the protocol version to ask the server for once the connection is established.
+   *
+   * @details Every connection starts with version 1. If a newer version is set, it is requested when the connection
+   * is established and used once the server replies (see @ref observer::on_protocol_version).
+   *
+   * @note This has to be called before @ref connect in order to have an effect.
+   * */
+  virtual void set_protocol_version(proto::protocol_version version) = 0;
+
+  /**
+   * @brief Sets the optional data to subscribe to, such as the audio samples of the microphones.
+   *
+   * @details The subscription is sent when the connection is established, or right away if it already is. Until then,
+   * the server sends none of the optional data.
+   *
+   * @param flags The data to subscribe to, from @ref proto::subscription_flags.
+   * */
+  virtual void set_subscriptions(std::uint32_t flags) = 0;
+
   virtual void close() = 0;
 
   /**
@@ -79,6 +131,14 @@ public:
    * */
   virtual void notify_ready() = 0;
 
+  /**
+   * @brief Stops or resumes reading from the server.
+   *
+   * @details While reading is paused, the data sent by the server backs up in the socket buffers. This is mostly
+   * useful for simulating slow clients.
+   * */
+  virtual void set_reading_paused(bool paused) = 0;
+
   /**
    * @brief Indicates whether or not an interrupt signal was note.
    *
@@ -2,10 +2,12 @@
 
 #include <sentinel/proto.h>
 
+#include <array>
 #include <sstream>
 #include <vector>
 
 #include <cassert>
+#include <cstring>
 
 namespace sentinel::client {
 
@@ -158,6 +160,17 @@ public:
 
   void add_observer(observer* o) override { m_observers.emplace_back(std::move(o)); }
 
+  void set_protocol_version(const proto::protocol_version version) override { m_requested_version = version; }
+
+  void set_subscriptions(const std::uint32_t flags) override
+  {
+    m_subscriptions = flags;
+
+    if (m_connected) {
+      send_subscriptions();
+    }
+  }
+
   void notify_ready() override
   {
     proto::writer w("ready", 0, /* conflate */ true);
@@ -168,6 +181,23 @@ public:
 
   void set_streaming_enabled(const bool enabled) override { m_streaming_enabled = enabled; }
 
+  void set_reading_paused(const bool paused) override
+  {
+    m_reading_paused = paused;
+
+    if (!m_connected || m_closed) {
+      return;
+    }
+
+    auto* stream = reinterpret_cast<uv_stream_t*>(&m_socket);
+
+    if (paused) {
+      uv_read_stop(stream);
+    } else if (uv_read_start(stream, on_alloc, on_read) != 0) {
+      notify_error("Failed to resume reading from server.");
+    }
+  }
+
   auto caught_interrupt() const -> bool override { return m_caught_interrupt; }
 
 protected:
@@ -218,10 +248,27 @@ protected:
       return;
     }
 
+    self->m_connected = true;
+
     for (auto* obs : self->m_observers) {
       obs->on_connection_established();
     }
 
+    if (self->m_requested_version != proto::protocol_version::v1) {
+      write_operation::send(reinterpret_cast<uv_stream_t*>(&self->m_socket),
+                            std::move(*proto::writer::create_protocol_update(self->m_requested_version)->buffer),
+                            nullptr,
+                            nullptr);
+    }
+
+    if (self->m_subscriptions != 0) {
+      self->send_subscriptions();
+    }
+
+    if (self->m_reading_paused || self->m_closed) {
+      return;
+    }
+
     if (uv_read_start(reinterpret_cast<uv_stream_t*>(&self->m_socket), on_alloc, on_read) != 0) {
       self->notify_error("Failed to start reading from server.");
       return;
@@ -255,21 +302,65 @@ protected:
 
   void attempt_read_message()
   {
-    const auto result = proto::read(m_read_buffer.data(), m_read_size);
+    /* A single read may contain several messages, which are all handled before the buffer is culled. */
+    std::size_t offset{};
+
+    while (offset < m_read_size) {
 
-    if (result.payload_ready) {
-      handle_message(result);
+      if (m_version == proto::protocol_version::v2) {
+
+        const auto result = proto::read_v2(m_read_buffer.data() + offset, m_read_size - offset);
+
+        if (!result.payload_ready) {
+          break;
+        }
+
+        handle_message_v2(m_read_buffer.data() + offset, result);
+
+        offset += result.cull_size;
+
+        continue;
+      }
+
+      const auto result = proto::read(m_read_buffer.data() + offset, m_read_size - offset);
+
+      if (!result.payload_ready) {
+        break;
+      }
+
+      handle_message(m_read_buffer.data() + offset, result);
+
+      offset += result.cull_size;
     }
 
-    m_read_buffer.erase(m_read_buffer.begin(), m_read_buffer.begin() + result.cull_size);
+    m_read_buffer.erase(m_read_buffer.begin(), m_read_buffer.begin() + offset);
 
-    m_read_size -= result.cull_size;
+    m_read_size -= offset;
+  }
+
+  void handle_message(const std::uint8_t* message, const proto::read_result& r)
+  {
+    if (r.type_id == "protocol") {
+      handle_protocol_update(message + r.payload_offset, r.payload_size);
+      return;
+    }
+
+    for (auto* o : m_observers) {
+      o->on_payload(r.type_id, message + r.payload_offset, r.payload_size, proto::protocol_version::v1);
+    }
+
+    if (m_streaming_enabled) {
+      notify_ready();
+    }
   }
 
-  void handle_message(const proto::read_result& r)
+  void handle_message_v2(const std::uint8_t* message, const proto::read_v2_result& r)
   {
+    check_sequence(message, r);
+
     for (auto* o : m_observers) {
-      o->on_payload(r.type_id, m_read_buffer.data() + r.payload_offset, r.payload_size);
+      o->on_payload(
+        proto::get_message_type_name(r.type), message + r.payload_offset, r.payload_size, proto::protocol_version::v2);
     }
 
     if (m_streaming_enabled) {
@@ -277,6 +368,79 @@ protected:
     }
   }
 
+  /**
+   * @brief Reports the messages that were missed before this one, if its sequence number skips ahead of the last one
+   *        of its type. Timed messages are not numbered, so the message that they wrap is checked instead.
+   * */
+  void check_sequence(const std::uint8_t* message, const proto::read_v2_result& r)
+  {
+    if ((r.type == proto::message_type::timed) && (r.payload_size > proto::message_timing::serialized_size())) {
+
+      const auto* inner = message + r.payload_offset + proto::message_timing::serialized_size();
+
+      const auto inner_result = proto::read_v2(inner, r.payload_size - proto::message_timing::serialized_size());
+
+      if (inner_result.payload_ready) {
+        check_sequence(inner, inner_result);
+      }
+
+      return;
+    }
+
+    const auto index = static_cast<std::size_t>(r.type);
+
+    /* The first message of each type is not checked, since the client may have connected at any point. */
+    if ((r.sequence == 0) || (index >= m_sequences.size())) {
+      return;
+    }
+
+    const auto last = m_sequences[index];
+
+    m_sequences[index] = r.sequence;
+
+    if ((last == 0) || (r.sequence <= last + 1)) {
+      return;
+    }
+
+    const auto conflatable = (r.flags & proto::message_flag_conflatable) != 0;
+
+    for (auto* o : m_observers) {
+      o->on_messages_missed(proto::get_message_type_name(r.type), r.sequence - last - 1, conflatable);
+    }
+  }
+
+  void send_subscriptions()
+  {
+    write_operation::send(reinterpret_cast<uv_stream_t*>(&m_socket),
+                          std::move(*proto::writer::create_subscription_update(m_subscriptions)->buffer),
+                          nullptr,
+                          nullptr);
+  }
+
+  void handle_protocol_update(const std::uint8_t* payload, const std::size_t payload_size)
+  {
+    std::uint32_t value{};
+
+    if (payload_size < sizeof(value)) {
+      notify_error("Received an invalid protocol version from server.");
+      return;
+    }
+
+    std::memcpy(&value, payload, sizeof(value));
+
+    if ((value != static_cast<std::uint32_t>(proto::protocol_version::v1)) &&
+        (value != static_cast<std::uint32_t>(proto::protocol_version::v2))) {
+      notify_error("Received an unsupported protocol version from server.");
+      return;
+    }
+
+    m_version = static_cast<proto::protocol_version>(value);
+
+    for (auto* o : m_observers) {
+      o->on_protocol_version(m_version);
+    }
+  }
+
   void notify_error(const char* what)
   {
     for (auto* obs : m_observers) {
@@ -295,6 +459,10 @@ private:
 
   bool m_is_connecting{ false };
 
+  bool m_connected{ false };
+
+  bool m_reading_paused{ false };
+
   std::vector<std::uint8_t> m_read_buffer;
 
   std::size_t m_read_size{ 0 };
@@ -302,6 +470,20 @@ private:
   bool m_streaming_enabled{ true };
 
   bool m_caught_interrupt{ false };
+
+  proto::protocol_version m_requested_version{ proto::protocol_version::v1 };
+
+  std::uint32_t m_subscriptions{ 0 };
+
+  /**
+   * @brief The framing of the messages from the server, which changes when the server replies to a version request.
+   * */
+  proto::protocol_version m_version{ proto::protocol_version::v1 };
+
+  /**
+   * @brief The last sequence number received for each message type.
+   * */
+  std::array<std::uint32_t, proto::message_type_count> m_sequences{};
 };
 
 } // namespace
@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+
+#include <sentinel/client.h>
+
+#include <uv.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace {
+
+using namespace sentinel;
+
+/**
+ * @brief A server that sends a fixed sequence of bytes to the first client that connects, without reading anything
+ *        back.
+ * */
+class scripted_server final
+{
+public:
+  scripted_server(uv_loop_t* loop, std::vector<std::uint8_t> script)
+    : m_script(std::move(script))
+  {
+    uv_tcp_init(loop, &m_server);
+
+    uv_tcp_init(loop, &m_client);
+
+    uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_server), this);
+
+    sockaddr_in address{};
+
+    uv_ip4_addr("127.0.0.1", 0, &address);
+
+    uv_tcp_bind(&m_server, reinterpret_cast<const sockaddr*>(&address), 0);
+
+    uv_listen(reinterpret_cast<uv_stream_t*>(&m_server), 1, on_connection);
+  }
+
+  auto get_port() const -> int
+  {
+    sockaddr_in address{};
+
+    int size = sizeof(address);
+
+    if (uv_tcp_getsockname(&m_server, reinterpret_cast<sockaddr*>(&address), &size) != 0) {
+      return 0;
+    }
+
+    return ntohs(address.sin_port);
+  }
+
+  void close()
+  {
+    uv_close(reinterpret_cast<uv_handle_t*>(&m_server), nullptr);
+
+    uv_close(reinterpret_cast<uv_handle_t*>(&m_client), nullptr);
+  }
+
+protected:
+  static void on_connection(uv_stream_t* server, const int status)
+  {
+    auto* self = static_cast<scripted_server*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(server)));
+
+    if ((status != 0) || (uv_accept(server, reinterpret_cast<uv_stream_t*>(&self->m_client)) != 0)) {
+      return;
+    }
+
+    const auto buf = uv_buf_init(reinterpret_cast<char*>(self->m_script.data()), self->m_script.size());
+
+    uv_write(&self->m_write, reinterpret_cast<uv_stream_t*>(&self->m_client), &buf, 1, nullptr);
+  }
+
+private:
+  std::vector<std::uint8_t> m_script;
+
+  uv_tcp_t m_server{};
+
+  uv_tcp_t m_client{};
+
+  uv_write_t m_write{};
+};
+
+class recording_observer final
+  : public client::observer
+  , public proto::payload_visitor_base
+{
+public:
+  void on_error(const char* what) override { ADD_FAILURE() << what; }
+
+  void on_connection_established() override {}
+
+  void on_connection_failed() override { ADD_FAILURE() << "Failed to connect."; }
+
+  void on_connection_closed() override {}
+
+  void on_payload(const std::string& type,
+                  const void* payload,
+                  const std::size_t payload_size,
+                  const proto::protocol_version version) override
+  {
+    EXPECT_TRUE(proto::decode_payload(type, payload, payload_size, *this, version)) << type;
+  }
+
+  void on_protocol_version(const proto::protocol_version version) override { m_version = version; }
+
+  void visit_message_timing(const proto::message_timing& timing) override { m_timing = timing; }
+
+  void visit_temperature_update(const float temperature, const std::uint64_t time, const std::uint32_t) override
+  {
+    m_temperature = temperature;
+
+    m_time = time;
+  }
+
+  proto::protocol_version m_version{ proto::protocol_version::v1 };
+
+  proto::message_timing m_timing{};
+
+  float m_temperature{};
+
+  std::uint64_t m_time{};
+};
+
+/**
+ * @brief Runs the loop until a condition is met, or until a second passes.
+ * */
+template<typename Condition>
+auto
+run_until(uv_loop_t* loop, Condition condition) -> bool
+{
+  uv_timer_t timer{};
+
+  auto expired = false;
+
+  uv_timer_init(loop, &timer);
+
+  uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&timer), &expired);
+
+  uv_timer_start(
+    &timer,
+    [](uv_timer_t* t) { *static_cast<bool*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(t))) = true; },
+    1000,
+    0);
+
+  while (!condition() && !expired) {
+    uv_run(loop, UV_RUN_ONCE);
+  }
+
+  uv_close(reinterpret_cast<uv_handle_t*>(&timer), nullptr);
+
+  uv_run(loop, UV_RUN_NOWAIT);
+
+  return condition();
+}
+
+} // namespace
+
+TEST(Connection, DecodesTimedMessagesInVersion2)
+{
+  uv_loop_t loop{};
+
+  uv_loop_init(&loop);
+
+  /* The reply to the protocol request is in the version 1 framing, and everything after it is in version 2. */
+  std::vector<std::uint8_t> script = *proto::writer::create_protocol_update(proto::protocol_version::v2)->buffer;
+
+  const auto temperature = proto::writer::create_temperature_update(21.5f, 7, 1);
+
+  temperature->sequence = 1;
+
+  const auto timed = proto::writer::create_v2(*proto::writer::create_timed(*temperature, 100, 200));
+
+  ASSERT_TRUE(timed);
+
+  script.insert(script.end(), timed->buffer->begin(), timed->buffer->end());
+
+  scripted_server server(&loop, std::move(script));
+
+  recording_observer obs;
+
+  auto conn = client::connection::create(&loop, false);
+
+  conn->add_observer(&obs);
+
+  conn->set_protocol_version(proto::protocol_version::v2);
+
+  conn->connect("127.0.0.1", server.get_port());
+
+  EXPECT_TRUE(run_until(&loop, [&obs]() -> bool { return obs.m_time != 0; }));
+
+  EXPECT_EQ(obs.m_version, proto::protocol_version::v2);
+  EXPECT_EQ(obs.m_temperature, 21.5f);
+  EXPECT_EQ(obs.m_time, 7);
+  EXPECT_EQ(obs.m_timing.captured, 100);
+  EXPECT_EQ(obs.m_timing.encoded, 200);
+
+  conn->close();
+
+  server.close();
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+
+  conn.reset();
+
+  EXPECT_EQ(uv_loop_close(&loop), 0);
+}
@@ -0,0 +1,1359 @@
+/**
+ * @brief Opens many TCP and HTTP clients against a running server and reports how each of them is served.
+ *
+ * @details The TCP clients use @ref sentinel::client::connection, while the HTTP clients poll the stream endpoint the
+ *          way that the dashboard does. A fraction of the clients can be made to read slowly, and clients can be made
+ *          to reconnect after a random amount of time, in order to see how the server copes with them. The report is
+ *          printed as JSON, and covers:
+ *
+ *            - The goodput of each client, which is the payload bytes of the messages it read per second.
+ *            - The staleness of what the clients read, which is how long ago it was captured.
+ *            - The latency of each hop (pipeline, handoff, queue and network), if the server sends timing stamps.
+ *            - The messages that the server dropped for the HTTP clients, as it reports in each response.
+ *            - The connections that were made, failed or lost.
+ *
+ * @note The staleness is measured against the clock of this machine, so it is only meaningful when the server runs on
+ *       the same machine (or one with a synchronized clock).
+ * */
+
+#include <sentinel/client.h>
+#include <sentinel/proto.h>
+
+#include <uv.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+using namespace sentinel;
+
+struct options final
+{
+  std::string host{ "127.0.0.1" };
+
+  int tcp_port{ 5100 };
+
+  int http_port{ 8100 };
+
+  int tcp_clients{ 10 };
+
+  int http_clients{ 10 };
+
+  double duration{ 30.0 };
+
+  double warmup{ 2.0 };
+
+  /**
+   * @brief The most bytes per second that a client reads, or zero to read as fast as possible.
+   * */
+  double read_rate{ 0.0 };
+
+  /**
+   * @brief The fraction of the clients (of each kind) that read at @ref options::slow_rate.
+   * */
+  double slow_fraction{ 0.0 };
+
+  double slow_rate{ 16.0 * 1024.0 };
+
+  /**
+   * @brief The shortest time between the stream requests of an HTTP client, in milliseconds.
+   * */
+  double poll_interval{ 0.0 };
+
+  /**
+   * @brief The average time that a client stays connected before it reconnects, in seconds, or zero to stay connected.
+   * */
+  double churn{ 0.0 };
+
+  bool pcm{ false };
+
+  bool adpcm{ false };
+
+  bool per_client{ false };
+
+  unsigned int seed{ 0 };
+};
+
+auto
+get_clock_time() -> std::uint64_t
+{
+  using namespace std::chrono;
+
+  return time_point_cast<microseconds>(system_clock::now()).time_since_epoch().count();
+}
+
+/**
+ * @brief Gets the capture time of a message, for the message types that have one.
+ * */
+auto
+get_message_time(const std::string& type, const std::uint8_t* payload, const std::size_t size, std::uint64_t& time)
+  -> bool
+{
+  std::size_t offset{};
+
+  if (type == "rgb_camera::update") {
+    offset = 4;
+  } else if ((type == "microphone::update") || (type == "microphone::adpcm") || (type == "microphone::level")) {
+    offset = 8;
+  } else if (type == "microphone::event") {
+    offset = 0;
+  } else {
+    return false;
+  }
+
+  if ((offset + sizeof(time)) > size) {
+    return false;
+  }
+
+  std::memcpy(&time, payload + offset, sizeof(time));
+
+  return true;
+}
+
+/**
+ * @brief Gets a percentile of values that are sorted.
+ * */
+auto
+percentile(const std::vector<double>& values, const double p) -> double
+{
+  if (values.empty()) {
+    return 0.0;
+  }
+
+  return values[static_cast<std::size_t>(p * static_cast<double>(values.size() - 1))];
+}
+
+/**
+ * @brief What a single client saw over the run. Only what happens after the warmup is counted, except for the
+ *        connections.
+ * */
+struct client_stats final
+{
+  bool slow{ false };
+
+  std::uint64_t bytes{};
+
+  std::uint64_t messages{};
+
+  std::uint64_t frames{};
+
+  std::uint64_t connects{};
+
+  std::uint64_t failed_connects{};
+
+  std::uint64_t disconnects{};
+
+  std::uint64_t polls{};
+
+  std::uint64_t empty_polls{};
+
+  std::uint64_t dropped{};
+
+  /**
+   * @brief The staleness of every message with a capture time, and of just the camera frames, in milliseconds.
+   * */
+  std::vector<double> staleness;
+
+  std::vector<double> frame_staleness;
+
+  /**
+   * @brief The latency of each hop of the timed messages, in milliseconds. These are empty unless the server has
+   *        timing stamps enabled.
+   * */
+  std::vector<double> pipeline_latency;
+
+  std::vector<double> handoff_latency;
+
+  std::vector<double> queue_latency;
+
+  std::vector<double> network_latency;
+};
+
+/**
+ * @brief Limits how fast a client reads, by telling it how long to stop reading for after each read.
+ * */
+class read_throttle final
+{
+public:
+  explicit read_throttle(const double rate)
+    : m_rate(rate)
+    , m_budget(rate)
+  {
+  }
+
+  /**
+   * @brief Takes bytes that were read out of the budget.
+   *
+   * @param now The time of the loop, in milliseconds.
+   *
+   * @return How many milliseconds to stop reading for, which is zero when there is budget left.
+   * */
+  auto consume(const std::uint64_t now, const std::size_t size) -> std::uint64_t
+  {
+    if (m_rate <= 0.0) {
+      return 0;
+    }
+
+    /* At most a second of reading is saved up, so that a client that was idle does not read in one large burst. */
+    m_budget = std::min(m_budget + m_rate * static_cast<double>(now - m_last_time) * 1.0e-3, m_rate);
+
+    m_last_time = now;
+
+    m_budget -= static_cast<double>(size);
+
+    if (m_budget >= 0.0) {
+      return 0;
+    }
+
+    return static_cast<std::uint64_t>(std::ceil((-m_budget / m_rate) * 1.0e3));
+  }
+
+private:
+  double m_rate{};
+
+  double m_budget{};
+
+  std::uint64_t m_last_time{};
+};
+
+/**
+ * @brief The parts shared by the TCP and HTTP clients, which are the accounting of what is read, the throttling of
+ *        reads and the reconnecting.
+ * */
+class load_client
+{
+public:
+  load_client(uv_loop_t* loop, const options& opts, const bool slow, const unsigned int seed)
+    : m_loop(loop)
+    , m_options(opts)
+    , m_throttle(slow ? opts.slow_rate : opts.read_rate)
+    , m_rng(seed)
+  {
+    m_stats.slow = slow;
+
+    uv_timer_init(loop, &m_throttle_timer);
+
+    uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_throttle_timer), this);
+
+    uv_timer_init(loop, &m_reconnect_timer);
+
+    uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_reconnect_timer), this);
+  }
+
+  load_client(const load_client&) = delete;
+
+  load_client(load_client&&) = delete;
+
+  auto operator=(const load_client&) -> load_client& = delete;
+
+  auto operator=(load_client&&) -> load_client& = delete;
+
+  virtual ~load_client() = default;
+
+  virtual auto get_kind() const -> const char* = 0;
+
+  /**
+   * @brief Starts the first connection.
+   * */
+  void start() { connect(); }
+
+  /**
+   * @brief Closes the connection and the timers, after which the client does nothing.
+   * */
+  virtual void stop()
+  {
+    m_stopped = true;
+
+    uv_close(reinterpret_cast<uv_handle_t*>(&m_throttle_timer), nullptr);
+
+    uv_close(reinterpret_cast<uv_handle_t*>(&m_reconnect_timer), nullptr);
+
+    disconnect();
+  }
+
+  /**
+   * @brief Frees what is left of the connections that were closed, which cannot be done from their own callbacks.
+   * */
+  virtual void sweep() {}
+
+  void set_recording(const bool recording) { m_recording = recording; }
+
+  auto get_stats() -> client_stats& { return m_stats; }
+
+protected:
+  virtual void connect() = 0;
+
+  virtual void disconnect() = 0;
+
+  virtual void set_reading_paused(bool paused) = 0;
+
+  auto get_loop() -> uv_loop_t* { return m_loop; }
+
+  auto get_options() const -> const options& { return m_options; }
+
+  auto is_stopped() const -> bool { return m_stopped; }
+
+  auto is_recording() const -> bool { return m_recording; }
+
+  /**
+   * @brief Called once a connection is made, to schedule when it is dropped (when churn is enabled).
+   * */
+  void on_connected()
+  {
+    m_stats.connects++;
+
+    if (m_options.churn <= 0.0) {
+      return;
+    }
+
+    std::exponential_distribution<double> lifetime(1.0 / m_options.churn);
+
+    const auto timeout = static_cast<std::uint64_t>(lifetime(m_rng) * 1.0e3);
+
+    uv_timer_start(&m_reconnect_timer, on_reconnect_timer, std::max<std::uint64_t>(timeout, 1), 0);
+  }
+
+  /**
+   * @brief Called when a connection could not be made or was lost, to make another one after a short delay.
+   * */
+  void on_connection_lost(const bool was_connected)
+  {
+    if (m_stopped) {
+      return;
+    }
+
+    if (was_connected) {
+      m_stats.disconnects++;
+    } else {
+      m_stats.failed_connects++;
+    }
+
+    uv_timer_stop(&m_throttle_timer);
+
+    disconnect();
+
+    uv_timer_start(&m_reconnect_timer, on_reconnect_timer, reconnect_delay, 0);
+  }
+
+  /**
+   * @brief Counts a message read from the server, along with the messages in it if it is an aggregate.
+   * */
+  void count_message(const std::string& type, const std::uint8_t* payload, const std::size_t size)
+  {
+    if (!m_recording) {
+      return;
+    }
+
+    if (type == "aggregate") {
+      std::size_t offset{};
+      while (offset < size) {
+        const auto res = proto::read(payload + offset, size - offset);
+        if (!res.payload_ready) {
+          break;
+        }
+        count_message(res.type_id, payload + offset + res.payload_offset, res.payload_size);
+        offset += res.cull_size;
+      }
+      return;
+    }
+
+    if (type == "timed") {
+      count_timed_message(payload, size);
+      return;
+    }
+
+    m_stats.messages++;
+
+    m_stats.bytes += size;
+
+    const auto is_frame = (type == "rgb_camera::update");
+
+    if (is_frame) {
+      m_stats.frames++;
+    }
+
+    std::uint64_t time{};
+
+    if (!get_message_time(type, payload, size, time)) {
+      return;
+    }
+
+    const auto now = get_clock_time();
+
+    const auto staleness = static_cast<double>((now > time) ? (now - time) : 0) * 1.0e-3;
+
+    m_stats.staleness.emplace_back(staleness);
+
+    if (is_frame) {
+      m_stats.frame_staleness.emplace_back(staleness);
+    }
+  }
+
+  /**
+   * @brief Records the latency of each hop of a timed message, and counts the message that it wraps.
+   * */
+  void count_timed_message(const std::uint8_t* payload, const std::size_t size)
+  {
+    if (size < proto::message_timing::serialized_size()) {
+      return;
+    }
+
+    proto::message_timing timing;
+
+    std::memcpy(&timing.captured, payload, 8);
+    std::memcpy(&timing.encoded, payload + 8, 8);
+    std::memcpy(&timing.enqueued, payload + 16, 8);
+    std::memcpy(&timing.written, payload + 24, 8);
+
+    const auto now = get_clock_time();
+
+    const auto hop = [](const std::uint64_t t0, const std::uint64_t t1) -> double {
+      return (t1 > t0) ? (static_cast<double>(t1 - t0) * 1.0e-3) : 0.0;
+    };
+
+    m_stats.pipeline_latency.emplace_back(hop(timing.captured, timing.encoded));
+    m_stats.handoff_latency.emplace_back(hop(timing.encoded, timing.enqueued));
+    m_stats.queue_latency.emplace_back(hop(timing.enqueued, timing.written));
+    m_stats.network_latency.emplace_back(hop(timing.written, now));
+
+    const auto* inner = payload + proto::message_timing::serialized_size();
+
+    const auto inner_size = size - proto::message_timing::serialized_size();
+
+    const auto res = proto::read(inner, inner_size);
+
+    if (res.payload_ready) {
+      count_message(res.type_id, inner + res.payload_offset, res.payload_size);
+    }
+  }
+
+  /**
+   * @brief Throttles reading, after some bytes were read off the socket.
+   * */
+  void throttle(const std::size_t size)
+  {
+    const auto delay = m_throttle.consume(uv_now(m_loop), size);
+
+    if (delay == 0) {
+      return;
+    }
+
+    set_reading_paused(true);
+
+    uv_timer_start(&m_throttle_timer, on_throttle_timer, delay, 0);
+  }
+
+  static void on_throttle_timer(uv_timer_t* timer)
+  {
+    auto* self = static_cast<load_client*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(timer)));
+
+    self->set_reading_paused(false);
+  }
+
+  static void on_reconnect_timer(uv_timer_t* timer)
+  {
+    auto* self = static_cast<load_client*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(timer)));
+
+    if (self->m_stopped) {
+      return;
+    }
+
+    uv_timer_stop(&self->m_throttle_timer);
+
+    self->disconnect();
+
+    self->connect();
+  }
+
+  client_stats m_stats;
+
+private:
+  /**
+   * @brief How long to wait before connecting again after a connection failed or was lost, in milliseconds.
+   * */
+  static constexpr std::uint64_t reconnect_delay{ 100 };
+
+  uv_loop_t* m_loop{ nullptr };
+
+  const options& m_options;
+
+  read_throttle m_throttle;
+
+  std::mt19937 m_rng;
+
+  uv_timer_t m_throttle_timer{};
+
+  uv_timer_t m_reconnect_timer{};
+
+  bool m_stopped{ false };
+
+  bool m_recording{ false };
+};
+
+/**
+ * @brief A client of the TCP server. Each connection gets its own observer, so that one that was dropped can finish
+ *        closing while the next one is made.
+ * */
+class tcp_load_client final : public load_client
+{
+public:
+  using load_client::load_client;
+
+  auto get_kind() const -> const char* override { return "tcp"; }
+
+  void sweep() override
+  {
+    auto it = std::remove_if(m_closed.begin(), m_closed.end(), [](const auto& s) { return s->closed; });
+
+    m_closed.erase(it, m_closed.end());
+  }
+
+protected:
+  struct session final : public client::observer
+  {
+    session(tcp_load_client* o, uv_loop_t* loop)
+      : owner(o)
+      , conn(client::connection::create(loop, /* interrupt handling */ false))
+    {
+      conn->add_observer(this);
+    }
+
+    void on_error(const char*) override
+    {
+      if (owner) {
+        owner->on_session_lost(this);
+      }
+    }
+
+    void on_connection_established() override
+    {
+      connected = true;
+
+      if (owner) {
+        owner->on_connected();
+      }
+    }
+
+    void on_connection_failed() override
+    {
+      if (owner) {
+        owner->on_session_lost(this);
+      }
+    }
+
+    void on_connection_closed() override { closed = true; }
+
+    /* The connection is never switched to version 2, so the payloads are always in the version 1 framing. */
+    void on_payload(const std::string& type,
+                    const void* payload,
+                    const std::size_t payload_size,
+                    const proto::protocol_version) override
+    {
+      if (owner) {
+        owner->on_payload(type, static_cast<const std::uint8_t*>(payload), payload_size);
+      }
+    }
+
+    tcp_load_client* owner{ nullptr };
+
+    std::unique_ptr<client::connection> conn;
+
+    bool connected{ false };
+
+    bool closed{ false };
+  };
+
+  void connect() override
+  {
+    m_session = std::make_unique<session>(this, get_loop());
+
+    const auto& opts = get_options();
+
+    if (opts.pcm) {
+      m_session->conn->set_subscriptions(opts.adpcm ? (proto::subscription_pcm | proto::subscription_adpcm)
+                                                    : proto::subscription_pcm);
+    }
+
+    m_session->conn->connect(opts.host.c_str(), opts.tcp_port);
+  }
+
+  void disconnect() override
+  {
+    if (!m_session) {
+      return;
+    }
+
+    m_session->owner = nullptr;
+
+    m_session->conn->close();
+
+    m_closed.emplace_back(std::move(m_session));
+  }
+
+  void set_reading_paused(const bool paused) override
+  {
+    if (m_session) {
+      m_session->conn->set_reading_paused(paused);
+    }
+  }
+
+  void on_session_lost(session* s) { on_connection_lost(s->connected); }
+
+  void on_payload(const std::string& type, const std::uint8_t* payload, const std::size_t payload_size)
+  {
+    count_message(type, payload, payload_size);
+
+    /* The message header is 8 bytes, followed by the type. */
+    throttle(8 + type.size() + payload_size);
+  }
+
+private:
+  std::unique_ptr<session> m_session;
+
+  std::vector<std::unique_ptr<session>> m_closed;
+};
+
+/**
+ * @brief A client of the HTTP server, which polls the stream endpoint the way the dashboard does.
+ * */
+class http_load_client final : public load_client
+{
+public:
+  http_load_client(uv_loop_t* loop, const options& opts, const bool slow, const unsigned int seed)
+    : load_client(loop, opts, slow, seed)
+  {
+    m_request = "GET /api/stream";
+
+    if (opts.pcm) {
+      m_request += opts.adpcm ? "?pcm=1&adpcm=1" : "?pcm=1";
+    }
+
+    m_request += " HTTP/1.1\r\nHost: " + opts.host + "\r\nConnection: keep-alive\r\n\r\n";
+
+    uv_timer_init(loop, &m_poll_timer);
+
+    uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_poll_timer), this);
+  }
+
+  auto get_kind() const -> const char* override { return "http"; }
+
+  void stop() override
+  {
+    load_client::stop();
+
+    uv_close(reinterpret_cast<uv_handle_t*>(&m_poll_timer), nullptr);
+  }
+
+protected:
+  /**
+   * @brief The state of one connection, which is freed once its socket is closed.
+   * */
+  struct socket_state final
+  {
+    http_load_client* owner{ nullptr };
+
+    uv_tcp_t socket{};
+
+    uv_connect_t connect{};
+
+    uv_write_t write{};
+
+    std::vector<std::uint8_t> buffer;
+
+    std::size_t buffer_size{};
+
+    bool connected{ false };
+  };
+
+  void connect() override
+  {
+    sockaddr_in address{};
+
+    const auto& opts = get_options();
+
+    if (uv_ip4_addr(opts.host.c_str(), opts.http_port, &address) != 0) {
+      std::cerr << "Failed to parse the address '" << opts.host << "'." << std::endl;
+      return;
+    }
+
+    m_state = new socket_state();
+
+    m_state->owner = this;
+
+    uv_tcp_init(get_loop(), &m_state->socket);
+
+    uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_state->socket), m_state);
+
+    m_state->connect.data = m_state;
+
+    if (uv_tcp_connect(&m_state->connect, &m_state->socket, reinterpret_cast<const sockaddr*>(&address), on_connect) !=
+        0) {
+      on_connection_lost(false);
+    }
+  }
+
+  void disconnect() override
+  {
+    uv_timer_stop(&m_poll_timer);
+
+    if (!m_state) {
+      return;
+    }
+
+    m_state->owner = nullptr;
+
+    uv_close(reinterpret_cast<uv_handle_t*>(&m_state->socket), on_close);
+
+    m_state = nullptr;
+  }
+
+  void set_reading_paused(const bool paused) override
+  {
+    if (!m_state || !m_state->connected) {
+      return;
+    }
+
+    auto* stream = reinterpret_cast<uv_stream_t*>(&m_state->socket);
+
+    if (paused) {
+      uv_read_stop(stream);
+    } else {
+      uv_read_start(stream, on_alloc, on_read);
+    }
+  }
+
+  static auto get_state(uv_handle_t* handle) -> socket_state*
+  {
+    return static_cast<socket_state*>(uv_handle_get_data(handle));
+  }
+
+  static void on_close(uv_handle_t* handle) { delete get_state(handle); }
+
+  static void on_connect(uv_connect_t* req, const int status)
+  {
+    auto* state = static_cast<socket_state*>(req->data);
+
+    auto* self = state->owner;
+
+    if (!self) {
+      return;
+    }
+
+    if (status != 0) {
+      self->on_connection_lost(false);
+      return;
+    }
+
+    state->connected = true;
+
+    self->on_connected();
+
+    uv_read_start(reinterpret_cast<uv_stream_t*>(&state->socket), on_alloc, on_read);
+
+    self->send_request();
+  }
+
+  static void on_alloc(uv_handle_t* handle, const size_t size, uv_buf_t* buf)
+  {
+    auto* state = get_state(handle);
+
+    state->buffer.resize(state->buffer_size + size);
+
+    buf->base = reinterpret_cast<char*>(state->buffer.data() + state->buffer_size);
+
+    buf->len = size;
+  }
+
+  static void on_read(uv_stream_t* stream, const ssize_t read_size, const uv_buf_t*)
+  {
+    auto* state = get_state(reinterpret_cast<uv_handle_t*>(stream));
+
+    auto* self = state->owner;
+
+    if (!self) {
+      return;
+    }
+
+    if (read_size < 0) {
+      self->on_connection_lost(true);
+      return;
+    }
+
+    state->buffer_size += static_cast<std::size_t>(read_size);
+
+    while (self->m_state == state) {
+
+      const auto used = self->handle_response(state->buffer.data(), state->buffer_size);
+
+      if (used == 0) {
+        break;
+      }
+
+      state->buffer.erase(state->buffer.begin(), state->buffer.begin() + used);
+
+      state->buffer_size -= used;
+    }
+
+    if (self->m_state == state) {
+      self->throttle(static_cast<std::size_t>(read_size));
+    }
+  }
+
+  /**
+   * @brief Handles a response, if all of it was read.
+   *
+   * @return The size of the response, or zero if it was not read completely yet.
+   * */
+  auto handle_response(const std::uint8_t* data, const std::size_t size) -> std::size_t
+  {
+    const std::string_view text(reinterpret_cast<const char*>(data), size);
+
+    const auto header_end = text.find("\r\n\r\n");
+
+    if (header_end == std::string_view::npos) {
+      return 0;
+    }
+
+    const auto header = text.substr(0, header_end);
+
+    const auto body_offset = header_end + 4;
+
+    const auto body_size = get_header_field(header, "Content-Length");
+
+    if ((body_offset + body_size) > size) {
+      return 0;
+    }
+
+    if (is_recording()) {
+
+      m_stats.polls++;
+
+      m_stats.dropped += get_header_field(header, "X-Dropped-Messages");
+
+      if (body_size == 0) {
+        m_stats.empty_polls++;
+      }
+    }
+
+    if (body_size > 0) {
+      const auto res = proto::read(data + body_offset, body_size);
+      if (res.payload_ready) {
+        count_message(res.type_id, data + body_offset + res.payload_offset, res.payload_size);
+      }
+    }
+
+    schedule_request(body_size == 0);
+
+    return body_offset + body_size;
+  }
+
+  static auto get_header_field(const std::string_view header, const std::string_view name) -> std::size_t
+  {
+    const auto key = std::string("\r\n") + std::string(name) + ": ";
+
+    const auto pos = header.find(key);
+
+    if (pos == std::string_view::npos) {
+      return 0;
+    }
+
+    const std::string value(header.substr(pos + key.size(), 20));
+
+    return static_cast<std::size_t>(std::strtoull(value.c_str(), nullptr, 10));
+  }
+
+  /**
+   * @brief Sends the next request, once the poll interval has passed since the last one.
+   *
+   * @param empty Whether or not the last response was empty, in which case the dashboard waits a little before it asks
+   *              again.
+   * */
+  void schedule_request(const bool empty)
+  {
+    const auto elapsed = uv_now(get_loop()) - m_request_time;
+
+    auto delay = static_cast<std::uint64_t>(get_options().poll_interval);
+
+    if (empty) {
+      delay = std::max(delay, empty_poll_delay);
+    }
+
+    if (elapsed >= delay) {
+      send_request();
+    } else {
+      uv_timer_start(&m_poll_timer, on_poll_timer, delay - elapsed, 0);
+    }
+  }
+
+  static void on_poll_timer(uv_timer_t* timer)
+  {
+    auto* self = static_cast<http_load_client*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(timer)));
+
+    self->send_request();
+  }
+
+  void send_request()
+  {
+    if (!m_state || is_stopped()) {
+      return;
+    }
+
+    m_request_time = uv_now(get_loop());
+
+    auto buf = uv_buf_init(const_cast<char*>(m_request.data()), static_cast<unsigned int>(m_request.size()));
+
+    uv_write(&m_state->write, reinterpret_cast<uv_stream_t*>(&m_state->socket), &buf, 1, nullptr);
+  }
+
+private:
+  /**
+   * @brief How long to wait before asking again after an empty response, in milliseconds.
+   * */
+  static constexpr std::uint64_t empty_poll_delay{ 5 };
+
+  std::string m_request;
+
+  socket_state* m_state{ nullptr };
+
+  uv_timer_t m_poll_timer{};
+
+  std::uint64_t m_request_time{};
+};
+
+/**
+ * @brief Runs the clients for the duration of the test, or until an interrupt signal is caught.
+ * */
+class load_runner final
+{
+public:
+  load_runner(uv_loop_t* loop, const options& opts)
+    : m_options(opts)
+  {
+    std::mt19937 rng(opts.seed);
+
+    const auto slow_tcp_clients = static_cast<int>(std::round(opts.slow_fraction * opts.tcp_clients));
+
+    const auto slow_http_clients = static_cast<int>(std::round(opts.slow_fraction * opts.http_clients));
+
+    for (int i = 0; i < opts.tcp_clients; i++) {
+      m_clients.emplace_back(std::make_unique<tcp_load_client>(loop, opts, i < slow_tcp_clients, rng()));
+    }
+
+    for (int i = 0; i < opts.http_clients; i++) {
+      m_clients.emplace_back(std::make_unique<http_load_client>(loop, opts, i < slow_http_clients, rng()));
+    }
+
+    for (auto* handle : { &m_warmup_timer, &m_end_timer, &m_sweep_timer }) {
+      uv_timer_init(loop, handle);
+      uv_handle_set_data(reinterpret_cast<uv_handle_t*>(handle), this);
+    }
+
+    uv_signal_init(loop, &m_signal);
+
+    uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_signal), this);
+  }
+
+  void start()
+  {
+    for (auto& c : m_clients) {
+      c->start();
+    }
+
+    uv_timer_start(&m_warmup_timer, on_warmup_timer, static_cast<std::uint64_t>(m_options.warmup * 1.0e3), 0);
+
+    uv_timer_start(&m_sweep_timer, on_sweep_timer, 1000, 1000);
+
+    uv_signal_start(&m_signal, on_signal, SIGINT);
+  }
+
+  /**
+   * @brief Gets the time that was measured, in seconds.
+   * */
+  auto get_duration() const -> double { return m_duration; }
+
+  auto get_clients() -> std::vector<std::unique_ptr<load_client>>& { return m_clients; }
+
+protected:
+  static auto get_self(uv_handle_t* handle) -> load_runner*
+  {
+    return static_cast<load_runner*>(uv_handle_get_data(handle));
+  }
+
+  static void on_warmup_timer(uv_timer_t* timer)
+  {
+    auto* self = get_self(reinterpret_cast<uv_handle_t*>(timer));
+
+    for (auto& c : self->m_clients) {
+      c->set_recording(true);
+    }
+
+    self->m_start_time = uv_now(uv_handle_get_loop(reinterpret_cast<uv_handle_t*>(timer)));
+
+    self->m_recording = true;
+
+    uv_timer_start(&self->m_end_timer, on_end_timer, static_cast<std::uint64_t>(self->m_options.duration * 1.0e3), 0);
+  }
+
+  static void on_end_timer(uv_timer_t* timer) { get_self(reinterpret_cast<uv_handle_t*>(timer))->finish(); }
+
+  static void on_sweep_timer(uv_timer_t* timer)
+  {
+    for (auto& c : get_self(reinterpret_cast<uv_handle_t*>(timer))->m_clients) {
+      c->sweep();
+    }
+  }
+
+  static void on_signal(uv_signal_t* signal, int)
+  {
+    std::cerr << "Caught signal, stopping early." << std::endl;
+
+    get_self(reinterpret_cast<uv_handle_t*>(signal))->finish();
+  }
+
+  void finish()
+  {
+    if (m_finished) {
+      return;
+    }
+
+    m_finished = true;
+
+    auto* loop = uv_handle_get_loop(reinterpret_cast<uv_handle_t*>(&m_end_timer));
+
+    if (m_recording) {
+      m_duration = static_cast<double>(uv_now(loop) - m_start_time) * 1.0e-3;
+    }
+
+    for (auto& c : m_clients) {
+      c->set_recording(false);
+      c->stop();
+    }
+
+    for (auto* handle : { &m_warmup_timer, &m_end_timer, &m_sweep_timer }) {
+      uv_close(reinterpret_cast<uv_handle_t*>(handle), nullptr);
+    }
+
+    uv_close(reinterpret_cast<uv_handle_t*>(&m_signal), nullptr);
+  }
+
+private:
+  const options& m_options;
+
+  std::vector<std::unique_ptr<load_client>> m_clients;
+
+  uv_timer_t m_warmup_timer{};
+
+  uv_timer_t m_end_timer{};
+
+  uv_timer_t m_sweep_timer{};
+
+  uv_signal_t m_signal{};
+
+  std::uint64_t m_start_time{};
+
+  double m_duration{};
+
+  bool m_recording{ false };
+
+  bool m_finished{ false };
+};
+
+void
+print_distribution(std::ostream& out, const char* name, std::vector<double>& values)
+{
+  std::sort(values.begin(), values.end());
+
+  out << "\"" << name << "\": { \"p50\": " << percentile(values, 0.5) << ", \"p99\": " << percentile(values, 0.99)
+      << ", \"max\": " << (values.empty() ? 0.0 : values.back()) << " }";
+}
+
+/**
+ * @brief Prints the totals of a group of clients, which are the clients of one kind that read at the same speed.
+ * */
+void
+print_group(std::ostream& out,
+            const char* kind,
+            const bool slow,
+            std::vector<std::unique_ptr<load_client>>& clients,
+            const double duration)
+{
+  client_stats total;
+
+  std::vector<double> goodput;
+
+  for (auto& c : clients) {
+
+    auto& s = c->get_stats();
+
+    if ((std::strcmp(c->get_kind(), kind) != 0) || (s.slow != slow)) {
+      continue;
+    }
+
+    goodput.emplace_back(static_cast<double>(s.bytes) / duration);
+
+    total.bytes += s.bytes;
+    total.messages += s.messages;
+    total.frames += s.frames;
+    total.connects += s.connects;
+    total.failed_connects += s.failed_connects;
+    total.disconnects += s.disconnects;
+    total.polls += s.polls;
+    total.empty_polls += s.empty_polls;
+    total.dropped += s.dropped;
+    total.staleness.insert(total.staleness.end(), s.staleness.begin(), s.staleness.end());
+    total.frame_staleness.insert(total.frame_staleness.end(), s.frame_staleness.begin(), s.frame_staleness.end());
+    total.pipeline_latency.insert(total.pipeline_latency.end(), s.pipeline_latency.begin(), s.pipeline_latency.end());
+    total.handoff_latency.insert(total.handoff_latency.end(), s.handoff_latency.begin(), s.handoff_latency.end());
+    total.queue_latency.insert(total.queue_latency.end(), s.queue_latency.begin(), s.queue_latency.end());
+    total.network_latency.insert(total.network_latency.end(), s.network_latency.begin(), s.network_latency.end());
+  }
+
+  std::sort(goodput.begin(), goodput.end());
+
+  out << "    \"" << kind << (slow ? "_slow" : "") << "\": {\n";
+  out << "      \"clients\": " << goodput.size() << ",\n";
+  out << "      \"goodput_bytes_per_second\": { \"min\": " << (goodput.empty() ? 0.0 : goodput.front()) << ", ";
+  out << "\"p50\": " << percentile(goodput, 0.5) << ", ";
+  out << "\"max\": " << (goodput.empty() ? 0.0 : goodput.back()) << ", ";
+  out << "\"total\": " << static_cast<double>(total.bytes) / duration << " },\n";
+
+  out << "      \"messages_per_second\": " << static_cast<double>(total.messages) / duration << ",\n";
+  out << "      \"frames_per_second\": " << static_cast<double>(total.frames) / duration << ",\n";
+  out << "      ";
+  print_distribution(out, "staleness_ms", total.staleness);
+  out << ",\n      ";
+  print_distribution(out, "frame_staleness_ms", total.frame_staleness);
+  out << ",\n";
+
+  if (!total.network_latency.empty()) {
+    out << "      ";
+    print_distribution(out, "pipeline_latency_ms", total.pipeline_latency);
+    out << ",\n      ";
+    print_distribution(out, "handoff_latency_ms", total.handoff_latency);
+    out << ",\n      ";
+    print_distribution(out, "queue_latency_ms", total.queue_latency);
+    out << ",\n      ";
+    print_distribution(out, "network_latency_ms", total.network_latency);
+    out << ",\n";
+  }
+
+  if (std::strcmp(kind, "http") == 0) {
+    out << "      \"polls\": " << total.polls << ",\n";
+    out << "      \"empty_polls\": " << total.empty_polls << ",\n";
+    out << "      \"server_dropped_messages\": " << total.dropped << ",\n";
+  }
+
+  out << "      \"connects\": " << total.connects << ",\n";
+  out << "      \"failed_connects\": " << total.failed_connects << ",\n";
+  out << "      \"disconnects\": " << total.disconnects << "\n";
+  out << "    }";
+}
+
+void
+print_client(std::ostream& out, load_client& c, const double duration)
+{
+  auto& s = c.get_stats();
+
+  out << "    { \"kind\": \"" << c.get_kind() << "\", \"slow\": " << (s.slow ? "true" : "false");
+  out << ", \"goodput_bytes_per_second\": " << static_cast<double>(s.bytes) / duration;
+  out << ", \"messages\": " << s.messages << ", \"frames\": " << s.frames << ", ";
+  print_distribution(out, "frame_staleness_ms", s.frame_staleness);
+  out << ", \"dropped\": " << s.dropped << ", \"connects\": " << s.connects << " }";
+}
+
+void
+print_report(std::ostream& out, load_runner& runner, const options& opts)
+{
+  const auto duration = std::max(runner.get_duration(), 1.0e-3);
+
+  auto& clients = runner.get_clients();
+
+  out << "{\n";
+  out << "  \"duration\": " << runner.get_duration() << ",\n";
+  out << "  \"groups\": {\n";
+
+  bool first = true;
+
+  for (const auto* kind : { "tcp", "http" }) {
+    for (const auto slow : { false, true }) {
+
+      const auto count = std::count_if(clients.begin(), clients.end(), [kind, slow](const auto& c) {
+        return (std::strcmp(c->get_kind(), kind) == 0) && (c->get_stats().slow == slow);
+      });
+
+      if (count == 0) {
+        continue;
+      }
+
+      if (!first) {
+        out << ",\n";
+      }
+
+      first = false;
+
+      print_group(out, kind, slow, clients, duration);
+    }
+  }
+
+  out << "\n  }";
+
+  if (opts.per_client) {
+
+    out << ",\n  \"clients\": [\n";
+
+    for (std::size_t i = 0; i < clients.size(); i++) {
+      print_client(out, *clients[i], duration);
+      out << (((i + 1) < clients.size()) ? ",\n" : "\n");
+    }
+
+    out << "  ]";
+  }
+
+  out << "\n}" << std::endl;
+}
+
+const char help[] = R"(
+Opens many TCP and HTTP clients against a running server, and prints how they were served as JSON.
+
+Options:
+  --host IP            : The IPv4 address of the server (default is 127.0.0.1).
+  --tcp-port PORT      : The port of the TCP server (default is 5100).
+  --http-port PORT     : The port of the HTTP server (default is 8100).
+  --tcp-clients N      : The number of TCP clients (default is 10).
+  --http-clients N     : The number of HTTP clients, which poll the stream endpoint (default is 10).
+  --duration SECONDS   : How long to measure for (default is 30).
+  --warmup SECONDS     : How long to run before measuring (default is 2).
+  --read-rate BYTES    : The most bytes per second that each client reads (default is no limit).
+  --slow-fraction F    : The fraction of the clients of each kind that read slowly (default is 0).
+  --slow-rate BYTES    : The bytes per second that the slow clients read (default is 16384).
+  --poll-interval MS   : The shortest time between the requests of an HTTP client (default is 0, which asks again as
+                         soon as each response is read).
+  --churn SECONDS      : The average time that a client stays connected before it reconnects (default is 0, which
+                         never reconnects).
+  --pcm                : Has the clients ask for audio samples.
+  --adpcm              : Has the clients accept ADPCM audio, along with --pcm.
+  --per-client         : Also prints what each client saw.
+  --seed N             : The seed for the random connection lifetimes (default is 0).
+  --help               : Prints this help message.
+
+Hundreds of clients may need a higher limit of open files (see 'ulimit -n').
+)";
+
+auto
+parse_options(const int argc, char** argv, options& opts) -> bool
+{
+  for (int i = 1; i < argc; i++) {
+
+    const std::string arg(argv[i]);
+
+    const auto has_next = (i + 1) < argc;
+
+    if (arg == "--pcm") {
+      opts.pcm = true;
+    } else if (arg == "--adpcm") {
+      opts.adpcm = true;
+    } else if (arg == "--per-client") {
+      opts.per_client = true;
+    } else if (arg == "--help") {
+      std::cerr << "Usage: " << argv[0] << " [options]" << std::endl;
+      std::cerr << help;
+      return false;
+    } else if (!has_next) {
+      std::cerr << "Invalid argument '" << arg << "' (see --help)." << std::endl;
+      return false;
+    } else {
+
+      const char* value = argv[++i];
+
+      if (arg == "--host") {
+        opts.host = value;
+      } else if (arg == "--tcp-port") {
+        opts.tcp_port = std::atoi(value);
+      } else if (arg == "--http-port") {
+        opts.http_port = std::atoi(value);
+      } else if (arg == "--tcp-clients") {
+        opts.tcp_clients = std::atoi(value);
+      } else if (arg == "--http-clients") {
+        opts.http_clients = std::atoi(value);
+      } else if (arg == "--duration") {
+        opts.duration = std::atof(value);
+      } else if (arg == "--warmup") {
+        opts.warmup = std::atof(value);
+      } else if (arg == "--read-rate") {
+        opts.read_rate = std::atof(value);
+      } else if (arg == "--slow-fraction") {
+        opts.slow_fraction = std::clamp(std::atof(value), 0.0, 1.0);
+      } else if (arg == "--slow-rate") {
+        opts.slow_rate = std::atof(value);
+      } else if (arg == "--poll-interval") {
+        opts.poll_interval = std::max(std::atof(value), 0.0);
+      } else if (arg == "--churn") {
+        opts.churn = std::max(std::atof(value), 0.0);
+      } else if (arg == "--seed") {
+        opts.seed = static_cast<unsigned int>(std::strtoul(value, nullptr, 10));
+      } else {
+        std::cerr << "Invalid argument '" << arg << "' (see --help)." << std::endl;
+        return false;
+      }
+    }
+  }
+
+  if (opts.duration <= 0.0) {
+    std::cerr << "The duration must be greater than zero." << std::endl;
+    return false;
+  }
+
+  if (opts.slow_rate <= 0.0) {
+    std::cerr << "The read rate of the slow clients must be greater than zero." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+  options opts;
+
+  if (!parse_options(argc, argv, opts)) {
+    return EXIT_FAILURE;
+  }
+
+  uv_loop_t loop{};
+
+  uv_loop_init(&loop);
+
+  {
+    load_runner runner(&loop, opts);
+
+    runner.start();
+
+    uv_run(&loop, UV_RUN_DEFAULT);
+
+    for (auto& c : runner.get_clients()) {
+      c->sweep();
+    }
+
+    print_report(std::cout, runner, opts);
+  }
+
+  uv_loop_close(&loop);
+
+  return EXIT_SUCCESS;
+}
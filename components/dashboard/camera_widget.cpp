@@ -8,8 +8,11 @@
 
 #include <implot.h>
 
+#include <algorithm>
 #include <chrono>
+#include <deque>
 #include <sstream>
+#include <utility>
 
 #include <iostream>
 
@@ -50,6 +53,15 @@ public:
 
     ImGui::TextUnformatted(m_time_string.data(), m_time_string.data() + m_time_string.size());
 
+    if (!m_latency_string.empty()) {
+
+      const auto latency_size = ImGui::CalcTextSize(m_latency_string.c_str()).x;
+
+      ImGui::SetCursorPosX((window_size - latency_size) * 0.5f);
+
+      ImGui::TextUnformatted(m_latency_string.c_str());
+    }
+
     if (ImPlot::BeginPlot("##View", ImVec2(-1, -1), ImPlotFlags_Equal)) {
 
       ImPlot::SetupAxis(ImAxis_X1, "", ImPlotAxisFlags_NoGridLines | ImPlotAxisFlags_NoDecorations);
@@ -68,12 +80,25 @@ public:
   }
 
 protected:
+  void visit_message_timing(const sentinel::proto::message_timing& timing) override
+  {
+    m_timing = timing;
+
+    m_timing_pending = true;
+  }
+
   void visit_rgb_camera_frame_event(const sentinel::proto::camera_frame_event& ev) override
   {
+    const auto timed = std::exchange(m_timing_pending, false);
+
     if (ev.sensor_id != m_config.sensor_id) {
       return;
     }
 
+    if (timed) {
+      update_latency();
+    }
+
     std::vector<std::uint8_t> rgba(ev.w * ev.h * 4, 0);
 
     for (std::size_t i = 0; i < (static_cast<std::size_t>(ev.w) * ev.h); i++) {
@@ -89,10 +114,16 @@ protected:
 
   void visit_monochrome_camera_frame_event(const sentinel::proto::camera_frame_event& ev) override
   {
+    const auto timed = std::exchange(m_timing_pending, false);
+
     if (ev.sensor_id != m_config.sensor_id) {
       return;
     }
 
+    if (timed) {
+      update_latency();
+    }
+
     std::vector<std::uint8_t> rgba(ev.w * ev.h * 4);
 
     for (std::size_t i = 0; i < (static_cast<std::size_t>(ev.w) * ev.h); i++) {
@@ -105,7 +136,62 @@ protected:
     update_image(rgba.data(), ev.w, ev.h, ev.time);
   }
 
-protected:
+  void visit_microphone_update(const std::int16_t*, std::uint32_t, std::uint32_t, std::uint64_t, std::uint32_t) override
+  {
+    m_timing_pending = false;
+  }
+
+  void visit_microphone_level(float, float, const float*, std::uint32_t, std::uint64_t, std::uint32_t) override
+  {
+    m_timing_pending = false;
+  }
+
+  void visit_microphone_event(bool, std::uint64_t, std::uint32_t) override { m_timing_pending = false; }
+
+  void visit_temperature_update(float, std::uint64_t, std::uint32_t) override { m_timing_pending = false; }
+
+  /**
+   * @brief Adds the latency of the frame that was just received, from the timing stamps that came with it, and formats
+   *        the latest latency of each hop along with the median and 95th percentile of the recent ones.
+   * */
+  void update_latency()
+  {
+    using namespace std::chrono;
+
+    const auto now =
+      static_cast<std::uint64_t>(duration_cast<microseconds>(system_clock::now().time_since_epoch()).count());
+
+    const auto hop = [](const std::uint64_t t0, const std::uint64_t t1) -> double {
+      return ((t0 == 0) || (t1 < t0)) ? 0.0 : (static_cast<double>(t1 - t0) * 1.0e-3);
+    };
+
+    const auto total = hop(m_timing.captured, now);
+
+    m_latencies.emplace_back(total);
+
+    if (m_latencies.size() > max_latencies) {
+      m_latencies.pop_front();
+    }
+
+    std::vector<double> sorted(m_latencies.begin(), m_latencies.end());
+
+    std::sort(sorted.begin(), sorted.end());
+
+    const auto p50 = sorted[(sorted.size() - 1) / 2];
+
+    const auto p95 = sorted[((sorted.size() - 1) * 95) / 100];
+
+    std::ostringstream stream;
+
+    stream.precision(0);
+
+    stream << std::fixed << "latency " << total << " ms (p50 " << p50 << ", p95 " << p95 << ") = pipeline "
+           << hop(m_timing.captured, m_timing.encoded) << " + handoff " << hop(m_timing.encoded, m_timing.enqueued)
+           << " + queue " << hop(m_timing.enqueued, m_timing.written) << " + network " << hop(m_timing.written, now);
+
+    m_latency_string = stream.str();
+  }
+
   void update_image(const std::uint8_t* rgba, std::uint16_t w, std::uint16_t h, std::uint64_t t)
   {
     using namespace std::chrono;
@@ -143,6 +229,22 @@ private:
   std::uint64_t m_last_time{ 0 };
 
   std::string m_time_string;
+
+  /**
+   * @brief The number of recent frames that the latency percentiles are taken over.
+   * */
+  static constexpr std::size_t max_latencies{ 100 };
+
+  sentinel::proto::message_timing m_timing;
+
+  /**
+   * @brief Whether or not @ref m_timing belongs to the payload that is visited next.
+   * */
+  bool m_timing_pending{ false };
+
+  std::deque<double> m_latencies;
+
+  std::string m_latency_string;
 };
 
 } // namespace
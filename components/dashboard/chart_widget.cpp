@@ -66,6 +66,16 @@ protected:
     m_y_history.emplace_back(temperature);
   }
 
+  void visit_microphone_level(float, float, const float*, std::uint32_t, std::uint64_t, std::uint32_t) override
+  {
+    //
+  }
+
+  void visit_microphone_event(bool, std::uint64_t, std::uint32_t) override
+  {
+    //
+  }
+
   auto visit_unknown_payload(const std::string& type, const void* payload, const std::size_t payload_size)
     -> bool override
   {
@@ -81,6 +81,18 @@ dashboard::handle_telemetry(const std::string& type, const void* payload, const
   }
 }
 
+auto
+dashboard::wants_audio_samples() const -> bool
+{
+  for (const auto& c : m_containers) {
+    if (c.widget_instance->wants_audio_samples()) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 auto
 dashboard::get_cell_pos(const ImVec2& size, int row, int col) const -> ImVec2
 {
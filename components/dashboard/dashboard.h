@@ -22,6 +22,11 @@ public:
 
   void handle_telemetry(const std::string& type, const void* payload, const std::size_t size);
 
+  /**
+   * @brief Indicates whether or not any of the widgets need audio samples.
+   * */
+  auto wants_audio_samples() const -> bool;
+
 protected:
   struct container final
   {
@@ -2,12 +2,15 @@
 
 #include <sentinel/proto.h>
 
+#include <algorithm>
 #include <fstream>
 #include <random>
 #include <string>
 
 #include <iostream>
 
+#include <cmath>
+
 namespace {
 
 using namespace sentinel::proto;
@@ -37,7 +40,9 @@ public:
     m_done = true;
 
     if (m_path == "api/stream") {
-      get_stream_data();
+      get_stream_data(/* samples */ false);
+    } else if (m_path.rfind("api/stream?pcm=1", 0) == 0) {
+      get_stream_data(/* samples */ true);
     } else {
       open_file();
     }
@@ -46,7 +51,7 @@ public:
   }
 
 protected:
-  auto get_microphone_data() -> std::shared_ptr<outbound_message>
+  auto get_microphone_data(const bool samples_requested) -> std::shared_ptr<outbound_message>
   {
     constexpr std::size_t sample_rate{ 44100 };
 
@@ -73,14 +78,31 @@ protected:
       m_time += dt;
     }
 
-    auto update = writer::create_microphone_update(samples.data(), samples.size(), sample_rate, tstamp, sensor_id);
+    if (samples_requested) {
+      return writer::create_microphone_update(samples.data(), samples.size(), sample_rate, tstamp, sensor_id);
+    }
+
+    float peak{};
+
+    float sum_of_squares{};
+
+    for (const auto s : samples) {
+
+      const auto v = static_cast<float>(s) / 32768.0f;
+
+      peak = std::max(peak, std::abs(v));
+
+      sum_of_squares += v * v;
+    }
+
+    const auto rms = std::sqrt(sum_of_squares / static_cast<float>(samples.size()));
 
-    return update;
+    return writer::create_microphone_level(peak, rms, nullptr, 0, tstamp, sensor_id);
   }
 
-  void get_stream_data()
+  void get_stream_data(const bool samples_requested)
   {
-    auto msg = get_microphone_data();
+    auto msg = get_microphone_data(samples_requested);
 
     const auto* ptr = reinterpret_cast<const char*>(msg->buffer->data());
 
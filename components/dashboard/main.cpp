@@ -89,7 +89,14 @@ protected:
     m_config_fetch_request.reset();
   }
 
-  void begin_telemetry_polling() { m_telemetry_fetch_request = fetch_request::create("api/stream"); }
+  void begin_telemetry_polling()
+  {
+    /* Audio samples are only sent when asked for, otherwise the microphones are only reported by their level. The
+     * samples are decoded the same way whether or not they are compressed, so compression is always accepted. */
+    const auto* path = m_landscape_dashboard.wants_audio_samples() ? "api/stream?pcm=1&adpcm=1" : "api/stream";
+
+    m_telemetry_fetch_request = fetch_request::create(path);
+  }
 
   void poll_telemetry_fetch_request()
   {
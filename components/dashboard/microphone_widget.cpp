@@ -7,11 +7,8 @@
 #include <AL/al.h>
 #include <AL/alc.h>
 
-#include <limits>
 #include <vector>
 
-#include <cmath>
-
 #include <iostream>
 #include <sstream>
 
@@ -125,6 +122,11 @@ public:
       m_player.update_playback_state(m_listen);
     }
 
+    if (m_event_active) {
+      ImGui::SameLine();
+      ImGui::TextUnformatted("Sound detected");
+    }
+
     if (!ImPlot::BeginPlot("##Chart", ImVec2(-1, -1), ImPlotFlags_Crosshairs)) {
       return;
     }
@@ -147,33 +149,41 @@ public:
     sentinel::proto::decode_payload(type, payload, payload_size, *this);
   }
 
+  auto wants_audio_samples() const -> bool override { return m_listen; }
+
 protected:
-  void visit_microphone_update(const std::int16_t* data,
-                               std::uint32_t size,
-                               std::uint32_t sample_rate,
-                               std::uint64_t time,
-                               std::uint32_t sensor_id) override
+  void visit_microphone_level(const float peak,
+                              const float,
+                              const float*,
+                              const std::uint32_t,
+                              const std::uint64_t time,
+                              const std::uint32_t sensor_id) override
   {
     if (m_config.sensor_id != sensor_id) {
       return;
     }
 
-    constexpr auto scale = -1.0f / static_cast<float>(std::numeric_limits<std::int16_t>::min());
-
-    float max{};
-
-    for (std::size_t i = 0; i < size; i++) {
-
-      const auto val = static_cast<float>(data[i]) * scale;
+    add_chart_entry(time * 1.0e-6, peak);
+  }
 
-      max = std::max(std::abs(val), max);
+  void visit_microphone_event(const bool active, const std::uint64_t, const std::uint32_t sensor_id) override
+  {
+    if (m_config.sensor_id == sensor_id) {
+      m_event_active = active;
     }
+  }
 
-    add_chart_entry(time * 1.0e-6, max);
-
-    if (m_listen) {
-      m_player.queue_buffer(data, size, sample_rate);
+  void visit_microphone_update(const std::int16_t* data,
+                               std::uint32_t size,
+                               std::uint32_t sample_rate,
+                               std::uint64_t time,
+                               std::uint32_t sensor_id) override
+  {
+    if ((m_config.sensor_id != sensor_id) || !m_listen) {
+      return;
     }
+
+    m_player.queue_buffer(data, size, sample_rate);
   }
 
   void add_chart_entry(const double x, const double y)
@@ -199,6 +209,8 @@ private:
 
   bool m_listen{ false };
 
+  bool m_event_active{ false };
+
   audio_player m_player;
 };
 
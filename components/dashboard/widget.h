@@ -10,4 +10,9 @@ public:
   virtual void render() = 0;
 
   virtual void handle_telemetry(const std::string& type, const void* payload, std::size_t size) = 0;
+
+  /**
+   * @brief Indicates whether or not the widget needs audio samples, which the server only sends when asked to.
+   * */
+  virtual auto wants_audio_samples() const -> bool { return false; }
 };
@@ -0,0 +1,128 @@
+#include <benchmark/benchmark.h>
+
+#include <sentinel/proto.h>
+
+#include "bench_data.h"
+
+#include <vector>
+
+#include <cmath>
+
+namespace {
+
+using sentinel::proto::bench::make_audio;
+
+using sentinel::proto::bench::sample_rate;
+
+constexpr std::uint32_t period_size{ 1024 };
+
+void
+BM_MicrophoneUpdate(benchmark::State& state)
+{
+  const auto audio = make_audio();
+
+  std::size_t offset{};
+
+  std::size_t message_size{};
+
+  for (auto _ : state) {
+
+    auto msg = sentinel::proto::writer::create_microphone_update(audio.data() + offset, period_size, sample_rate, 0, 0);
+
+    message_size = msg->buffer->size();
+
+    benchmark::DoNotOptimize(msg);
+
+    offset = (offset + period_size) % (audio.size() - period_size);
+  }
+
+  state.SetBytesProcessed(state.iterations() * period_size * sizeof(std::int16_t));
+
+  state.counters["message_size"] = static_cast<double>(message_size);
+}
+
+BENCHMARK(BM_MicrophoneUpdate);
+
+void
+BM_MicrophoneAdpcmUpdate(benchmark::State& state)
+{
+  const auto audio = make_audio();
+
+  sentinel::proto::adpcm_encoder encoder;
+
+  std::size_t offset{};
+
+  std::size_t message_size{};
+
+  for (auto _ : state) {
+
+    auto msg = sentinel::proto::writer::create_microphone_adpcm_update(
+      encoder, audio.data() + offset, period_size, sample_rate, 0, 0);
+
+    message_size = msg->buffer->size();
+
+    benchmark::DoNotOptimize(msg);
+
+    offset = (offset + period_size) % (audio.size() - period_size);
+  }
+
+  state.SetBytesProcessed(state.iterations() * period_size * sizeof(std::int16_t));
+
+  const auto raw = sentinel::proto::writer::create_microphone_update(audio.data(), period_size, sample_rate, 0, 0);
+
+  state.counters["message_size"] = static_cast<double>(message_size);
+
+  state.counters["ratio"] = static_cast<double>(raw->buffer->size()) / static_cast<double>(message_size);
+
+  /* The quality of the whole second of audio, after a round trip through the codec. */
+  sentinel::proto::adpcm_encoder quality_encoder;
+
+  std::vector<std::uint8_t> encoded((audio.size() + 1) / 2);
+
+  quality_encoder.encode(audio.data(), audio.size(), encoded.data());
+
+  std::vector<std::int16_t> decoded(audio.size());
+
+  sentinel::proto::adpcm_decode(sentinel::proto::adpcm_state{}, encoded.data(), decoded.size(), decoded.data());
+
+  double signal{};
+
+  double error{};
+
+  for (std::size_t i = 0; i < audio.size(); i++) {
+    const auto diff = static_cast<double>(audio[i]) - static_cast<double>(decoded[i]);
+    signal += static_cast<double>(audio[i]) * static_cast<double>(audio[i]);
+    error += diff * diff;
+  }
+
+  state.counters["snr_db"] = 10.0 * std::log10(signal / std::max(error, 1.0));
+}
+
+BENCHMARK(BM_MicrophoneAdpcmUpdate);
+
+void
+BM_AdpcmDecode(benchmark::State& state)
+{
+  const auto audio = make_audio();
+
+  sentinel::proto::adpcm_encoder encoder;
+
+  std::vector<std::uint8_t> encoded((period_size + 1) / 2);
+
+  encoder.encode(audio.data(), period_size, encoded.data());
+
+  std::vector<std::int16_t> decoded(period_size);
+
+  for (auto _ : state) {
+
+    sentinel::proto::adpcm_decode(sentinel::proto::adpcm_state{}, encoded.data(), decoded.size(), decoded.data());
+
+    benchmark::DoNotOptimize(decoded.data());
+  }
+
+  state.SetBytesProcessed(state.iterations() * period_size * sizeof(std::int16_t));
+}
+
+BENCHMARK(BM_AdpcmDecode);
+
+} // namespace
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <cmath>
+#include <cstdint>
+
+namespace sentinel::proto::bench {
+
+constexpr std::uint32_t sample_rate{ 44100 };
+
+/**
+ * @brief Makes a second of audio that is somewhat like what a microphone picks up: a few tones over background noise.
+ * */
+inline auto
+make_audio() -> std::vector<std::int16_t>
+{
+  std::mt19937 rng(0);
+
+  std::normal_distribution<float> noise(0.0f, 300.0f);
+
+  std::vector<std::int16_t> samples(sample_rate);
+
+  for (std::size_t i = 0; i < samples.size(); i++) {
+
+    const auto t = static_cast<float>(i) / static_cast<float>(sample_rate);
+
+    const auto tone = 6000.0f * std::sin(2.0f * 3.14159265f * 220.0f * t) +
+                      2000.0f * std::sin(2.0f * 3.14159265f * 1760.0f * t);
+
+    samples[i] = static_cast<std::int16_t>(tone + noise(rng));
+  }
+
+  return samples;
+}
+
+/**
+ * @brief Makes an RGB image that is somewhat like a camera frame: smooth gradients with some sensor noise, so that the
+ *        JPEG encoder does about as much work as it would on a real frame.
+ * */
+inline auto
+make_image(const int w, const int h) -> std::vector<std::uint8_t>
+{
+  std::mt19937 rng(0);
+
+  std::uniform_int_distribution<int> noise(-8, 8);
+
+  std::vector<std::uint8_t> data(static_cast<std::size_t>(w) * static_cast<std::size_t>(h) * 3);
+
+  for (int y = 0; y < h; y++) {
+    for (int x = 0; x < w; x++) {
+
+      auto* pixel = &data[(static_cast<std::size_t>(y) * w + x) * 3];
+
+      const int base[3]{ (x * 255) / w, (y * 255) / h, ((x + y) * 127) / (w + h) + 64 };
+
+      for (int c = 0; c < 3; c++) {
+        pixel[c] = static_cast<std::uint8_t>(std::min(std::max(base[c] + noise(rng), 0), 255));
+      }
+    }
+  }
+
+  return data;
+}
+
+} // namespace sentinel::proto::bench
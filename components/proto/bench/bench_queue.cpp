@@ -0,0 +1,90 @@
+#include <benchmark/benchmark.h>
+
+#include <sentinel/proto.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Makes a message for each of a number of topics.
+ * */
+auto
+make_messages(const std::size_t topics, const std::size_t per_topic, const bool conflate)
+  -> std::vector<std::shared_ptr<sentinel::proto::outbound_message>>
+{
+  const std::vector<std::uint8_t> payload(64, 0x5a);
+
+  std::vector<std::shared_ptr<sentinel::proto::outbound_message>> messages;
+
+  for (std::size_t i = 0; i < per_topic; i++) {
+    for (std::size_t t = 0; t < topics; t++) {
+      const auto type = "bench::topic_" + std::to_string(t);
+      sentinel::proto::writer wr(type.c_str(), payload.size(), conflate);
+      wr.write(payload.data(), payload.size());
+      messages.emplace_back(wr.complete());
+    }
+  }
+
+  return messages;
+}
+
+/**
+ * @brief Fills a client queue and drains it into an aggregate, the way that an HTTP client does on each poll, with the
+ *        arguments being the number of topics and the number of messages per topic in each poll.
+ * */
+void
+BM_QueueChurn(benchmark::State& state)
+{
+  const auto topics = static_cast<std::size_t>(state.range(0));
+
+  const auto per_topic = static_cast<std::size_t>(state.range(1));
+
+  const auto messages = make_messages(topics, per_topic, false);
+
+  sentinel::proto::queue q(16);
+
+  for (auto _ : state) {
+
+    for (const auto& msg : messages) {
+      q.add(msg);
+    }
+
+    auto aggregate = q.aggregate();
+
+    benchmark::DoNotOptimize(aggregate);
+
+    q.clear();
+  }
+
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(messages.size()));
+}
+
+BENCHMARK(BM_QueueChurn)->ArgNames({ "topics", "per_topic" })->ArgsProduct({ { 1, 8, 64, 256 }, { 1, 16, 64 } });
+
+/**
+ * @brief Adds conflated messages, which replace the queued message of their topic, with the argument being the number
+ *        of topics.
+ * */
+void
+BM_QueueConflate(benchmark::State& state)
+{
+  const auto topics = static_cast<std::size_t>(state.range(0));
+
+  const auto messages = make_messages(topics, 4, true);
+
+  sentinel::proto::queue q(16);
+
+  for (auto _ : state) {
+    for (const auto& msg : messages) {
+      q.add(msg);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(messages.size()));
+}
+
+BENCHMARK(BM_QueueConflate)->Arg(1)->Arg(64)->Arg(256);
+
+} // namespace
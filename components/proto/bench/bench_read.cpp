@@ -0,0 +1,268 @@
+#include <benchmark/benchmark.h>
+
+#include <sentinel/proto.h>
+#include <sentinel/proto_schema.h>
+
+#include "bench_data.h"
+
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Counts the decoded messages, so that the decoding is not optimized out.
+ * */
+class counting_visitor final : public sentinel::proto::payload_visitor_base
+{
+public:
+  void visit_rgb_camera_frame_event(const sentinel::proto::camera_frame_event& ev) override { m_count += ev.w; }
+
+  void visit_microphone_update(const std::int16_t* data,
+                               std::uint32_t size,
+                               std::uint32_t,
+                               std::uint64_t,
+                               std::uint32_t) override
+  {
+    m_count += (size > 0) ? static_cast<std::size_t>(data[size - 1] != 0) : 0;
+  }
+
+  void visit_microphone_level(float, float, const float*, std::uint32_t band_count, std::uint64_t, std::uint32_t)
+    override
+  {
+    m_count += band_count;
+  }
+
+  auto get_count() const -> std::size_t { return m_count; }
+
+private:
+  std::size_t m_count{};
+};
+
+/**
+ * @brief Makes an aggregate of sub-messages, the way that the queue of an HTTP client does, alternating between sample
+ *        and level updates.
+ * */
+auto
+make_aggregate(const std::size_t count) -> std::shared_ptr<sentinel::proto::outbound_message>
+{
+  const auto audio = sentinel::proto::bench::make_audio();
+
+  const std::vector<float> bands(16, 0.25f);
+
+  std::vector<std::shared_ptr<sentinel::proto::outbound_message>> messages;
+
+  std::size_t size{};
+
+  for (std::size_t i = 0; i < count; i++) {
+
+    auto msg = (i % 2) ? sentinel::proto::writer::create_microphone_level(0.5f, 0.1f, bands.data(), 16, i, 0)
+                       : sentinel::proto::writer::create_microphone_update(audio.data(), 256, 44100, i, 0);
+
+    size += msg->buffer->size();
+
+    messages.emplace_back(std::move(msg));
+  }
+
+  sentinel::proto::writer wr("aggregate", size, false);
+
+  for (const auto& msg : messages) {
+    wr.write(msg->buffer->data(), msg->buffer->size());
+  }
+
+  return wr.complete();
+}
+
+void
+BM_ReadHeader(benchmark::State& state)
+{
+  const auto audio = sentinel::proto::bench::make_audio();
+
+  const auto msg = sentinel::proto::writer::create_microphone_update(audio.data(), 1024, 44100, 0, 0);
+
+  for (auto _ : state) {
+
+    auto res = sentinel::proto::read(msg->buffer->data(), msg->buffer->size());
+
+    benchmark::DoNotOptimize(res);
+  }
+}
+
+BENCHMARK(BM_ReadHeader);
+
+void
+BM_ReadHeaderV2(benchmark::State& state)
+{
+  const auto audio = sentinel::proto::bench::make_audio();
+
+  const auto v1 = sentinel::proto::writer::create_microphone_update(audio.data(), 1024, 44100, 0, 0);
+
+  const auto msg = sentinel::proto::writer::create_v2(*v1);
+
+  for (auto _ : state) {
+
+    auto res = sentinel::proto::read_v2(msg->buffer->data(), msg->buffer->size());
+
+    benchmark::DoNotOptimize(res);
+  }
+}
+
+BENCHMARK(BM_ReadHeaderV2);
+
+/**
+ * @brief Decodes an aggregate, with the argument being the number of sub-messages.
+ * */
+void
+BM_DecodeAggregate(benchmark::State& state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+
+  const auto msg = make_aggregate(count);
+
+  const auto* data = msg->buffer->data();
+
+  const auto res = sentinel::proto::read(data, msg->buffer->size());
+
+  counting_visitor visitor;
+
+  for (auto _ : state) {
+
+    const auto success =
+      sentinel::proto::decode_payload(res.type_id, data + res.payload_offset, res.payload_size, visitor);
+
+    benchmark::DoNotOptimize(success);
+  }
+
+  benchmark::DoNotOptimize(visitor.get_count());
+
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(count));
+
+  state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(msg->buffer->size()));
+}
+
+BENCHMARK(BM_DecodeAggregate)->RangeMultiplier(4)->Range(1, 1024);
+
+/**
+ * @brief Decodes the same aggregates as @ref BM_DecodeAggregate, in the version 2 framing.
+ * */
+void
+BM_DecodeAggregateV2(benchmark::State& state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+
+  const auto msg = sentinel::proto::writer::create_v2(*make_aggregate(count));
+
+  const auto* data = msg->buffer->data();
+
+  const auto res = sentinel::proto::read_v2(data, msg->buffer->size());
+
+  counting_visitor visitor;
+
+  for (auto _ : state) {
+
+    const auto success =
+      sentinel::proto::decode_payload(res.type, data + res.payload_offset, res.payload_size, visitor);
+
+    benchmark::DoNotOptimize(success);
+  }
+
+  benchmark::DoNotOptimize(visitor.get_count());
+
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(count));
+
+  state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(msg->buffer->size()));
+}
+
+BENCHMARK(BM_DecodeAggregateV2)->RangeMultiplier(4)->Range(1, 1024);
+
+/**
+ * @brief Decodes the same aggregates as @ref BM_DecodeAggregateV2, with the decoders that are instantiated from the
+ *        message schemas instead of the virtual calls of a payload visitor.
+ * */
+void
+BM_VisitAggregateV2(benchmark::State& state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+
+  const auto msg = sentinel::proto::writer::create_v2(*make_aggregate(count));
+
+  const auto* data = msg->buffer->data() + sentinel::proto::header_v2_size;
+
+  const auto size = msg->buffer->size() - sentinel::proto::header_v2_size;
+
+  std::size_t visited{};
+
+  const auto visitor = [&visited](const auto& m) {
+    using message = std::decay_t<decltype(m)>;
+    if constexpr (std::is_same_v<message, sentinel::proto::microphone_update_message>) {
+      visited += (m.size > 0) ? static_cast<std::size_t>(m.samples[m.size - 1] != 0) : 0;
+    } else if constexpr (std::is_same_v<message, sentinel::proto::microphone_level_message>) {
+      visited += m.band_count;
+    }
+  };
+
+  for (auto _ : state) {
+
+    for (std::size_t i = 0; i < size;) {
+
+      const auto res = sentinel::proto::read_v2(data + i, size - i);
+
+      const auto success =
+        sentinel::proto::visit_message(res.type, data + i + res.payload_offset, res.payload_size, visitor);
+
+      benchmark::DoNotOptimize(success);
+
+      i += res.cull_size;
+    }
+  }
+
+  benchmark::DoNotOptimize(visited);
+
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(count));
+
+  state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(msg->buffer->size()));
+}
+
+BENCHMARK(BM_VisitAggregateV2)->RangeMultiplier(4)->Range(1, 1024);
+
+/**
+ * @brief Decodes a camera frame (which includes decoding the JPEG), with the arguments being the width and height.
+ * */
+void
+BM_DecodeRgbCameraUpdate(benchmark::State& state)
+{
+  const auto w = static_cast<int>(state.range(0));
+
+  const auto h = static_cast<int>(state.range(1));
+
+  const auto image = sentinel::proto::bench::make_image(w, h);
+
+  const auto msg = sentinel::proto::writer::create_rgb_camera_update(image.data(), w, h, 0, 0, {}, 0.5f);
+
+  const auto* data = msg->buffer->data();
+
+  const auto res = sentinel::proto::read(data, msg->buffer->size());
+
+  counting_visitor visitor;
+
+  for (auto _ : state) {
+
+    const auto success =
+      sentinel::proto::decode_payload(res.type_id, data + res.payload_offset, res.payload_size, visitor);
+
+    benchmark::DoNotOptimize(success);
+  }
+
+  benchmark::DoNotOptimize(visitor.get_count());
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_DecodeRgbCameraUpdate)
+  ->ArgNames({ "w", "h" })
+  ->Args({ 320, 240 })
+  ->Args({ 640, 480 })
+  ->Args({ 1280, 720 })
+  ->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -0,0 +1,92 @@
+#include <benchmark/benchmark.h>
+
+#include <sentinel/proto.h>
+
+#include "bench_data.h"
+
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Composes a message with a payload of the given size, which is the cost that every message type pays.
+ * */
+void
+BM_WriterMessage(benchmark::State& state)
+{
+  const auto size = static_cast<std::size_t>(state.range(0));
+
+  const std::vector<std::uint8_t> payload(size, 0x5a);
+
+  for (auto _ : state) {
+
+    sentinel::proto::writer wr("bench::message", size, false);
+
+    wr.write(payload.data(), payload.size());
+
+    auto msg = wr.complete();
+
+    benchmark::DoNotOptimize(msg);
+  }
+
+  state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(size));
+}
+
+BENCHMARK(BM_WriterMessage)->RangeMultiplier(8)->Range(16, 1 << 20);
+
+/**
+ * @brief Encodes a camera frame, with the arguments being the width, the height and the quality (in percent).
+ * */
+void
+BM_RgbCameraUpdate(benchmark::State& state)
+{
+  const auto w = static_cast<int>(state.range(0));
+
+  const auto h = static_cast<int>(state.range(1));
+
+  const auto quality = static_cast<float>(state.range(2)) / 100.0f;
+
+  const auto image = sentinel::proto::bench::make_image(w, h);
+
+  std::size_t message_size{};
+
+  for (auto _ : state) {
+
+    auto msg = sentinel::proto::writer::create_rgb_camera_update(image.data(), w, h, 0, 0, {}, quality);
+
+    message_size = msg->buffer->size();
+
+    benchmark::DoNotOptimize(msg);
+  }
+
+  state.SetItemsProcessed(state.iterations());
+
+  state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(image.size()));
+
+  state.counters["message_size"] = static_cast<double>(message_size);
+}
+
+BENCHMARK(BM_RgbCameraUpdate)
+  ->ArgNames({ "w", "h", "quality" })
+  ->ArgsProduct({ { 320 }, { 240 }, { 25, 50, 90 } })
+  ->ArgsProduct({ { 640 }, { 480 }, { 25, 50, 90 } })
+  ->ArgsProduct({ { 1280 }, { 720 }, { 25, 50, 90 } })
+  ->Unit(benchmark::kMillisecond);
+
+void
+BM_MicrophoneLevel(benchmark::State& state)
+{
+  const std::vector<float> bands(static_cast<std::size_t>(state.range(0)), 0.25f);
+
+  for (auto _ : state) {
+
+    auto msg = sentinel::proto::writer::create_microphone_level(
+      0.5f, 0.1f, bands.data(), static_cast<std::uint32_t>(bands.size()), 0, 0);
+
+    benchmark::DoNotOptimize(msg);
+  }
+}
+
+BENCHMARK(BM_MicrophoneLevel)->Arg(0)->Arg(16)->Arg(64);
+
+} // namespace
@@ -4,6 +4,7 @@
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include <cstddef>
@@ -36,6 +37,109 @@ public:
   ~message_incomplete_exception() override = default;
 };
 
+/**
+ * @brief The versions of the framing that messages are sent in.
+ *
+ * @details Version 1 (the default) puts the type of each message in its header as a string. Version 2 has a fixed-size
+ *          binary header instead, with a numeric type code and a sequence number. It is only sent to clients that ask
+ *          for it.
+ * */
+enum class protocol_version : std::uint32_t
+{
+  v1 = 1,
+  v2 = 2
+};
+
+/**
+ * @brief The numeric codes of the message types, which are sent in place of the type strings in version 2 headers.
+ *
+ * @note Codes are never renumbered or reused, since they are part of the protocol.
+ * */
+enum class message_type : std::uint16_t
+{
+  unknown = 0,
+  ready = 1,
+  protocol = 2,
+  aggregate = 3,
+  timed = 4,
+  rgb_camera_update = 5,
+  monochrome_camera_update = 6,
+  microphone_update = 7,
+  microphone_adpcm = 8,
+  microphone_level = 9,
+  microphone_event = 10,
+  temperature_update = 11,
+  subscription = 12
+};
+
+/**
+ * @brief The number of message type codes, including the unknown type.
+ * */
+constexpr std::size_t message_type_count{ 13 };
+
+/**
+ * @brief Gets the code of a message type.
+ *
+ * @param name The type string of the message, such as "rgb_camera::update".
+ *
+ * @return The code of the type, or @ref message_type::unknown if there is none.
+ * */
+auto
+get_message_type(std::string_view name) -> message_type;
+
+/**
+ * @brief Gets the type string of a message type code.
+ *
+ * @return The type string, which is empty for unknown codes.
+ * */
+auto
+get_message_type_name(message_type type) -> const std::string&;
+
+/**
+ * @brief Indicates whether newer messages of a type may replace older ones in a queue.
+ *
+ * @return The `conflate` constant of the schema of the type, or false for types without a schema (such as aggregate and
+ *         timed messages).
+ * */
+auto
+is_conflatable(message_type type) -> bool;
+
+/**
+ * @brief The flags in a version 2 header.
+ * */
+enum message_flags : std::uint16_t
+{
+  /**
+   * @brief Newer messages of the same type may replace this one while it is queued for a client. A gap in the sequence
+   *        numbers before a message with this flag was most likely caused by conflation, rather than by dropping
+   *        messages.
+   * */
+  message_flag_conflatable = 1
+};
+
+/**
+ * @brief The optional data that a client subscribes to with a subscription message.
+ * */
+enum subscription_flags : std::uint32_t
+{
+  /**
+   * @brief The client receives the audio samples of the microphones, which are much larger than the level updates
+   *        that every client receives.
+   * */
+  subscription_pcm = 1,
+
+  /**
+   * @brief The client accepts IMA-ADPCM audio samples in place of plain ones. This only has an effect along with
+   *        @ref subscription_pcm.
+   * */
+  subscription_adpcm = 2
+};
+
+/**
+ * @brief The size of a version 2 header.
+ * */
+constexpr std::size_t header_v2_size{ 12 };
+
 /**
  * @brief Used to describe the results of a read operation.
  * */
@@ -75,6 +179,58 @@ struct read_result final
 auto
 read(const std::uint8_t* data, std::size_t size) -> read_result;
 
+/**
+ * @brief Used to describe the results of reading a message in the version 2 framing.
+ * */
+struct read_v2_result final
+{
+  /**
+   * @brief How many bytes to remove from the beginning of the read buffer.
+   * */
+  std::size_t cull_size{};
+
+  /**
+   * @brief The type of the message that was read, which may be @ref message_type::unknown for types that are newer
+   *        than this library.
+   * */
+  message_type type{ message_type::unknown };
+
+  /**
+   * @brief The flags of the message, from @ref message_flags.
+   * */
+  std::uint16_t flags{};
+
+  /**
+   * @brief The number of the message among the messages of its type, which starts at one. Zero means that the message
+   *        is not numbered, which is the case for aggregate and timed messages (the messages that they wrap are).
+   * */
+  std::uint32_t sequence{};
+
+  /**
+   * @brief The byte offset to the beginning of the payload.
+   * */
+  std::size_t payload_offset{ 0 };
+
+  /**
+   * @brief The number of bytes in the payload.
+   * */
+  std::size_t payload_size{ 0 };
+
+  /**
+   * @brief Whether or not the payload in the message is complete.
+   * */
+  bool payload_ready{ false };
+};
+
+/**
+ * @brief Attempts to extract a message in the version 2 framing from a read buffer. Unlike @ref read, this does not
+ *        allocate memory.
+ *
+ * @return The result of the read operation.
+ * */
+auto
+read_v2(const std::uint8_t* data, std::size_t size) -> read_v2_result;
+
 /**
  * @brief Used to describe bounding boxes in pixel space.
  * */
@@ -173,11 +329,74 @@ struct microphone_buffer_event final
   std::uint32_t sensor_id{};
 };
 
+/**
+ * @brief The times that a message passed through each stage of the server, in microseconds since Unix epoch (the same
+ *        clock as the capture times in the payloads). A stage that was not stamped is zero.
+ *
+ * @details Clients can compare these against the time that they received the message at, which is only meaningful
+ *          if their clock is synchronized with the server's.
+ * */
+struct message_timing final
+{
+  /**
+   * @brief When the data in the message was captured.
+   * */
+  std::uint64_t captured{};
+
+  /**
+   * @brief When the message was composed, after the pipeline was done with the data (filtering, storing, encoding).
+   * */
+  std::uint64_t encoded{};
+
+  /**
+   * @brief When the IO loop received the message from the pipeline, to queue it for the clients.
+   * */
+  std::uint64_t enqueued{};
+
+  /**
+   * @brief When the message was written to the socket of the client.
+   * */
+  std::uint64_t written{};
+
+  static constexpr auto serialized_size() -> std::size_t { return 32; }
+};
+
+/**
+ * @brief The stamps of a timed message that are set after it was composed.
+ * */
+enum class timing_stamp
+{
+  enqueued,
+  written
+};
+
+/**
+ * @brief Sets a stamp in every timed message of a buffer, including the ones in aggregates. Messages that are not
+ *        timed are left as they are.
+ *
+ * @param data The buffer of whole messages, such as the one of an outbound message.
+ *
+ * @param time The time to set the stamp to, in microseconds since Unix epoch.
+ *
+ * @return The number of messages that were stamped.
+ * */
+auto
+set_timing_stamp(std::uint8_t* data,
+                 std::size_t size,
+                 timing_stamp stamp,
+                 std::uint64_t time,
+                 protocol_version version = protocol_version::v1) -> std::size_t;
+
 class payload_visitor
 {
 public:
   virtual ~payload_visitor() = default;
 
+  /**
+   * @brief Called with the stamps of a timed message, right before its payload is visited.
+   * */
+  virtual void visit_message_timing(const message_timing&) {}
+
   virtual void visit_rgb_camera_frame_event(const camera_frame_event&) = 0;
 
   virtual void visit_monochrome_camera_frame_event(const camera_frame_event&) = 0;
@@ -190,6 +409,31 @@ public:
 
   virtual void visit_temperature_update(const float temperature, std::uint64_t time, std::uint32_t sensor_id) = 0;
 
+  /**
+   * @brief Called with the features of a microphone's audio over a short interval.
+   *
+   * @param peak The peak absolute sample value, in the range [0, 1].
+   *
+   * @param rms The root mean square of the samples, in the range [0, 1].
+   *
+   * @param bands The mean square of the samples in each frequency band, from lowest to highest.
+   *
+   * @param band_count The number of frequency bands, which may be zero.
+   * */
+  virtual void visit_microphone_level(float peak,
+                                      float rms,
+                                      const float* bands,
+                                      std::uint32_t band_count,
+                                      std::uint64_t time,
+                                      std::uint32_t sensor_id) = 0;
+
+  /**
+   * @brief Called when an acoustic event starts or ends on a microphone.
+   *
+   * @param active Whether the event started (true) or ended (false).
+   * */
+  virtual void visit_microphone_event(bool active, std::uint64_t time, std::uint32_t sensor_id) = 0;
+
   /**
    * @brief Called when the payload is not able to be decoded.
    *
@@ -218,6 +462,17 @@ public:
 
   void visit_temperature_update(const float temperature, std::uint64_t time, std::uint32_t sensor_id) override {}
 
+  void visit_microphone_level(float peak,
+                              float rms,
+                              const float* bands,
+                              std::uint32_t band_count,
+                              std::uint64_t time,
+                              std::uint32_t sensor_id) override
+  {
+  }
+
+  void visit_microphone_event(bool active, std::uint64_t time, std::uint32_t sensor_id) override {}
+
   auto visit_unknown_payload(const std::string& type, const void* payload, std::size_t size) -> bool override
   {
     return true;
@@ -233,11 +488,25 @@ public:
  *
  * @param visitor The visitor to pass the decoded information to.
  *
+ * @param version The framing of the messages that are nested in the payload (such as the ones in an aggregate).
+ *
+ * @return True if the message was able to be decoded, false otherwise.
+ * */
+auto
+decode_payload(const std::string& type,
+               const void* payload,
+               std::size_t payload_size,
+               payload_visitor& visitor,
+               protocol_version version = protocol_version::v1) -> bool;
+
+/**
+ * @brief Attempts to decode the payload of a message that was read with @ref read_v2. The decoder of the type is
+ *        looked up by its code, instead of by comparing type strings.
+ *
  * @return True if the message was able to be decoded, false otherwise.
  * */
 auto
-decode_payload(const std::string& type, const void* payload, std::size_t payload_size, payload_visitor& visitor)
-  -> bool;
+decode_payload(message_type type, const void* payload, std::size_t payload_size, payload_visitor& visitor) -> bool;
 
 struct outbound_message final
 {
@@ -251,12 +520,87 @@ struct outbound_message final
    * */
   bool conflate{ false };
 
+  /**
+   * @brief The type of the message (or of the message that it wraps, for a timed message), which its sequence number
+   *        is counted by.
+   * */
+  message_type type{ message_type::unknown };
+
+  /**
+   * @brief The number of the message among the messages of its type, which the server assigns when it publishes the
+   *        message. This is only sent in the version 2 framing.
+   * */
+  std::uint32_t sequence{};
+
   /**
    * @brief The data to send across the wire.
    * */
   std::shared_ptr<std::vector<std::uint8_t>> buffer;
+
+  /**
+   * @brief An optional, compressed encoding of the same message, which is sent in its place to clients that accept it.
+   * */
+  std::shared_ptr<outbound_message> compressed;
+};
+
+/**
+ * @brief The state of an IMA-ADPCM encoder or decoder, at the start of a block of samples.
+ * */
+struct adpcm_state final
+{
+  std::int16_t predictor{};
+
+  std::uint8_t step_index{};
+};
+
+/**
+ * @brief Appends a message to a buffer in the version 2 framing, along with the messages that are nested in it.
+ *
+ * @param out The buffer to append the message to.
+ *
+ * @param msg The message to append, whose sequence number is put in its header. The flags of each header come from
+ *            the type of the message, see @ref is_conflatable.
+ *
+ * @return True on success, false if the message is malformed or has a type without a code (in which case the buffer is
+ *         left as it was).
+ * */
+auto
+append_v2(std::vector<std::uint8_t>& out, const outbound_message& msg) -> bool;
+
+/**
+ * @brief A streaming IMA-ADPCM encoder, which compresses 16-bit samples into 4 bits each.
+ *
+ * @details The state carries over from one call to the next, so that a continuous stream is encoded without a jump at
+ *          the start of each block. The state at the start of each block is sent along with it, so that each block can
+ *          be decoded on its own.
+ * */
+class adpcm_encoder final
+{
+public:
+  auto get_state() const -> adpcm_state { return m_state; }
+
+  /**
+   * @brief Encodes a block of samples.
+   *
+   * @param output The encoded samples, which must have room for (size + 1) / 2 bytes. The first sample of each byte is
+   *               in the low nibble.
+   * */
+  void encode(const std::int16_t* samples, std::size_t size, std::uint8_t* output);
+
+private:
+  adpcm_state m_state;
 };
 
+/**
+ * @brief Decodes a block of IMA-ADPCM samples.
+ *
+ * @param state The state of the encoder at the start of the block.
+ *
+ * @param size The number of samples to decode.
+ * */
+void
+adpcm_decode(adpcm_state state, const std::uint8_t* input, std::size_t size, std::int16_t* output);
+
 /**
  * @brief Used for composing messages.
  * */
@@ -265,6 +609,27 @@ class writer final
 public:
   static auto create_ready_update(std::uint64_t time) -> std::shared_ptr<outbound_message>;
 
+  /**
+   * @brief Composes a protocol message, which a client sends to ask for a protocol version and which the server sends
+   *        back with the version that it switched to.
+   *
+   * @note This message is always sent in the version 1 framing.
+   * */
+  static auto create_protocol_update(protocol_version version) -> std::shared_ptr<outbound_message>;
+
+  /**
+   * @brief Composes a subscription message, which a client sends to choose the optional data that it receives.
+   *
+   * @param flags The data to subscribe to, from @ref subscription_flags. Anything that is not included is unsubscribed
+   *              from.
+   * */
+  static auto create_subscription_update(std::uint32_t flags) -> std::shared_ptr<outbound_message>;
+
+  /**
+   * @brief Composes a JPEG encoded camera frame.
+   *
+   * @note The people detections are not part of the message layout yet, so they are not sent.
+   * */
   static auto create_rgb_camera_update(const std::uint8_t* data,
                                        std::uint16_t w,
                                        std::uint16_t h,
@@ -273,6 +638,28 @@ public:
                                        const std::vector<pixel_space_detection>& people,
                                        float jpeg_quality) -> std::shared_ptr<outbound_message>;
 
+  /**
+   * @brief Composes the beginning of an RGB camera update, up to where the JPEG data begins.
+   *
+   * @details This is used for sending JPEG data that has already been encoded, such as the frames in storage. The caller
+   *          is responsible for sending exactly @p jpeg_size bytes of JPEG data after the returned prefix.
+   *
+   * @param jpeg_size The number of bytes in the JPEG data that follows the prefix.
+   *
+   * @param time The time that the frame was taken at, in terms of microseconds since Unix epoch.
+   *
+   * @param sensor_id The ID of the camera that took the frame.
+   *
+   * @return The header, type and fixed-size payload fields of the message.
+   * */
+  static auto create_rgb_camera_update_prefix(std::uint32_t jpeg_size, std::uint64_t time, std::uint32_t sensor_id)
+    -> std::vector<std::uint8_t>;
+
+  /**
+   * @brief Composes an uncompressed camera frame, with one byte per pixel.
+   *
+   * @note The people detections are not part of the message layout yet, so they are not sent.
+   * */
   static auto create_monochrome_camera_update(const std::uint8_t* data,
                                               std::uint16_t w,
                                               std::uint16_t h,
@@ -287,9 +674,107 @@ public:
                                        std::uint64_t time,
                                        std::uint32_t sensor_id) -> std::shared_ptr<outbound_message>;
 
+  /**
+   * @brief The offset of the samples within a microphone update.
+   * */
+  static constexpr std::size_t microphone_update_samples_offset{ 8 + 18 + 20 };
+
+  /**
+   * @brief Composes a microphone update around samples that have already been written into a buffer.
+   *
+   * @details This is used for capturing samples straight into a message buffer, so that they do not need to be copied
+   *          and so that the buffer can be reused for later messages.
+   *
+   * @param buffer The buffer that the samples were written into, at @ref writer::microphone_update_samples_offset. It
+   *               is resized to the size of the message, which does not allocate memory if the buffer was made by
+   *               @ref writer::create_microphone_update with at least as many samples.
+   *
+   * @param size The number of samples in the buffer.
+   * */
+  static void complete_microphone_update(std::vector<std::uint8_t>& buffer,
+                                         std::uint32_t size,
+                                         std::uint32_t sample_rate,
+                                         std::uint64_t time,
+                                         std::uint32_t sensor_id);
+
+  /**
+   * @brief Composes a microphone update with IMA-ADPCM samples, which is a quarter of the size of a plain one.
+   *
+   * @details This is decoded into the same visitor call as a plain microphone update.
+   *
+   * @param encoder The encoder of the microphone's stream, which is updated with the samples.
+   * */
+  static auto create_microphone_adpcm_update(adpcm_encoder& encoder,
+                                             const std::int16_t* data,
+                                             std::uint32_t size,
+                                             std::uint32_t sample_rate,
+                                             std::uint64_t time,
+                                             std::uint32_t sensor_id) -> std::shared_ptr<outbound_message>;
+
+  /**
+   * @brief Composes a microphone update with IMA-ADPCM samples into an existing buffer.
+   *
+   * @details This is used for reusing the compressed message of a buffer that is published repeatedly, so that no
+   *          memory is allocated per message.
+   *
+   * @param buffer The buffer to write the message into. It is resized to the size of the message, which does not
+   *               allocate memory if the buffer was made by @ref writer::create_microphone_adpcm_update with at least
+   *               as many samples.
+   *
+   * @param encoder The encoder of the microphone's stream, which is updated with the samples.
+   * */
+  static void complete_microphone_adpcm_update(std::vector<std::uint8_t>& buffer,
+                                               adpcm_encoder& encoder,
+                                               const std::int16_t* data,
+                                               std::uint32_t size,
+                                               std::uint32_t sample_rate,
+                                               std::uint64_t time,
+                                               std::uint32_t sensor_id);
+
+  /**
+   * @brief Composes a microphone level update, which is a compact summary of the audio that can be sent in place of the
+   *        samples.
+   *
+   * @param bands The mean square of the samples in each frequency band, or null if @p band_count is zero.
+   * */
+  static auto create_microphone_level(float peak,
+                                      float rms,
+                                      const float* bands,
+                                      std::uint32_t band_count,
+                                      std::uint64_t time,
+                                      std::uint32_t sensor_id) -> std::shared_ptr<outbound_message>;
+
+  /**
+   * @brief Composes a marker for the start or end of an acoustic event.
+   * */
+  static auto create_microphone_event(bool active, std::uint64_t time, std::uint32_t sensor_id)
+    -> std::shared_ptr<outbound_message>;
+
   static auto create_temperature_update(float temperature, std::uint64_t time, std::uint32_t sensor_id)
     -> std::shared_ptr<outbound_message>;
 
+  /**
+   * @brief Wraps a message in a timed message, which carries the stamps of @ref message_timing along with it.
+   *
+   * @details The timed message keeps the type hash and conflation of the original one, so it is queued the same way.
+   *          The compressed encoding of the message (if any) is wrapped too. The enqueued and written stamps start out
+   *          as zero, and are set with @ref set_timing_stamp.
+   *
+   * @param captured The time that the data in the message was captured, in microseconds since Unix epoch.
+   *
+   * @param encoded The time that the message was composed, in microseconds since Unix epoch.
+   * */
+  static auto create_timed(const outbound_message& msg, std::uint64_t captured, std::uint64_t encoded)
+    -> std::shared_ptr<outbound_message>;
+
+  /**
+   * @brief Converts a message to the version 2 framing, using @ref append_v2. The converted message keeps the type,
+   *        sequence number and conflation of the original.
+   *
+   * @return The converted message, or null if the message cannot be converted.
+   * */
+  static auto create_v2(const outbound_message& msg) -> std::shared_ptr<outbound_message>;
+
   /**
    * @brief Constructs a new writer.
    *
@@ -327,6 +812,8 @@ private:
 
   std::size_t m_type_hash{};
 
+  message_type m_type{ message_type::unknown };
+
   bool m_conflate{ false };
 };
 
@@ -361,17 +848,31 @@ public:
   /**
    * @brief Aggregates all messages into one.
    *
+   * @param version The framing of the aggregate and of the messages in it.
+   *
    * @note The caller should clear the queue after calling this function, in most circumstances.
    * */
-  auto aggregate() const -> std::shared_ptr<outbound_message>;
+  auto aggregate(protocol_version version = protocol_version::v1) const -> std::shared_ptr<outbound_message>;
+
+  /**
+   * @brief Gets the number of messages that were removed before they could be sent, either because they were
+   *        conflated or because their topic was full.
+   *
+   * @note This is not reset by @ref queue::clear.
+   * */
+  auto get_dropped() const -> std::uint64_t { return m_dropped; }
 
 protected:
   using map_type = std::map<std::size_t, std::vector<std::shared_ptr<outbound_message>>>;
 
+  auto aggregate_v2() const -> std::shared_ptr<outbound_message>;
+
 private:
   map_type m_queue;
 
   std::size_t m_max_messages_per_topic{};
+
+  std::uint64_t m_dropped{};
 };
 
 } // namespace sentinel::proto
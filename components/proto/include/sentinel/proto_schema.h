@@ -0,0 +1,613 @@
+#pragma once
+
+#include <sentinel/proto.h>
+
+#include <array>
+#include <memory>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * @file proto_schema.h
+ *
+ * @brief The layout of each message payload, described once at compile time. The encoders, sizes and decoders of the
+ *        messages are instantiated from these descriptions, instead of being written out by hand for each message.
+ *
+ * @details A message is described by a struct with its fields, along with these static members:
+ *
+ *          - `type`: The @ref message_type code of the message.
+ *          - `name`: The type string of the message (a string literal).
+ *          - `conflate`: Whether or not newer messages of the type may replace older ones in a queue.
+ *          - `fields()`: The member pointers of the fixed-size fields, in the order that they are serialized.
+ *
+ *          A message may end with an array, whose length is given by its fixed-size fields. It is described with:
+ *
+ *          - `tail_type`: The element type of the array.
+ *          - `tail()`: The member pointer to the (const) pointer to the array.
+ *          - `tail_count(msg)`: The number of elements in the array.
+ *
+ *          Fields are serialized in host byte order (which is little endian on every supported platform) without any
+ *          padding. When a message is decoded, its array points into the payload, so it is only valid for as long as
+ *          the payload is and it may not be aligned for its element type.
+ *
+ *          Adding a message that the server sends takes:
+ *
+ *          - One of these structs, and an entry in @ref schema_messages.
+ *          - A code in @ref message_type, and a matching @ref message_type_count.
+ *          - A method of @ref payload_visitor (and its empty override in @ref payload_visitor_base), along with the
+ *            overload in read.cpp that calls it.
+ *
+ *          The type strings and conflation of the codes are generated from the structs, and the build fails if a code
+ *          is left without a struct or if an overload is missing. Messages that a client sends are not decoded, so
+ *          they are listed with the other client messages in message_type.cpp and read.cpp instead.
+ * */
+
+namespace sentinel::proto {
+
+/**
+ * @brief Sent by a client when it is ready for more data.
+ * */
+struct ready_message final
+{
+  std::uint64_t time{};
+
+  static constexpr message_type type{ message_type::ready };
+
+  static constexpr std::string_view name{ "ready" };
+
+  static constexpr bool conflate{ true };
+
+  static constexpr auto fields() { return std::make_tuple(&ready_message::time); }
+};
+
+/**
+ * @brief Sent by a client to ask for a protocol version, and by the server with the version that it chose.
+ * */
+struct protocol_message final
+{
+  std::uint32_t version{};
+
+  static constexpr message_type type{ message_type::protocol };
+
+  static constexpr std::string_view name{ "protocol" };
+
+  static constexpr bool conflate{ false };
+
+  static constexpr auto fields() { return std::make_tuple(&protocol_message::version); }
+};
+
+/**
+ * @brief Sent by a client to choose the optional data that it receives.
+ * */
+struct subscription_message final
+{
+  std::uint32_t flags{};
+
+  static constexpr message_type type{ message_type::subscription };
+
+  static constexpr std::string_view name{ "subscription" };
+
+  static constexpr bool conflate{ false };
+
+  static constexpr auto fields() { return std::make_tuple(&subscription_message::flags); }
+};
+
+/**
+ * @brief A JPEG encoded frame from a color camera.
+ * */
+struct rgb_camera_update_message final
+{
+  std::uint32_t jpeg_size{};
+
+  std::uint64_t time{};
+
+  std::uint32_t sensor_id{};
+
+  const std::uint8_t* jpeg{};
+
+  static constexpr message_type type{ message_type::rgb_camera_update };
+
+  static constexpr std::string_view name{ "rgb_camera::update" };
+
+  static constexpr bool conflate{ true };
+
+  static constexpr auto fields()
+  {
+    return std::make_tuple(
+      &rgb_camera_update_message::jpeg_size, &rgb_camera_update_message::time, &rgb_camera_update_message::sensor_id);
+  }
+
+  using tail_type = std::uint8_t;
+
+  static constexpr auto tail() { return &rgb_camera_update_message::jpeg; }
+
+  static constexpr auto tail_count(const rgb_camera_update_message& msg) -> std::size_t { return msg.jpeg_size; }
+};
+
+/**
+ * @brief An uncompressed frame from a monochrome camera, with one byte per pixel.
+ * */
+struct monochrome_camera_update_message final
+{
+  std::uint16_t w{};
+
+  std::uint16_t h{};
+
+  std::uint64_t time{};
+
+  std::uint32_t sensor_id{};
+
+  const std::uint8_t* pixels{};
+
+  static constexpr message_type type{ message_type::monochrome_camera_update };
+
+  static constexpr std::string_view name{ "monochrome_camera::update" };
+
+  static constexpr bool conflate{ true };
+
+  static constexpr auto fields()
+  {
+    return std::make_tuple(&monochrome_camera_update_message::w,
+                           &monochrome_camera_update_message::h,
+                           &monochrome_camera_update_message::time,
+                           &monochrome_camera_update_message::sensor_id);
+  }
+
+  using tail_type = std::uint8_t;
+
+  static constexpr auto tail() { return &monochrome_camera_update_message::pixels; }
+
+  static constexpr auto tail_count(const monochrome_camera_update_message& msg) -> std::size_t
+  {
+    return static_cast<std::size_t>(msg.w) * msg.h;
+  }
+};
+
+/**
+ * @brief A block of 16-bit samples from a microphone.
+ * */
+struct microphone_update_message final
+{
+  std::uint32_t sample_rate{};
+
+  std::uint32_t size{};
+
+  std::uint64_t time{};
+
+  std::uint32_t sensor_id{};
+
+  const std::int16_t* samples{};
+
+  static constexpr message_type type{ message_type::microphone_update };
+
+  static constexpr std::string_view name{ "microphone::update" };
+
+  static constexpr bool conflate{ false };
+
+  static constexpr auto fields()
+  {
+    return std::make_tuple(&microphone_update_message::sample_rate,
+                           &microphone_update_message::size,
+                           &microphone_update_message::time,
+                           &microphone_update_message::sensor_id);
+  }
+
+  using tail_type = std::int16_t;
+
+  static constexpr auto tail() { return &microphone_update_message::samples; }
+
+  static constexpr auto tail_count(const microphone_update_message& msg) -> std::size_t { return msg.size; }
+};
+
+/**
+ * @brief A block of IMA-ADPCM samples from a microphone, along with the state of the encoder at the start of it.
+ * */
+struct microphone_adpcm_message final
+{
+  std::uint32_t sample_rate{};
+
+  std::uint32_t size{};
+
+  std::uint64_t time{};
+
+  std::uint32_t sensor_id{};
+
+  std::int16_t predictor{};
+
+  std::uint8_t step_index{};
+
+  std::uint8_t reserved{};
+
+  const std::uint8_t* encoded{};
+
+  static constexpr message_type type{ message_type::microphone_adpcm };
+
+  static constexpr std::string_view name{ "microphone::adpcm" };
+
+  static constexpr bool conflate{ false };
+
+  static constexpr auto fields()
+  {
+    return std::make_tuple(&microphone_adpcm_message::sample_rate,
+                           &microphone_adpcm_message::size,
+                           &microphone_adpcm_message::time,
+                           &microphone_adpcm_message::sensor_id,
+                           &microphone_adpcm_message::predictor,
+                           &microphone_adpcm_message::step_index,
+                           &microphone_adpcm_message::reserved);
+  }
+
+  using tail_type = std::uint8_t;
+
+  static constexpr auto tail() { return &microphone_adpcm_message::encoded; }
+
+  static constexpr auto tail_count(const microphone_adpcm_message& msg) -> std::size_t
+  {
+    return (static_cast<std::size_t>(msg.size) + 1) / 2;
+  }
+};
+
+/**
+ * @brief A summary of the audio from a microphone over a short interval.
+ * */
+struct microphone_level_message final
+{
+  float peak{};
+
+  float rms{};
+
+  std::uint64_t time{};
+
+  std::uint32_t sensor_id{};
+
+  std::uint32_t band_count{};
+
+  const float* bands{};
+
+  static constexpr message_type type{ message_type::microphone_level };
+
+  static constexpr std::string_view name{ "microphone::level" };
+
+  static constexpr bool conflate{ false };
+
+  static constexpr auto fields()
+  {
+    return std::make_tuple(&microphone_level_message::peak,
+                           &microphone_level_message::rms,
+                           &microphone_level_message::time,
+                           &microphone_level_message::sensor_id,
+                           &microphone_level_message::band_count);
+  }
+
+  using tail_type = float;
+
+  static constexpr auto tail() { return &microphone_level_message::bands; }
+
+  static constexpr auto tail_count(const microphone_level_message& msg) -> std::size_t { return msg.band_count; }
+};
+
+/**
+ * @brief The start (active is one) or end (active is zero) of an acoustic event on a microphone.
+ * */
+struct microphone_event_message final
+{
+  std::uint64_t time{};
+
+  std::uint32_t sensor_id{};
+
+  std::uint32_t active{};
+
+  static constexpr message_type type{ message_type::microphone_event };
+
+  static constexpr std::string_view name{ "microphone::event" };
+
+  static constexpr bool conflate{ false };
+
+  static constexpr auto fields()
+  {
+    return std::make_tuple(
+      &microphone_event_message::time, &microphone_event_message::sensor_id, &microphone_event_message::active);
+  }
+};
+
+struct temperature_update_message final
+{
+  float temperature{};
+
+  std::uint64_t time{};
+
+  std::uint32_t sensor_id{};
+
+  static constexpr message_type type{ message_type::temperature_update };
+
+  static constexpr std::string_view name{ "temperature::update" };
+
+  static constexpr bool conflate{ true };
+
+  static constexpr auto fields()
+  {
+    return std::make_tuple(&temperature_update_message::temperature,
+                           &temperature_update_message::time,
+                           &temperature_update_message::sensor_id);
+  }
+};
+
+template<typename... Messages>
+struct message_list final
+{
+};
+
+/**
+ * @brief The messages that @ref visit_message decodes. Aggregate and timed messages are not in this list, since they
+ *        wrap other messages instead of having fields of their own, and neither are the messages of the client (ready,
+ *        protocol and subscription), which are handled by the connection.
+ * */
+using schema_messages = message_list<rgb_camera_update_message,
+                                     monochrome_camera_update_message,
+                                     microphone_update_message,
+                                     microphone_adpcm_message,
+                                     microphone_level_message,
+                                     microphone_event_message,
+                                     temperature_update_message>;
+
+namespace schema {
+
+template<typename Member>
+struct member_traits;
+
+template<typename Owner, typename Value>
+struct member_traits<Value Owner::*> final
+{
+  using value_type = Value;
+};
+
+template<typename Message, typename = void>
+struct has_tail : std::false_type
+{
+};
+
+template<typename Message>
+struct has_tail<Message, std::void_t<typename Message::tail_type>> : std::true_type
+{
+};
+
+/**
+ * @brief Gets the size of the fixed-size fields of a message, which come before its array (if it has one).
+ * */
+template<typename Message>
+constexpr auto
+get_fixed_size() -> std::size_t
+{
+  return std::apply(
+    [](auto... members) {
+      return (std::size_t{} + ... + sizeof(typename member_traits<decltype(members)>::value_type));
+    },
+    Message::fields());
+}
+
+/**
+ * @brief Gets the size of the version 1 header of a message, including its type string.
+ * */
+template<typename Message>
+constexpr auto
+get_header_size() -> std::size_t
+{
+  return 8 + Message::name.size();
+}
+
+/**
+ * @brief Gets the number of bytes in the array at the end of a message.
+ * */
+template<typename Message>
+constexpr auto
+get_tail_size(const Message& msg) -> std::size_t
+{
+  if constexpr (has_tail<Message>::value) {
+    return Message::tail_count(msg) * sizeof(typename Message::tail_type);
+  } else {
+    return 0;
+  }
+}
+
+template<typename Message>
+constexpr auto
+get_payload_size(const Message& msg) -> std::size_t
+{
+  return get_fixed_size<Message>() + get_tail_size(msg);
+}
+
+/**
+ * @brief Writes the fixed-size fields of a message.
+ *
+ * @param out Where to write the fields to, which must have room for @ref get_fixed_size bytes.
+ * */
+template<typename Message>
+void
+encode_fields(const Message& msg, std::uint8_t* out)
+{
+  std::apply(
+    [&msg, out](auto... members) {
+      std::size_t offset{};
+      ((std::memcpy(out + offset, &(msg.*members), sizeof(msg.*members)), offset += sizeof(msg.*members)), ...);
+    },
+    Message::fields());
+}
+
+/**
+ * @brief Reads the fixed-size fields of a message.
+ *
+ * @param in The fields to read, which must have at least @ref get_fixed_size bytes.
+ * */
+template<typename Message>
+void
+decode_fields(const std::uint8_t* in, Message& msg)
+{
+  std::apply(
+    [&msg, in](auto... members) {
+      std::size_t offset{};
+      ((std::memcpy(&(msg.*members), in + offset, sizeof(msg.*members)), offset += sizeof(msg.*members)), ...);
+    },
+    Message::fields());
+}
+
+/**
+ * @brief Writes the version 1 header of a message, along with its type string.
+ *
+ * @param out Where to write the header to, which must have room for @ref get_header_size bytes.
+ * */
+template<typename Message>
+void
+encode_header(const Message& msg, std::uint8_t* out)
+{
+  const std::uint32_t header[2]{ static_cast<std::uint32_t>(Message::name.size()),
+                                 static_cast<std::uint32_t>(get_payload_size(msg)) };
+
+  std::memcpy(out, header, sizeof(header));
+
+  std::memcpy(out + sizeof(header), Message::name.data(), Message::name.size());
+}
+
+/**
+ * @brief Writes the payload of a message.
+ *
+ * @param out Where to write the payload to, which must have room for @ref get_payload_size bytes.
+ * */
+template<typename Message>
+void
+encode_payload(const Message& msg, std::uint8_t* out)
+{
+  encode_fields(msg, out);
+
+  if constexpr (has_tail<Message>::value) {
+
+    const auto tail_size = get_tail_size(msg);
+
+    if (tail_size > 0) {
+      std::memcpy(out + get_fixed_size<Message>(), msg.*Message::tail(), tail_size);
+    }
+  }
+}
+
+/**
+ * @brief Reads the payload of a message.
+ *
+ * @details Bytes after the end of the message are ignored, so that fields may be added to the end of a message without
+ *          breaking older clients.
+ *
+ * @return True on success, false if the payload is too small for the message.
+ * */
+template<typename Message>
+auto
+decode_payload(const std::uint8_t* payload, const std::size_t size, Message& msg) -> bool
+{
+  constexpr auto fixed_size = get_fixed_size<Message>();
+
+  if (size < fixed_size) {
+    return false;
+  }
+
+  decode_fields(payload, msg);
+
+  if constexpr (has_tail<Message>::value) {
+
+    if ((size - fixed_size) < get_tail_size(msg)) {
+      return false;
+    }
+
+    msg.*Message::tail() = reinterpret_cast<const typename Message::tail_type*>(payload + fixed_size);
+  }
+
+  return true;
+}
+
+template<typename Message, typename Visitor>
+auto
+decode_and_visit(const std::uint8_t* payload, const std::size_t size, Visitor& visitor) -> bool
+{
+  Message msg;
+
+  if (!decode_payload(payload, size, msg)) {
+    return false;
+  }
+
+  visitor(static_cast<const Message&>(msg));
+
+  return true;
+}
+
+template<typename Visitor, typename... Messages>
+auto
+visit_message(message_list<Messages...>,
+              const message_type type,
+              const std::uint8_t* payload,
+              const std::size_t size,
+              Visitor& visitor) -> bool
+{
+  auto decoded = false;
+
+  static_cast<void>(
+    ((type == Messages::type ? (decoded = decode_and_visit<Messages>(payload, size, visitor), true) : false) || ...));
+
+  return decoded;
+}
+
+} // namespace schema
+
+/**
+ * @brief Composes a message from its fields.
+ *
+ * @return The message, in the version 1 framing.
+ * */
+template<typename Message>
+auto
+create_message(const Message& msg) -> std::shared_ptr<outbound_message>
+{
+  std::array<std::uint8_t, schema::get_fixed_size<Message>()> fields{};
+
+  schema::encode_fields(msg, fields.data());
+
+  writer wr(Message::name.data(), schema::get_payload_size(msg), Message::conflate);
+
+  wr.write(fields.data(), fields.size());
+
+  if constexpr (schema::has_tail<Message>::value) {
+
+    const auto tail_size = schema::get_tail_size(msg);
+
+    if (tail_size > 0) {
+      wr.write(msg.*Message::tail(), tail_size);
+    }
+  }
+
+  return wr.complete();
+}
+
+/**
+ * @brief Decodes the payload of a message that is described by a schema, and passes it to a visitor.
+ *
+ * @details Unlike @ref decode_payload, this has no virtual calls and does not copy any data: the decoder of each type
+ *          is instantiated for the visitor, so that it can be inlined into the caller.
+ *
+ * @param type The type of the message, from its header.
+ *
+ * @param visitor Called with the decoded message (for example, `const temperature_update_message&`). It has to accept
+ *                every message in @ref schema_messages, which a generic lambda or a set of overloads can do.
+ *
+ * @return True if the message was decoded, false if its type is not in @ref schema_messages or its payload is too
+ *         small.
+ * */
+template<typename Visitor>
+auto
+visit_message(const message_type type, const void* payload, const std::size_t payload_size, Visitor&& visitor) -> bool
+{
+  return schema::visit_message(
+    schema_messages{}, type, static_cast<const std::uint8_t*>(payload), payload_size, visitor);
+}
+
+} // namespace sentinel::proto
@@ -0,0 +1,122 @@
+#include <sentinel/proto.h>
+
+#include <algorithm>
+
+namespace sentinel::proto {
+
+namespace {
+
+constexpr std::int32_t step_table[89]{
+  7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+  31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+  130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+  544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+  2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+  9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+constexpr std::int32_t index_table[8]{ -1, -1, -1, -1, 2, 4, 6, 8 };
+
+constexpr std::int32_t max_step_index{ 88 };
+
+/**
+ * @brief Updates the state with a 4-bit code, in the same way for the encoder and the decoder.
+ * */
+void
+apply_code(adpcm_state& state, const std::uint8_t code)
+{
+  const auto step = step_table[state.step_index];
+
+  auto diff = step >> 3;
+
+  if (code & 4) {
+    diff += step;
+  }
+
+  if (code & 2) {
+    diff += step >> 1;
+  }
+
+  if (code & 1) {
+    diff += step >> 2;
+  }
+
+  auto predictor = static_cast<std::int32_t>(state.predictor);
+
+  predictor += (code & 8) ? -diff : diff;
+
+  state.predictor = static_cast<std::int16_t>(std::clamp<std::int32_t>(predictor, -32768, 32767));
+
+  const auto index = static_cast<std::int32_t>(state.step_index) + index_table[code & 7];
+
+  state.step_index = static_cast<std::uint8_t>(std::clamp<std::int32_t>(index, 0, max_step_index));
+}
+
+auto
+encode_sample(adpcm_state& state, const std::int16_t sample) -> std::uint8_t
+{
+  auto step = step_table[state.step_index];
+
+  auto diff = static_cast<std::int32_t>(sample) - static_cast<std::int32_t>(state.predictor);
+
+  std::uint8_t code = 0;
+
+  if (diff < 0) {
+    code = 8;
+    diff = -diff;
+  }
+
+  if (diff >= step) {
+    code |= 4;
+    diff -= step;
+  }
+
+  step >>= 1;
+
+  if (diff >= step) {
+    code |= 2;
+    diff -= step;
+  }
+
+  step >>= 1;
+
+  if (diff >= step) {
+    code |= 1;
+  }
+
+  apply_code(state, code);
+
+  return code;
+}
+
+} // namespace
+
+void
+adpcm_encoder::encode(const std::int16_t* samples, const std::size_t size, std::uint8_t* output)
+{
+  for (std::size_t i = 0; i < size; i += 2) {
+
+    const auto low = encode_sample(m_state, samples[i]);
+
+    const auto high = ((i + 1) < size) ? encode_sample(m_state, samples[i + 1]) : std::uint8_t(0);
+
+    output[i / 2] = static_cast<std::uint8_t>(low | (high << 4));
+  }
+}
+
+void
+adpcm_decode(adpcm_state state, const std::uint8_t* input, const std::size_t size, std::int16_t* output)
+{
+  state.step_index = static_cast<std::uint8_t>(std::min<std::int32_t>(state.step_index, max_step_index));
+
+  for (std::size_t i = 0; i < size; i++) {
+
+    const auto code = static_cast<std::uint8_t>((input[i / 2] >> ((i % 2) * 4)) & 0x0f);
+
+    apply_code(state, code);
+
+    output[i] = state.predictor;
+  }
+}
+
+} // namespace sentinel::proto
@@ -0,0 +1,126 @@
+#include <sentinel/proto.h>
+#include <sentinel/proto_schema.h>
+
+#include <array>
+#include <string>
+#include <string_view>
+
+namespace sentinel::proto {
+
+namespace {
+
+/**
+ * @brief The messages that have a schema, including the ones of the client that are not in @ref schema_messages.
+ * */
+using described_messages = message_list<ready_message, protocol_message, subscription_message>;
+
+template<typename... Messages>
+constexpr void
+add_conflatable(std::array<bool, message_type_count>& table, message_list<Messages...>)
+{
+  ((table[static_cast<std::size_t>(Messages::type)] = Messages::conflate), ...);
+}
+
+constexpr auto
+make_conflatable_table() -> std::array<bool, message_type_count>
+{
+  std::array<bool, message_type_count> table{};
+  add_conflatable(table, described_messages{});
+  add_conflatable(table, schema_messages{});
+  return table;
+}
+
+/**
+ * @brief Whether or not each type may be conflated, indexed by type code.
+ * */
+constexpr auto conflatable{ make_conflatable_table() };
+
+template<typename... Messages>
+constexpr void
+add_names(std::array<std::string_view, message_type_count>& table, message_list<Messages...>)
+{
+  ((table[static_cast<std::size_t>(Messages::type)] = Messages::name), ...);
+}
+
+constexpr auto
+make_name_table() -> std::array<std::string_view, message_type_count>
+{
+  std::array<std::string_view, message_type_count> table{};
+  /* The aggregate and timed messages only wrap other messages, so they have no schema to take a name from. */
+  table[static_cast<std::size_t>(message_type::aggregate)] = "aggregate";
+  table[static_cast<std::size_t>(message_type::timed)] = "timed";
+  add_names(table, described_messages{});
+  add_names(table, schema_messages{});
+  return table;
+}
+
+/**
+ * @brief The type strings, indexed by type code.
+ * */
+constexpr auto name_table{ make_name_table() };
+
+constexpr auto
+is_every_type_named() -> bool
+{
+  for (std::size_t i = 1; i < name_table.size(); i++) {
+    if (name_table[i].empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(is_every_type_named(), "Each message type code needs a schema, and message_type_count needs to match.");
+
+/**
+ * @brief The type strings as strings, since they are returned by reference.
+ * */
+auto
+get_names() -> const std::array<std::string, message_type_count>&
+{
+  static const auto names = [] {
+    std::array<std::string, message_type_count> result;
+    for (std::size_t i = 0; i < result.size(); i++) {
+      result[i] = std::string(name_table[i]);
+    }
+    return result;
+  }();
+
+  return names;
+}
+
+} // namespace
+
+auto
+get_message_type(const std::string_view name) -> message_type
+{
+  const auto& names = get_names();
+
+  for (std::size_t i = 1; i < names.size(); i++) {
+    if (names[i] == name) {
+      return static_cast<message_type>(i);
+    }
+  }
+
+  return message_type::unknown;
+}
+
+auto
+get_message_type_name(const message_type type) -> const std::string&
+{
+  const auto& names = get_names();
+
+  const auto index = static_cast<std::size_t>(type);
+
+  return (index < names.size()) ? names[index] : names[0];
+}
+
+auto
+is_conflatable(const message_type type) -> bool
+{
+  const auto index = static_cast<std::size_t>(type);
+
+  return (index < conflatable.size()) && conflatable[index];
+}
+
+} // namespace sentinel::proto
@@ -1,5 +1,7 @@
 #include <sentinel/proto.h>
 
+#include <cstring>
+
 namespace sentinel::proto {
 
 queue::queue(std::size_t max_messages_per_topic)
@@ -24,6 +26,7 @@ queue::add(std::shared_ptr<outbound_message> msg)
 
   if (msg->conflate) {
     /* The message will be replaced. */
+    m_dropped += it->second.size();
     it->second.clear();
   }
 
@@ -31,14 +34,19 @@ queue::add(std::shared_ptr<outbound_message> msg)
 
   if (vec.size() >= m_max_messages_per_topic) {
     vec.erase(vec.begin());
+    m_dropped++;
   }
 
   vec.emplace_back(msg);
 }
 
 auto
-queue::aggregate() const -> std::shared_ptr<outbound_message>
+queue::aggregate(const protocol_version version) const -> std::shared_ptr<outbound_message>
 {
+  if (version == protocol_version::v2) {
+    return aggregate_v2();
+  }
+
   std::size_t size = 0;
 
   for (const auto& entry : m_queue) {
@@ -62,4 +70,49 @@ queue::aggregate() const -> std::shared_ptr<outbound_message>
   return wr.complete();
 }
 
+auto
+queue::aggregate_v2() const -> std::shared_ptr<outbound_message>
+{
+  std::size_t size = header_v2_size;
+
+  for (const auto& entry : m_queue) {
+
+    for (const auto& msg : entry.second) {
+
+      size += msg->buffer->size();
+    }
+  }
+
+  auto buffer = std::make_shared<std::vector<std::uint8_t>>();
+
+  /* The version 2 headers are smaller than the version 1 headers, so this is enough for the converted messages. */
+  buffer->reserve(size);
+
+  buffer->resize(header_v2_size);
+
+  for (const auto& entry : m_queue) {
+
+    for (const auto& msg : entry.second) {
+
+      /* Messages that cannot be converted are left out, the same way that a client skips messages it cannot decode. */
+      append_v2(*buffer, *msg);
+    }
+  }
+
+  const std::uint16_t fields[2]{ static_cast<std::uint16_t>(message_type::aggregate), 0 };
+
+  const std::uint32_t sequence{};
+
+  const auto payload_size = static_cast<std::uint32_t>(buffer->size() - header_v2_size);
+
+  std::memcpy(buffer->data(), fields, sizeof(fields));
+  std::memcpy(buffer->data() + 4, &sequence, sizeof(sequence));
+  std::memcpy(buffer->data() + 8, &payload_size, sizeof(payload_size));
+
+  auto msg = std::make_shared<outbound_message>();
+  msg->type = message_type::aggregate;
+  msg->buffer = std::move(buffer);
+  return msg;
+}
+
 } // namespace sentinel::proto
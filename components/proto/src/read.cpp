@@ -1,6 +1,10 @@
 #include <sentinel/proto.h>
+#include <sentinel/proto_schema.h>
 
-#include <optional>
+#include <string>
+#include <vector>
+
+#include <cstring>
 
 #include <stb_image.h>
 
@@ -43,14 +47,37 @@ read(const std::uint8_t* data, const std::size_t size) -> read_result
   return result;
 }
 
-namespace {
-
 auto
-u16(const std::uint8_t* ptr) -> std::uint16_t
+read_v2(const std::uint8_t* data, const std::size_t size) -> read_v2_result
 {
-  return *reinterpret_cast<const std::uint16_t*>(ptr);
+  if (size < header_v2_size) {
+    return read_v2_result{};
+  }
+
+  const auto payload_size = unpack_u32(data + 8);
+
+  if ((header_v2_size + payload_size) > size) {
+    return read_v2_result{};
+  }
+
+  std::uint16_t fields[2]{};
+
+  std::memcpy(fields, data, sizeof(fields));
+
+  read_v2_result result{};
+  result.cull_size = header_v2_size + payload_size;
+  result.payload_ready = true;
+  result.payload_offset = header_v2_size;
+  result.payload_size = payload_size;
+  result.type = (fields[0] < message_type_count) ? static_cast<message_type>(fields[0]) : message_type::unknown;
+  result.flags = fields[1];
+  result.sequence = unpack_u32(data + 4);
+
+  return result;
 }
 
+namespace {
+
 auto
 u32(const std::uint8_t* ptr) -> std::uint32_t
 {
@@ -63,87 +90,272 @@ u64(const std::uint8_t* ptr) -> std::uint64_t
   return *reinterpret_cast<const std::uint64_t*>(ptr);
 }
 
-auto
-f32(const std::uint8_t* ptr) -> float
+/**
+ * @brief The header of a message in either framing.
+ * */
+struct message_header final
 {
-  return *reinterpret_cast<const float*>(ptr);
-}
+  bool payload_ready{ false };
+
+  std::size_t cull_size{};
+
+  message_type type{ message_type::unknown };
+
+  /**
+   * @brief The type string, which is only in version 1 headers.
+   * */
+  std::string_view name;
+
+  std::size_t payload_offset{};
+
+  std::size_t payload_size{};
+};
 
 auto
-decode_camera_frame_event(const uint8_t* payload, const std::size_t size, const std::size_t channels)
-  -> std::optional<camera_frame_event>
+read_header(const std::uint8_t* data, const std::size_t size, const protocol_version version) -> message_header
 {
-  const auto buf_size = u32(payload);
+  message_header h;
+
+  if (version == protocol_version::v2) {
+    const auto res = read_v2(data, size);
+    h.payload_ready = res.payload_ready;
+    h.cull_size = res.cull_size;
+    h.type = res.type;
+    h.payload_offset = res.payload_offset;
+    h.payload_size = res.payload_size;
+    return h;
+  }
 
-  if ((buf_size + 16) != size) {
-    return {};
+  if (size < 8) {
+    return h;
   }
 
-  int w = 0;
-  int h = 0;
-  auto* ptr = stbi_load_from_memory(payload + 16, buf_size, &w, &h, nullptr, 3);
-  if (ptr == nullptr) {
-    return {};
+  const std::size_t type_size = u32(data);
+
+  const std::size_t payload_size = u32(data + 4);
+
+  if ((8 + type_size + payload_size) > size) {
+    return h;
   }
 
-  camera_frame_event ev{};
-  ev.allocated_pixel_data.reset(ptr);
-  ev.w = w;
-  ev.h = h;
-  ev.time = u64(payload + 4);
-  ev.sensor_id = u32(payload + 12);
-  ev.data = ptr;
-  return ev;
+  h.payload_ready = true;
+  h.cull_size = 8 + type_size + payload_size;
+  h.name = std::string_view(reinterpret_cast<const char*>(data + 8), type_size);
+  h.type = get_message_type(h.name);
+  h.payload_offset = 8 + type_size;
+  h.payload_size = payload_size;
+
+  return h;
 }
 
-} // namespace
+/**
+ * @brief Passes the messages decoded by @ref visit_message on to a payload visitor.
+ * */
+class visitor_adapter final
+{
+public:
+  explicit visitor_adapter(payload_visitor& visitor)
+    : m_visitor(visitor)
+  {
+  }
+
+  void operator()(const rgb_camera_update_message& msg)
+  {
+    int w = 0;
+    int h = 0;
+    auto* ptr = stbi_load_from_memory(msg.jpeg, static_cast<int>(msg.jpeg_size), &w, &h, nullptr, 3);
+    if (ptr == nullptr) {
+      m_result = false;
+      return;
+    }
+
+    camera_frame_event ev{};
+    ev.allocated_pixel_data.reset(ptr);
+    ev.w = w;
+    ev.h = h;
+    ev.time = msg.time;
+    ev.sensor_id = msg.sensor_id;
+    ev.data = ptr;
+    m_visitor.visit_rgb_camera_frame_event(ev);
+  }
+
+  void operator()(const monochrome_camera_update_message& msg)
+  {
+    camera_frame_event ev{};
+    ev.w = msg.w;
+    ev.h = msg.h;
+    ev.time = msg.time;
+    ev.sensor_id = msg.sensor_id;
+    ev.data = msg.pixels;
+    m_visitor.visit_monochrome_camera_frame_event(ev);
+  }
+
+  void operator()(const microphone_update_message& msg)
+  {
+    m_visitor.visit_microphone_update(msg.samples, msg.size, msg.sample_rate, msg.time, msg.sensor_id);
+  }
+
+  void operator()(const microphone_adpcm_message& msg)
+  {
+    adpcm_state state;
+    state.predictor = msg.predictor;
+    state.step_index = msg.step_index;
+    std::vector<std::int16_t> samples(msg.size);
+    adpcm_decode(state, msg.encoded, msg.size, samples.data());
+    m_visitor.visit_microphone_update(samples.data(), msg.size, msg.sample_rate, msg.time, msg.sensor_id);
+  }
+
+  void operator()(const microphone_level_message& msg)
+  {
+    m_visitor.visit_microphone_level(msg.peak, msg.rms, msg.bands, msg.band_count, msg.time, msg.sensor_id);
+  }
+
+  void operator()(const microphone_event_message& msg)
+  {
+    m_visitor.visit_microphone_event(msg.active != 0, msg.time, msg.sensor_id);
+  }
+
+  void operator()(const temperature_update_message& msg)
+  {
+    m_visitor.visit_temperature_update(msg.temperature, msg.time, msg.sensor_id);
+  }
+
+  /**
+   * @brief Indicates whether or not the visitor accepted the message.
+   * */
+  auto get_result() const -> bool { return m_result; }
+
+private:
+  payload_visitor& m_visitor;
+
+  bool m_result{ true };
+};
 
+/**
+ * @brief Decodes a message that is nested in another one, in the given framing.
+ * */
 auto
-decode_payload(const std::string& type, const void* payload, const std::size_t payload_size, payload_visitor& visitor)
+decode_nested(const std::uint8_t* message,
+              const message_header& h,
+              payload_visitor& visitor,
+              const protocol_version version) -> bool;
+
+auto
+decode_timed(const std::uint8_t* ptr, const std::size_t size, payload_visitor& visitor, const protocol_version version)
   -> bool
 {
-  const std::uint8_t* ptr = static_cast<const std::uint8_t*>(payload);
+  if (size < message_timing::serialized_size()) {
+    return false;
+  }
+  message_timing timing;
+  timing.captured = u64(ptr);
+  timing.encoded = u64(ptr + 8);
+  timing.enqueued = u64(ptr + 16);
+  timing.written = u64(ptr + 24);
+  const auto* inner = ptr + message_timing::serialized_size();
+  const auto inner_size = size - message_timing::serialized_size();
+  const auto h = read_header(inner, inner_size, version);
+  if (!h.payload_ready || (h.cull_size != inner_size)) {
+    return false;
+  }
+  visitor.visit_message_timing(timing);
+  return decode_nested(inner, h, visitor, version);
+}
 
-  if (type == "rgb_camera::update") {
-    const auto ev = decode_camera_frame_event(ptr, payload_size, 3);
-    if (!ev) {
-      return false;
-    }
-    visitor.visit_rgb_camera_frame_event(ev.value());
-  } else if (type == "monochrome_camera::update") {
-    const auto ev = decode_camera_frame_event(ptr, payload_size, 1);
-    if (!ev) {
-      return false;
+auto
+decode_aggregate(const std::uint8_t* ptr,
+                 const std::size_t size,
+                 payload_visitor& visitor,
+                 const protocol_version version) -> bool
+{
+  for (std::size_t i = 0; i < size;) {
+    const auto h = read_header(ptr + i, size - i, version);
+    if (!h.payload_ready) {
+      break;
     }
-    visitor.visit_monochrome_camera_frame_event(ev.value());
-  } else if (type == "microphone::update") {
-    const auto r = u32(ptr);
-    const auto s = u32(ptr + 4);
-    const auto t = u64(ptr + 8);
-    const auto id = u32(ptr + 16);
-    visitor.visit_microphone_update(reinterpret_cast<const std::int16_t*>(ptr + 20), s, r, t, id);
-  } else if (type == "temperature::update") {
-    const auto v = f32(ptr);
-    const auto t = u64(ptr + 4);
-    const auto id = u32(ptr + 12);
-    visitor.visit_temperature_update(v, t, id);
-  } else if (type == "aggregate") {
-    for (std::size_t i = 0; i < payload_size;) {
-      const auto res = read(ptr + i, payload_size - i);
-      if (!res.payload_ready) {
-        break;
-      }
-      const auto sub_ptr = static_cast<const std::uint8_t*>(payload) + i + res.payload_offset;
-      if (!decode_payload(res.type_id, sub_ptr, res.payload_size, visitor)) {
-        break;
-      }
-      i += res.payload_offset + res.payload_size;
+    if (!decode_nested(ptr + i, h, visitor, version)) {
+      break;
     }
-  } else {
-    return visitor.visit_unknown_payload(type, payload, payload_size);
+    i += h.cull_size;
   }
 
   return true;
 }
 
+/**
+ * @brief Decodes the payload of a message of any type.
+ *
+ * @param version The framing of the messages that are nested in the payload.
+ *
+ * @param name The type string of the message, which is passed to the visitor for the types that are not decoded. If
+ *             this is empty, it is looked up from the type.
+ * */
+auto
+decode_message(const message_type type,
+               const std::uint8_t* ptr,
+               const std::size_t size,
+               payload_visitor& visitor,
+               const protocol_version version,
+               const std::string_view name) -> bool
+{
+  visitor_adapter adapter(visitor);
+
+  if (visit_message(type, ptr, size, adapter)) {
+    return adapter.get_result();
+  }
+
+  switch (type) {
+    case message_type::unknown:
+    case message_type::ready:
+    case message_type::protocol:
+    case message_type::subscription:
+      return visitor.visit_unknown_payload(std::string(name.empty() ? get_message_type_name(type) : name), ptr, size);
+    case message_type::aggregate:
+      return decode_aggregate(ptr, size, visitor, version);
+    case message_type::timed:
+      return decode_timed(ptr, size, visitor, version);
+    default:
+      /* The payload is too small for its type. */
+      return false;
+  }
+}
+
+auto
+decode_nested(const std::uint8_t* message,
+              const message_header& h,
+              payload_visitor& visitor,
+              const protocol_version version) -> bool
+{
+  if (version == protocol_version::v2) {
+    return decode_payload(h.type, message + h.payload_offset, h.payload_size, visitor);
+  }
+
+  return decode_message(h.type, message + h.payload_offset, h.payload_size, visitor, version, h.name);
+}
+
+} // namespace
+
+auto
+decode_payload(const std::string& type,
+               const void* payload,
+               const std::size_t payload_size,
+               payload_visitor& visitor,
+               const protocol_version version) -> bool
+{
+  return decode_message(
+    get_message_type(type), static_cast<const std::uint8_t*>(payload), payload_size, visitor, version, type);
+}
+
+auto
+decode_payload(const message_type type, const void* payload, const std::size_t payload_size, payload_visitor& visitor)
+  -> bool
+{
+  if ((type == message_type::unknown) || (static_cast<std::size_t>(type) >= message_type_count)) {
+    return visitor.visit_unknown_payload(std::to_string(static_cast<unsigned>(type)), payload, payload_size);
+  }
+
+  return decode_message(
+    type, static_cast<const std::uint8_t*>(payload), payload_size, visitor, protocol_version::v2, std::string_view{});
+}
+
 } // namespace sentinel::proto
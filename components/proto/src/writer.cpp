@@ -1,7 +1,9 @@
 #include <sentinel/proto.h>
+#include <sentinel/proto_schema.h>
 
 #include <algorithm>
 #include <functional>
+#include <string_view>
 #include <vector>
 
 #include <cstring>
@@ -22,7 +24,8 @@ clamp(Scalar x, Scalar min, Scalar max) -> Scalar
 } // namespace
 
 writer::writer(const char* type, const std::size_t payload_size, const bool conflate)
-  : m_type_hash(std::hash<std::string>{}(type /* note: string copy occurs here */))
+  : m_type_hash(std::hash<std::string_view>{}(type))
+  , m_type(get_message_type(type))
 {
   const std::size_t header_size = 8;
 
@@ -64,6 +67,7 @@ writer::complete() -> std::shared_ptr<outbound_message>
 
   auto msg = std::make_shared<outbound_message>();
   msg->type_hash = m_type_hash;
+  msg->type = m_type;
   msg->conflate = m_conflate;
   msg->buffer = std::make_shared<std::vector<std::uint8_t>>(std::move(m_data));
   return msg;
@@ -75,12 +79,16 @@ writer::create_rgb_camera_update(const std::uint8_t* data,
                                  std::uint16_t h,
                                  std::uint64_t time,
                                  std::uint32_t sensor_id,
-                                 const std::vector<pixel_space_detection>& people,
+                                 const std::vector<pixel_space_detection>& /* people */,
                                  const float jpeg_quality) -> std::shared_ptr<outbound_message>
 {
   const int quality = clamp(1 + static_cast<int>(jpeg_quality * 99), 1, 100);
 
-  std::vector<std::uint8_t> buf;
+  /* The JPEG data is encoded into a buffer that is kept for the next frame, so that it does not have to grow (and
+   * allocate) each time. */
+  thread_local std::vector<std::uint8_t> buf;
+
+  buf.clear();
 
   auto writer_func = [](void* buf_ptr, void* data, int size) {
     auto* buf = static_cast<std::vector<std::uint8_t>*>(buf_ptr);
@@ -94,18 +102,33 @@ writer::create_rgb_camera_update(const std::uint8_t* data,
 
   stbi_write_jpg_to_func(writer_func, &buf, w, h, 3, data, quality);
 
-  writer wr("rgb_camera::update",
-            4 + 8 + 4 + buf.size() + pixel_space_detection::serialized_size() * people.size(),
-            /* conflate */ true);
+  rgb_camera_update_message msg;
+  msg.jpeg_size = static_cast<std::uint32_t>(buf.size());
+  msg.time = time;
+  msg.sensor_id = sensor_id;
+  msg.jpeg = buf.data();
+  return create_message(msg);
+}
+
+auto
+writer::create_rgb_camera_update_prefix(const std::uint32_t jpeg_size,
+                                        const std::uint64_t time,
+                                        const std::uint32_t sensor_id) -> std::vector<std::uint8_t>
+{
+  rgb_camera_update_message msg;
+  msg.jpeg_size = jpeg_size;
+  msg.time = time;
+  msg.sensor_id = sensor_id;
+
+  constexpr auto header_size = schema::get_header_size<rgb_camera_update_message>();
+
+  std::vector<std::uint8_t> prefix(header_size + schema::get_fixed_size<rgb_camera_update_message>());
 
-  const std::uint32_t buf_size = buf.size();
+  schema::encode_header(msg, prefix.data());
 
-  wr.write(&buf_size, sizeof(buf_size));
-  wr.write(&time, sizeof(time));
-  wr.write(&sensor_id, sizeof(sensor_id));
-  wr.write(buf.data(), buf.size());
+  schema::encode_fields(msg, prefix.data() + header_size);
 
-  return wr.complete();
+  return prefix;
 }
 
 auto
@@ -114,21 +137,17 @@ writer::create_monochrome_camera_update(const std::uint8_t* data,
                                         std::uint16_t h,
                                         std::uint64_t time,
                                         std::uint32_t sensor_id,
-                                        const std::vector<pixel_space_detection>& people)
+                                        const std::vector<pixel_space_detection>& /* people */)
   -> std::shared_ptr<outbound_message>
 
 {
-  writer wr("monochrome_camera::update",
-            2 + 2 + 8 + 4 + (w * h) + pixel_space_detection::serialized_size() * people.size(),
-            /* conflate */ true);
-
-  wr.write(&w, sizeof(w));
-  wr.write(&h, sizeof(h));
-  wr.write(&time, sizeof(time));
-  wr.write(&sensor_id, sizeof(sensor_id));
-  wr.write(data, w * h);
-
-  return wr.complete();
+  monochrome_camera_update_message msg;
+  msg.w = w;
+  msg.h = h;
+  msg.time = time;
+  msg.sensor_id = sensor_id;
+  msg.pixels = data;
+  return create_message(msg);
 }
 
 auto
@@ -138,36 +157,394 @@ writer::create_microphone_update(const std::int16_t* data,
                                  std::uint64_t time,
                                  std::uint32_t sensor_id) -> std::shared_ptr<outbound_message>
 {
-  writer wr("microphone::update",
-            size * 2 + sizeof(size) + sizeof(time) + sizeof(sample_rate) + sizeof(sensor_id),
-            /* conflate */ false);
+  microphone_update_message msg;
+  msg.sample_rate = sample_rate;
+  msg.size = size;
+  msg.time = time;
+  msg.sensor_id = sensor_id;
+  msg.samples = data;
+  return create_message(msg);
+}
 
-  wr.write(&sample_rate, sizeof(sample_rate));
-  wr.write(&size, sizeof(size));
-  wr.write(&time, sizeof(time));
-  wr.write(&sensor_id, sizeof(sensor_id));
-  wr.write(data, size * 2);
+auto
+writer::create_microphone_adpcm_update(adpcm_encoder& encoder,
+                                       const std::int16_t* data,
+                                       const std::uint32_t size,
+                                       const std::uint32_t sample_rate,
+                                       const std::uint64_t time,
+                                       const std::uint32_t sensor_id) -> std::shared_ptr<outbound_message>
+{
+  const auto state = encoder.get_state();
+
+  std::vector<std::uint8_t> encoded((static_cast<std::size_t>(size) + 1) / 2);
+
+  encoder.encode(data, size, encoded.data());
+
+  microphone_adpcm_message msg;
+  msg.sample_rate = sample_rate;
+  msg.size = size;
+  msg.time = time;
+  msg.sensor_id = sensor_id;
+  msg.predictor = state.predictor;
+  msg.step_index = state.step_index;
+  msg.encoded = encoded.data();
+  return create_message(msg);
+}
+
+void
+writer::complete_microphone_adpcm_update(std::vector<std::uint8_t>& buffer,
+                                         adpcm_encoder& encoder,
+                                         const std::int16_t* data,
+                                         const std::uint32_t size,
+                                         const std::uint32_t sample_rate,
+                                         const std::uint64_t time,
+                                         const std::uint32_t sensor_id)
+{
+  constexpr auto encoded_offset =
+    schema::get_header_size<microphone_adpcm_message>() + schema::get_fixed_size<microphone_adpcm_message>();
 
-  return wr.complete();
+  const auto state = encoder.get_state();
+
+  microphone_adpcm_message msg;
+  msg.sample_rate = sample_rate;
+  msg.size = size;
+  msg.time = time;
+  msg.sensor_id = sensor_id;
+  msg.predictor = state.predictor;
+  msg.step_index = state.step_index;
+
+  buffer.resize(encoded_offset + schema::get_tail_size(msg));
+
+  schema::encode_header(msg, buffer.data());
+
+  schema::encode_fields(msg, buffer.data() + schema::get_header_size<microphone_adpcm_message>());
+
+  encoder.encode(data, size, buffer.data() + encoded_offset);
+}
+
+void
+writer::complete_microphone_update(std::vector<std::uint8_t>& buffer,
+                                   const std::uint32_t size,
+                                   const std::uint32_t sample_rate,
+                                   const std::uint64_t time,
+                                   const std::uint32_t sensor_id)
+{
+  constexpr auto header_size = schema::get_header_size<microphone_update_message>();
+
+  static_assert((header_size + schema::get_fixed_size<microphone_update_message>()) == microphone_update_samples_offset,
+                "Sample offset must match the message layout.");
+
+  microphone_update_message msg;
+  msg.sample_rate = sample_rate;
+  msg.size = size;
+  msg.time = time;
+  msg.sensor_id = sensor_id;
+
+  buffer.resize(header_size + schema::get_payload_size(msg));
+
+  schema::encode_header(msg, buffer.data());
+
+  schema::encode_fields(msg, buffer.data() + header_size);
+}
+
+auto
+writer::create_microphone_level(const float peak,
+                                const float rms,
+                                const float* bands,
+                                const std::uint32_t band_count,
+                                const std::uint64_t time,
+                                const std::uint32_t sensor_id) -> std::shared_ptr<outbound_message>
+{
+  microphone_level_message msg;
+  msg.peak = peak;
+  msg.rms = rms;
+  msg.time = time;
+  msg.sensor_id = sensor_id;
+  msg.band_count = band_count;
+  msg.bands = bands;
+  return create_message(msg);
+}
+
+auto
+writer::create_microphone_event(const bool active, const std::uint64_t time, const std::uint32_t sensor_id)
+  -> std::shared_ptr<outbound_message>
+{
+  microphone_event_message msg;
+  msg.time = time;
+  msg.sensor_id = sensor_id;
+  msg.active = active ? 1 : 0;
+  return create_message(msg);
 }
 
 auto
 writer::create_temperature_update(float temperature, std::uint64_t time, std::uint32_t sensor_id)
   -> std::shared_ptr<outbound_message>
 {
-  writer wr("temperature::update", sizeof(float) + sizeof(time) + 4, /* conflate */ true);
-  wr.write(&temperature, sizeof(temperature));
-  wr.write(&time, sizeof(time));
-  wr.write(&sensor_id, sizeof(sensor_id));
-  return wr.complete();
+  temperature_update_message msg;
+  msg.temperature = temperature;
+  msg.time = time;
+  msg.sensor_id = sensor_id;
+  return create_message(msg);
+}
+
+auto
+writer::create_timed(const outbound_message& msg, const std::uint64_t captured, const std::uint64_t encoded)
+  -> std::shared_ptr<outbound_message>
+{
+  const std::uint64_t stamps[4]{ captured, encoded, 0, 0 };
+
+  static_assert(sizeof(stamps) == message_timing::serialized_size(), "The stamps must match the timing size.");
+
+  writer wr("timed", sizeof(stamps) + msg.buffer->size(), msg.conflate);
+  wr.write(stamps, sizeof(stamps));
+  wr.write(msg.buffer->data(), msg.buffer->size());
+
+  auto timed = wr.complete();
+  timed->type_hash = msg.type_hash;
+  timed->type = msg.type;
+
+  if (msg.compressed) {
+    timed->compressed = create_timed(*msg.compressed, captured, encoded);
+  }
+
+  return timed;
+}
+
+auto
+set_timing_stamp(std::uint8_t* data,
+                 const std::size_t size,
+                 const timing_stamp stamp,
+                 const std::uint64_t time,
+                 const protocol_version version) -> std::size_t
+{
+  const auto offset = (stamp == timing_stamp::enqueued) ? 16 : 24;
+
+  /* The header is read in place instead of with @ref read, so that this does not allocate the type string of every
+   * message that is written to a client. */
+  const auto is_type = [](const std::uint8_t* type, const std::uint32_t type_size, const char* name) {
+    return (type_size == std::strlen(name)) && (std::memcmp(type, name, type_size) == 0);
+  };
+
+  std::size_t count{};
+
+  if (version == protocol_version::v2) {
+
+    for (std::size_t i = 0; (i + header_v2_size) <= size;) {
+
+      std::uint16_t type{};
+
+      std::uint32_t payload_size{};
+
+      std::memcpy(&type, data + i, sizeof(type));
+
+      std::memcpy(&payload_size, data + i + 8, sizeof(payload_size));
+
+      if (payload_size > (size - i - header_v2_size)) {
+        break;
+      }
+
+      auto* payload = data + i + header_v2_size;
+
+      if ((type == static_cast<std::uint16_t>(message_type::timed)) &&
+          (payload_size >= message_timing::serialized_size())) {
+        std::memcpy(payload + offset, &time, sizeof(time));
+        count++;
+      } else if (type == static_cast<std::uint16_t>(message_type::aggregate)) {
+        count += set_timing_stamp(payload, payload_size, stamp, time, version);
+      }
+
+      i += header_v2_size + payload_size;
+    }
+
+    return count;
+  }
+
+  for (std::size_t i = 0; (i + 8) <= size;) {
+
+    std::uint32_t header[2]{};
+
+    std::memcpy(header, data + i, sizeof(header));
+
+    const auto message_size = std::size_t(8) + header[0] + header[1];
+
+    if (message_size > (size - i)) {
+      break;
+    }
+
+    const auto* type = data + i + 8;
+
+    auto* payload = data + i + 8 + header[0];
+
+    if (is_type(type, header[0], "timed") && (header[1] >= message_timing::serialized_size())) {
+      std::memcpy(payload + offset, &time, sizeof(time));
+      count++;
+    } else if (is_type(type, header[0], "aggregate")) {
+      count += set_timing_stamp(payload, header[1], stamp, time);
+    }
+
+    i += message_size;
+  }
+
+  return count;
 }
 
 auto
 writer::create_ready_update(std::uint64_t time) -> std::shared_ptr<outbound_message>
 {
-  writer wr("ready", sizeof(time), /* conflate */ true);
-  wr.write(&time, sizeof(time));
-  return wr.complete();
+  ready_message msg;
+  msg.time = time;
+  return create_message(msg);
+}
+
+auto
+writer::create_protocol_update(const protocol_version version) -> std::shared_ptr<outbound_message>
+{
+  protocol_message msg;
+  msg.version = static_cast<std::uint32_t>(version);
+  return create_message(msg);
+}
+
+auto
+writer::create_subscription_update(const std::uint32_t flags) -> std::shared_ptr<outbound_message>
+{
+  subscription_message msg;
+  msg.flags = flags;
+  return create_message(msg);
+}
+
+namespace {
+
+/**
+ * @brief Appends whole version 1 messages (such as the ones in an aggregate) in the version 2 framing.
+ *
+ * @details The flags of each header are taken from the schema of its type. A timed message gets the flags of the
+ *          message that it wraps, and an aggregate gets none.
+ *
+ * @param sequence The sequence number to put in the headers, except the ones of aggregate and timed messages.
+ * */
+auto
+append_v2_messages(std::vector<std::uint8_t>& out,
+                   const std::uint8_t* data,
+                   const std::size_t size,
+                   const std::uint32_t sequence) -> bool
+{
+  for (std::size_t i = 0; i < size;) {
+
+    if ((size - i) < 8) {
+      return false;
+    }
+
+    std::uint32_t header[2]{};
+
+    std::memcpy(header, data + i, sizeof(header));
+
+    const auto message_size = std::size_t(8) + header[0] + header[1];
+
+    if (message_size > (size - i)) {
+      return false;
+    }
+
+    const auto type = get_message_type(std::string_view(reinterpret_cast<const char*>(data + i + 8), header[0]));
+
+    if (type == message_type::unknown) {
+      return false;
+    }
+
+    const auto* payload = data + i + 8 + header[0];
+
+    const auto header_offset = out.size();
+
+    out.resize(header_offset + header_v2_size);
+
+    std::uint16_t message_flags = is_conflatable(type) ? message_flag_conflatable : 0;
+
+    if (type == message_type::timed) {
+
+      const auto stamps_size = message_timing::serialized_size();
+
+      if (header[1] < stamps_size) {
+        return false;
+      }
+
+      out.insert(out.end(), payload, payload + stamps_size);
+
+      const auto inner_offset = out.size();
+
+      /* The wrapped message carries the sequence number, since the numbers are counted per message type. */
+      if (!append_v2_messages(out, payload + stamps_size, header[1] - stamps_size, sequence) ||
+          ((out.size() - inner_offset) < header_v2_size)) {
+        return false;
+      }
+
+      std::memcpy(&message_flags, &out[inner_offset + 2], sizeof(message_flags));
+
+    } else if (type == message_type::aggregate) {
+
+      if (!append_v2_messages(out, payload, header[1], 0)) {
+        return false;
+      }
+
+    } else {
+      out.insert(out.end(), payload, payload + header[1]);
+    }
+
+    const auto is_container = (type == message_type::aggregate) || (type == message_type::timed);
+
+    const std::uint16_t fields[2]{ static_cast<std::uint16_t>(type), message_flags };
+
+    const std::uint32_t message_sequence = is_container ? 0 : sequence;
+
+    const auto payload_size = static_cast<std::uint32_t>(out.size() - header_offset - header_v2_size);
+
+    std::memcpy(&out[header_offset], fields, sizeof(fields));
+    std::memcpy(&out[header_offset + 4], &message_sequence, sizeof(message_sequence));
+    std::memcpy(&out[header_offset + 8], &payload_size, sizeof(payload_size));
+
+    i += message_size;
+  }
+
+  return true;
+}
+
+} // namespace
+
+auto
+append_v2(std::vector<std::uint8_t>& out, const outbound_message& msg) -> bool
+{
+  const auto original_size = out.size();
+
+  if (!append_v2_messages(out, msg.buffer->data(), msg.buffer->size(), msg.sequence)) {
+    out.resize(original_size);
+    return false;
+  }
+
+  return true;
+}
+
+auto
+writer::create_v2(const outbound_message& msg) -> std::shared_ptr<outbound_message>
+{
+  auto buffer = std::make_shared<std::vector<std::uint8_t>>();
+
+  /* The version 2 header is smaller than the version 1 header of every known type, so this does not grow. */
+  buffer->reserve(msg.buffer->size());
+
+  if (!append_v2(*buffer, msg)) {
+    return nullptr;
+  }
+
+  auto converted = std::make_shared<outbound_message>();
+  converted->type_hash = msg.type_hash;
+  converted->conflate = msg.conflate;
+  converted->type = msg.type;
+  converted->sequence = msg.sequence;
+  converted->buffer = std::move(buffer);
+
+  if (msg.compressed) {
+    converted->compressed = create_v2(*msg.compressed);
+  }
+
+  return converted;
 }
 
 } // namespace sentinel::proto
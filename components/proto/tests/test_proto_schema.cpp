@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <sentinel/proto.h>
+#include <sentinel/proto_schema.h>
+
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+using namespace sentinel::proto;
+
+class monochrome_visitor final : public payload_visitor_base
+{
+public:
+  void visit_monochrome_camera_frame_event(const camera_frame_event& ev) override
+  {
+    m_w = ev.w;
+    m_h = ev.h;
+    m_pixels.assign(ev.data, ev.data + static_cast<std::size_t>(ev.w) * ev.h);
+  }
+
+  std::uint16_t m_w{};
+
+  std::uint16_t m_h{};
+
+  std::vector<std::uint8_t> m_pixels;
+};
+
+} // namespace
+
+TEST(ProtoSchema, FixedSizesMatchTheProtocol)
+{
+  EXPECT_EQ(schema::get_fixed_size<rgb_camera_update_message>(), 16);
+  EXPECT_EQ(schema::get_fixed_size<monochrome_camera_update_message>(), 16);
+  EXPECT_EQ(schema::get_fixed_size<microphone_update_message>(), 20);
+  EXPECT_EQ(schema::get_fixed_size<microphone_adpcm_message>(), 24);
+  EXPECT_EQ(schema::get_fixed_size<microphone_level_message>(), 24);
+  EXPECT_EQ(schema::get_fixed_size<microphone_event_message>(), 16);
+  EXPECT_EQ(schema::get_fixed_size<temperature_update_message>(), 16);
+}
+
+TEST(ProtoSchema, VisitsTheFieldsThatWereWritten)
+{
+  const std::vector<float> bands{ 0.25f, 0.5f, 0.75f };
+
+  const auto msg = writer::create_microphone_level(0.5f, 0.125f, bands.data(), 3, 42, 7);
+
+  const auto r = read(msg->buffer->data(), msg->buffer->size());
+
+  ASSERT_TRUE(r.payload_ready);
+
+  microphone_level_message decoded;
+
+  auto visits = 0;
+
+  const auto visitor = [&](const auto& m) {
+    visits++;
+    if constexpr (std::is_same_v<std::decay_t<decltype(m)>, microphone_level_message>) {
+      decoded = m;
+    }
+  };
+
+  const auto* payload = msg->buffer->data() + r.payload_offset;
+
+  const auto success = visit_message(get_message_type(r.type_id), payload, r.payload_size, visitor);
+
+  ASSERT_TRUE(success);
+  EXPECT_EQ(visits, 1);
+  EXPECT_EQ(decoded.peak, 0.5f);
+  EXPECT_EQ(decoded.rms, 0.125f);
+  EXPECT_EQ(decoded.time, 42);
+  EXPECT_EQ(decoded.sensor_id, 7);
+  ASSERT_EQ(decoded.band_count, 3);
+  EXPECT_EQ(std::vector<float>(decoded.bands, decoded.bands + 3), bands);
+
+  /* A payload that ends before its bands do is rejected without visiting it. */
+  EXPECT_FALSE(visit_message(message_type::microphone_level, payload, r.payload_size - 1, visitor));
+  EXPECT_EQ(visits, 1);
+}
+
+TEST(ProtoSchema, DecodesMonochromeFramesAsTheyAreWritten)
+{
+  const std::vector<std::uint8_t> pixels{ 1, 2, 3, 4, 5, 6 };
+
+  const auto msg = writer::create_monochrome_camera_update(pixels.data(), 3, 2, 0, 1, {});
+
+  const auto r = read(msg->buffer->data(), msg->buffer->size());
+
+  monochrome_visitor visitor;
+
+  ASSERT_TRUE(decode_payload(r.type_id, msg->buffer->data() + r.payload_offset, r.payload_size, visitor));
+  EXPECT_EQ(visitor.m_w, 3);
+  EXPECT_EQ(visitor.m_h, 2);
+  EXPECT_EQ(visitor.m_pixels, pixels);
+}
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+
+#include <sentinel/proto.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace sentinel::proto;
+
+/**
+ * @brief Records the payloads that it visits as text, so that two decodings can be compared.
+ * */
+class recording_visitor final : public payload_visitor_base
+{
+public:
+  void visit_message_timing(const message_timing& timing) override
+  {
+    m_log += "timing " + std::to_string(timing.captured) + " " + std::to_string(timing.written) + "\n";
+  }
+
+  void visit_microphone_level(const float peak,
+                              const float,
+                              const float*,
+                              const std::uint32_t num_bands,
+                              const std::uint64_t,
+                              const std::uint32_t sensor_id) override
+  {
+    m_log += "level " + std::to_string(peak) + " " + std::to_string(num_bands) + " " + std::to_string(sensor_id) + "\n";
+  }
+
+  void visit_microphone_event(const bool active, const std::uint64_t time, const std::uint32_t sensor_id) override
+  {
+    m_log += "event " + std::to_string(active) + " " + std::to_string(time) + " " + std::to_string(sensor_id) + "\n";
+  }
+
+  void visit_temperature_update(const float temperature,
+                                const std::uint64_t time,
+                                const std::uint32_t sensor_id) override
+  {
+    m_log += "temperature " + std::to_string(temperature) + " " + std::to_string(time) + " " +
+             std::to_string(sensor_id) + "\n";
+  }
+
+  auto visit_unknown_payload(const std::string& type, const void*, std::size_t) -> bool override
+  {
+    m_log += "unknown " + type + "\n";
+    return true;
+  }
+
+  auto get_log() const -> const std::string& { return m_log; }
+
+private:
+  std::string m_log;
+};
+
+auto
+make_queue() -> queue
+{
+  const std::vector<float> bands(4, 0.25f);
+
+  auto level = writer::create_timed(*writer::create_microphone_level(0.5f, 0.1f, bands.data(), 4, 6, 3), 100, 200);
+  level->sequence = 9;
+
+  auto temperature = writer::create_temperature_update(21.0f, 7, 1);
+  temperature->sequence = 4;
+
+  queue q;
+  q.add(level);
+  q.add(temperature);
+  q.add(writer::create_microphone_event(true, 8, 2));
+  return q;
+}
+
+} // namespace
+
+TEST(ProtocolV2, AggregateDecodesLikeVersion1)
+{
+  const auto q = make_queue();
+
+  const auto v1 = q.aggregate(protocol_version::v1);
+  const auto v2 = q.aggregate(protocol_version::v2);
+
+  EXPECT_LT(v2->buffer->size(), v1->buffer->size());
+
+  recording_visitor v1_visitor;
+  const auto r1 = read(v1->buffer->data(), v1->buffer->size());
+  ASSERT_TRUE(r1.payload_ready);
+  EXPECT_TRUE(decode_payload(r1.type_id, v1->buffer->data() + r1.payload_offset, r1.payload_size, v1_visitor));
+
+  recording_visitor v2_visitor;
+  const auto r2 = read_v2(v2->buffer->data(), v2->buffer->size());
+  ASSERT_TRUE(r2.payload_ready);
+  EXPECT_EQ(r2.type, message_type::aggregate);
+  EXPECT_EQ(r2.cull_size, v2->buffer->size());
+  EXPECT_TRUE(decode_payload(r2.type, v2->buffer->data() + r2.payload_offset, r2.payload_size, v2_visitor));
+
+  EXPECT_FALSE(v2_visitor.get_log().empty());
+  EXPECT_EQ(v1_visitor.get_log(), v2_visitor.get_log());
+}
+
+TEST(ProtocolV2, HeadersCarryTypeCodesAndSequences)
+{
+  const auto q = make_queue();
+
+  const auto v2 = q.aggregate(protocol_version::v2);
+
+  const auto* ptr = v2->buffer->data() + header_v2_size;
+
+  auto remaining = v2->buffer->size() - header_v2_size;
+
+  std::vector<std::pair<message_type, std::uint32_t>> headers;
+
+  while (remaining > 0) {
+    const auto r = read_v2(ptr, remaining);
+    ASSERT_TRUE(r.payload_ready);
+    headers.emplace_back(r.type, r.sequence);
+    if (r.type == message_type::timed) {
+      const auto stamps_size = message_timing::serialized_size();
+      const auto inner = read_v2(ptr + r.payload_offset + stamps_size, r.payload_size - stamps_size);
+      ASSERT_TRUE(inner.payload_ready);
+      headers.emplace_back(inner.type, inner.sequence);
+    }
+    ptr += r.cull_size;
+    remaining -= r.cull_size;
+  }
+
+  /* The timed message is not numbered, but the message that it wraps is. */
+  const std::vector<std::pair<message_type, std::uint32_t>> expected{ { message_type::timed, 0 },
+                                                                      { message_type::microphone_level, 9 },
+                                                                      { message_type::microphone_event, 0 },
+                                                                      { message_type::temperature_update, 4 } };
+
+  std::sort(headers.begin(), headers.end());
+
+  EXPECT_EQ(headers, expected);
+}
+
+TEST(ProtocolV2, TypeNamesRoundTrip)
+{
+  for (std::size_t i = 1; i < message_type_count; i++) {
+    const auto type = static_cast<message_type>(i);
+    EXPECT_EQ(get_message_type(get_message_type_name(type)), type);
+  }
+
+  EXPECT_EQ(get_message_type("not a type"), message_type::unknown);
+}
+
+TEST(ProtocolV2, HeadersFlagConflatableTypes)
+{
+  const std::vector<std::uint8_t> pixels(4 * 4 * 3, 128);
+
+  const std::vector<std::int16_t> samples(16, 0);
+
+  const auto frame = writer::create_v2(*writer::create_rgb_camera_update(pixels.data(), 4, 4, 1, 1, {}, 0.5f));
+  ASSERT_TRUE(frame);
+
+  const auto r1 = read_v2(frame->buffer->data(), frame->buffer->size());
+  ASSERT_TRUE(r1.payload_ready);
+  EXPECT_EQ(r1.type, message_type::rgb_camera_update);
+  EXPECT_EQ(r1.flags, message_flag_conflatable);
+
+  const auto audio = writer::create_v2(*writer::create_microphone_update(samples.data(), 16, 8000, 1, 1));
+  ASSERT_TRUE(audio);
+
+  const auto r2 = read_v2(audio->buffer->data(), audio->buffer->size());
+  ASSERT_TRUE(r2.payload_ready);
+  EXPECT_EQ(r2.type, message_type::microphone_update);
+  EXPECT_EQ(r2.flags, 0);
+
+  /* A timed message has the flags of the message that it wraps. */
+  const auto timed = writer::create_v2(*writer::create_timed(*writer::create_temperature_update(21.0f, 1, 1), 1, 2));
+  ASSERT_TRUE(timed);
+
+  const auto r3 = read_v2(timed->buffer->data(), timed->buffer->size());
+  ASSERT_TRUE(r3.payload_ready);
+  EXPECT_EQ(r3.type, message_type::timed);
+  EXPECT_EQ(r3.flags, message_flag_conflatable);
+
+  const auto stamps_size = message_timing::serialized_size();
+  const auto inner = read_v2(timed->buffer->data() + r3.payload_offset + stamps_size, r3.payload_size - stamps_size);
+  ASSERT_TRUE(inner.payload_ready);
+  EXPECT_EQ(inner.flags, message_flag_conflatable);
+}
@@ -0,0 +1,1021 @@
+/**
+ * @brief Runs the server in-process on replayed cameras and microphones, with in-process TCP and HTTP clients, and
+ *        reports what it sustains as JSON.
+ *
+ * @details The server is run by the same @ref program class as the server executable, on its own IO thread. The
+ *          clients run on another thread, so that their work is not counted against the server. Measurements start
+ *          after a warmup period, and cover:
+ *
+ *            - The messages (and frames) published by the pipelines and received by the clients, per second.
+ *            - The time from when a frame or a period of audio was captured to when a client read it off the socket.
+ *            - The CPU time of each stage, by the name of its threads.
+ *            - The high-water mark of the resident memory.
+ * */
+
+#include "../src/clock.h"
+#include "../src/config.h"
+#include "../src/program.h"
+#include "../src/thread_name.h"
+
+#include <sentinel/proto.h>
+
+#include <nlohmann/json.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include <uv.h>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+struct options final
+{
+  int cameras{ 1 };
+
+  int microphones{ 1 };
+
+  int tcp_clients{ 1 };
+
+  int http_clients{ 1 };
+
+  double duration{ 10.0 };
+
+  double warmup{ 1.0 };
+
+  std::string video_path;
+
+  std::string audio_path;
+
+  std::string audio_signal{ "events" };
+
+  std::string storage_path;
+
+  bool realtime{ true };
+
+  bool adpcm{ false };
+
+  bool shared_audio_capture{ false };
+
+  bool timing_stamps{ false };
+
+  int tcp_port{ 15100 };
+
+  int http_port{ 18100 };
+};
+
+/**
+ * @brief Gets the capture time of a message, for the message types that have one.
+ * */
+auto
+get_message_time(const std::string& type, const std::uint8_t* payload, const std::size_t size, std::uint64_t& time)
+  -> bool
+{
+  std::size_t offset{};
+
+  if (type == "rgb_camera::update") {
+    offset = 4;
+  } else if ((type == "microphone::update") || (type == "microphone::adpcm") || (type == "microphone::level")) {
+    offset = 8;
+  } else if (type == "microphone::event") {
+    offset = 0;
+  } else {
+    return false;
+  }
+
+  if ((offset + sizeof(time)) > size) {
+    return false;
+  }
+
+  std::memcpy(&time, payload + offset, sizeof(time));
+
+  return true;
+}
+
+auto
+is_frame(const std::string& type) -> bool
+{
+  return type == "rgb_camera::update";
+}
+
+auto
+is_audio(const std::string& type) -> bool
+{
+  return (type == "microphone::update") || (type == "microphone::adpcm");
+}
+
+/**
+ * @brief The latencies of one kind of message, in microseconds.
+ * */
+class latency_recorder final
+{
+public:
+  void add(const std::uint64_t latency)
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    m_samples.emplace_back(latency);
+  }
+
+  auto to_json() -> nlohmann::json
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    nlohmann::json result;
+
+    result["count"] = m_samples.size();
+
+    if (m_samples.empty()) {
+      return result;
+    }
+
+    std::sort(m_samples.begin(), m_samples.end());
+
+    const auto percentile = [this](const double p) -> std::uint64_t {
+      const auto index = static_cast<std::size_t>(p * static_cast<double>(m_samples.size() - 1));
+      return m_samples[index];
+    };
+
+    result["p50_us"] = percentile(0.5);
+
+    result["p99_us"] = percentile(0.99);
+
+    result["max_us"] = m_samples.back();
+
+    return result;
+  }
+
+private:
+  std::mutex m_lock;
+
+  std::vector<std::uint64_t> m_samples;
+};
+
+/**
+ * @brief Counts the messages of one transport (or of the pipelines), which are read from the benchmark thread while
+ *        they are written from the others.
+ * */
+struct message_counters final
+{
+  std::atomic<std::uint64_t> bytes{};
+
+  std::atomic<std::uint64_t> messages{};
+
+  std::atomic<std::uint64_t> frames{};
+
+  std::atomic<std::uint64_t> audio_messages{};
+
+  latency_recorder video_latency;
+
+  latency_recorder audio_latency;
+
+  /**
+   * @brief Latencies are only recorded after the warmup, so that the start of the pipelines is left out.
+   * */
+  std::atomic<bool> recording{ false };
+
+  void count(const std::string& type, const std::uint8_t* payload, const std::size_t size)
+  {
+    if (type == "aggregate") {
+      count_all(payload, size);
+      return;
+    }
+
+    if ((type == "timed") && (size >= sentinel::proto::message_timing::serialized_size())) {
+      count_all(payload + sentinel::proto::message_timing::serialized_size(),
+                size - sentinel::proto::message_timing::serialized_size());
+      return;
+    }
+
+    messages++;
+
+    if (is_frame(type)) {
+      frames++;
+    } else if (is_audio(type)) {
+      audio_messages++;
+    }
+
+    std::uint64_t time{};
+
+    if (!recording.load() || !get_message_time(type, payload, size, time)) {
+      return;
+    }
+
+    const auto now = sentinel::get_clock_time();
+
+    const auto latency = (now > time) ? (now - time) : 0;
+
+    if (is_frame(type)) {
+      video_latency.add(latency);
+    } else if (is_audio(type)) {
+      audio_latency.add(latency);
+    }
+  }
+
+  /**
+   * @brief Counts every complete message in a buffer.
+   *
+   * @return The number of bytes of complete messages.
+   * */
+  auto count_all(const std::uint8_t* data, const std::size_t size) -> std::size_t
+  {
+    std::size_t offset{};
+
+    while (offset < size) {
+
+      const auto res = sentinel::proto::read(data + offset, size - offset);
+
+      if (!res.payload_ready) {
+        break;
+      }
+
+      count(res.type_id, data + offset + res.payload_offset, res.payload_size);
+
+      offset += res.cull_size;
+    }
+
+    return offset;
+  }
+};
+
+struct counter_snapshot final
+{
+  std::uint64_t bytes{};
+
+  std::uint64_t messages{};
+
+  std::uint64_t frames{};
+
+  std::uint64_t audio_messages{};
+};
+
+auto
+take_snapshot(const message_counters& c) -> counter_snapshot
+{
+  return counter_snapshot{ c.bytes.load(), c.messages.load(), c.frames.load(), c.audio_messages.load() };
+}
+
+auto
+to_json(const counter_snapshot& begin, const counter_snapshot& end, const double duration) -> nlohmann::json
+{
+  nlohmann::json result;
+
+  result["messages"] = end.messages - begin.messages;
+
+  result["frames_per_second"] = static_cast<double>(end.frames - begin.frames) / duration;
+
+  result["audio_messages_per_second"] = static_cast<double>(end.audio_messages - begin.audio_messages) / duration;
+
+  result["messages_per_second"] = static_cast<double>(end.messages - begin.messages) / duration;
+
+  result["bytes_per_second"] = static_cast<double>(end.bytes - begin.bytes) / duration;
+
+  return result;
+}
+
+/**
+ * @brief Counts the messages that the pipelines publish, before they are queued for the clients.
+ * */
+class publish_counter final : public telemetry_observer
+{
+public:
+  explicit publish_counter(message_counters& counters)
+    : m_counters(counters)
+  {
+  }
+
+  void observe_telemetry(std::shared_ptr<sentinel::proto::outbound_message>& msg) override
+  {
+    m_counters.bytes += msg->buffer->size();
+
+    m_counters.count_all(msg->buffer->data(), msg->buffer->size());
+  }
+
+private:
+  message_counters& m_counters;
+};
+
+/**
+ * @brief A client on the client loop, which connects to the server (retrying until it is listening) and counts what
+ *        it reads.
+ * */
+class bench_client
+{
+public:
+  bench_client(uv_loop_t* loop, const int port, message_counters& counters)
+    : m_loop(loop)
+    , m_counters(counters)
+  {
+    uv_ip4_addr("127.0.0.1", port, &m_address);
+
+    uv_timer_init(loop, &m_retry_timer);
+
+    uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_retry_timer), this);
+  }
+
+  bench_client(const bench_client&) = delete;
+
+  bench_client(bench_client&&) = delete;
+
+  auto operator=(const bench_client&) -> bench_client& = delete;
+
+  auto operator=(bench_client&&) -> bench_client& = delete;
+
+  virtual ~bench_client() = default;
+
+  void connect()
+  {
+    uv_tcp_init(m_loop, &m_socket);
+
+    uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_socket), this);
+
+    m_connect.data = this;
+
+    uv_tcp_connect(&m_connect, &m_socket, reinterpret_cast<const sockaddr*>(&m_address), on_connect);
+  }
+
+  virtual void close()
+  {
+    m_closing = true;
+
+    uv_close(reinterpret_cast<uv_handle_t*>(&m_retry_timer), nullptr);
+
+    if (!uv_is_closing(reinterpret_cast<uv_handle_t*>(&m_socket))) {
+      uv_close(reinterpret_cast<uv_handle_t*>(&m_socket), nullptr);
+    }
+  }
+
+protected:
+  /**
+   * @brief Called once the connection is made.
+   * */
+  virtual void on_connected() {}
+
+  /**
+   * @brief Called with the bytes that were read so far.
+   *
+   * @return The number of bytes that were used, which are removed from the buffer.
+   * */
+  virtual auto on_data(const std::uint8_t* data, std::size_t size) -> std::size_t = 0;
+
+  auto get_socket() -> uv_stream_t* { return reinterpret_cast<uv_stream_t*>(&m_socket); }
+
+  auto get_loop() -> uv_loop_t* { return m_loop; }
+
+  auto get_counters() -> message_counters& { return m_counters; }
+
+  auto is_closing() const -> bool { return m_closing; }
+
+  static void on_connect(uv_connect_t* req, const int status)
+  {
+    auto* self = static_cast<bench_client*>(req->data);
+
+    if (self->m_closing) {
+      return;
+    }
+
+    if (status != 0) {
+      /* The server may not be listening yet. */
+      uv_close(reinterpret_cast<uv_handle_t*>(&self->m_socket), nullptr);
+      uv_timer_start(&self->m_retry_timer, on_retry, 100, 0);
+      return;
+    }
+
+    uv_read_start(self->get_socket(), on_alloc, on_read);
+
+    self->on_connected();
+  }
+
+  static void on_retry(uv_timer_t* timer)
+  {
+    auto* self = static_cast<bench_client*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(timer)));
+
+    if (!self->m_closing) {
+      self->connect();
+    }
+  }
+
+  static void on_alloc(uv_handle_t* handle, const size_t size, uv_buf_t* buf)
+  {
+    auto* self = static_cast<bench_client*>(uv_handle_get_data(handle));
+
+    self->m_buffer.resize(self->m_buffer_size + size);
+
+    buf->base = reinterpret_cast<char*>(self->m_buffer.data() + self->m_buffer_size);
+
+    buf->len = size;
+  }
+
+  static void on_read(uv_stream_t* stream, const ssize_t read_size, const uv_buf_t*)
+  {
+    auto* self = static_cast<bench_client*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(stream)));
+
+    if (read_size < 0) {
+      if (!self->m_closing) {
+        spdlog::error("A benchmark client lost its connection.");
+        uv_close(reinterpret_cast<uv_handle_t*>(stream), nullptr);
+      }
+      return;
+    }
+
+    self->m_counters.bytes += static_cast<std::uint64_t>(read_size);
+
+    self->m_buffer_size += static_cast<std::size_t>(read_size);
+
+    const auto used = self->on_data(self->m_buffer.data(), self->m_buffer_size);
+
+    self->m_buffer.erase(self->m_buffer.begin(), self->m_buffer.begin() + used);
+
+    self->m_buffer_size -= used;
+  }
+
+private:
+  uv_loop_t* m_loop{ nullptr };
+
+  message_counters& m_counters;
+
+  sockaddr_in m_address{};
+
+  uv_tcp_t m_socket{};
+
+  uv_connect_t m_connect{};
+
+  uv_timer_t m_retry_timer{};
+
+  std::vector<std::uint8_t> m_buffer;
+
+  std::size_t m_buffer_size{};
+
+  bool m_closing{ false };
+};
+
+class tcp_bench_client final : public bench_client
+{
+public:
+  using bench_client::bench_client;
+
+protected:
+  auto on_data(const std::uint8_t* data, const std::size_t size) -> std::size_t override
+  {
+    return get_counters().count_all(data, size);
+  }
+};
+
+/**
+ * @brief Polls the stream endpoint the way the dashboard does, asking again as soon as each response is read.
+ * */
+class http_bench_client final : public bench_client
+{
+public:
+  http_bench_client(uv_loop_t* loop, const int port, message_counters& counters, const bool adpcm)
+    : bench_client(loop, port, counters)
+    , m_request(std::string("GET /api/stream?pcm=1") + (adpcm ? "&adpcm=1" : "") +
+                " HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: keep-alive\r\n\r\n")
+  {
+    uv_timer_init(loop, &m_poll_timer);
+
+    uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_poll_timer), this);
+  }
+
+  void close() override
+  {
+    bench_client::close();
+
+    uv_close(reinterpret_cast<uv_handle_t*>(&m_poll_timer), nullptr);
+  }
+
+protected:
+  void on_connected() override { send_request(); }
+
+  auto on_data(const std::uint8_t* data, const std::size_t size) -> std::size_t override
+  {
+    const std::string_view text(reinterpret_cast<const char*>(data), size);
+
+    const auto header_end = text.find("\r\n\r\n");
+
+    if (header_end == std::string_view::npos) {
+      return 0;
+    }
+
+    const auto body_offset = header_end + 4;
+
+    const auto body_size = get_content_length(text.substr(0, header_end));
+
+    if ((body_offset + body_size) > size) {
+      return 0;
+    }
+
+    get_counters().count_all(data + body_offset, body_size);
+
+    /* An empty response means that nothing was queued, so the next one is not asked for right away. */
+    if (body_size == 0) {
+      uv_timer_start(&m_poll_timer, on_poll_timer, empty_poll_delay, 0);
+    } else {
+      send_request();
+    }
+
+    return body_offset + body_size;
+  }
+
+  static auto get_content_length(const std::string_view header) -> std::size_t
+  {
+    const std::string_view key("Content-Length: ");
+
+    const auto pos = header.find(key);
+
+    if (pos == std::string_view::npos) {
+      return 0;
+    }
+
+    const std::string value(header.substr(pos + key.size(), 20));
+
+    return static_cast<std::size_t>(std::strtoull(value.c_str(), nullptr, 10));
+  }
+
+  static void on_poll_timer(uv_timer_t* timer)
+  {
+    auto* self = static_cast<http_bench_client*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(timer)));
+
+    self->send_request();
+  }
+
+  void send_request()
+  {
+    if (is_closing()) {
+      return;
+    }
+
+    auto buf = uv_buf_init(const_cast<char*>(m_request.data()), static_cast<unsigned int>(m_request.size()));
+
+    uv_write(&m_write, get_socket(), &buf, 1, nullptr);
+  }
+
+private:
+  /**
+   * @brief How long to wait before asking again after an empty response, in milliseconds.
+   * */
+  static constexpr std::uint64_t empty_poll_delay{ 5 };
+
+  std::string m_request;
+
+  uv_write_t m_write{};
+
+  uv_timer_t m_poll_timer{};
+};
+
+/**
+ * @brief Runs the clients on their own loop and thread.
+ * */
+class client_runner final
+{
+public:
+  client_runner(const options& opts, message_counters& tcp_counters, message_counters& http_counters)
+  {
+    uv_loop_init(&m_loop);
+
+    uv_async_init(&m_loop, &m_stop, on_stop);
+
+    uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_stop), this);
+
+    for (int i = 0; i < opts.tcp_clients; i++) {
+      m_clients.emplace_back(std::make_unique<tcp_bench_client>(&m_loop, opts.tcp_port, tcp_counters));
+    }
+
+    for (int i = 0; i < opts.http_clients; i++) {
+      m_clients.emplace_back(std::make_unique<http_bench_client>(&m_loop, opts.http_port, http_counters, opts.adpcm));
+    }
+
+    for (auto& c : m_clients) {
+      c->connect();
+    }
+
+    m_thread = std::thread([this]() {
+      set_thread_name("clients");
+      uv_run(&m_loop, UV_RUN_DEFAULT);
+    });
+  }
+
+  client_runner(const client_runner&) = delete;
+
+  client_runner(client_runner&&) = delete;
+
+  auto operator=(const client_runner&) -> client_runner& = delete;
+
+  auto operator=(client_runner&&) -> client_runner& = delete;
+
+  ~client_runner()
+  {
+    uv_async_send(&m_stop);
+
+    if (m_thread.joinable()) {
+      m_thread.join();
+    }
+
+    uv_loop_close(&m_loop);
+  }
+
+protected:
+  static void on_stop(uv_async_t* handle)
+  {
+    auto* self = static_cast<client_runner*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(handle)));
+
+    for (auto& c : self->m_clients) {
+      c->close();
+    }
+
+    uv_close(reinterpret_cast<uv_handle_t*>(handle), nullptr);
+  }
+
+private:
+  uv_loop_t m_loop{};
+
+  uv_async_t m_stop{};
+
+  std::vector<std::unique_ptr<bench_client>> m_clients;
+
+  std::thread m_thread;
+};
+
+/**
+ * @brief Gets the CPU time (user and system) used by the threads of the process so far, in seconds, by thread name.
+ *
+ * @note Threads that have exited are not included.
+ * */
+auto
+get_thread_cpu_times() -> std::map<std::string, double>
+{
+  std::map<std::string, double> times;
+
+  const auto ticks_per_second = static_cast<double>(sysconf(_SC_CLK_TCK));
+
+  std::error_code ec;
+
+  for (const auto& entry : std::filesystem::directory_iterator("/proc/self/task", ec)) {
+
+    std::ifstream file(entry.path() / "stat");
+
+    std::string stat;
+
+    std::getline(file, stat);
+
+    /* The name is in parentheses and may contain spaces, so the fields are counted from the closing one. */
+    const auto name_begin = stat.find('(');
+
+    const auto name_end = stat.rfind(')');
+
+    if ((name_begin == std::string::npos) || (name_end == std::string::npos)) {
+      continue;
+    }
+
+    const auto name = stat.substr(name_begin + 1, name_end - name_begin - 1);
+
+    std::istringstream fields(stat.substr(name_end + 2));
+
+    std::string field;
+
+    std::uint64_t utime{};
+
+    std::uint64_t stime{};
+
+    /* The state is field 3, while utime and stime are fields 14 and 15. */
+    for (int i = 3; (i <= 15) && (fields >> field); i++) {
+      if (i == 14) {
+        utime = std::strtoull(field.c_str(), nullptr, 10);
+      } else if (i == 15) {
+        stime = std::strtoull(field.c_str(), nullptr, 10);
+      }
+    }
+
+    times[name] += static_cast<double>(utime + stime) / ticks_per_second;
+  }
+
+  return times;
+}
+
+auto
+make_config(const options& opts) -> config
+{
+  config cfg;
+
+  cfg.server_ip = "127.0.0.1";
+
+  cfg.tcp_server_enabled = opts.tcp_clients > 0;
+
+  cfg.tcp_server_port = opts.tcp_port;
+
+  cfg.http_server_enabled = opts.http_clients > 0;
+
+  cfg.http_server_port = opts.http_port;
+
+  cfg.shared_audio_capture = opts.shared_audio_capture;
+
+  cfg.timing_stamps_enabled = opts.timing_stamps;
+
+  std::uint32_t sensor_id{};
+
+  for (int i = 0; i < opts.cameras; i++) {
+
+    config::camera_config cam;
+
+    cam.name = "camera " + std::to_string(i);
+
+    cam.sensor_id = sensor_id++;
+
+    cam.replay_path = opts.video_path;
+
+    cam.replay_realtime = opts.realtime;
+
+    cam.storage_enabled = !opts.storage_path.empty();
+
+    cam.storage_path = opts.storage_path + "/camera_" + std::to_string(i);
+
+    cfg.cameras.emplace_back(std::move(cam));
+  }
+
+  for (int i = 0; i < opts.microphones; i++) {
+
+    config::microphone_config mic;
+
+    mic.name = "microphone " + std::to_string(i);
+
+    mic.sensor_id = sensor_id++;
+
+    mic.replay_path = opts.audio_path;
+
+    mic.replay_signal = opts.audio_path.empty() ? opts.audio_signal : std::string();
+
+    mic.replay_realtime = opts.realtime;
+
+    mic.storage_enabled = !opts.storage_path.empty();
+
+    mic.storage_path = opts.storage_path + "/microphone_" + std::to_string(i);
+
+    cfg.microphones.emplace_back(std::move(mic));
+  }
+
+  return cfg;
+}
+
+const char help[] = R"(
+Runs the server on replayed cameras and microphones, with in-process clients, and prints what it sustains as JSON.
+
+Options:
+  --cameras N          : The number of cameras, which all play back the same video (default is 1).
+  --microphones N      : The number of microphones (default is 1).
+  --tcp-clients N      : The number of TCP clients (default is 1).
+  --http-clients N     : The number of HTTP clients, which poll the stream endpoint (default is 1).
+  --video PATH         : A directory of '<timestamp>.jpg' frames or a video file to play back on each camera.
+  --audio PATH         : A WAV file to play back on each microphone.
+  --signal NAME        : The signal to generate on each microphone when no WAV file is given ('tone', 'noise' or
+                         'events', the default).
+  --fast               : Plays back the recordings as fast as they can be processed, instead of at their own rate.
+  --adpcm              : Has the HTTP clients accept ADPCM audio.
+  --shared-capture     : Captures every microphone on one thread.
+  --timing-stamps      : Sends every message with timing stamps, to measure what they cost.
+  --storage PATH       : Stores the frames and audio under this directory (storage is disabled by default).
+  --duration SECONDS   : How long to measure for (default is 10).
+  --warmup SECONDS     : How long to run before measuring (default is 1).
+  --tcp-port PORT      : The port of the TCP server (default is 15100).
+  --http-port PORT     : The port of the HTTP server (default is 18100).
+  --help               : Prints this help message.
+)";
+
+auto
+parse_options(const int argc, char** argv, options& opts) -> bool
+{
+  for (int i = 1; i < argc; i++) {
+
+    const std::string arg(argv[i]);
+
+    const auto has_next = (i + 1) < argc;
+
+    if (arg == "--fast") {
+      opts.realtime = false;
+    } else if (arg == "--adpcm") {
+      opts.adpcm = true;
+    } else if (arg == "--shared-capture") {
+      opts.shared_audio_capture = true;
+    } else if (arg == "--timing-stamps") {
+      opts.timing_stamps = true;
+    } else if (arg == "--help") {
+      std::cerr << "Usage: " << argv[0] << " [options]" << std::endl;
+      std::cerr << help;
+      return false;
+    } else if (!has_next) {
+      std::cerr << "Invalid argument '" << arg << "' (see --help)." << std::endl;
+      return false;
+    } else {
+
+      const char* value = argv[++i];
+
+      if (arg == "--cameras") {
+        opts.cameras = std::atoi(value);
+      } else if (arg == "--microphones") {
+        opts.microphones = std::atoi(value);
+      } else if (arg == "--tcp-clients") {
+        opts.tcp_clients = std::atoi(value);
+      } else if (arg == "--http-clients") {
+        opts.http_clients = std::atoi(value);
+      } else if (arg == "--video") {
+        opts.video_path = value;
+      } else if (arg == "--audio") {
+        opts.audio_path = value;
+      } else if (arg == "--signal") {
+        opts.audio_signal = value;
+      } else if (arg == "--storage") {
+        opts.storage_path = value;
+      } else if (arg == "--duration") {
+        opts.duration = std::atof(value);
+      } else if (arg == "--warmup") {
+        opts.warmup = std::atof(value);
+      } else if (arg == "--tcp-port") {
+        opts.tcp_port = std::atoi(value);
+      } else if (arg == "--http-port") {
+        opts.http_port = std::atoi(value);
+      } else {
+        std::cerr << "Invalid argument '" << arg << "' (see --help)." << std::endl;
+        return false;
+      }
+    }
+  }
+
+  if ((opts.cameras > 0) && opts.video_path.empty()) {
+    std::cerr << "The cameras need a recording to play back (see --video)." << std::endl;
+    return false;
+  }
+
+  if (opts.duration <= 0.0) {
+    std::cerr << "The duration must be greater than zero." << std::endl;
+    return false;
+  }
+
+  return true;
+}
+
+auto
+to_json(const options& opts) -> nlohmann::json
+{
+  nlohmann::json result;
+
+  result["cameras"] = opts.cameras;
+
+  result["microphones"] = opts.microphones;
+
+  result["tcp_clients"] = opts.tcp_clients;
+
+  result["http_clients"] = opts.http_clients;
+
+  result["realtime"] = opts.realtime;
+
+  result["adpcm"] = opts.adpcm;
+
+  result["shared_audio_capture"] = opts.shared_audio_capture;
+
+  result["timing_stamps"] = opts.timing_stamps;
+
+  result["storage"] = !opts.storage_path.empty();
+
+  result["duration"] = opts.duration;
+
+  return result;
+}
+
+} // namespace
+
+int
+main(int argc, char** argv)
+{
+  options opts;
+
+  if (!parse_options(argc, argv, opts)) {
+    return EXIT_FAILURE;
+  }
+
+  /* The output is meant to be read by scripts, so only problems are logged. */
+  spdlog::set_level(spdlog::level::warn);
+
+  const auto cfg = make_config(opts);
+
+  try {
+    cfg.validate();
+  } catch (const std::runtime_error& e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  message_counters published;
+
+  message_counters tcp_received;
+
+  message_counters http_received;
+
+  publish_counter counter(published);
+
+  program prg;
+
+  prg.add_telemetry_observer(&counter);
+
+  std::thread io_thread([&prg, &cfg]() {
+    set_thread_name("io");
+    prg.run(cfg);
+  });
+
+  nlohmann::json result;
+
+  {
+    client_runner clients(opts, tcp_received, http_received);
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(opts.warmup));
+
+    for (auto* c : { &published, &tcp_received, &http_received }) {
+      c->recording.store(true);
+    }
+
+    const auto published_begin = take_snapshot(published);
+
+    const auto tcp_begin = take_snapshot(tcp_received);
+
+    const auto http_begin = take_snapshot(http_received);
+
+    const auto cpu_begin = get_thread_cpu_times();
+
+    const auto time_begin = std::chrono::steady_clock::now();
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(opts.duration));
+
+    const auto published_end = take_snapshot(published);
+
+    const auto tcp_end = take_snapshot(tcp_received);
+
+    const auto http_end = take_snapshot(http_received);
+
+    const auto cpu_end = get_thread_cpu_times();
+
+    const auto duration = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_begin).count();
+
+    for (auto* c : { &published, &tcp_received, &http_received }) {
+      c->recording.store(false);
+    }
+
+    result["options"] = to_json(opts);
+
+    result["published"] = to_json(published_begin, published_end, duration);
+
+    result["tcp"] = to_json(tcp_begin, tcp_end, duration);
+
+    result["tcp"]["video_latency"] = tcp_received.video_latency.to_json();
+
+    result["tcp"]["audio_latency"] = tcp_received.audio_latency.to_json();
+
+    result["http"] = to_json(http_begin, http_end, duration);
+
+    result["http"]["video_latency"] = http_received.video_latency.to_json();
+
+    result["http"]["audio_latency"] = http_received.audio_latency.to_json();
+
+    nlohmann::json cpu;
+
+    for (const auto& entry : cpu_end) {
+      const auto it = cpu_begin.find(entry.first);
+      const auto begin = (it != cpu_begin.end()) ? it->second : 0.0;
+      cpu[entry.first] = (entry.second - begin) / duration;
+    }
+
+    /* The fraction of a core used by the threads of each stage, over the measurement. */
+    result["cpu"] = cpu;
+  }
+
+  prg.stop();
+
+  io_thread.join();
+
+  rusage usage{};
+
+  getrusage(RUSAGE_SELF, &usage);
+
+  result["max_rss_kib"] = usage.ru_maxrss;
+
+  std::cout << result.dump(2) << std::endl;
+
+  return EXIT_SUCCESS;
+}
@@ -1,20 +1,17 @@
+#include "src/avi_clip.h"
 #include "src/config.h"
-#include "src/http_server.h"
-#include "src/image.h"
-#include "src/pipeline_runner.h"
-#include "src/server.h"
-#include "src/video_device.h"
-
-#include "src/microphone_pipeline.h"
-#include "src/video_pipeline.h"
+#include "src/program.h"
+#include "src/storage_index.h"
 
 #include <spdlog/spdlog.h>
 
 #include <iostream>
+#include <limits>
 #include <string>
 #include <vector>
 
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
@@ -25,18 +22,6 @@ CMRC_DECLARE(sentinel_server_resources);
 
 namespace {
 
-auto
-to_handle(uv_timer_t* handle) -> uv_handle_t*
-{
-  return reinterpret_cast<uv_handle_t*>(handle);
-}
-
-auto
-to_handle(uv_signal_t* handle) -> uv_handle_t*
-{
-  return reinterpret_cast<uv_handle_t*>(handle);
-}
-
 #ifdef WITH_BUNDLE
 auto
 open_rc_file(const char* path) -> std::vector<std::uint8_t>
@@ -55,132 +40,106 @@ open_rc_file(const char* path) -> std::vector<std::uint8_t>
 }
 #endif /* WITH_BUNDLE */
 
-class program final : public telemetry_observer
+/**
+ * @brief The options for exporting stored frames, instead of running the server.
+ * */
+struct export_options final
 {
-public:
-  program()
-  {
-    uv_loop_init(&m_loop);
-
-    uv_handle_set_data(to_handle(&m_signal), this);
-    uv_signal_init(&m_loop, &m_signal);
-
-    m_server = server::create(&m_loop);
-
-    m_http_server = http_server::create(&m_loop);
-
-#ifdef WITH_BUNDLE
-    m_http_server->add_file("/index.html", "text/html", open_rc_file("index.html"));
-    m_http_server->add_file("/dashboard.js", "text/javascript", open_rc_file("dashboard.js"));
-    m_http_server->add_file("/dashboard.wasm", "application/wasm", open_rc_file("dashboard.wasm"));
-#endif
-  }
-
-  program(const program&) = delete;
+  bool enabled{ false };
 
-  program(program&&) = delete;
+  std::uint32_t sensor_id{};
 
-  auto operator=(const program&) -> program& = delete;
+  std::uint64_t from{};
 
-  auto operator=(program&&) -> program& = delete;
+  std::uint64_t to{ std::numeric_limits<std::uint64_t>::max() };
 
-  ~program() { uv_loop_close(&m_loop); }
+  std::uint64_t step{};
 
-  void run(const config& cfg)
-  {
-    m_http_server->add_file("/config.json", "application/json", cfg.export_dashboard_config());
-
-    for (const auto& camera_cfg : cfg.cameras) {
-
-      auto p = video_pipeline::create(camera_cfg);
-
-      auto runner = std::make_unique<pipeline_runner>(&m_loop, std::move(p));
+  const char* output_path{ "-" };
+};
 
-      runner->add_telemetry_observer(this);
+/**
+ * @brief Writes the stored frames of a camera into a Motion JPEG AVI file, the same way the "clip" HTTP endpoint does.
+ * */
+auto
+export_clip(const config& cfg, const export_options& opts) -> int
+{
+  const config::camera_config* camera_cfg{ nullptr };
 
-      m_pipeline_runners.emplace_back(std::move(runner));
+  for (const auto& c : cfg.cameras) {
+    if (c.sensor_id == opts.sensor_id) {
+      camera_cfg = &c;
     }
+  }
 
-    for (const auto& microphone_cfg : cfg.microphones) {
-
-      auto p = microphone_pipeline::create(microphone_cfg);
-
-      auto runner = std::make_unique<pipeline_runner>(&m_loop, std::move(p));
-
-      runner->add_telemetry_observer(this);
-
-      m_pipeline_runners.emplace_back(std::move(runner));
-    }
+  if (camera_cfg == nullptr) {
+    std::cerr << "No camera has sensor ID " << opts.sensor_id << "." << std::endl;
+    return EXIT_FAILURE;
+  }
 
-    uv_signal_start(&m_signal, on_signal, SIGINT);
+  auto index = std::make_shared<storage_index>(camera_cfg->storage_path);
 
-    if (cfg.tcp_server_enabled) {
-      m_server->setup(cfg.server_ip.c_str(), cfg.tcp_server_port);
-    }
+  index->scan();
 
-    if (cfg.http_server_enabled) {
-      m_http_server->setup(cfg.server_ip.c_str(), cfg.http_server_port);
-    }
+  auto frames = index->query(opts.from, opts.to, opts.step, std::numeric_limits<std::size_t>::max());
 
-    spdlog::info("Starting IO loop.");
+  std::cerr << "Exporting " << frames.size() << " frames." << std::endl;
 
-    uv_run(&m_loop, UV_RUN_DEFAULT);
+  avi_clip clip(index, std::move(frames));
 
-    shutdown();
+  if (clip.get_file_size() > avi_clip::max_size) {
+    std::cerr << "The clip would be too large, try a shorter range or a larger step." << std::endl;
+    return EXIT_FAILURE;
   }
 
-protected:
-  static auto get_self(uv_handle_t* handle) -> program* { return static_cast<program*>(uv_handle_get_data(handle)); }
-
-  static void on_signal(uv_signal_t* signal, int signum)
-  {
-    spdlog::info("Caught signal, stopping loop.");
+  const auto to_stdout = std::strcmp(opts.output_path, "-") == 0;
 
-    auto* self = get_self(to_handle(signal));
+  auto* output = to_stdout ? stdout : std::fopen(opts.output_path, "wb");
 
-    uv_stop(&self->m_loop);
+  if (output == nullptr) {
+    std::cerr << "Failed to open '" << opts.output_path << "' for writing." << std::endl;
+    return EXIT_FAILURE;
   }
 
-  void observe_telemetry(std::shared_ptr<sentinel::proto::outbound_message>& msg) override
-  {
-    m_server->publish_telemetry(msg);
+  const auto success = write_http_body(clip, output);
 
-    m_http_server->publish_telemetry(msg);
+  if (!to_stdout) {
+    std::fclose(output);
   }
 
-  void shutdown()
-  {
-    m_server->close();
-
-    m_http_server->close();
-
-    uv_signal_stop(&m_signal);
-
-    uv_close(to_handle(&m_signal), nullptr);
-
-    for (auto& r : m_pipeline_runners) {
-      r->close();
-    }
-
-    uv_run(&m_loop, UV_RUN_DEFAULT);
+  if (!success) {
+    std::cerr << "Failed to write the clip." << std::endl;
+    return EXIT_FAILURE;
   }
 
-private:
-  uv_loop_t m_loop{};
+  return EXIT_SUCCESS;
+}
 
-  uv_signal_t m_signal{};
+auto
+parse_u64(const char* str, std::uint64_t& value) -> bool
+{
+  if ((str[0] == 0) || (str[0] == '-')) {
+    return false;
+  }
 
-  std::unique_ptr<server> m_server;
+  char* end{ nullptr };
 
-  std::unique_ptr<http_server> m_http_server;
+  value = std::strtoull(str, &end, 10);
 
-  std::vector<std::unique_ptr<pipeline_runner>> m_pipeline_runners;
-};
+  return *end == 0;
+}
 
 const char help[] = R"(
 Options:
-  --config PATH : Specifies the path to the configuration file.
-  --help        : The device index to capture video from.
+  --config PATH        : Specifies the path to the configuration file.
+  --help               : Prints this help message.
+
+Export options (writes stored frames to an AVI file instead of running the server):
+  --export SENSOR_ID   : Exports the stored frames of the camera with this sensor ID.
+  --from TIME          : The earliest frame to export, in microseconds since Unix epoch.
+  --to TIME            : The latest frame to export, in microseconds since Unix epoch.
+  --step TIME          : The minimum time between exported frames, in microseconds.
+  --output PATH        : The file to write the clip to, or '-' for standard output (the default).
 )";
 
 } // namespace
@@ -198,8 +157,11 @@ main(int argc, char** argv)
 
   const char* config_path{ "config.yaml" };
 
+  export_options export_opts;
+
   for (int i = 1; i < argc; i++) {
     const auto has_next = (i + 1) < argc;
+    std::uint64_t value{};
     if (std::strcmp(argv[i], "--config") == 0) {
       if (!has_next) {
         std::cerr << "Missing path to '--config' argument." << std::endl;
@@ -207,6 +169,30 @@ main(int argc, char** argv)
       }
       config_path = argv[i + 1];
       i++;
+    } else if ((std::strcmp(argv[i], "--export") == 0) || (std::strcmp(argv[i], "--from") == 0) ||
+               (std::strcmp(argv[i], "--to") == 0) || (std::strcmp(argv[i], "--step") == 0)) {
+      if (!has_next || !parse_u64(argv[i + 1], value)) {
+        std::cerr << "Missing or invalid value to '" << argv[i] << "' argument." << std::endl;
+        return EXIT_FAILURE;
+      }
+      if (std::strcmp(argv[i], "--export") == 0) {
+        export_opts.enabled = true;
+        export_opts.sensor_id = static_cast<std::uint32_t>(value);
+      } else if (std::strcmp(argv[i], "--from") == 0) {
+        export_opts.from = value;
+      } else if (std::strcmp(argv[i], "--to") == 0) {
+        export_opts.to = value;
+      } else {
+        export_opts.step = value;
+      }
+      i++;
+    } else if (std::strcmp(argv[i], "--output") == 0) {
+      if (!has_next) {
+        std::cerr << "Missing path to '--output' argument." << std::endl;
+        return EXIT_FAILURE;
+      }
+      export_opts.output_path = argv[i + 1];
+      i++;
     } else if (std::strcmp(argv[i], "--help") == 0) {
       std::cerr << "Usage: " << argv[i] << " [options]" << std::endl;
       std::cerr << help;
@@ -226,9 +212,19 @@ main(int argc, char** argv)
     return EXIT_FAILURE;
   }
 
+  if (export_opts.enabled) {
+    return export_clip(cfg, export_opts);
+  }
+
   {
     auto prg = std::make_unique<program>();
 
+#ifdef WITH_BUNDLE
+    prg->add_file("/index.html", "text/html", open_rc_file("index.html"));
+    prg->add_file("/dashboard.js", "text/javascript", open_rc_file("dashboard.js"));
+    prg->add_file("/dashboard.wasm", "application/wasm", open_rc_file("dashboard.wasm"));
+#endif
+
     prg->run(cfg);
   }
 
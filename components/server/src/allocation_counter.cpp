@@ -0,0 +1,210 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+
+#ifdef SENTINEL_COUNT_ALLOCATIONS
+#include <new>
+
+#include <cstddef>
+#include <cstdlib>
+#endif
+
+namespace {
+
+/* These are trivial, so that they can be used by operator new before (and after) any constructors run. */
+
+thread_local std::uint64_t thread_count{};
+
+thread_local std::uint64_t thread_mark{};
+
+std::atomic<std::uint64_t> total_count{};
+
+} // namespace
+
+auto
+allocation_counter::get_thread_count() noexcept -> std::uint64_t
+{
+  return thread_count;
+}
+
+auto
+allocation_counter::get_total_count() noexcept -> std::uint64_t
+{
+  return total_count.load(std::memory_order_relaxed);
+}
+
+auto
+allocation_counter::take_thread_count() noexcept -> std::uint64_t
+{
+  const auto count = thread_count - thread_mark;
+
+  thread_mark = thread_count;
+
+  return count;
+}
+
+#ifdef SENTINEL_COUNT_ALLOCATIONS
+
+namespace {
+
+auto
+counted_alloc(std::size_t size, const std::size_t alignment) noexcept -> void*
+{
+  thread_count++;
+
+  total_count.fetch_add(1, std::memory_order_relaxed);
+
+  if (size == 0) {
+    size = 1;
+  }
+
+  if (alignment <= alignof(std::max_align_t)) {
+    return std::malloc(size);
+  }
+
+  /* The size of an aligned allocation has to be a multiple of the alignment. */
+  return std::aligned_alloc(alignment, ((size + alignment - 1) / alignment) * alignment);
+}
+
+auto
+counted_alloc_or_throw(const std::size_t size, const std::size_t alignment) -> void*
+{
+  for (;;) {
+
+    if (auto* ptr = counted_alloc(size, alignment)) {
+      return ptr;
+    }
+
+    auto handler = std::get_new_handler();
+
+    if (!handler) {
+      throw std::bad_alloc();
+    }
+
+    handler();
+  }
+}
+
+} // namespace
+
+auto
+operator new(const std::size_t size) -> void*
+{
+  return counted_alloc_or_throw(size, 0);
+}
+
+auto
+operator new[](const std::size_t size) -> void*
+{
+  return counted_alloc_or_throw(size, 0);
+}
+
+auto
+operator new(const std::size_t size, const std::align_val_t alignment) -> void*
+{
+  return counted_alloc_or_throw(size, static_cast<std::size_t>(alignment));
+}
+
+auto
+operator new[](const std::size_t size, const std::align_val_t alignment) -> void*
+{
+  return counted_alloc_or_throw(size, static_cast<std::size_t>(alignment));
+}
+
+auto
+operator new(const std::size_t size, const std::nothrow_t&) noexcept -> void*
+{
+  return counted_alloc(size, 0);
+}
+
+auto
+operator new[](const std::size_t size, const std::nothrow_t&) noexcept -> void*
+{
+  return counted_alloc(size, 0);
+}
+
+auto
+operator new(const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept -> void*
+{
+  return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+
+auto
+operator new[](const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept -> void*
+{
+  return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete[](void* ptr) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete(void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete[](void* ptr, std::size_t) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete(void* ptr, std::align_val_t) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete[](void* ptr, std::align_val_t) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete(void* ptr, std::size_t, std::align_val_t) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete(void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  std::free(ptr);
+}
+
+void
+operator delete[](void* ptr, std::align_val_t, const std::nothrow_t&) noexcept
+{
+  std::free(ptr);
+}
+
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Counts the heap allocations (calls to the global operator new) that each thread makes, so that the steady
+ *        state of a pipeline can be checked for allocations.
+ *
+ * @details The allocations are only counted when the server is built with ENABLE_ALLOCATION_COUNTING, which replaces
+ *          the global operator new. Otherwise, every count is zero. Allocations that C libraries make with malloc (such
+ *          as the ones of libuv and OpenCV) are not counted.
+ * */
+class allocation_counter final
+{
+public:
+#ifdef SENTINEL_COUNT_ALLOCATIONS
+  static constexpr bool enabled{ true };
+#else
+  static constexpr bool enabled{ false };
+#endif
+
+  /**
+   * @brief Gets the number of allocations that the calling thread has made since it started.
+   * */
+  static auto get_thread_count() noexcept -> std::uint64_t;
+
+  /**
+   * @brief Gets the number of allocations that every thread has made since the program started.
+   * */
+  static auto get_total_count() noexcept -> std::uint64_t;
+
+  /**
+   * @brief Gets the number of allocations that the calling thread has made since the last call to this function on
+   *        that thread. This is used to attribute the allocations of a thread to the stage that it just finished.
+   * */
+  static auto take_thread_count() noexcept -> std::uint64_t;
+};
@@ -0,0 +1,136 @@
+#include "audio_event_detector.h"
+
+#include <algorithm>
+
+#include <cmath>
+
+namespace {
+
+/**
+ * @brief The lowest level that is reported, so that digital silence does not produce infinities.
+ * */
+constexpr float min_level{ -120.0f };
+
+/**
+ * @brief How quickly the noise floor follows the level down, in seconds.
+ * */
+constexpr float floor_fall_time{ 0.5f };
+
+/**
+ * @brief How quickly the noise floor follows the level up, in seconds.
+ * */
+constexpr float floor_rise_time{ 10.0f };
+
+auto
+to_db(const float mean_square) -> float
+{
+  if (mean_square <= 0.0f) {
+    return min_level;
+  }
+
+  return std::max(10.0f * std::log10(mean_square), min_level);
+}
+
+} // namespace
+
+audio_event_detector::audio_event_detector(const float on_threshold,
+                                           const float off_threshold,
+                                           const float flux_threshold,
+                                           const float hold)
+  : m_on_threshold(on_threshold)
+  , m_off_threshold(std::min(off_threshold, on_threshold))
+  , m_flux_threshold(flux_threshold)
+  , m_hold(hold)
+  , m_features(flux_bands)
+  , m_previous_bands(flux_bands, min_level)
+{
+}
+
+auto
+audio_event_detector::update(const std::int16_t* samples, const std::size_t count, const std::uint32_t rate) -> bool
+{
+  if ((count == 0) || (rate == 0)) {
+    return false;
+  }
+
+  const auto duration = static_cast<float>(count) / static_cast<float>(rate);
+
+  m_features.reset();
+
+  m_features.add(samples, count, rate);
+
+  const auto rms = m_features.get_rms();
+
+  m_level = to_db(rms * rms);
+
+  m_flux = update_flux();
+
+  if (m_first_period) {
+    m_noise_floor = m_level;
+    m_first_period = false;
+    return false;
+  }
+
+  const auto above_floor = m_level - m_noise_floor;
+
+  if (!m_active) {
+
+    const auto onset = (m_flux >= m_flux_threshold) && (above_floor >= m_off_threshold);
+
+    if ((above_floor >= m_on_threshold) || onset) {
+      m_active = true;
+      m_quiet_time = 0.0f;
+      return true;
+    }
+
+    update_noise_floor(duration);
+
+    return false;
+  }
+
+  if (above_floor >= m_off_threshold) {
+    m_quiet_time = 0.0f;
+    return false;
+  }
+
+  m_quiet_time += duration;
+
+  if (m_quiet_time < m_hold) {
+    return false;
+  }
+
+  m_active = false;
+
+  return true;
+}
+
+void
+audio_event_detector::update_noise_floor(const float duration)
+{
+  const auto time_constant = (m_level < m_noise_floor) ? floor_fall_time : floor_rise_time;
+
+  const auto alpha = 1.0f - std::exp(-duration / time_constant);
+
+  m_noise_floor += (m_level - m_noise_floor) * alpha;
+}
+
+auto
+audio_event_detector::update_flux() -> float
+{
+  const auto& bands = m_features.get_bands();
+
+  float rise{};
+
+  for (std::size_t i = 0; i < bands.size(); i++) {
+
+    const auto level = to_db(bands[i]);
+
+    if (!m_first_period) {
+      rise += std::max(level - m_previous_bands[i], 0.0f);
+    }
+
+    m_previous_bands[i] = level;
+  }
+
+  return bands.empty() ? 0.0f : (rise / static_cast<float>(bands.size()));
+}
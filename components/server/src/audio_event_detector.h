@@ -0,0 +1,101 @@
+#pragma once
+
+#include "audio_features.h"
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Detects acoustic events (sounds that stand out from the background) in a stream of audio periods.
+ *
+ * @details The level of each period is compared against an adaptive noise floor, which follows the level down quickly
+ *          and up slowly, so that steady background noise (such as HVAC hum) becomes part of the floor. An event
+ *          starts when the level rises far enough above the floor, or when the spectral flux (the average rise of the
+ *          band levels since the previous period) shows an onset while the level is above the floor. An event ends
+ *          once the level has stayed close to the floor for the hold time, so that short pauses do not split it.
+ *
+ *          The noise floor is not updated during an event, so that long events do not become part of the background.
+ * */
+class audio_event_detector final
+{
+public:
+  /**
+   * @brief The number of frequency bands used for the spectral flux.
+   * */
+  static constexpr std::size_t flux_bands{ 16 };
+
+  /**
+   * @brief Constructs a new event detector.
+   *
+   * @param on_threshold How far above the noise floor the level has to be to start an event, in dB.
+   *
+   * @param off_threshold How far above the noise floor the level has to be to continue an event, in dB.
+   *
+   * @param flux_threshold The spectral flux that starts an event, in dB.
+   *
+   * @param hold The number of seconds that the level has to stay below the off threshold to end an event.
+   * */
+  audio_event_detector(float on_threshold, float off_threshold, float flux_threshold, float hold);
+
+  /**
+   * @brief Updates the detector with a new period of audio.
+   *
+   * @return True if an event started or ended with this period.
+   * */
+  auto update(const std::int16_t* samples, std::size_t count, std::uint32_t rate) -> bool;
+
+  auto is_active() const -> bool { return m_active; }
+
+  /**
+   * @brief Gets the level of the last period, in dB relative to full scale.
+   * */
+  auto get_level() const -> float { return m_level; }
+
+  /**
+   * @brief Gets the current noise floor, in dB relative to full scale.
+   * */
+  auto get_noise_floor() const -> float { return m_noise_floor; }
+
+  /**
+   * @brief Gets the spectral flux of the last period, in dB.
+   * */
+  auto get_flux() const -> float { return m_flux; }
+
+protected:
+  void update_noise_floor(float duration);
+
+  auto update_flux() -> float;
+
+private:
+  const float m_on_threshold{};
+
+  const float m_off_threshold{};
+
+  const float m_flux_threshold{};
+
+  const float m_hold{};
+
+  audio_features m_features;
+
+  /**
+   * @brief The band levels of the previous period, in dB.
+   * */
+  std::vector<float> m_previous_bands;
+
+  bool m_first_period{ true };
+
+  bool m_active{ false };
+
+  float m_level{};
+
+  float m_noise_floor{};
+
+  float m_flux{};
+
+  /**
+   * @brief The number of seconds that the level has been below the off threshold during the current event.
+   * */
+  float m_quiet_time{};
+};
@@ -0,0 +1,227 @@
+#include "audio_features.h"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+constexpr float sample_scale{ 1.0f / 32768.0f };
+
+constexpr double pi{ 3.14159265358979323846 };
+
+/**
+ * @brief Gets the largest power of two that is not greater than @p n, or zero if @p n is zero.
+ * */
+auto
+floor_power_of_two(std::size_t n) -> std::size_t
+{
+  std::size_t p = 1;
+
+  while ((p * 2) <= n) {
+    p *= 2;
+  }
+
+  return (n == 0) ? 0 : p;
+}
+
+} // namespace
+
+audio_features::audio_features(const std::size_t band_count)
+  : m_band_count(band_count)
+  , m_band_sums(band_count)
+  , m_bands(band_count)
+{
+}
+
+void
+audio_features::reset()
+{
+  m_peak = 0;
+
+  m_sum_of_squares = 0;
+
+  m_sample_count = 0;
+
+  m_transform_count = 0;
+
+  std::fill(m_band_sums.begin(), m_band_sums.end(), 0.0);
+}
+
+void
+audio_features::add(const std::int16_t* samples, const std::size_t count, const std::uint32_t rate)
+{
+  std::int64_t sum_of_squares{};
+
+  for (std::size_t i = 0; i < count; i++) {
+
+    const std::int32_t s = samples[i];
+
+    m_peak = std::max(m_peak, std::abs(s));
+
+    sum_of_squares += s * s;
+  }
+
+  m_sum_of_squares += static_cast<double>(sum_of_squares);
+
+  m_sample_count += count;
+
+  if (m_band_count == 0) {
+    return;
+  }
+
+  const auto size = floor_power_of_two(count);
+
+  if ((size < 4) || (rate == 0)) {
+    return;
+  }
+
+  if ((size != m_transform_size) || (rate != m_transform_rate)) {
+    prepare(size, rate);
+  }
+
+  /* The most recent samples are used, if the buffer is not a power of two. */
+  transform(samples + (count - size));
+}
+
+auto
+audio_features::get_peak() const -> float
+{
+  return std::min(static_cast<float>(m_peak) * sample_scale, 1.0f);
+}
+
+auto
+audio_features::get_rms() const -> float
+{
+  if (m_sample_count == 0) {
+    return 0.0f;
+  }
+
+  return static_cast<float>(std::sqrt(m_sum_of_squares / static_cast<double>(m_sample_count))) * sample_scale;
+}
+
+auto
+audio_features::get_bands() -> const std::vector<float>&
+{
+  const auto scale = (m_transform_count > 0) ? (1.0 / static_cast<double>(m_transform_count)) : 0.0;
+
+  for (std::size_t i = 0; i < m_band_count; i++) {
+    m_bands[i] = static_cast<float>(m_band_sums[i] * scale);
+  }
+
+  return m_bands;
+}
+
+void
+audio_features::prepare(const std::size_t size, const std::uint32_t rate)
+{
+  m_transform_size = size;
+
+  m_transform_rate = rate;
+
+  const auto half_size = size / 2;
+
+  m_buffer.resize(half_size);
+
+  m_twiddles.resize(half_size + 1);
+
+  for (std::size_t k = 0; k <= half_size; k++) {
+    const auto angle = -2.0 * pi * static_cast<double>(k) / static_cast<double>(size);
+    m_twiddles[k] = std::complex<float>(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+  }
+
+  m_bin_bands.resize(half_size + 1);
+
+  const auto nyquist = static_cast<double>(rate) * 0.5;
+
+  const auto log_range = std::log(nyquist / min_band_frequency);
+
+  for (std::size_t k = 0; k <= half_size; k++) {
+
+    const auto frequency = static_cast<double>(k) * static_cast<double>(rate) / static_cast<double>(size);
+
+    if ((frequency < min_band_frequency) || (log_range <= 0.0)) {
+      m_bin_bands[k] = m_band_count;
+      continue;
+    }
+
+    const auto band = static_cast<std::size_t>(std::log(frequency / min_band_frequency) / log_range * m_band_count);
+
+    m_bin_bands[k] = std::min(band, m_band_count - 1);
+  }
+}
+
+void
+audio_features::transform(const std::int16_t* samples)
+{
+  const auto n = m_transform_size;
+
+  const auto m = n / 2;
+
+  /* The real samples are packed into a complex sequence of half the size, with the even samples as the real part and
+   * the odd samples as the imaginary part. The sequence is stored in bit-reversed order for the transform. */
+  std::size_t bits = 0;
+
+  while ((std::size_t(1) << bits) < m) {
+    bits++;
+  }
+
+  for (std::size_t i = 0; i < m; i++) {
+
+    std::size_t j = 0;
+
+    for (std::size_t b = 0; b < bits; b++) {
+      j |= ((i >> b) & 1) << (bits - 1 - b);
+    }
+
+    m_buffer[j] = std::complex<float>(samples[i * 2] * sample_scale, samples[i * 2 + 1] * sample_scale);
+  }
+
+  for (std::size_t len = 2; len <= m; len *= 2) {
+
+    const auto half = len / 2;
+
+    /* The twiddles are for the full size, so every (n / len)th one belongs to this stage. */
+    const auto stride = n / len;
+
+    for (std::size_t i = 0; i < m; i += len) {
+      for (std::size_t j = 0; j < half; j++) {
+        const auto u = m_buffer[i + j];
+        const auto v = m_buffer[i + j + half] * m_twiddles[j * stride];
+        m_buffer[i + j] = u + v;
+        m_buffer[i + j + half] = u - v;
+      }
+    }
+  }
+
+  /* The spectrum of the even and odd samples are separated and combined into the spectrum of the real samples. Only
+   * the bins from DC to Nyquist are needed, since the rest mirror them. */
+  const auto norm = 1.0 / (static_cast<double>(n) * static_cast<double>(n));
+
+  for (std::size_t k = 1; k <= m; k++) {
+
+    const auto band = m_bin_bands[k];
+
+    if (band >= m_band_count) {
+      continue;
+    }
+
+    const auto z0 = m_buffer[k % m];
+
+    const auto z1 = std::conj(m_buffer[(m - k) % m]);
+
+    const auto even = (z0 + z1) * 0.5f;
+
+    const auto odd = (z0 - z1) * std::complex<float>(0.0f, -0.5f);
+
+    const auto x = even + (m_twiddles[k] * odd);
+
+    /* Every bin but Nyquist has a mirror image, which holds as much energy. */
+    const auto weight = (k == m) ? 1.0 : 2.0;
+
+    m_band_sums[band] += static_cast<double>(std::norm(x)) * weight * norm;
+  }
+
+  m_transform_count++;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <complex>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Accumulates a compact summary of audio, so that clients which only display the sound level do not need the
+ *        samples.
+ *
+ * @details The peak and RMS cover every sample that was added. If frequency bands are enabled, each buffer of samples
+ *          is also transformed with a real FFT (over the largest power of two that fits in the buffer), and the energy
+ *          of each bin is added to one of several logarithmically spaced bands.
+ *
+ *          The memory for the transform is only allocated when the buffer size or sampling rate changes, so no memory
+ *          is allocated per buffer once capture has started.
+ * */
+class audio_features final
+{
+public:
+  /**
+   * @brief The lowest frequency covered by the bands, in Hz.
+   * */
+  static constexpr float min_band_frequency{ 50.0f };
+
+  /**
+   * @brief Constructs a new set of audio features.
+   *
+   * @param band_count The number of frequency bands to compute, which may be zero to skip the transform.
+   * */
+  explicit audio_features(std::size_t band_count);
+
+  /**
+   * @brief Adds a buffer of samples to the features.
+   * */
+  void add(const std::int16_t* samples, std::size_t count, std::uint32_t rate);
+
+  /**
+   * @brief Clears the features, so that a new interval can be accumulated.
+   * */
+  void reset();
+
+  /**
+   * @brief Gets the number of samples that were added since the last reset.
+   * */
+  auto get_sample_count() const -> std::uint64_t { return m_sample_count; }
+
+  /**
+   * @brief Gets the peak absolute sample value, in the range [0, 1].
+   * */
+  auto get_peak() const -> float;
+
+  /**
+   * @brief Gets the root mean square of the samples, in the range [0, 1].
+   * */
+  auto get_rms() const -> float;
+
+  /**
+   * @brief Gets the mean square of the samples in each band, averaged over the buffers that were added.
+   *
+   * @details Since the transform is not windowed, the bands add up to roughly the square of the RMS (less whatever is
+   *          below @ref audio_features::min_band_frequency).
+   * */
+  auto get_bands() -> const std::vector<float>&;
+
+protected:
+  /**
+   * @brief Updates the transform tables for a new transform size or sampling rate.
+   * */
+  void prepare(std::size_t size, std::uint32_t rate);
+
+  void transform(const std::int16_t* samples);
+
+private:
+  std::size_t m_band_count{};
+
+  std::int32_t m_peak{};
+
+  double m_sum_of_squares{};
+
+  std::uint64_t m_sample_count{};
+
+  /**
+   * @brief The number of transforms that were added to the band energies.
+   * */
+  std::uint64_t m_transform_count{};
+
+  std::vector<double> m_band_sums;
+
+  std::vector<float> m_bands;
+
+  std::size_t m_transform_size{};
+
+  std::uint32_t m_transform_rate{};
+
+  /**
+   * @brief The band of each bin, or the band count if the bin is not covered by any band.
+   * */
+  std::vector<std::size_t> m_bin_bands;
+
+  std::vector<std::complex<float>> m_twiddles;
+
+  std::vector<std::complex<float>> m_buffer;
+};
@@ -0,0 +1,545 @@
+#include "audio_storage.h"
+
+#include "clock.h"
+#include "wav_header.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <sstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * @brief The number of seconds of samples to put into each block.
+ * */
+constexpr std::size_t block_duration{ 1 };
+
+/**
+ * @brief The maximum number of blocks, including the one being filled. Once every block is waiting to be written,
+ *        new samples are dropped.
+ * */
+constexpr std::size_t max_blocks{ 32 };
+
+/**
+ * @brief The number of seconds of samples to write between updates of the segment header.
+ * */
+constexpr std::uint64_t header_interval{ 5 };
+
+/**
+ * @brief How far (in microseconds) the time of a buffer may be from the end of the samples before it, before it is
+ *        considered a gap in the audio.
+ * */
+constexpr std::uint64_t max_time_error{ 200 * 1000 };
+
+constexpr std::uint64_t sample_size{ sizeof(std::int16_t) };
+
+auto
+time_error(const std::uint64_t a, const std::uint64_t b) -> std::uint64_t
+{
+  return (a > b) ? (a - b) : (b - a);
+}
+
+auto
+write_all(const int fd, const void* data, const std::size_t size, const std::uint64_t offset) -> bool
+{
+  const auto* ptr = static_cast<const std::uint8_t*>(data);
+
+  std::size_t written{};
+
+  while (written < size) {
+
+    const auto result = ::pwrite(fd, ptr + written, size - written, static_cast<off_t>(offset + written));
+
+    if (result <= 0) {
+      return false;
+    }
+
+    written += static_cast<std::size_t>(result);
+  }
+
+  return true;
+}
+
+} // namespace
+
+auto
+audio_storage::create(const config::microphone_config& cfg) -> std::shared_ptr<audio_storage>
+{
+  auto seconds_to_usec = [](const double seconds) -> std::uint64_t {
+    return static_cast<std::uint64_t>(std::max(seconds, 0.0) * 1000 * 1000);
+  };
+
+  /* The sizes in the WAV header are 32-bit, which limits the length of a segment. */
+  const auto max_segment_duration = static_cast<double>(std::numeric_limits<std::uint32_t>::max() / sample_size) /
+                                    static_cast<double>(std::max(cfg.rate, 1U));
+
+  const auto segment_duration =
+    std::clamp(static_cast<double>(cfg.storage_segment_duration), 1.0, max_segment_duration * 0.9);
+
+  return std::make_shared<audio_storage>(cfg.storage_path,
+                                         seconds_to_usec(segment_duration),
+                                         seconds_to_usec(static_cast<double>(cfg.storage_days) * 24 * 3600));
+}
+
+audio_storage::audio_storage(std::string directory, const std::uint64_t segment_duration, const std::uint64_t max_age)
+  : m_directory(std::move(directory))
+  , m_segment_duration(segment_duration)
+  , m_max_age(max_age)
+{
+}
+
+audio_storage::~audio_storage()
+{
+  if (!m_thread.joinable()) {
+    return;
+  }
+
+  if (!m_current.samples.empty()) {
+    submit_block();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_queue_lock);
+    m_should_stop = true;
+  }
+
+  m_queue_cv.notify_one();
+
+  m_thread.join();
+}
+
+auto
+audio_storage::get_segment_path(const std::uint64_t time) const -> std::string
+{
+  std::ostringstream path_stream;
+
+  path_stream << m_directory << '/' << time << ".wav";
+
+  return path_stream.str();
+}
+
+void
+audio_storage::start()
+{
+  scan();
+
+  m_pending_blocks.reserve(max_blocks);
+
+  m_free_blocks.reserve(max_blocks);
+
+  m_thread = std::thread(&audio_storage::run, this);
+}
+
+void
+audio_storage::scan()
+{
+  std::error_code error;
+
+  std::filesystem::create_directories(m_directory, error);
+
+  if (error) {
+    spdlog::error("Failed to create audio storage directory '{}'.", m_directory);
+    return;
+  }
+
+  std::deque<segment> segments;
+
+  for (const auto& dir_entry : std::filesystem::directory_iterator(m_directory)) {
+
+    const auto entry_path = dir_entry.path();
+
+    if (entry_path.extension().string() != ".wav") {
+      continue;
+    }
+
+    std::istringstream in_stream(entry_path.stem().string());
+
+    segment s;
+
+    std::uint32_t data_size{};
+
+    if (!(in_stream >> s.time) || !read_wav_header(entry_path.string(), s.rate, data_size)) {
+      continue;
+    }
+
+    const auto file_size = std::filesystem::file_size(entry_path, error);
+
+    if (error || (file_size < wav_header_size)) {
+      continue;
+    }
+
+    s.samples = std::min<std::uint64_t>((file_size - wav_header_size) / sample_size,
+                                        std::numeric_limits<std::uint32_t>::max() / sample_size);
+
+    const auto size = s.samples * sample_size;
+
+    if ((size != data_size) || ((wav_header_size + size) != file_size)) {
+
+      spdlog::warn("Fixing the header of audio segment '{}', which was not closed properly.", entry_path.string());
+
+      const auto fd = ::open(entry_path.c_str(), O_WRONLY | O_CLOEXEC);
+
+      if (fd < 0) {
+        continue;
+      }
+
+      const auto header = make_wav_header(s.rate, static_cast<std::uint32_t>(size));
+
+      const auto fixed =
+        write_all(fd, header.data(), header.size(), 0) && (::ftruncate(fd, wav_header_size + size) == 0);
+
+      ::close(fd);
+
+      if (!fixed) {
+        continue;
+      }
+    }
+
+    segments.emplace_back(s);
+  }
+
+  auto cmp = [](const segment& l, const segment& r) -> bool { return l.time < r.time; };
+
+  std::sort(segments.begin(), segments.end(), cmp);
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    m_segments = std::move(segments);
+  }
+
+  remove_old_segments(sentinel::get_clock_time());
+}
+
+void
+audio_storage::store(const std::uint64_t time, const std::uint32_t rate, const std::int16_t* samples, std::size_t count)
+{
+  if ((rate == 0) || (count == 0)) {
+    return;
+  }
+
+  if (!m_current.samples.empty()) {
+
+    const auto expected = m_current.time + ((m_current.samples.size() * 1000000) / m_current.rate);
+
+    if ((m_current.rate != rate) || (time_error(time, expected) > max_time_error)) {
+      submit_block();
+    }
+  }
+
+  const auto block_size = static_cast<std::size_t>(rate) * block_duration;
+
+  std::size_t offset{};
+
+  while (offset < count) {
+
+    if (m_current.samples.empty()) {
+      m_current.time = time + ((offset * 1000000) / rate);
+      m_current.rate = rate;
+      m_current.samples.reserve(block_size);
+    }
+
+    const auto n = std::min(count - offset, block_size - m_current.samples.size());
+
+    m_current.samples.insert(m_current.samples.end(), samples + offset, samples + offset + n);
+
+    offset += n;
+
+    if (m_current.samples.size() >= block_size) {
+      submit_block();
+    }
+  }
+}
+
+void
+audio_storage::submit_block()
+{
+  block next;
+
+  {
+    std::lock_guard<std::mutex> lock(m_queue_lock);
+
+    if (!m_free_blocks.empty()) {
+      next = std::move(m_free_blocks.back());
+      m_free_blocks.pop_back();
+    } else if (m_block_count < max_blocks) {
+      m_block_count++;
+    } else {
+      /* The writer is too far behind. The next block will start a new segment, since its time won't line up. */
+      m_dropped_samples += m_current.samples.size();
+      m_current.samples.clear();
+      return;
+    }
+
+    m_pending_blocks.emplace_back(std::move(m_current));
+  }
+
+  m_queue_cv.notify_one();
+
+  m_current = std::move(next);
+
+  m_current.samples.clear();
+}
+
+auto
+audio_storage::get_dropped_samples() const -> std::uint64_t
+{
+  std::lock_guard<std::mutex> lock(m_queue_lock);
+
+  return m_dropped_samples;
+}
+
+void
+audio_storage::run()
+{
+  std::vector<block> blocks;
+
+  blocks.reserve(max_blocks);
+
+  while (true) {
+
+    {
+      std::unique_lock<std::mutex> lock(m_queue_lock);
+
+      m_queue_cv.wait(lock, [this]() -> bool { return m_should_stop || !m_pending_blocks.empty(); });
+
+      if (m_pending_blocks.empty()) {
+        break;
+      }
+
+      std::swap(blocks, m_pending_blocks);
+    }
+
+    for (const auto& b : blocks) {
+      write_block(b);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_queue_lock);
+
+      for (auto& b : blocks) {
+        m_free_blocks.emplace_back(std::move(b));
+      }
+    }
+
+    blocks.clear();
+  }
+
+  close_segment();
+}
+
+void
+audio_storage::write_block(const block& b)
+{
+  segment last;
+
+  if (m_fd >= 0) {
+    std::lock_guard<std::mutex> lock(m_lock);
+    last = m_segments.back();
+  }
+
+  const auto contiguous = (m_fd >= 0) && (last.rate == b.rate) &&
+                          (time_error(b.time, last.get_end_time()) <= max_time_error) &&
+                          ((b.time - last.time) < m_segment_duration);
+
+  if (!contiguous) {
+
+    close_segment();
+
+    remove_old_segments(b.time);
+
+    if (!open_segment(b.time, b.rate)) {
+      if (!m_write_failed) {
+        spdlog::error("Failed to open audio segment '{}'.", get_segment_path(b.time));
+        m_write_failed = true;
+      }
+      return;
+    }
+
+    last = segment{ b.time, b.rate, 0 };
+  }
+
+  const auto size = b.samples.size() * sample_size;
+
+  if (!write_all(m_fd, b.samples.data(), size, wav_header_size + (last.samples * sample_size))) {
+    if (!m_write_failed) {
+      spdlog::error("Failed to write to audio segment '{}'.", get_segment_path(last.time));
+      m_write_failed = true;
+    }
+    close_segment();
+    return;
+  }
+
+  m_write_failed = false;
+
+  const auto samples = last.samples + b.samples.size();
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_segments.back().samples = samples;
+  }
+
+  if ((samples - m_header_samples) >= (header_interval * b.rate)) {
+    update_header();
+  }
+}
+
+auto
+audio_storage::open_segment(const std::uint64_t time, const std::uint32_t rate) -> bool
+{
+  const auto fd = ::open(get_segment_path(time).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  const auto header = make_wav_header(rate, 0);
+
+  if (!write_all(fd, header.data(), header.size(), 0)) {
+    ::close(fd);
+    return false;
+  }
+
+#ifdef __linux__
+  /* The size of the file is kept as it is, so that it still ends at the last sample if the server stops abruptly. */
+  const auto expected_size = ((m_segment_duration * rate) / 1000000) * sample_size;
+
+  ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(wav_header_size + expected_size));
+#endif
+
+  m_fd = fd;
+
+  m_header_samples = 0;
+
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  m_segments.emplace_back(segment{ time, rate, 0 });
+
+  return true;
+}
+
+void
+audio_storage::close_segment()
+{
+  if (m_fd < 0) {
+    return;
+  }
+
+  update_header();
+
+  segment last;
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    last = m_segments.back();
+
+    if (last.samples == 0) {
+      m_segments.pop_back();
+    }
+  }
+
+  /* This releases the space that was allocated for samples that never came. */
+  if (::ftruncate(m_fd, static_cast<off_t>(wav_header_size + (last.samples * sample_size))) != 0) {
+    spdlog::warn("Failed to truncate audio segment '{}'.", get_segment_path(last.time));
+  }
+
+  ::close(m_fd);
+
+  m_fd = -1;
+
+  if (last.samples == 0) {
+    std::error_code error;
+    std::filesystem::remove(get_segment_path(last.time), error);
+  }
+}
+
+void
+audio_storage::update_header()
+{
+  segment last;
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    last = m_segments.back();
+  }
+
+  const auto header = make_wav_header(last.rate, static_cast<std::uint32_t>(last.samples * sample_size));
+
+  if (write_all(m_fd, header.data(), header.size(), 0)) {
+    m_header_samples = last.samples;
+  }
+}
+
+void
+audio_storage::remove_old_segments(const std::uint64_t now)
+{
+  if (now <= m_max_age) {
+    return;
+  }
+
+  std::vector<std::uint64_t> removed;
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    /* The open segment is always the newest one, so it is only removed if it was closed first. */
+    const std::size_t open_count = (m_fd >= 0) ? 1 : 0;
+
+    while ((m_segments.size() > open_count) && (m_segments.front().get_end_time() < (now - m_max_age))) {
+      removed.emplace_back(m_segments.front().time);
+      m_segments.pop_front();
+    }
+  }
+
+  for (const auto time : removed) {
+    std::error_code error;
+    std::filesystem::remove(get_segment_path(time), error);
+  }
+}
+
+auto
+audio_storage::region::follows(const region& previous) const -> bool
+{
+  return (rate == previous.rate) && (time_error(time, previous.get_end_time()) <= max_time_error);
+}
+
+auto
+audio_storage::query(const std::uint64_t from, const std::uint64_t to) const -> std::vector<region>
+{
+  std::vector<region> regions;
+
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  for (const auto& s : m_segments) {
+
+    const auto end = s.get_end_time();
+
+    if ((s.samples == 0) || (s.time > to) || (end <= from)) {
+      continue;
+    }
+
+    /* The first sample at or after the start of the range, and the sample after the last one within it. */
+    const auto first = (from > s.time) ? ((((from - s.time) * s.rate) + 999999) / 1000000) : 0;
+
+    const auto last =
+      (to >= end) ? s.samples : std::min<std::uint64_t>(s.samples, (((to - s.time) * s.rate) / 1000000) + 1);
+
+    if (first >= last) {
+      continue;
+    }
+
+    const auto offset = wav_header_size + (first * sample_size);
+
+    regions.emplace_back(
+      region{ s.time, s.rate, offset, (last - first) * sample_size, s.time + ((first * 1000000) / s.rate) });
+  }
+
+  return regions;
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "config.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Stores the audio of a microphone in WAV segment files.
+ *
+ * @details Samples are gathered into large blocks on the capture thread, which are handed to a writer thread so that
+ *          the capture thread never waits on the disk. Blocks are reused once they are written, so no memory is
+ *          allocated once capture has started.
+ *
+ *          Each segment file covers a fixed amount of time and is named after the time of its first sample. Its space
+ *          is allocated up front, so that it is not fragmented by the other files that are written at the same time.
+ *          The header is updated periodically, so that a segment can be played back while it is still being written.
+ *          If capture is interrupted (or samples are lost), a new segment is started, so that the time of each sample
+ *          can always be derived from its position in the segment.
+ *
+ * @note The methods of this class are thread safe, except for @ref audio_storage::store, which must only be called from
+ *       one thread.
+ * */
+class audio_storage final
+{
+public:
+  struct segment final
+  {
+    /**
+     * @brief The time of the first sample, in terms of microseconds since Unix epoch.
+     * */
+    std::uint64_t time{};
+
+    std::uint32_t rate{};
+
+    /**
+     * @brief The number of samples in the segment file.
+     * */
+    std::uint64_t samples{};
+
+    auto get_end_time() const -> std::uint64_t { return time + ((samples * 1000000) / rate); }
+  };
+
+  /**
+   * @brief A range of samples within a segment file.
+   * */
+  struct region final
+  {
+    std::uint64_t segment{};
+
+    std::uint32_t rate{};
+
+    /**
+     * @brief The offset of the first sample within the segment file.
+     * */
+    std::uint64_t offset{};
+
+    /**
+     * @brief The number of bytes of samples.
+     * */
+    std::uint64_t size{};
+
+    /**
+     * @brief The time of the first sample, in terms of microseconds since Unix epoch.
+     * */
+    std::uint64_t time{};
+
+    auto get_end_time() const -> std::uint64_t { return time + (((size / sizeof(std::int16_t)) * 1000000) / rate); }
+
+    /**
+     * @brief Indicates whether or not this region carries on from another one, at the same rate and without a gap.
+     * */
+    auto follows(const region& previous) const -> bool;
+  };
+
+  /**
+   * @brief Creates the audio storage of a microphone, according to its configuration. The writer thread is not started
+   *        yet.
+   * */
+  static auto create(const config::microphone_config& cfg) -> std::shared_ptr<audio_storage>;
+
+  /**
+   * @brief Constructs a new audio storage, without starting the writer thread.
+   *
+   * @param directory The directory to put the segment files into.
+   *
+   * @param segment_duration The amount of time covered by each segment file, in microseconds.
+   *
+   * @param max_age How long to keep each segment, in microseconds.
+   * */
+  audio_storage(std::string directory, std::uint64_t segment_duration, std::uint64_t max_age);
+
+  audio_storage(const audio_storage&) = delete;
+
+  audio_storage(audio_storage&&) = delete;
+
+  auto operator=(const audio_storage&) -> audio_storage& = delete;
+
+  auto operator=(audio_storage&&) -> audio_storage& = delete;
+
+  /**
+   * @brief Writes the samples that have not been written yet, and stops the writer thread.
+   * */
+  ~audio_storage();
+
+  auto get_segment_path(std::uint64_t time) const -> std::string;
+
+  /**
+   * @brief Finds the existing segments and starts the writer thread.
+   *
+   * @note If a segment was not closed properly (for example, because of a power loss), its header is fixed so that it
+   *       covers every complete sample in the file.
+   * */
+  void start();
+
+  /**
+   * @brief Stores a buffer of samples.
+   *
+   * @param time The time of the first sample, in terms of microseconds since Unix epoch.
+   *
+   * @param rate The sampling rate.
+   *
+   * @param samples The samples to store.
+   *
+   * @param count The number of samples to store.
+   * */
+  void store(std::uint64_t time, std::uint32_t rate, const std::int16_t* samples, std::size_t count);
+
+  /**
+   * @brief Finds the samples within a time range, in chronological order.
+   * */
+  auto query(std::uint64_t from, std::uint64_t to) const -> std::vector<region>;
+
+  /**
+   * @brief Gets the number of samples that were dropped because the writer thread could not keep up.
+   * */
+  auto get_dropped_samples() const -> std::uint64_t;
+
+protected:
+  struct block final
+  {
+    std::uint64_t time{};
+
+    std::uint32_t rate{};
+
+    std::vector<std::int16_t> samples;
+  };
+
+  void scan();
+
+  /**
+   * @brief Hands the current block to the writer thread.
+   * */
+  void submit_block();
+
+  void run();
+
+  void write_block(const block& b);
+
+  auto open_segment(std::uint64_t time, std::uint32_t rate) -> bool;
+
+  void close_segment();
+
+  void update_header();
+
+  void remove_old_segments(std::uint64_t now);
+
+private:
+  const std::string m_directory;
+
+  const std::uint64_t m_segment_duration{};
+
+  const std::uint64_t m_max_age{};
+
+  mutable std::mutex m_lock;
+
+  std::deque<segment> m_segments;
+
+  /**
+   * @brief The block that is being filled by the capture thread.
+   * */
+  block m_current;
+
+  mutable std::mutex m_queue_lock;
+
+  std::condition_variable m_queue_cv;
+
+  /**
+   * @brief The blocks that are waiting to be written. This never holds more than the maximum number of blocks, so it
+   *        is only allocated once.
+   * */
+  std::vector<block> m_pending_blocks;
+
+  std::vector<block> m_free_blocks;
+
+  /**
+   * @brief The number of blocks that have been allocated.
+   * */
+  std::size_t m_block_count{ 1 };
+
+  std::uint64_t m_dropped_samples{};
+
+  bool m_should_stop{ false };
+
+  std::thread m_thread;
+
+  /**
+   * @brief The file descriptor of the segment that is being written by the writer thread, or -1 if there is none.
+   * */
+  int m_fd{ -1 };
+
+  /**
+   * @brief The number of samples that the header of the open segment currently covers.
+   * */
+  std::uint64_t m_header_samples{};
+
+  bool m_write_failed{ false };
+};
@@ -0,0 +1,230 @@
+#include "avi_clip.h"
+
+#include "jpeg_header.h"
+
+#include <algorithm>
+
+namespace {
+
+/**
+ * @brief The number of index entries to produce in each chunk, which bounds the amount of memory used for the index.
+ * */
+constexpr std::size_t index_entries_per_chunk{ 4096 };
+
+/**
+ * @brief The size of everything before the first frame chunk.
+ * */
+constexpr std::uint32_t header_size{ 224 };
+
+constexpr std::uint32_t avi_flag_has_index{ 0x10 };
+
+constexpr std::uint32_t avi_index_flag_keyframe{ 0x10 };
+
+auto
+padded(const std::uint32_t size) -> std::uint32_t
+{
+  return size + (size & 1);
+}
+
+void
+put_fourcc(std::vector<std::uint8_t>& out, const char* fourcc)
+{
+  out.insert(out.end(), fourcc, fourcc + 4);
+}
+
+void
+put_u16(std::vector<std::uint8_t>& out, const std::uint16_t value)
+{
+  out.emplace_back(static_cast<std::uint8_t>(value));
+  out.emplace_back(static_cast<std::uint8_t>(value >> 8));
+}
+
+void
+put_u32(std::vector<std::uint8_t>& out, const std::uint32_t value)
+{
+  put_u16(out, static_cast<std::uint16_t>(value));
+  put_u16(out, static_cast<std::uint16_t>(value >> 16));
+}
+
+} // namespace
+
+avi_clip::avi_clip(std::shared_ptr<storage_index> index,
+                   std::vector<storage_index::entry> frames,
+                   std::shared_ptr<void> lease)
+  : m_index(std::move(index))
+  , m_lease(std::move(lease))
+  , m_frames(std::move(frames))
+{
+  std::uint64_t movi_size = 4;
+
+  for (const auto& f : m_frames) {
+    movi_size += 8 + padded(f.size);
+  }
+
+  const auto index_size = static_cast<std::uint64_t>(m_frames.size()) * 16;
+
+  m_file_size = header_size + (movi_size - 4) + 8 + index_size;
+
+  m_movi_size = static_cast<std::uint32_t>(std::min<std::uint64_t>(movi_size, max_size));
+}
+
+void
+avi_clip::prepare()
+{
+  if (!m_frames.empty() && !read_jpeg_size(m_index->get_path(m_frames[0].time), m_width, m_height)) {
+    /* Most players take the frame size from the JPEG data anyways. */
+    m_width = 0;
+    m_height = 0;
+  }
+}
+
+auto
+avi_clip::make_header() const -> std::vector<std::uint8_t>
+{
+  const auto num_frames = static_cast<std::uint32_t>(m_frames.size());
+
+  std::uint32_t usec_per_frame{ 1000000 };
+
+  std::uint32_t max_frame_size{ 0 };
+
+  if (num_frames > 1) {
+    const auto duration = m_frames.back().time - m_frames.front().time;
+    usec_per_frame = static_cast<std::uint32_t>(std::max<std::uint64_t>(duration / (num_frames - 1), 1));
+  }
+
+  for (const auto& f : m_frames) {
+    max_frame_size = std::max(max_frame_size, f.size);
+  }
+
+  std::vector<std::uint8_t> out;
+
+  out.reserve(header_size);
+
+  put_fourcc(out, "RIFF");
+  put_u32(out, static_cast<std::uint32_t>(std::min<std::uint64_t>(m_file_size - 8, max_size)));
+  put_fourcc(out, "AVI ");
+
+  put_fourcc(out, "LIST");
+  put_u32(out, 192);
+  put_fourcc(out, "hdrl");
+
+  put_fourcc(out, "avih");
+  put_u32(out, 56);
+  put_u32(out, usec_per_frame);
+  put_u32(out, 0); /* max bytes per second */
+  put_u32(out, 0); /* padding granularity */
+  put_u32(out, avi_flag_has_index);
+  put_u32(out, num_frames);
+  put_u32(out, 0); /* initial frames */
+  put_u32(out, 1); /* streams */
+  put_u32(out, max_frame_size);
+  put_u32(out, m_width);
+  put_u32(out, m_height);
+  for (int i = 0; i < 4; i++) {
+    put_u32(out, 0); /* reserved */
+  }
+
+  put_fourcc(out, "LIST");
+  put_u32(out, 116);
+  put_fourcc(out, "strl");
+
+  put_fourcc(out, "strh");
+  put_u32(out, 56);
+  put_fourcc(out, "vids");
+  put_fourcc(out, "MJPG");
+  put_u32(out, 0); /* flags */
+  put_u16(out, 0); /* priority */
+  put_u16(out, 0); /* language */
+  put_u32(out, 0); /* initial frames */
+  put_u32(out, usec_per_frame);
+  put_u32(out, 1000000);
+  put_u32(out, 0); /* start */
+  put_u32(out, num_frames);
+  put_u32(out, max_frame_size);
+  put_u32(out, 0xffffffff); /* quality */
+  put_u32(out, 0);          /* sample size */
+  put_u16(out, 0);
+  put_u16(out, 0);
+  put_u16(out, m_width);
+  put_u16(out, m_height);
+
+  put_fourcc(out, "strf");
+  put_u32(out, 40);
+  put_u32(out, 40);
+  put_u32(out, m_width);
+  put_u32(out, m_height);
+  put_u16(out, 1);  /* planes */
+  put_u16(out, 24); /* bits per pixel */
+  put_fourcc(out, "MJPG");
+  put_u32(out, static_cast<std::uint32_t>(m_width) * m_height * 3);
+  put_u32(out, 0);
+  put_u32(out, 0);
+  put_u32(out, 0);
+  put_u32(out, 0);
+
+  put_fourcc(out, "LIST");
+  put_u32(out, m_movi_size);
+  put_fourcc(out, "movi");
+
+  return out;
+}
+
+auto
+avi_clip::next(http_body_chunk& chunk) -> bool
+{
+  if (!m_header_done) {
+    /* The header goes in front of the first frame. */
+    chunk.data = make_header();
+    m_header_done = true;
+  }
+
+  if (m_pad) {
+    chunk.data.emplace_back(0);
+    m_pad = false;
+  }
+
+  if (m_next_frame < m_frames.size()) {
+
+    const auto& f = m_frames[m_next_frame];
+
+    put_fourcc(chunk.data, "00dc");
+    put_u32(chunk.data, f.size);
+
+    chunk.file_path = m_index->get_path(f.time);
+    chunk.file_offset = 0;
+    chunk.file_size = f.size;
+
+    m_pad = (f.size & 1) != 0;
+
+    m_next_frame++;
+
+    return true;
+  }
+
+  if (m_index_done) {
+    return false;
+  }
+
+  if (m_next_index_entry == 0) {
+    put_fourcc(chunk.data, "idx1");
+    put_u32(chunk.data, static_cast<std::uint32_t>(m_frames.size() * 16));
+  }
+
+  const auto end = std::min(m_next_index_entry + index_entries_per_chunk, m_frames.size());
+
+  for (; m_next_index_entry < end; m_next_index_entry++) {
+
+    const auto size = m_frames[m_next_index_entry].size;
+
+    put_fourcc(chunk.data, "00dc");
+    put_u32(chunk.data, avi_index_flag_keyframe);
+    put_u32(chunk.data, m_next_index_offset);
+    put_u32(chunk.data, size);
+
+    m_next_index_offset += 8 + padded(size);
+  }
+
+  m_index_done = m_next_index_entry >= m_frames.size();
+
+  return true;
+}
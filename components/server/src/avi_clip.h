@@ -0,0 +1,95 @@
+#pragma once
+
+#include "http_handler.h"
+#include "storage_index.h"
+
+#include <memory>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Assembles stored frames into a Motion JPEG AVI file.
+ *
+ * @details The JPEG data of each frame is used as-is, so no pixels are decoded or encoded. Since the size of each frame
+ *          is known from the storage index, the layout of the whole file (including the index at the end of it) is
+ *          computed up front and the file can be produced one frame at a time.
+ * */
+class avi_clip final : public http_body
+{
+public:
+  /**
+   * @brief The largest clip that can be produced, since AVI files use 32-bit sizes and many players treat them as signed.
+   * */
+  static constexpr std::uint64_t max_size{ 0x7fffffff };
+
+  /**
+   * @brief Constructs a new clip.
+   *
+   * @param index The index that the frames are stored in.
+   *
+   * @param frames The frames to put into the clip, in chronological order.
+   *
+   * @param lease The lease on the frames, which is held until the clip is destroyed. May be null.
+   * */
+  avi_clip(std::shared_ptr<storage_index> index,
+           std::vector<storage_index::entry> frames,
+           std::shared_ptr<void> lease = nullptr);
+
+  /**
+   * @brief Reads the frame size from the first frame.
+   * */
+  void prepare() override;
+
+  /**
+   * @brief Gets the size of the file in bytes, which may exceed @ref avi_clip::max_size.
+   * */
+  auto get_file_size() const -> std::uint64_t { return m_file_size; }
+
+  auto get_size() const -> std::size_t override { return static_cast<std::size_t>(m_file_size); }
+
+  auto next(http_body_chunk& chunk) -> bool override;
+
+protected:
+  auto make_header() const -> std::vector<std::uint8_t>;
+
+private:
+  std::shared_ptr<storage_index> m_index;
+
+  std::shared_ptr<void> m_lease;
+
+  std::vector<storage_index::entry> m_frames;
+
+  std::uint64_t m_file_size{};
+
+  std::uint32_t m_movi_size{};
+
+  std::uint16_t m_width{};
+
+  std::uint16_t m_height{};
+
+  /**
+   * @brief The index of the next frame to produce a chunk for.
+   * */
+  std::size_t m_next_frame{};
+
+  /**
+   * @brief The index of the next frame to produce an index entry for.
+   * */
+  std::size_t m_next_index_entry{};
+
+  /**
+   * @brief The offset of the next index entry, relative to the beginning of the movie list.
+   * */
+  std::uint32_t m_next_index_offset{ 4 };
+
+  /**
+   * @brief Whether or not the previous frame needs a padding byte, since chunks must be word aligned.
+   * */
+  bool m_pad{ false };
+
+  bool m_header_done{ false };
+
+  bool m_index_done{ false };
+};
@@ -0,0 +1,99 @@
+#include "background_task.h"
+
+#include "thread_name.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Moves the calling thread to the lowest CPU priority and the idle IO class, so that it only gets to use the CPU
+ *        and the disk when nothing else needs them.
+ * */
+void
+lower_thread_priority()
+{
+#ifdef __linux__
+  const auto tid = static_cast<id_t>(syscall(SYS_gettid));
+
+  if (setpriority(PRIO_PROCESS, tid, 19) != 0) {
+    spdlog::warn("Failed to lower the CPU priority of a background task.");
+  }
+
+  constexpr int ioprio_who_process{ 1 };
+  constexpr int ioprio_class_idle{ 3 };
+  constexpr int ioprio_class_shift{ 13 };
+
+  if (syscall(SYS_ioprio_set, ioprio_who_process, tid, ioprio_class_idle << ioprio_class_shift) != 0) {
+    spdlog::warn("Failed to lower the IO priority of a background task.");
+  }
+#endif
+}
+
+} // namespace
+
+background_task::background_task(const float rate)
+  : m_op_interval(std::chrono::duration_cast<clock_type::duration>(
+      std::chrono::duration<double>(1.0 / std::max(static_cast<double>(rate), 0.001))))
+{
+}
+
+background_task::~background_task()
+{
+  stop();
+}
+
+void
+background_task::start()
+{
+  m_thread = std::thread([this]() {
+    set_thread_name("background");
+    lower_thread_priority();
+    run();
+  });
+}
+
+void
+background_task::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_should_stop = true;
+  }
+
+  m_wake.notify_all();
+
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+}
+
+auto
+background_task::throttle() -> bool
+{
+  const auto now = clock_type::now();
+
+  m_next_op = std::max(m_next_op, now);
+
+  const auto op_time = m_next_op;
+
+  m_next_op += m_op_interval;
+
+  return wait_until(op_time);
+}
+
+auto
+background_task::wait_until(const clock_type::time_point t) -> bool
+{
+  std::unique_lock<std::mutex> lock(m_lock);
+
+  return !m_wake.wait_until(lock, t, [this]() -> bool { return m_should_stop; });
+}
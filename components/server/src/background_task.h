@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/**
+ * @brief A thread for storage maintenance, which runs at a low CPU and IO priority and limits how many file operations
+ *        it performs per second, so that it does not disturb capture.
+ *
+ * @note Derived classes must call @ref background_task::stop in their destructor, so that the thread has exited before
+ *       their members are destroyed.
+ * */
+class background_task
+{
+public:
+  using clock_type = std::chrono::steady_clock;
+
+  /**
+   * @brief Constructs a new background task, without starting it.
+   *
+   * @param rate The maximum number of file operations per second.
+   * */
+  explicit background_task(float rate);
+
+  background_task(const background_task&) = delete;
+
+  background_task(background_task&&) = delete;
+
+  auto operator=(const background_task&) -> background_task& = delete;
+
+  auto operator=(background_task&&) -> background_task& = delete;
+
+  virtual ~background_task();
+
+protected:
+  /**
+   * @brief Starts the thread, which calls @ref background_task::run.
+   * */
+  void start();
+
+  /**
+   * @brief Stops the thread, waiting for the current file operation to finish.
+   * */
+  void stop();
+
+  /**
+   * @note This is the entrypoint of the thread. It should return once @ref background_task::throttle or
+   *       @ref background_task::wait_until return false.
+   * */
+  virtual void run() = 0;
+
+  /**
+   * @brief Waits until the next file operation is allowed.
+   *
+   * @return False if the task is stopping, true otherwise.
+   * */
+  auto throttle() -> bool;
+
+  /**
+   * @return False if the task is stopping, true otherwise.
+   * */
+  auto wait_until(clock_type::time_point t) -> bool;
+
+private:
+  const clock_type::duration m_op_interval;
+
+  clock_type::time_point m_next_op;
+
+  std::mutex m_lock;
+
+  std::condition_variable m_wake;
+
+  bool m_should_stop{ false };
+
+  std::thread m_thread;
+};
@@ -0,0 +1,38 @@
+#include "camera_storage.h"
+
+#include "metadata_log.h"
+#include "storage_index.h"
+#include "thumbnail_store.h"
+
+namespace {
+
+/**
+ * @brief The timelapse is split into segments of a day, so that reviewing a day reads a single file.
+ * */
+constexpr std::uint64_t timelapse_segment_duration{ 24ULL * 3600 * 1000 * 1000 };
+
+} // namespace
+
+auto
+camera_storage::create(const config::camera_config& cfg) -> camera_storage
+{
+  camera_storage storage;
+
+  storage.index = std::make_shared<storage_index>(cfg.storage_path);
+
+  storage.thumbnails = thumbnail_store::create_pyramid(cfg);
+
+  if (cfg.storage_metadata_enabled) {
+    storage.metadata = std::make_shared<metadata_log>(cfg.storage_path + "/metadata");
+  }
+
+  if (cfg.storage_timelapse_interval > 0) {
+    storage.timelapse = std::make_shared<thumbnail_store>(cfg.storage_path + "/timelapse",
+                                                          cfg.sensor_id,
+                                                          cfg.storage_timelapse_size.width,
+                                                          cfg.storage_timelapse_size.height,
+                                                          timelapse_segment_duration);
+  }
+
+  return storage;
+}
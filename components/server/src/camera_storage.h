@@ -0,0 +1,39 @@
+#pragma once
+
+#include "config.h"
+
+#include <memory>
+#include <vector>
+
+class metadata_log;
+class storage_index;
+class thumbnail_store;
+
+/**
+ * @brief The parts of storage that belong to a camera. They are shared between the pipeline that writes to them and the
+ *        HTTP handler that reads from them.
+ * */
+struct camera_storage final
+{
+  /**
+   * @brief Creates the storage of a camera, according to its configuration. Nothing is read from disk yet.
+   * */
+  static auto create(const config::camera_config& cfg) -> camera_storage;
+
+  std::shared_ptr<storage_index> index;
+
+  /**
+   * @brief The thumbnail stores, from largest to smallest. This is empty if thumbnails are not enabled.
+   * */
+  std::vector<std::shared_ptr<thumbnail_store>> thumbnails;
+
+  /**
+   * @brief The metadata of each stored frame, or null if metadata is not enabled.
+   * */
+  std::shared_ptr<metadata_log> metadata;
+
+  /**
+   * @brief The timelapse of the stored frames, or null if no timelapse is made.
+   * */
+  std::shared_ptr<thumbnail_store> timelapse;
+};
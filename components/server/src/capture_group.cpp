@@ -0,0 +1,200 @@
+#include "capture_group.h"
+
+#include "metrics.h"
+#include "thread_name.h"
+
+#include <spdlog/spdlog.h>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace {
+
+auto
+to_handle(uv_async_t* handle) -> uv_handle_t*
+{
+  return reinterpret_cast<uv_handle_t*>(handle);
+}
+
+/**
+ * @brief The longest time to wait in one poll, in milliseconds.
+ * */
+constexpr int max_poll_timeout{ 1000 };
+
+} // namespace
+
+capture_group::capture_group(uv_loop_t* loop, std::vector<std::unique_ptr<pipeline>> pipelines)
+  : m_pipelines(std::move(pipelines))
+{
+  uv_async_init(loop, &m_handle, on_async_update);
+
+  uv_handle_set_data(to_handle(&m_handle), this);
+
+  m_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+  if (m_wake_fd < 0) {
+    spdlog::error("Failed to create the wake descriptor of a capture group.");
+  }
+
+  m_thread = std::thread(&capture_group::run, this);
+}
+
+capture_group::~capture_group()
+{
+  if (m_wake_fd >= 0) {
+    ::close(m_wake_fd);
+  }
+}
+
+void
+capture_group::close()
+{
+  m_should_close.store(true);
+
+  if (m_wake_fd >= 0) {
+    const std::uint64_t value{ 1 };
+    [[maybe_unused]] const auto result = write(m_wake_fd, &value, sizeof(value));
+  }
+
+  if (m_thread.joinable()) {
+    m_thread.join();
+  }
+
+  m_pipelines.clear();
+
+  uv_close(to_handle(&m_handle), nullptr);
+}
+
+auto
+capture_group::get_self(uv_handle_t* handle) -> capture_group*
+{
+  return static_cast<capture_group*>(uv_handle_get_data(handle));
+}
+
+void
+capture_group::run()
+{
+  set_thread_name("capture");
+
+  std::vector<pollfd> fds;
+
+  /* The first descriptor of each pipeline, with the end of the last one at the back. */
+  std::vector<std::size_t> offsets;
+
+  std::vector<bool> closed(m_pipelines.size(), false);
+
+  while (!m_should_close.load()) {
+
+    fds.clear();
+
+    offsets.clear();
+
+    if (m_wake_fd >= 0) {
+      fds.emplace_back(pollfd{ m_wake_fd, POLLIN, 0 });
+    }
+
+    int timeout = max_poll_timeout;
+
+    for (std::size_t i = 0; i < m_pipelines.size(); i++) {
+
+      offsets.emplace_back(fds.size());
+
+      if (!closed[i] && !m_pipelines[i]->get_poll_descriptors(fds, timeout)) {
+        spdlog::error("A pipeline that cannot be polled was added to a capture group, it will not be run.");
+        fds.resize(offsets.back());
+        closed[i] = true;
+      }
+    }
+
+    offsets.emplace_back(fds.size());
+
+    if (::poll(fds.data(), fds.size(), timeout) < 0) {
+      if (errno != EINTR) {
+        spdlog::error("Failed to poll capture devices.");
+        break;
+      }
+      continue;
+    }
+
+    std::vector<std::shared_ptr<sentinel::proto::outbound_message>> outs;
+
+    for (std::size_t i = 0; i < m_pipelines.size(); i++) {
+
+      if (closed[i]) {
+        continue;
+      }
+
+      bool should_close = false;
+
+      auto pipeline_outs = m_pipelines[i]->poll(&fds[offsets[i]], offsets[i + 1] - offsets[i], should_close);
+
+      for (auto& out : pipeline_outs) {
+        outs.emplace_back(std::move(out));
+      }
+
+      closed[i] = should_close;
+    }
+
+    if (outs.empty()) {
+      continue;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_lock);
+
+      if (m_outputs.empty()) {
+        m_output_time = get_metrics_time();
+      }
+
+      for (auto& out : outs) {
+        m_outputs.emplace_back(std::move(out));
+      }
+    }
+
+    uv_async_send(&m_handle);
+  }
+}
+
+void
+capture_group::on_async_update(uv_async_t* handle)
+{
+  auto* self = get_self(to_handle(handle));
+
+  std::vector<std::shared_ptr<sentinel::proto::outbound_message>> outs;
+
+  std::uint64_t output_time{};
+
+  {
+    std::lock_guard<std::mutex> lock(self->m_lock);
+
+    outs = std::move(self->m_outputs);
+
+    self->m_outputs.clear();
+
+    output_time = self->m_output_time;
+  }
+
+  if (self->m_handoff_time && !outs.empty()) {
+    self->m_handoff_time->record_since(output_time);
+  }
+
+  for (auto& out : outs) {
+    for (auto* obs : self->m_observers) {
+      obs->observe_telemetry(out);
+    }
+  }
+}
+
+void
+capture_group::add_telemetry_observer(telemetry_observer* o)
+{
+  m_observers.emplace_back(o);
+}
+
+void
+capture_group::set_handoff_histogram(std::shared_ptr<latency_histogram> h)
+{
+  m_handoff_time = std::move(h);
+}
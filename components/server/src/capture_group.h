@@ -0,0 +1,95 @@
+#pragma once
+
+#include <uv.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "pipeline.h"
+#include "telemetry_observer.h"
+
+class latency_histogram;
+
+/**
+ * @brief Runs several pipelines on one thread, by polling the descriptors of their devices.
+ *
+ * @details Unlike @ref pipeline_runner, which blocks a thread on each device, the capture thread waits on every device
+ *          at once and only iterates the pipelines whose devices are ready. Pipelines that fail to open their device
+ *          ask to be polled again later, so a failed device does not keep the thread busy.
+ * */
+class capture_group final
+{
+public:
+  /**
+   * @brief Constructs a new capture group and starts its thread.
+   *
+   * @param loop The loop to hand the telemetry of the pipelines to.
+   *
+   * @param pipelines The pipelines to run, which must support @ref pipeline::get_poll_descriptors.
+   * */
+  capture_group(uv_loop_t* loop, std::vector<std::unique_ptr<pipeline>> pipelines);
+
+  capture_group(const capture_group&) = delete;
+
+  capture_group(capture_group&&) = delete;
+
+  auto operator=(const capture_group&) -> capture_group& = delete;
+
+  auto operator=(capture_group&&) -> capture_group& = delete;
+
+  ~capture_group();
+
+  /**
+   * @brief Stops the thread and closes the pipelines.
+   * */
+  void close();
+
+  void add_telemetry_observer(telemetry_observer* o);
+
+  /**
+   * @brief Sets the histogram to record the time that the output of the pipelines waits for the IO loop in.
+   *
+   * @note This must be called from the IO loop, and the histogram is only used from there.
+   * */
+  void set_handoff_histogram(std::shared_ptr<latency_histogram> h);
+
+protected:
+  static auto get_self(uv_handle_t* handle) -> capture_group*;
+
+  static void on_async_update(uv_async_t* handle);
+
+  /**
+   * @note This is the entrypoint of the capture thread.
+   * */
+  void run();
+
+private:
+  std::vector<std::unique_ptr<pipeline>> m_pipelines;
+
+  std::mutex m_lock;
+
+  std::vector<std::shared_ptr<sentinel::proto::outbound_message>> m_outputs;
+
+  /**
+   * @brief When the oldest of the outputs was added, as given by @ref get_metrics_time.
+   * */
+  std::uint64_t m_output_time{};
+
+  std::shared_ptr<latency_histogram> m_handoff_time;
+
+  std::vector<telemetry_observer*> m_observers;
+
+  std::atomic<bool> m_should_close{ false };
+
+  /**
+   * @brief An event descriptor that is polled along with the devices, so that the thread can be woken up to close.
+   * */
+  int m_wake_fd{ -1 };
+
+  uv_async_t m_handle{};
+
+  std::thread m_thread;
+};
@@ -60,6 +60,24 @@ load_ui_config(const YAML::Node& root) -> config::ui_config
   return cfg;
 }
 
+auto
+load_storage_tier_config(const YAML::Node& node) -> config::storage_tier_config
+{
+  config::storage_tier_config tier;
+
+  tier.age = node["age"].as<float>();
+
+  tier.interval = node["interval"].as<float>(tier.interval);
+
+  const auto size = node["size"];
+  if (size.IsDefined() && !size.IsNull()) {
+    tier.width = size["width"].as<int>();
+    tier.height = size["height"].as<int>();
+  }
+
+  return tier;
+}
+
 void
 load_microphones(const YAML::Node& root, config& cfg)
 {
@@ -71,6 +89,53 @@ load_microphones(const YAML::Node& root, config& cfg)
 
     mic.sensor_id = node["sensor_id"].as<std::uint32_t>();
 
+    mic.rate = node["rate"].as<unsigned int>(mic.rate);
+
+    mic.adpcm_enabled = node["adpcm"].as<bool>(mic.adpcm_enabled);
+
+    const auto replay = node["replay"];
+    if (replay.IsDefined() && !replay.IsNull()) {
+      mic.replay_path = replay["path"].as<std::string>(mic.replay_path);
+      mic.replay_signal = replay["signal"].as<std::string>(mic.replay_signal);
+      mic.replay_frequency = replay["frequency"].as<float>(mic.replay_frequency);
+      mic.replay_period_size = replay["period_size"].as<std::size_t>(mic.replay_period_size);
+      mic.replay_realtime = replay["realtime"].as<bool>(mic.replay_realtime);
+      mic.replay_loop = replay["loop"].as<bool>(mic.replay_loop);
+    }
+
+    const auto storage = node["storage"];
+    if (storage.IsDefined() && !storage.IsNull()) {
+      mic.storage_enabled = storage["enabled"].as<bool>(false);
+      mic.storage_path = storage["directory"].as<std::string>(mic.storage_path);
+      mic.storage_days = storage["days"].as<float>(mic.storage_days);
+      mic.storage_segment_duration = storage["segment_duration"].as<float>(mic.storage_segment_duration);
+    }
+
+    const auto level = node["level"];
+    if (level.IsDefined() && !level.IsNull()) {
+      mic.level_interval = level["interval"].as<float>(mic.level_interval);
+      mic.level_bands = level["bands"].as<std::size_t>(mic.level_bands);
+    }
+
+    const auto coalesce = node["coalesce"];
+    if (coalesce.IsDefined() && !coalesce.IsNull()) {
+      mic.coalesce_duration = coalesce["duration"].as<float>(mic.coalesce_duration);
+      mic.coalesce_bytes = coalesce["bytes"].as<std::size_t>(mic.coalesce_bytes);
+      mic.coalesce_max_latency = coalesce["max_latency"].as<float>(mic.coalesce_max_latency);
+    }
+
+    const auto events = node["events"];
+    if (events.IsDefined() && !events.IsNull()) {
+      mic.events_enabled = events["enabled"].as<bool>(false);
+      mic.event_on_threshold = events["on_threshold"].as<float>(mic.event_on_threshold);
+      mic.event_off_threshold = events["off_threshold"].as<float>(mic.event_off_threshold);
+      mic.event_flux_threshold = events["flux_threshold"].as<float>(mic.event_flux_threshold);
+      mic.event_hold = events["hold"].as<float>(mic.event_hold);
+      mic.event_pre_roll = events["pre_roll"].as<float>(mic.event_pre_roll);
+      mic.event_gate_stream = events["gate_stream"].as<bool>(mic.event_gate_stream);
+      mic.event_gate_storage = events["gate_storage"].as<bool>(mic.event_gate_storage);
+    }
+
     cfg.microphones.emplace_back(std::move(mic));
   }
 }
@@ -86,6 +151,14 @@ load_impl(const YAML::Node& root, config& cfg)
 
   cfg.http_server_enabled = root["http_server_enabled"].as<bool>(cfg.http_server_enabled);
 
+  cfg.shared_audio_capture = root["shared_audio_capture"].as<bool>(cfg.shared_audio_capture);
+
+  cfg.trace_enabled = root["trace_enabled"].as<bool>(cfg.trace_enabled);
+
+  cfg.trace_path = root["trace_path"].as<std::string>(cfg.trace_path);
+
+  cfg.timing_stamps_enabled = root["timing_stamps_enabled"].as<bool>(cfg.timing_stamps_enabled);
+
   cfg.http_server_port = root["http_server_port"].as<int>(cfg.http_server_port);
 
   for (const auto& node : root["cameras"]) {
@@ -96,6 +169,13 @@ load_impl(const YAML::Node& root, config& cfg)
 
     cam_cfg.device_index = node["device_index"].as<int>();
 
+    const auto replay = node["replay"];
+    if (replay.IsDefined() && !replay.IsNull()) {
+      cam_cfg.replay_path = replay["path"].as<std::string>();
+      cam_cfg.replay_realtime = replay["realtime"].as<bool>(cam_cfg.replay_realtime);
+      cam_cfg.replay_loop = replay["loop"].as<bool>(cam_cfg.replay_loop);
+    }
+
     cam_cfg.name = node["name"].as<std::string>();
 
     cam_cfg.jpeg_quality = node["stream_quality"].as<float>();
@@ -120,6 +200,41 @@ load_impl(const YAML::Node& root, config& cfg)
       cam_cfg.storage_width = storage_size["width"].as<int>();
       cam_cfg.storage_height = storage_size["height"].as<int>();
     }
+    const auto storage_event = storage["event"];
+    if (storage_event.IsDefined() && !storage_event.IsNull()) {
+      cam_cfg.storage_pre_roll = storage_event["pre_roll"].as<float>(cam_cfg.storage_pre_roll);
+      cam_cfg.storage_post_roll = storage_event["post_roll"].as<float>(cam_cfg.storage_post_roll);
+      cam_cfg.storage_pre_roll_max_bytes =
+        storage_event["pre_roll_max_bytes"].as<std::size_t>(cam_cfg.storage_pre_roll_max_bytes);
+    }
+    const auto compaction = storage["compaction"];
+    if (compaction.IsDefined() && !compaction.IsNull() && compaction["enabled"].as<bool>(false)) {
+      cam_cfg.storage_compaction_rate = compaction["rate"].as<float>(cam_cfg.storage_compaction_rate);
+      for (const auto& tier_node : compaction["tiers"]) {
+        cam_cfg.storage_tiers.emplace_back(load_storage_tier_config(tier_node));
+      }
+    }
+    cam_cfg.storage_metadata_enabled = storage["metadata"].as<bool>(cam_cfg.storage_metadata_enabled);
+    const auto thumbnails = storage["thumbnails"];
+    if (thumbnails.IsDefined() && !thumbnails.IsNull() && thumbnails["enabled"].as<bool>(false)) {
+      cam_cfg.storage_thumbnail_quality = thumbnails["quality"].as<float>(cam_cfg.storage_thumbnail_quality);
+      cam_cfg.storage_thumbnail_backfill_rate =
+        thumbnails["backfill_rate"].as<float>(cam_cfg.storage_thumbnail_backfill_rate);
+      for (const auto& size_node : thumbnails["sizes"]) {
+        cam_cfg.storage_thumbnail_sizes.emplace_back(
+          config::size_config{ size_node["width"].as<int>(), size_node["height"].as<int>() });
+      }
+    }
+    const auto timelapse = storage["timelapse"];
+    if (timelapse.IsDefined() && !timelapse.IsNull() && timelapse["enabled"].as<bool>(false)) {
+      cam_cfg.storage_timelapse_interval = timelapse["interval"].as<float>(60.0f);
+      cam_cfg.storage_timelapse_quality = timelapse["quality"].as<float>(cam_cfg.storage_timelapse_quality);
+      const auto timelapse_size = timelapse["size"];
+      if (timelapse_size.IsDefined() && !timelapse_size.IsNull()) {
+        cam_cfg.storage_timelapse_size.width = timelapse_size["width"].as<int>();
+        cam_cfg.storage_timelapse_size.height = timelapse_size["height"].as<int>();
+      }
+    }
 
     const auto& frame_filter = node["frame_filter"];
     if (frame_filter.IsDefined() && !frame_filter.IsNull()) {
@@ -276,6 +391,30 @@ check_unique_names(const std::vector<Item>& items, Accessor accessor)
   }
 }
 
+void
+check_storage_tiers(const config::camera_config& cam)
+{
+  for (const auto& tier : cam.storage_tiers) {
+
+    const auto prefix = "A storage tier of camera '" + cam.name + "' ";
+
+    if (!(tier.age > 0)) {
+      throw std::runtime_error(prefix + "needs an age greater than zero.");
+    }
+
+    if (!(tier.interval >= 0)) {
+      throw std::runtime_error(prefix + "has a negative interval.");
+    }
+
+    /* The frames of a tier are only shrunk if it has a size, in which case both sides have to be usable by resize. */
+    const auto has_size = (tier.width != -1) || (tier.height != -1);
+
+    if (has_size && ((tier.width <= 0) || (tier.height <= 0))) {
+      throw std::runtime_error(prefix + "needs a width and height greater than zero.");
+    }
+  }
+}
+
 } // namespace
 
 void
@@ -283,5 +422,16 @@ config::validate() const
 {
   check_unique_names(cameras, [](const camera_config& cfg) -> std::string { return cfg.name; });
 
+  for (const auto& cam : cameras) {
+    check_storage_tiers(cam);
+  }
+
   check_unique_names(microphones, [](const microphone_config& cfg) -> std::string { return cfg.name; });
+
+  for (const auto& mic : microphones) {
+    const auto& signal = mic.replay_signal;
+    if (!signal.empty() && (signal != "tone") && (signal != "noise") && (signal != "events")) {
+      throw std::runtime_error("The signal '" + signal + "' of microphone '" + mic.name + "' is not known.");
+    }
+  }
 }
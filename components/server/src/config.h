@@ -3,10 +3,44 @@
 #include <string>
 #include <vector>
 
+#include <cstddef>
 #include <cstdint>
 
 struct config final
 {
+  struct size_config final
+  {
+    int width{};
+
+    int height{};
+  };
+
+  /**
+   * @brief Describes how stored frames are compacted once they reach a certain age.
+   * */
+  struct storage_tier_config final
+  {
+    /**
+     * @brief The number of seconds after which a frame belongs to this tier.
+     * */
+    float age{};
+
+    /**
+     * @brief The minimum number of seconds between the frames that are kept in this tier.
+     * */
+    float interval{};
+
+    /**
+     * @brief The width to shrink frames to, or negative one to keep the original size.
+     * */
+    int width{ -1 };
+
+    /**
+     * @brief The height to shrink frames to, or negative one to keep the original size.
+     * */
+    int height{ -1 };
+  };
+
   struct camera_config final
   {
     /**
@@ -24,6 +58,22 @@ struct config final
      * */
     int device_index{};
 
+    /**
+     * @brief A directory of stored frames (named by their timestamp) or a video file to play back in place of the
+     *        device. The device is used when this is empty.
+     * */
+    std::string replay_path;
+
+    /**
+     * @brief Whether to play back the frames at the timing they were recorded at, or as fast as they can be read.
+     * */
+    bool replay_realtime{ true };
+
+    /**
+     * @brief Whether to start over once the last frame has been played back.
+     * */
+    bool replay_loop{ true };
+
     /**
      * @brief The width of each frame, in terms of pixels.
      * */
@@ -79,6 +129,68 @@ struct config final
      * */
     float storage_rate{ 1.0f };
 
+    /**
+     * @brief The number of seconds of frames to keep in memory, so that they can be stored when an event occurs.
+     *        Zero means that only the frames of the event itself are stored.
+     * */
+    float storage_pre_roll{ 0.0f };
+
+    /**
+     * @brief The number of seconds to keep storing frames after an event has ended.
+     * */
+    float storage_post_roll{ 0.0f };
+
+    /**
+     * @brief The maximum number of bytes of encoded frames to keep in memory for the pre-roll.
+     * */
+    std::size_t storage_pre_roll_max_bytes{ 64 * 1024 * 1024 };
+
+    /**
+     * @brief The tiers to compact stored frames into as they get older. No compaction is done if this is empty.
+     * */
+    std::vector<storage_tier_config> storage_tiers;
+
+    /**
+     * @brief The maximum number of file operations per second that compaction may perform.
+     * */
+    float storage_compaction_rate{ 20.0f };
+
+    /**
+     * @brief Whether or not to keep a log of the metadata (such as the filter score) of each stored frame.
+     * */
+    bool storage_metadata_enabled{ true };
+
+    /**
+     * @brief The sizes of the thumbnails to store along with each frame. No thumbnails are stored if this is empty.
+     * */
+    std::vector<size_config> storage_thumbnail_sizes;
+
+    /**
+     * @brief At what quality to store the thumbnails.
+     * */
+    float storage_thumbnail_quality{ 0.5f };
+
+    /**
+     * @brief The maximum number of thumbnails per second to make for frames that were stored without them. Zero means
+     *        that thumbnails are only made for new frames.
+     * */
+    float storage_thumbnail_backfill_rate{ 10.0f };
+
+    /**
+     * @brief The number of seconds between the frames of the timelapse. No timelapse is made if this is zero.
+     * */
+    float storage_timelapse_interval{ 0.0f };
+
+    /**
+     * @brief The size of the timelapse frames. If this is not positive, the stored frames are used as they are.
+     * */
+    size_config storage_timelapse_size{ -1, -1 };
+
+    /**
+     * @brief At what quality to encode the timelapse frames, if they are resized.
+     * */
+    float storage_timelapse_quality{ 0.5f };
+
     /**
      * @brief Whether or not to enable frame filtering.
      * */
@@ -143,6 +255,128 @@ struct config final
      * @brief The sampling rate of the audio.
      * */
     unsigned int rate{ 44100 };
+
+    /**
+     * @brief A WAV file to play back in place of the device, which is used when this is not empty.
+     * */
+    std::string replay_path;
+
+    /**
+     * @brief A signal to generate in place of the device ('tone', 'noise' or 'events'), which is used when this is not
+     *        empty.
+     * */
+    std::string replay_signal;
+
+    /**
+     * @brief The frequency of the generated tone, in hertz.
+     * */
+    float replay_frequency{ 440.0f };
+
+    /**
+     * @brief The number of samples in each period that is played back or generated.
+     * */
+    std::size_t replay_period_size{ 1024 };
+
+    /**
+     * @brief Whether to play back or generate the audio at its sampling rate, or as fast as it can be processed.
+     * */
+    bool replay_realtime{ true };
+
+    /**
+     * @brief Whether to start over at the end of the WAV file.
+     * */
+    bool replay_loop{ true };
+
+    /**
+     * @brief Whether or not to store the audio.
+     * */
+    bool storage_enabled{ false };
+
+    /**
+     * @brief Where to store the audio.
+     * */
+    std::string storage_path{ "." };
+
+    /**
+     * @brief The number of days to store the audio.
+     * */
+    float storage_days{ 7.0f };
+
+    /**
+     * @brief The number of seconds of audio to put into each file.
+     * */
+    float storage_segment_duration{ 600.0f };
+
+    /**
+     * @brief The number of seconds of audio to summarize in each level update.
+     * */
+    float level_interval{ 0.1f };
+
+    /**
+     * @brief The number of frequency bands to include in each level update, which may be zero.
+     * */
+    std::size_t level_bands{ 0 };
+
+    /**
+     * @brief Whether or not to also encode the audio with IMA-ADPCM, which is sent to the clients that accept it in
+     *        place of the plain samples.
+     * */
+    bool adpcm_enabled{ true };
+
+    /**
+     * @brief The number of seconds of audio to pack into each sample message, or zero to send one message per period.
+     * */
+    float coalesce_duration{ 0.0f };
+
+    /**
+     * @brief The number of bytes of samples to pack into each sample message, or zero to not coalesce by size.
+     * */
+    std::size_t coalesce_bytes{ 0 };
+
+    /**
+     * @brief The most audio (in seconds) that a sample message may hold, which caps the latency added by coalescing.
+     * */
+    float coalesce_max_latency{ 0.1f };
+
+    /**
+     * @brief Whether or not to detect acoustic events, which are published as event markers.
+     * */
+    bool events_enabled{ false };
+
+    /**
+     * @brief How far above the noise floor the sound level has to rise to start an event, in dB.
+     * */
+    float event_on_threshold{ 12.0f };
+
+    /**
+     * @brief How far above the noise floor the sound level has to stay to continue an event, in dB.
+     * */
+    float event_off_threshold{ 6.0f };
+
+    /**
+     * @brief The spectral flux (the average rise of the band levels between periods) that starts an event, in dB.
+     * */
+    float event_flux_threshold{ 6.0f };
+
+    /**
+     * @brief The number of seconds that the sound level has to stay near the noise floor to end an event.
+     * */
+    float event_hold{ 2.0f };
+
+    /**
+     * @brief The number of seconds of audio before an event to include when streaming or storing it.
+     * */
+    float event_pre_roll{ 1.0f };
+
+    /**
+     * @brief Whether or not to only stream audio samples during events.
+     * */
+    bool event_gate_stream{ false };
+
+    /**
+     * @brief Whether or not to only store audio during events.
+     * */
+    bool event_gate_storage{ false };
   };
 
   struct widget_config
@@ -193,6 +427,29 @@ struct config final
 
   bool http_server_enabled{ true };
 
+  /**
+   * @brief Whether or not to capture every microphone on one thread, which polls their devices, instead of blocking a
+   *        thread on each one.
+   * */
+  bool shared_audio_capture{ false };
+
+  /**
+   * @brief Whether or not to record the spans of each frame through every stage from the start. Tracing can also be
+   *        turned on and off at "/api/trace".
+   * */
+  bool trace_enabled{ false };
+
+  /**
+   * @brief The path that the trace is saved to when the process receives SIGUSR1.
+   * */
+  std::string trace_path{ "sentinel_trace.json" };
+
+  /**
+   * @brief Whether or not to send each message with the times that it was captured, encoded, queued and written, so
+   *        that clients can measure the latency of each hop.
+   * */
+  bool timing_stamps_enabled{ false };
+
   ui_config landscape_ui;
 
   ui_config portrait_ui;
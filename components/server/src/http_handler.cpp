@@ -0,0 +1,190 @@
+#include "http_handler.h"
+
+#include "mapped_file.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+auto
+hex_value(const char c) -> int
+{
+  if ((c >= '0') && (c <= '9')) {
+    return c - '0';
+  }
+
+  if ((c >= 'a') && (c <= 'f')) {
+    return (c - 'a') + 10;
+  }
+
+  if ((c >= 'A') && (c <= 'F')) {
+    return (c - 'A') + 10;
+  }
+
+  return -1;
+}
+
+auto
+url_decode(const std::string& in) -> std::string
+{
+  std::string out;
+
+  out.reserve(in.size());
+
+  for (std::size_t i = 0; i < in.size(); i++) {
+
+    if ((in[i] == '%') && ((i + 2) < in.size())) {
+
+      const auto hi = hex_value(in[i + 1]);
+      const auto lo = hex_value(in[i + 2]);
+
+      if ((hi >= 0) && (lo >= 0)) {
+        out.push_back(static_cast<char>((hi << 4) | lo));
+        i += 2;
+        continue;
+      }
+    }
+
+    out.push_back((in[i] == '+') ? ' ' : in[i]);
+  }
+
+  return out;
+}
+
+} // namespace
+
+auto
+http_request::parse(const std::string& url) -> http_request
+{
+  http_request req;
+
+  const auto query_pos = url.find('?');
+
+  req.path = url.substr(0, query_pos);
+
+  if (query_pos == std::string::npos) {
+    return req;
+  }
+
+  std::size_t pos = query_pos + 1;
+
+  while (pos < url.size()) {
+
+    auto end = url.find('&', pos);
+    if (end == std::string::npos) {
+      end = url.size();
+    }
+
+    const auto param = url.substr(pos, end - pos);
+
+    const auto eq = param.find('=');
+
+    if (eq == std::string::npos) {
+      req.query[url_decode(param)] = std::string();
+    } else {
+      req.query[url_decode(param.substr(0, eq))] = url_decode(param.substr(eq + 1));
+    }
+
+    pos = end + 1;
+  }
+
+  return req;
+}
+
+auto
+http_request::get_u64(const char* name, const std::uint64_t fallback, std::uint64_t& value) const -> bool
+{
+  auto it = query.find(name);
+
+  if (it == query.end()) {
+    value = fallback;
+    return true;
+  }
+
+  const auto& str = it->second;
+
+  if (str.empty() || (str[0] == '-')) {
+    return false;
+  }
+
+  char* end{ nullptr };
+
+  value = std::strtoull(str.c_str(), &end, 10);
+
+  return (end != nullptr) && (*end == 0);
+}
+
+auto
+http_request::get_float(const char* name, const float fallback, float& value) const -> bool
+{
+  auto it = query.find(name);
+
+  if (it == query.end()) {
+    value = fallback;
+    return true;
+  }
+
+  const auto& str = it->second;
+
+  if (str.empty()) {
+    return false;
+  }
+
+  char* end{ nullptr };
+
+  value = std::strtof(str.c_str(), &end);
+
+  return (end != nullptr) && (*end == 0) && std::isfinite(value);
+}
+
+auto
+write_http_body(http_body& body, std::FILE* output) -> bool
+{
+  body.prepare();
+
+  http_body_chunk chunk;
+
+  while (body.next(chunk)) {
+
+    if (!chunk.data.empty() && (std::fwrite(chunk.data.data(), 1, chunk.data.size(), output) != chunk.data.size())) {
+      return false;
+    }
+
+    if (chunk.file_size > 0) {
+
+      mapped_file file;
+
+      if (!file.open(chunk.file_path.c_str(), chunk.file_offset, chunk.file_size, /* populate */ false)) {
+        return false;
+      }
+
+      if (std::fwrite(file.data(), 1, file.size(), output) != file.size()) {
+        return false;
+      }
+    }
+
+    chunk = http_body_chunk{};
+  }
+
+  return std::fflush(output) == 0;
+}
+
+auto
+http_response::from_string(const int status, const char* content_type, const std::string& str) -> http_response
+{
+  http_response res;
+
+  res.status = status;
+
+  res.content_type = content_type;
+
+  res.content.resize(str.size());
+
+  if (!str.empty()) {
+    std::memcpy(&res.content[0], str.data(), str.size());
+  }
+
+  return res;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * @brief Describes an HTTP request that was received by the server.
+ * */
+struct http_request final
+{
+  /**
+   * @brief The path of the URL, not including the query string.
+   * */
+  std::string path;
+
+  /**
+   * @brief The parameters in the query string of the URL.
+   * */
+  std::map<std::string, std::string> query;
+
+  /**
+   * @brief Parses the path and query string out of a request URL.
+   * */
+  static auto parse(const std::string& url) -> http_request;
+
+  /**
+   * @brief Gets a query parameter as an unsigned integer.
+   *
+   * @param name The name of the parameter.
+   *
+   * @param fallback The value to return if the parameter is missing.
+   *
+   * @param value The value of the parameter.
+   *
+   * @return False if the parameter exists but is not a valid integer, true otherwise.
+   * */
+  auto get_u64(const char* name, std::uint64_t fallback, std::uint64_t& value) const -> bool;
+
+  /**
+   * @brief Gets a query parameter as a floating point number.
+   *
+   * @param name The name of the parameter.
+   *
+   * @param fallback The value to return if the parameter is missing.
+   *
+   * @param value The value of the parameter.
+   *
+   * @return False if the parameter exists but is not a valid number, true otherwise.
+   * */
+  auto get_float(const char* name, float fallback, float& value) const -> bool;
+};
+
+/**
+ * @brief A piece of a response body.
+ *
+ * @details The piece consists of bytes held in memory, followed by an optional region of a file. The file region is sent
+ *          directly from the page cache, without being read into a buffer first.
+ * */
+struct http_body_chunk final
+{
+  std::vector<std::uint8_t> data;
+
+  /**
+   * @brief The path of the file that follows the data, or empty if there is no file region.
+   * */
+  std::string file_path;
+
+  std::uint64_t file_offset{};
+
+  std::size_t file_size{};
+};
+
+/**
+ * @brief A response body that is produced one piece at a time, so that large responses do not need to be held in
+ *        memory.
+ * */
+class http_body
+{
+public:
+  virtual ~http_body() = default;
+
+  /**
+   * @brief Does the work of the body that may block, such as reading from disk.
+   *
+   * @details This is called once from the thread pool, before anything else is called on the body.
+   * */
+  virtual void prepare() {}
+
+  /**
+   * @brief Gets the total number of bytes in the body, which is sent in the response header.
+   * */
+  virtual auto get_size() const -> std::size_t = 0;
+
+  /**
+   * @brief Gets the next piece of the body.
+   *
+   * @return False if there are no more pieces, true otherwise.
+   * */
+  virtual auto next(http_body_chunk& chunk) -> bool = 0;
+};
+
+/**
+ * @brief Writes an entire response body to a file.
+ *
+ * @details This is used for producing the same content as an HTTP endpoint from the command line.
+ *
+ * @return True on success, false if a file region could not be read or the output could not be written.
+ * */
+auto
+write_http_body(http_body& body, std::FILE* output) -> bool;
+
+struct http_response final
+{
+  int status{ 200 };
+
+  std::string content_type;
+
+  /**
+   * @brief Header fields to add to the response, each ending with a CRLF.
+   * */
+  std::string extra_fields;
+
+  /**
+   * @brief The content of the response, when the response is small enough to be held in memory.
+   * */
+  std::vector<std::uint8_t> content;
+
+  /**
+   * @brief The content of the response, when it is streamed. If this is set, @ref http_response::content is ignored.
+   * */
+  std::unique_ptr<http_body> body;
+
+  static auto from_string(int status, const char* content_type, const std::string& str) -> http_response;
+};
+
+/**
+ * @brief Used for serving content that is generated at the time of the request.
+ *
+ * @note Handlers are called from the IO loop, so they should not block.
+ * */
+class http_handler
+{
+public:
+  virtual ~http_handler() = default;
+
+  /**
+   * @brief Handles a GET request.
+   *
+   * @param req The request to handle.
+   *
+   * @param res The response to fill out.
+   *
+   * @return True if the handler recognized the path in the request, false otherwise.
+   * */
+  virtual auto handle_get(const http_request& req, http_response& res) -> bool = 0;
+};
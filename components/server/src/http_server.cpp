@@ -1,12 +1,17 @@
 #include "http_server.h"
 
+#include "clock.h"
+#include "http_handler.h"
 #include "image.h"
+#include "mapped_file.h"
+#include "trace.h"
 #include "uv.h"
 
 #include <sentinel/proto.h>
 
 #include <llhttp.h>
 
+#include <functional>
 #include <map>
 #include <memory>
 #include <sstream>
@@ -32,6 +37,8 @@ struct resource final
 
 using resource_map = std::map<std::string, resource>;
 
+using handler_list = std::vector<std::unique_ptr<http_handler>>;
+
 class http_client final
 {
 public:
@@ -39,14 +46,26 @@ public:
 
   using close_callback = void (*)(void* cb_data, http_client*);
 
-  explicit http_client(uv_loop_t* loop, const resource_map* resources)
+  http_client(uv_loop_t* loop,
+              const resource_map* resources,
+              const handler_list* handlers,
+              metrics_registry* metrics,
+              const std::uint64_t id)
     : m_resources(resources)
+    , m_handlers(handlers)
     , m_telemetry_queue(2)
+    , m_metrics(metrics)
+    , m_write_time(add_write_histogram(*metrics, "http", id))
+    , m_queue_wait_time(add_queue_wait_histogram(*metrics, "http", id))
   {
     uv_tcp_init(loop, &m_socket);
 
     uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_socket), this);
 
+    m_work.data = this;
+
+    m_body_write.data = this;
+
     m_settings.on_url = on_url;
 
     m_settings.on_message_complete = on_message_complete;
@@ -84,7 +103,26 @@ public:
     }
   }
 
-  void publish_telemetry(std::shared_ptr<sentinel::proto::outbound_message>& msg) { m_telemetry_queue.add(msg); }
+  void publish_telemetry(std::shared_ptr<sentinel::proto::outbound_message>& msg)
+  {
+    /* Audio samples are much larger than everything else, so they are only sent to clients that ask for them. Other
+     * clients get by with the level updates. */
+    static const auto samples_type_hash = std::hash<std::string>{}("microphone::update");
+
+    if (msg->type_hash == samples_type_hash) {
+
+      if (!m_samples_subscribed) {
+        return;
+      }
+
+      if (m_adpcm_accepted && msg->compressed) {
+        enqueue(msg->compressed);
+        return;
+      }
+    }
+
+    enqueue(msg);
+  }
 
 protected:
   static auto get_self(uv_handle_t* handle) -> http_client*
@@ -94,6 +132,15 @@ protected:
 
   static auto get_self(llhttp_t* parser) -> http_client* { return static_cast<http_client*>(parser->data); }
 
+  void enqueue(const std::shared_ptr<sentinel::proto::outbound_message>& msg)
+  {
+    if (m_telemetry_queue.empty()) {
+      m_queue_time = get_metrics_time();
+    }
+
+    m_telemetry_queue.add(msg);
+  }
+
   static void on_alloc(uv_handle_t* handle, size_t size, uv_buf_t* buf)
   {
     auto* self = get_self(handle);
@@ -111,16 +158,73 @@ protected:
       return;
     }
 
-    if (llhttp_execute(&self->m_parser, buf->base, static_cast<std::size_t>(read_size)) != HPE_OK) {
-      self->close();
+    self->parse(buf->base, static_cast<std::size_t>(read_size));
+  }
+
+  /**
+   * @brief Parses received bytes, which may hold more than one request.
+   *
+   * @details The parser is paused after a request with a streamed response, so that the requests after it are not
+   *          handled until the body is sent. The rest of the bytes are kept until then, and no more are read.
+   * */
+  void parse(const char* data, const std::size_t size)
+  {
+    m_parsing = true;
+
+    const auto err = llhttp_execute(&m_parser, data, size);
+
+    m_parsing = false;
+
+    if (err == HPE_PAUSED) {
+      const auto* pos = llhttp_get_error_pos(&m_parser);
+      m_pending_input.assign(pos, data + size);
+      uv_read_stop(reinterpret_cast<uv_stream_t*>(&m_socket));
+      return;
+    }
+
+    if (err != HPE_OK) {
+      close();
+    }
+  }
+
+  /**
+   * @brief Handles the requests that were held back while a body was streamed, and starts reading again once they are
+   *        all handled.
+   * */
+  void resume_requests()
+  {
+    llhttp_resume(&m_parser);
+
+    std::vector<char> input;
+
+    input.swap(m_pending_input);
+
+    if (!input.empty()) {
+      parse(input.data(), input.size());
+    }
+
+    if (!m_body && !uv_is_closing(to_handle(&m_socket))) {
+      start_reading();
     }
   }
 
   static void on_close(uv_handle_t* handle)
   {
     auto* c = get_self(handle);
-    if (c->m_close_cb) {
-      c->m_close_cb(c->m_close_data, c);
+
+    if (c->m_work_pending) {
+      /* The worker thread is still using this client, so wait for it before notifying the server. */
+      c->m_close_deferred = true;
+      return;
+    }
+
+    c->notify_close();
+  }
+
+  void notify_close()
+  {
+    if (m_close_cb) {
+      m_close_cb(m_close_data, this);
     }
   }
 
@@ -135,8 +239,12 @@ protected:
 
   static auto on_message_complete(llhttp_t* parser) -> int
   {
-    get_self(parser)->handle_request();
-    return HPE_OK;
+    auto* self = get_self(parser);
+
+    self->handle_request();
+
+    /* Requests are not handled while a body is streamed, so that responses do not get interleaved. */
+    return self->m_body ? HPE_PAUSED : HPE_OK;
   }
 
   static void append_string(const char* data, size_t size, std::string& out)
@@ -164,14 +272,14 @@ protected:
 
   void handle_get_request()
   {
-    std::string url = m_request.url;
+    auto req = http_request::parse(m_request.url);
 
-    if (url == "/") {
-      url = "/index.html";
+    if (req.path == "/") {
+      req.path = "/index.html";
     }
 
     {
-      auto it = m_resources->find(url);
+      auto it = m_resources->find(req.path);
 
       if (it != m_resources->end()) {
         respond(200, it->second.content_type.c_str(), it->second.data);
@@ -179,31 +287,266 @@ protected:
       }
     }
 
-    if (url == "/api/stream") {
-      respond(200, "application/octet-stream", get_latest_update());
+    if (req.path == "/metrics") {
+      const auto text = m_metrics->export_text();
+      respond(200, "text/plain; version=0.0.4", std::vector<std::uint8_t>(text.begin(), text.end()));
+      return;
+    }
+
+    if (req.path == "/api/trace") {
+      if (req.query.count("enabled") != 0) {
+        std::uint64_t enabled{};
+        if (!req.get_u64("enabled", 0, enabled)) {
+          respond(400);
+          return;
+        }
+        tracer::set_enabled(enabled != 0);
+      }
+      const auto text = tracer::export_json();
+      respond(200, "application/json", std::vector<std::uint8_t>(text.begin(), text.end()));
+      return;
+    }
+
+    if (req.path == "/api/stream") {
+      std::uint64_t pcm{};
+      req.get_u64("pcm", 0, pcm);
+      m_samples_subscribed = (pcm != 0);
+      std::uint64_t adpcm{};
+      req.get_u64("adpcm", 0, adpcm);
+      m_adpcm_accepted = (adpcm != 0);
+      std::uint64_t version{ 1 };
+      req.get_u64("version", 1, version);
+      m_version = (version >= 2) ? sentinel::proto::protocol_version::v2 : sentinel::proto::protocol_version::v1;
+      auto body = get_latest_update();
+      const auto dropped = m_telemetry_queue.get_dropped();
+      auto extra_fields = "X-Dropped-Messages: " + std::to_string(dropped - m_dropped_reported) + "\r\n";
+      m_dropped_reported = dropped;
+      if (req.query.count("version") != 0) {
+        extra_fields += "X-Protocol-Version: " + std::to_string(static_cast<std::uint32_t>(m_version)) + "\r\n";
+      }
+      respond(200, "application/octet-stream", body, extra_fields);
       return;
     }
 
+    for (const auto& h : *m_handlers) {
+
+      http_response res;
+
+      if (h->handle_get(req, res)) {
+        respond(std::move(res));
+        return;
+      }
+    }
+
     respond(404);
   }
 
-  void respond(const int status, const char* type = nullptr, const std::vector<std::uint8_t>& content = {})
+  static auto make_header(const int status,
+                          const char* type,
+                          const std::size_t content_length,
+                          const std::string& extra_fields = {}) -> std::string
   {
     std::ostringstream header_stream;
     header_stream << "HTTP/1.1 " << status << "\r\n";
     if (type != nullptr) {
       header_stream << "Content-Type: " << type << "\r\n";
     }
-    header_stream << "Content-Length: " << content.size() << "\r\n";
+    header_stream << "Content-Length: " << content_length << "\r\n";
+    header_stream << extra_fields;
     header_stream << "\r\n";
-    const auto header = header_stream.str();
+    return header_stream.str();
+  }
+
+  void respond(http_response res)
+  {
+    const char* type = res.content_type.empty() ? nullptr : res.content_type.c_str();
+
+    if (!res.body) {
+      respond(res.status, type, res.content, res.extra_fields);
+      return;
+    }
+
+    m_body = std::move(res.body);
+
+    m_status = res.status;
+
+    m_content_type = std::move(res.content_type);
+
+    m_extra_fields = std::move(res.extra_fields);
+
+    /* The body may have to read from disk before its size is known, so it is prepared in the thread pool. */
+    queue_work(on_prepare_work, on_prepare_complete);
+  }
+
+  void queue_work(uv_work_cb work_cb, uv_after_work_cb after_work_cb)
+  {
+    if (uv_queue_work(uv_handle_get_loop(to_handle(&m_socket)), &m_work, work_cb, after_work_cb) != 0) {
+      spdlog::error("Failed to queue work for HTTP response.");
+      close();
+      return;
+    }
+
+    m_work_pending = true;
+  }
+
+  /**
+   * @brief Finishes the work that was queued, and returns false if the client was closed in the meantime.
+   * */
+  auto complete_work() -> bool
+  {
+    m_work_pending = false;
+
+    if (m_close_deferred) {
+      m_chunk_file.close();
+      notify_close();
+      return false;
+    }
+
+    return true;
+  }
+
+  static void on_prepare_work(uv_work_t* work) { static_cast<http_client*>(work->data)->m_body->prepare(); }
+
+  static void on_prepare_complete(uv_work_t* work, const int status)
+  {
+    auto* self = static_cast<http_client*>(work->data);
+
+    if (!self->complete_work()) {
+      return;
+    }
+
+    if (status != 0) {
+      self->close();
+      return;
+    }
+
+    const auto header = make_header(self->m_status,
+                                    self->m_content_type.empty() ? nullptr : self->m_content_type.c_str(),
+                                    self->m_body->get_size(),
+                                    self->m_extra_fields);
+
+    std::vector<std::uint8_t> out(header.size());
+
+    std::memcpy(&out[0], header.data(), header.size());
+
+    write_operation::send(
+      reinterpret_cast<uv_stream_t*>(&self->m_socket), std::move(out), nullptr, nullptr, self->m_write_time);
+
+    self->send_next_chunk();
+  }
+
+  void send_next_chunk()
+  {
+    m_chunk = http_body_chunk{};
+
+    if (!m_body->next(m_chunk)) {
+      m_body.reset();
+      /* A body that is empty ends while its request is still being parsed, which then just carries on. */
+      if (!m_parsing) {
+        resume_requests();
+      }
+      return;
+    }
+
+    if (m_chunk.file_size == 0) {
+      write_chunk();
+      return;
+    }
+
+    /* Mapping the file may block on disk IO, so it is done in the thread pool. */
+    queue_work(on_map_work, on_map_complete);
+  }
+
+  static void on_map_work(uv_work_t* work)
+  {
+    auto* self = static_cast<http_client*>(work->data);
+
+    const auto& c = self->m_chunk;
+
+    self->m_map_success = self->m_chunk_file.open(c.file_path.c_str(), c.file_offset, c.file_size, /* populate */ true);
+  }
+
+  static void on_map_complete(uv_work_t* work, const int status)
+  {
+    auto* self = static_cast<http_client*>(work->data);
+
+    if (!self->complete_work()) {
+      return;
+    }
+
+    if ((status != 0) || !self->m_map_success) {
+      /* The content length has already been sent, so the only option is to drop the connection. */
+      spdlog::error("Failed to map '{}' for HTTP response.", self->m_chunk.file_path);
+      self->close();
+      return;
+    }
+
+    self->write_chunk();
+  }
+
+  void write_chunk()
+  {
+    uv_buf_t bufs[2]{};
+
+    unsigned int num_bufs{ 0 };
+
+    if (!m_chunk.data.empty()) {
+      bufs[num_bufs].base = reinterpret_cast<char*>(m_chunk.data.data());
+      bufs[num_bufs].len = m_chunk.data.size();
+      num_bufs++;
+    }
+
+    if (m_chunk_file.size() > 0) {
+      bufs[num_bufs].base = const_cast<char*>(reinterpret_cast<const char*>(m_chunk_file.data()));
+      bufs[num_bufs].len = m_chunk_file.size();
+      num_bufs++;
+    }
+
+    if (num_bufs == 0) {
+      send_next_chunk();
+      return;
+    }
+
+    if (uv_write(&m_body_write, reinterpret_cast<uv_stream_t*>(&m_socket), bufs, num_bufs, on_chunk_written) != 0) {
+      spdlog::error("Failed to write HTTP response body.");
+      m_chunk_file.close();
+      close();
+    }
+  }
+
+  static void on_chunk_written(uv_write_t* req, const int status)
+  {
+    auto* self = static_cast<http_client*>(req->data);
+
+    self->m_chunk_file.close();
+
+    if (status != 0) {
+      /* This happens when the connection is closed while the body is being sent. */
+      self->close();
+      return;
+    }
+
+    self->send_next_chunk();
+  }
+
+  /**
+   * @param extra_fields Header fields to add to the response, each ending with a CRLF.
+   * */
+  void respond(const int status,
+               const char* type = nullptr,
+               const std::vector<std::uint8_t>& content = {},
+               const std::string& extra_fields = {})
+  {
+    const auto header = make_header(status, type, content.size(), extra_fields);
 
     std::vector<std::uint8_t> out;
     out.resize(header.size() + content.size());
     std::memcpy(&out[0], header.data(), header.size());
-    std::memcpy(&out[header.size()], content.data(), content.size());
+    if (!content.empty()) {
+      std::memcpy(&out[header.size()], content.data(), content.size());
+    }
 
-    write_operation::send(reinterpret_cast<uv_stream_t*>(&m_socket), std::move(out), nullptr, nullptr);
+    write_operation::send(reinterpret_cast<uv_stream_t*>(&m_socket), std::move(out), nullptr, nullptr, m_write_time);
   }
 
   auto get_latest_update() -> std::vector<std::uint8_t>
@@ -215,10 +558,15 @@ protected:
       return empty_response;
     }
 
-    auto buf = m_telemetry_queue.aggregate()->buffer;
+    m_queue_wait_time->record_since(m_queue_time);
+
+    auto buf = m_telemetry_queue.aggregate(m_version)->buffer;
 
     m_telemetry_queue.clear();
 
+    sentinel::proto::set_timing_stamp(
+      buf->data(), buf->size(), sentinel::proto::timing_stamp::written, sentinel::get_clock_time(), m_version);
+
     return std::move(*buf);
   }
 
@@ -237,15 +585,102 @@ private:
 
   request m_request;
 
+  /**
+   * @brief The bytes that were received after a request with a streamed response, which are parsed once it is sent.
+   * */
+  std::vector<char> m_pending_input;
+
+  bool m_parsing{ false };
+
   sentinel::proto::queue m_telemetry_queue;
 
+  /**
+   * @brief The number of messages dropped from the telemetry queue as of the last stream response, so that each
+   *        response only reports the ones dropped since the one before it.
+   * */
+  std::uint64_t m_dropped_reported{};
+
+  /**
+   * @brief Whether or not the client asked for audio samples (with the "pcm" parameter) in its last stream request.
+   * */
+  bool m_samples_subscribed{ false };
+
+  /**
+   * @brief Whether or not the client accepts IMA-ADPCM audio samples (with the "adpcm" parameter), in place of plain
+   *        ones.
+   * */
+  bool m_adpcm_accepted{ false };
+
+  /**
+   * @brief The framing that the client asked for (with the "version" parameter) in its last stream request. Versions
+   *        newer than the server supports fall back to the newest one, which is reported in the response.
+   * */
+  sentinel::proto::protocol_version m_version{ sentinel::proto::protocol_version::v1 };
+
   const resource_map* m_resources{ nullptr };
+
+  const handler_list* m_handlers{ nullptr };
+
+  metrics_registry* m_metrics{ nullptr };
+
+  std::shared_ptr<latency_histogram> m_write_time;
+
+  /**
+   * @brief The time that the oldest message in the telemetry queue waited before it was sent.
+   * */
+  std::shared_ptr<latency_histogram> m_queue_wait_time;
+
+  /**
+   * @brief When the oldest message in the telemetry queue was added, as given by @ref get_metrics_time.
+   * */
+  std::uint64_t m_queue_time{};
+
+  /**
+   * @brief The body of the response that is currently being streamed, if any.
+   * */
+  std::unique_ptr<http_body> m_body;
+
+  /**
+   * @brief The status of the response whose body is currently being streamed.
+   * */
+  int m_status{};
+
+  std::string m_content_type;
+
+  std::string m_extra_fields;
+
+  /**
+   * @brief The piece of the response body that is currently being sent.
+   * */
+  http_body_chunk m_chunk;
+
+  /**
+   * @brief The file region of the current piece of the response body.
+   * */
+  mapped_file m_chunk_file;
+
+  /**
+   * @brief Used for preparing the body and mapping the file regions of it in the thread pool.
+   * */
+  uv_work_t m_work{};
+
+  uv_write_t m_body_write{};
+
+  /**
+   * @brief Whether or not the thread pool is working on this client, in which case it is not closed until it is done.
+   * */
+  bool m_work_pending{ false };
+
+  bool m_map_success{ false };
+
+  bool m_close_deferred{ false };
 };
 
 class http_server_impl final : public http_server
 {
 public:
-  http_server_impl(uv_loop_t* loop)
+  http_server_impl(uv_loop_t* loop, metrics_registry& metrics)
+    : m_metrics(metrics)
   {
     uv_tcp_init(loop, &m_server);
 
@@ -280,16 +715,31 @@ public:
       return false;
     }
 
-    spdlog::info("Listening for HTTP connections on '{}:{}'.", ip, port);
+    spdlog::info("Listening for HTTP connections on '{}:{}'.", ip, get_port());
 
     return true;
   }
 
+  auto get_port() const -> int override
+  {
+    sockaddr_in address{};
+
+    int size = sizeof(address);
+
+    if (uv_tcp_getsockname(&m_server, reinterpret_cast<sockaddr*>(&address), &size) != 0) {
+      return 0;
+    }
+
+    return ntohs(address.sin_port);
+  }
+
   void add_file(std::string path, std::string content_type, std::vector<std::uint8_t> data) override
   {
     m_resources.emplace(std::move(path), resource{ std::move(content_type), std::move(data) });
   }
 
+  void add_handler(std::unique_ptr<http_handler> handler) override { m_handlers.emplace_back(std::move(handler)); }
+
   void publish_telemetry(std::shared_ptr<sentinel::proto::outbound_message>& msg) override
   {
     for (auto& c : m_clients) {
@@ -330,7 +780,8 @@ protected:
 
     auto* loop = uv_handle_get_loop(to_handle(server));
 
-    auto c = std::make_unique<http_client>(loop, &self->m_resources);
+    auto c = std::make_unique<http_client>(
+      loop, &self->m_resources, &self->m_handlers, &self->m_metrics, self->m_next_client_id++);
 
     c->accept(server);
 
@@ -351,12 +802,18 @@ private:
   float m_anomaly_level{ 1 };
 
   resource_map m_resources;
+
+  handler_list m_handlers;
+
+  metrics_registry& m_metrics;
+
+  std::uint64_t m_next_client_id{};
 };
 
 } // namespace
 
 auto
-http_server::create(uv_loop_t* loop) -> std::unique_ptr<http_server>
+http_server::create(uv_loop_t* loop, metrics_registry& metrics) -> std::unique_ptr<http_server>
 {
-  return std::make_unique<http_server_impl>(loop);
+  return std::make_unique<http_server_impl>(loop, metrics);
 }
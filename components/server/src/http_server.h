@@ -13,10 +13,17 @@
 
 struct image;
 
+class http_handler;
+
+class metrics_registry;
+
 class http_server
 {
 public:
-  static auto create(uv_loop_t* loop) -> std::unique_ptr<http_server>;
+  /**
+   * @param metrics The registry to add the timing of each client connection to, which is also served at "/metrics".
+   * */
+  static auto create(uv_loop_t* loop, metrics_registry& metrics) -> std::unique_ptr<http_server>;
 
   http_server() = default;
 
@@ -34,6 +41,13 @@ public:
 
   virtual auto setup(const char* ip, int port) -> bool = 0;
 
+  /**
+   * @brief Gets the port that the server is listening on, which is chosen by the system if it was set up with zero.
+   *
+   * @return The port, or zero if the server is not listening.
+   * */
+  virtual auto get_port() const -> int = 0;
+
   virtual void add_file(std::string path, std::string content_type, std::vector<std::uint8_t> data) = 0;
 
   void add_file(std::string path, std::string content_type, std::string data)
@@ -45,5 +59,12 @@ public:
     add_file(path, content_type, std::move(tmp));
   }
 
+  /**
+   * @brief Adds a handler for requests that do not match any of the files.
+   *
+   * @note Handlers are checked in the order that they are added.
+   * */
+  virtual void add_handler(std::unique_ptr<http_handler> handler) = 0;
+
   virtual void publish_telemetry(std::shared_ptr<sentinel::proto::outbound_message>& msg) = 0;
 };
@@ -35,3 +35,18 @@ image::resize(std::size_t w, std::size_t h, std::size_t c)
     frame = std::move(next_frame);
   }
 }
+
+void
+image::assign(cv::Mat bgr_frame)
+{
+  width = bgr_frame.cols;
+  height = bgr_frame.rows;
+  channels = 3;
+  data.resize(width * height * channels);
+
+  /* Converts straight into the data, since the header does not own its memory. */
+  cv::Mat rgb(bgr_frame.rows, bgr_frame.cols, CV_8UC3, data.data());
+  cv::cvtColor(bgr_frame, rgb, cv::COLOR_BGR2RGB);
+
+  frame = std::move(bgr_frame);
+}
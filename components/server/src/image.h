@@ -35,4 +35,9 @@ struct image final
   std::uint64_t time{};
 
   void resize(std::size_t w, std::size_t h, std::size_t c);
+
+  /**
+   * @brief Takes a BGR frame, as produced by OpenCV, and fills the RGB data from it.
+   * */
+  void assign(cv::Mat bgr_frame);
 };
@@ -0,0 +1,81 @@
+#include "jpeg_header.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <fstream>
+#include <utility>
+#include <vector>
+
+namespace {
+
+auto
+be16(const std::uint8_t* ptr) -> std::uint16_t
+{
+  return static_cast<std::uint16_t>((ptr[0] << 8) | ptr[1]);
+}
+
+} // namespace
+
+auto
+read_jpeg_size(const std::string& path, std::uint16_t& w, std::uint16_t& h) -> bool
+{
+  std::ifstream file(path, std::ios::binary);
+
+  std::vector<std::uint8_t> data(64 * 1024);
+
+  file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+  data.resize(static_cast<std::size_t>(file.gcount()));
+
+  if ((data.size() < 4) || (data[0] != 0xff) || (data[1] != 0xd8)) {
+    return false;
+  }
+
+  std::size_t i = 2;
+
+  while ((i + 9) < data.size()) {
+
+    if (data[i] != 0xff) {
+      return false;
+    }
+
+    const auto marker = data[i + 1];
+
+    /* These are the start-of-frame markers, which exclude the Huffman table, arithmetic coding and DAC markers. */
+    const auto is_sof =
+      (marker >= 0xc0) && (marker <= 0xcf) && (marker != 0xc4) && (marker != 0xc8) && (marker != 0xcc);
+
+    if (is_sof) {
+      h = be16(&data[i + 5]);
+      w = be16(&data[i + 7]);
+      return true;
+    }
+
+    i += 2 + be16(&data[i + 2]);
+  }
+
+  return false;
+}
+
+auto
+read_reduced_jpeg(const std::string& path, const int min_w, const int min_h) -> cv::Mat
+{
+  std::uint16_t w{};
+  std::uint16_t h{};
+
+  if (!read_jpeg_size(path, w, h)) {
+    return cv::Mat();
+  }
+
+  const std::pair<int, int> reductions[]{ { 8, cv::IMREAD_REDUCED_COLOR_8 },
+                                          { 4, cv::IMREAD_REDUCED_COLOR_4 },
+                                          { 2, cv::IMREAD_REDUCED_COLOR_2 } };
+
+  for (const auto& r : reductions) {
+    if (((w / r.first) >= min_w) && ((h / r.first) >= min_h)) {
+      return cv::imread(path, r.second);
+    }
+  }
+
+  return cv::imread(path, cv::IMREAD_COLOR);
+}
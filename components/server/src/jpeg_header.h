@@ -0,0 +1,36 @@
+#pragma once
+
+#include <opencv2/core/mat.hpp>
+
+#include <string>
+
+#include <cstdint>
+
+/**
+ * @brief Finds the frame size in the start-of-frame segment of a JPEG file, without decoding the file.
+ *
+ * @param path The path of the JPEG file.
+ *
+ * @param w The width of the frame.
+ *
+ * @param h The height of the frame.
+ *
+ * @return True on success, false if the file could not be read or the start-of-frame segment was not found.
+ * */
+auto
+read_jpeg_size(const std::string& path, std::uint16_t& w, std::uint16_t& h) -> bool;
+
+/**
+ * @brief Decodes a JPEG file at the smallest reduced size that is still at least as large as a minimum size. This is
+ *        much faster than decoding the file at full size, since the JPEG decoder can skip most of the work.
+ *
+ * @param path The path of the JPEG file.
+ *
+ * @param min_w The minimum width of the decoded frame.
+ *
+ * @param min_h The minimum height of the decoded frame.
+ *
+ * @return The decoded frame, which is empty if the file could not be decoded.
+ * */
+auto
+read_reduced_jpeg(const std::string& path, int min_w, int min_h) -> cv::Mat;
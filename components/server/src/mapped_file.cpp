@@ -0,0 +1,115 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+mapped_file::mapped_file(mapped_file&& other) noexcept
+  : m_base(std::exchange(other.m_base, nullptr))
+  , m_base_size(std::exchange(other.m_base_size, 0))
+  , m_data(std::exchange(other.m_data, nullptr))
+  , m_size(std::exchange(other.m_size, 0))
+{
+}
+
+auto
+mapped_file::operator=(mapped_file&& other) noexcept -> mapped_file&
+{
+  if (this != &other) {
+    close();
+    m_base = std::exchange(other.m_base, nullptr);
+    m_base_size = std::exchange(other.m_base_size, 0);
+    m_data = std::exchange(other.m_data, nullptr);
+    m_size = std::exchange(other.m_size, 0);
+  }
+
+  return *this;
+}
+
+mapped_file::~mapped_file()
+{
+  close();
+}
+
+auto
+mapped_file::open(const char* path, const std::uint64_t offset, std::size_t size, const bool populate) -> bool
+{
+  close();
+
+  const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat info{};
+
+  if ((::fstat(fd, &info) != 0) || (static_cast<std::uint64_t>(info.st_size) < offset)) {
+    ::close(fd);
+    return false;
+  }
+
+  const auto file_size = static_cast<std::uint64_t>(info.st_size);
+
+  if (size == 0) {
+    size = static_cast<std::size_t>(file_size - offset);
+  }
+
+  if ((offset + size) > file_size) {
+    ::close(fd);
+    return false;
+  }
+
+  if (size == 0) {
+    /* Nothing to map, but the region is valid. */
+    ::close(fd);
+    return true;
+  }
+
+  /* The offset passed to mmap must be a multiple of the page size. */
+  const auto page_size = static_cast<std::uint64_t>(::sysconf(_SC_PAGESIZE));
+
+  const auto base_offset = offset - (offset % page_size);
+
+  const auto base_size = static_cast<std::size_t>(size + (offset - base_offset));
+
+  int flags = MAP_PRIVATE;
+
+#ifdef MAP_POPULATE
+  if (populate) {
+    flags |= MAP_POPULATE;
+  }
+#endif
+
+  void* base = ::mmap(nullptr, base_size, PROT_READ, flags, fd, static_cast<off_t>(base_offset));
+
+  ::close(fd);
+
+  if (base == MAP_FAILED) {
+    return false;
+  }
+
+  ::madvise(base, base_size, MADV_SEQUENTIAL);
+
+  m_base = base;
+  m_base_size = base_size;
+  m_data = static_cast<const std::uint8_t*>(base) + (offset - base_offset);
+  m_size = size;
+
+  return true;
+}
+
+void
+mapped_file::close()
+{
+  if (m_base != nullptr) {
+    ::munmap(m_base, m_base_size);
+  }
+
+  m_base = nullptr;
+  m_base_size = 0;
+  m_data = nullptr;
+  m_size = 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief A read-only memory mapping of a region of a file.
+ *
+ * @details This is used for sending stored data without copying it into user space buffers first.
+ * */
+class mapped_file final
+{
+public:
+  mapped_file() = default;
+
+  mapped_file(const mapped_file&) = delete;
+
+  mapped_file(mapped_file&& other) noexcept;
+
+  auto operator=(const mapped_file&) -> mapped_file& = delete;
+
+  auto operator=(mapped_file&& other) noexcept -> mapped_file&;
+
+  ~mapped_file();
+
+  /**
+   * @brief Maps a region of a file into memory.
+   *
+   * @param path The path of the file to map.
+   *
+   * @param offset The byte offset of the region to map.
+   *
+   * @param size The number of bytes in the region. Zero means the rest of the file.
+   *
+   * @param populate Whether or not to read the pages in immediately. This should be used when mapping from a worker
+   *                 thread, so that the thread which accesses the data later does not block on disk IO.
+   *
+   * @return True on success, false if the file could not be opened or is smaller than the region.
+   * */
+  auto open(const char* path, std::uint64_t offset, std::size_t size, bool populate) -> bool;
+
+  /**
+   * @brief Unmaps the file, if it is mapped.
+   * */
+  void close();
+
+  auto data() const -> const std::uint8_t* { return m_data; }
+
+  auto size() const -> std::size_t { return m_size; }
+
+private:
+  void* m_base{ nullptr };
+
+  std::size_t m_base_size{};
+
+  const std::uint8_t* m_data{ nullptr };
+
+  std::size_t m_size{};
+};
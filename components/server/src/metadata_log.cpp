@@ -0,0 +1,438 @@
+#include "metadata_log.h"
+
+#include "mapped_file.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+
+namespace {
+
+struct column_info final
+{
+  const char* name;
+
+  std::size_t width;
+};
+
+enum column_index : std::size_t
+{
+  time_column,
+  filter_score_column,
+  anomaly_score_column,
+  detections_column,
+  size_column
+};
+
+constexpr column_info columns[]{
+  { "time", sizeof(std::uint64_t) },         { "filter_score", sizeof(float) }, { "anomaly_score", sizeof(float) },
+  { "detections", sizeof(std::uint16_t) }, { "size", sizeof(std::uint32_t) }
+};
+
+auto
+get_segment(const std::uint64_t time) -> std::uint64_t
+{
+  return time - (time % metadata_log::segment_duration);
+}
+
+template<typename T>
+auto
+write_value(std::FILE* file, const T& value) -> bool
+{
+  return (std::fwrite(&value, sizeof(value), 1, file) == 1) && (std::fflush(file) == 0);
+}
+
+/**
+ * @brief A column of a segment, mapped into memory.
+ * */
+template<typename T>
+class column_view final
+{
+public:
+  auto open(const std::string& path, const std::size_t rows) -> bool
+  {
+    if (!m_file.open(path.c_str(), 0, rows * sizeof(T), /* populate */ false)) {
+      return false;
+    }
+
+    /* The mapping starts on a page boundary, so the values are aligned. */
+    m_values = reinterpret_cast<const T*>(m_file.data());
+
+    return true;
+  }
+
+  auto operator[](const std::size_t i) const -> T { return m_values[i]; }
+
+  auto begin() const -> const T* { return m_values; }
+
+  auto end() const -> const T* { return m_values + (m_file.size() / sizeof(T)); }
+
+private:
+  mapped_file m_file;
+
+  const T* m_values{ nullptr };
+};
+
+} // namespace
+
+metadata_log::metadata_log(std::string directory)
+  : m_directory(std::move(directory))
+{
+}
+
+metadata_log::~metadata_log()
+{
+  close_segment();
+}
+
+auto
+metadata_log::get_column_path(const std::uint64_t segment, const std::size_t column) const -> std::string
+{
+  std::ostringstream path_stream;
+
+  path_stream << m_directory << '/' << segment << '.' << columns[column].name;
+
+  return path_stream.str();
+}
+
+void
+metadata_log::close_segment()
+{
+  for (auto& f : m_files) {
+    if (f) {
+      std::fclose(f);
+      f = nullptr;
+    }
+  }
+
+  m_segment.reset();
+}
+
+void
+metadata_log::scan()
+{
+  std::error_code error;
+
+  std::filesystem::create_directories(m_directory, error);
+
+  if (error) {
+    spdlog::error("Failed to create metadata directory '{}'.", m_directory);
+    return;
+  }
+
+  std::vector<std::uint64_t> segments;
+
+  for (const auto& dir_entry : std::filesystem::directory_iterator(m_directory)) {
+
+    const auto entry_path = dir_entry.path();
+
+    if (entry_path.extension().string() != ".time") {
+      continue;
+    }
+
+    std::istringstream in_stream(entry_path.stem().string());
+
+    std::uint64_t segment{};
+
+    if (in_stream >> segment) {
+      segments.emplace_back(segment);
+    }
+  }
+
+  std::sort(segments.begin(), segments.end());
+
+  for (const auto segment : segments) {
+
+    std::uint64_t sizes[column_count]{};
+
+    std::uint64_t rows{ std::numeric_limits<std::uint64_t>::max() };
+
+    for (std::size_t i = 0; i < column_count; i++) {
+      sizes[i] = std::filesystem::file_size(get_column_path(segment, i), error);
+      rows = std::min<std::uint64_t>(rows, error ? 0 : (sizes[i] / columns[i].width));
+    }
+
+    for (std::size_t i = 0; i < column_count; i++) {
+      if (sizes[i] > (rows * columns[i].width)) {
+        spdlog::warn("Truncating metadata column '{}' to {} rows.", get_column_path(segment, i), rows);
+        std::filesystem::resize_file(get_column_path(segment, i), rows * columns[i].width, error);
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  close_segment();
+
+  m_segments = std::move(segments);
+}
+
+auto
+metadata_log::append(const row& r) -> bool
+{
+  const auto segment = get_segment(r.time);
+
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  if (m_segment != segment) {
+
+    close_segment();
+
+    for (std::size_t i = 0; i < column_count; i++) {
+
+      m_files[i] = std::fopen(get_column_path(segment, i).c_str(), "ab");
+
+      if (!m_files[i] || (std::fseek(m_files[i], 0, SEEK_END) != 0)) {
+        close_segment();
+        return false;
+      }
+    }
+
+    m_segment = segment;
+
+    if (std::find(m_segments.begin(), m_segments.end(), segment) == m_segments.end()) {
+      m_segments.emplace_back(segment);
+      std::sort(m_segments.begin(), m_segments.end());
+    }
+  }
+
+  long offsets[column_count]{};
+
+  for (std::size_t i = 0; i < column_count; i++) {
+    offsets[i] = std::ftell(m_files[i]);
+  }
+
+  /* The time column goes last, since queries ignore the other columns past the end of it. */
+  const auto success = write_value(m_files[filter_score_column], r.filter_score) &&
+                       write_value(m_files[anomaly_score_column], r.anomaly_score) &&
+                       write_value(m_files[detections_column], r.detections) &&
+                       write_value(m_files[size_column], r.size) && write_value(m_files[time_column], r.time);
+
+  if (!success) {
+    /* A partial row would put every row after it out of line, so it is removed from the columns right away. */
+    close_segment();
+    for (std::size_t i = 0; i < column_count; i++) {
+      std::error_code error;
+      std::filesystem::resize_file(get_column_path(segment, i), static_cast<std::uint64_t>(offsets[i]), error);
+    }
+  }
+
+  return success;
+}
+
+auto
+metadata_log::update_size(const std::uint64_t time, const std::uint32_t size) -> bool
+{
+  const auto segment = get_segment(time);
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (std::find(m_segments.begin(), m_segments.end(), segment) == m_segments.end()) {
+      return false;
+    }
+  }
+
+  std::error_code error;
+
+  const auto time_size = std::filesystem::file_size(get_column_path(segment, time_column), error);
+
+  const auto row_count = error ? 0 : static_cast<std::size_t>(time_size / columns[time_column].width);
+
+  if (row_count == 0) {
+    return false;
+  }
+
+  std::size_t row_index{};
+
+  {
+    column_view<std::uint64_t> times;
+
+    if (!times.open(get_column_path(segment, time_column), row_count)) {
+      return false;
+    }
+
+    const auto it = std::lower_bound(times.begin(), times.end(), time);
+
+    if ((it == times.end()) || (*it != time)) {
+      return false;
+    }
+
+    row_index = static_cast<std::size_t>(it - times.begin());
+  }
+
+  /* Only the one value is overwritten, so the row is never seen half updated. Appends are unaffected, since they
+   * always go to the end of the column. */
+  auto* file = std::fopen(get_column_path(segment, size_column).c_str(), "r+b");
+
+  if (!file) {
+    return false;
+  }
+
+  const auto offset = static_cast<long>(row_index * columns[size_column].width);
+
+  const auto success = (std::fseek(file, offset, SEEK_SET) == 0) && write_value(file, size);
+
+  return (std::fclose(file) == 0) && success;
+}
+
+auto
+metadata_log::query(const predicate& p, const std::size_t max_rows) const -> std::vector<row>
+{
+  std::vector<std::uint64_t> segments;
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    for (const auto segment : m_segments) {
+      if ((segment <= p.to) && ((segment + segment_duration) > p.from)) {
+        segments.emplace_back(segment);
+      }
+    }
+  }
+
+  std::vector<row> rows;
+
+  for (const auto segment : segments) {
+
+    if (rows.size() >= max_rows) {
+      break;
+    }
+
+    if (!query_segment(segment, p, max_rows, rows)) {
+      spdlog::debug("Skipping metadata segment {}, which was most likely deleted during the query.", segment);
+    }
+  }
+
+  return rows;
+}
+
+auto
+metadata_log::query_segment(const std::uint64_t segment,
+                            const predicate& p,
+                            const std::size_t max_rows,
+                            std::vector<row>& rows) const -> bool
+{
+  std::error_code error;
+
+  const auto time_size = std::filesystem::file_size(get_column_path(segment, time_column), error);
+
+  if (error) {
+    return false;
+  }
+
+  /* The time column is written last, so every other column has at least this many rows. */
+  const auto row_count = static_cast<std::size_t>(time_size / columns[time_column].width);
+
+  if (row_count == 0) {
+    return true;
+  }
+
+  column_view<std::uint64_t> times;
+
+  if (!times.open(get_column_path(segment, time_column), row_count)) {
+    return false;
+  }
+
+  const auto first = std::lower_bound(times.begin(), times.end(), p.from) - times.begin();
+
+  const auto last = std::upper_bound(times.begin(), times.end(), p.to) - times.begin();
+
+  std::vector<std::uint32_t> selection;
+
+  selection.reserve(static_cast<std::size_t>(last - first));
+
+  for (auto i = first; i < last; i++) {
+    selection.emplace_back(static_cast<std::uint32_t>(i));
+  }
+
+  /* Each predicate only reads the rows that are still selected, from a single column. */
+
+  auto narrow = [&selection](const auto& column, const auto& matches) {
+    auto it = std::remove_if(
+      selection.begin(), selection.end(), [&](const std::uint32_t i) -> bool { return !matches(column[i]); });
+    selection.erase(it, selection.end());
+  };
+
+  column_view<float> filter_scores;
+
+  if (!filter_scores.open(get_column_path(segment, filter_score_column), row_count)) {
+    return false;
+  }
+
+  if (p.min_filter_score.has_value()) {
+    const auto min = p.min_filter_score.value();
+    narrow(filter_scores, [min](const float v) -> bool { return v >= min; });
+  }
+
+  column_view<float> anomaly_scores;
+
+  if (!anomaly_scores.open(get_column_path(segment, anomaly_score_column), row_count)) {
+    return false;
+  }
+
+  if (p.min_anomaly_score.has_value()) {
+    const auto min = p.min_anomaly_score.value();
+    narrow(anomaly_scores, [min](const float v) -> bool { return v >= min; });
+  }
+
+  column_view<std::uint16_t> detections;
+
+  if (!detections.open(get_column_path(segment, detections_column), row_count)) {
+    return false;
+  }
+
+  if (p.min_detections.has_value()) {
+    const auto min = p.min_detections.value();
+    narrow(detections, [min](const std::uint16_t v) -> bool { return v >= min; });
+  }
+
+  column_view<std::uint32_t> sizes;
+
+  if (!sizes.open(get_column_path(segment, size_column), row_count)) {
+    return false;
+  }
+
+  narrow(sizes, [](const std::uint32_t v) -> bool { return v != 0; });
+
+  for (const auto i : selection) {
+
+    if (rows.size() >= max_rows) {
+      break;
+    }
+
+    rows.emplace_back(row{ times[i], filter_scores[i], anomaly_scores[i], detections[i], sizes[i] });
+  }
+
+  return true;
+}
+
+void
+metadata_log::remove_before(const std::uint64_t time)
+{
+  std::vector<std::uint64_t> removed;
+
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    while (!m_segments.empty() && ((m_segments.front() + segment_duration) <= time)) {
+
+      if (m_segment == m_segments.front()) {
+        close_segment();
+      }
+
+      removed.emplace_back(m_segments.front());
+
+      m_segments.erase(m_segments.begin());
+    }
+  }
+
+  for (const auto segment : removed) {
+    for (std::size_t i = 0; i < column_count; i++) {
+      std::error_code error;
+      std::filesystem::remove(get_column_path(segment, i), error);
+    }
+  }
+}
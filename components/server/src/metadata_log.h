@@ -0,0 +1,160 @@
+#pragma once
+
+#include <array>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * @brief The information about a frame that is produced while it goes through the pipeline.
+ * */
+struct frame_metadata final
+{
+  /**
+   * @brief The output of the frame filter, or NaN if the frame was not filtered.
+   * */
+  float filter_score{ std::numeric_limits<float>::quiet_NaN() };
+
+  /**
+   * @brief How unusual the frame is, or NaN if there is no anomaly detector.
+   * */
+  float anomaly_score{ std::numeric_limits<float>::quiet_NaN() };
+
+  /**
+   * @brief The number of people detected in the frame.
+   * */
+  std::uint16_t detections{};
+};
+
+/**
+ * @brief An append-only log of the metadata of each stored frame, kept in columns so that queries only read the columns
+ *        that they need.
+ *
+ * @details The log is split into segments of one day. Each segment has one file per column, which holds a fixed size
+ *          value per row. Queries memory map the columns, find the time range with a binary search on the time column,
+ *          and then narrow down the rows one predicate (and one column) at a time.
+ *
+ * @note This class is thread safe. It is written to by the pipeline thread and queried from the IO loop.
+ * */
+class metadata_log final
+{
+public:
+  struct row final
+  {
+    std::uint64_t time{};
+
+    float filter_score{};
+
+    float anomaly_score{};
+
+    std::uint16_t detections{};
+
+    /**
+     * @brief The number of bytes in the stored frame.
+     * */
+    std::uint32_t size{};
+  };
+
+  /**
+   * @brief Describes which rows a query should return. Rows must match every predicate that is set.
+   * */
+  struct predicate final
+  {
+    std::uint64_t from{};
+
+    std::uint64_t to{ std::numeric_limits<std::uint64_t>::max() };
+
+    std::optional<float> min_filter_score;
+
+    std::optional<float> min_anomaly_score;
+
+    std::optional<std::uint16_t> min_detections;
+  };
+
+  /**
+   * @brief The amount of time covered by each segment, in microseconds.
+   * */
+  static constexpr std::uint64_t segment_duration{ 24ULL * 3600 * 1000 * 1000 };
+
+  /**
+   * @brief Constructs a new metadata log.
+   *
+   * @param directory The directory to put the segment files into.
+   * */
+  explicit metadata_log(std::string directory);
+
+  metadata_log(const metadata_log&) = delete;
+
+  metadata_log(metadata_log&&) = delete;
+
+  auto operator=(const metadata_log&) -> metadata_log& = delete;
+
+  auto operator=(metadata_log&&) -> metadata_log& = delete;
+
+  ~metadata_log();
+
+  /**
+   * @brief Finds the existing segments.
+   *
+   * @note If the columns of a segment have different lengths (for example, because of a power loss), the longer ones
+   *       are cut off so that every column ends at the last complete row.
+   * */
+  void scan();
+
+  /**
+   * @brief Appends a row to the log.
+   *
+   * @note Rows are expected to be appended in chronological order.
+   * */
+  auto append(const row& r) -> bool;
+
+  /**
+   * @brief Changes the frame size in the row of a frame, such as after the frame was shrunk.
+   *
+   * @param size The new size of the frame, or zero if the frame was deleted. Rows with a size of zero are left out of
+   *             queries.
+   *
+   * @return True if the row was found and changed, false otherwise.
+   * */
+  auto update_size(std::uint64_t time, std::uint32_t size) -> bool;
+
+  /**
+   * @brief Finds the rows that match a predicate, in chronological order. Rows of deleted frames are left out.
+   * */
+  auto query(const predicate& p, std::size_t max_rows) const -> std::vector<row>;
+
+  /**
+   * @brief Deletes the segments that only contain rows from before a certain time.
+   * */
+  void remove_before(std::uint64_t time);
+
+  auto get_column_path(std::uint64_t segment, std::size_t column) const -> std::string;
+
+protected:
+  auto query_segment(std::uint64_t segment, const predicate& p, std::size_t max_rows, std::vector<row>& rows) const
+    -> bool;
+
+  void close_segment();
+
+private:
+  static constexpr std::size_t column_count{ 5 };
+
+  const std::string m_directory;
+
+  mutable std::mutex m_lock;
+
+  /**
+   * @brief The start times of the existing segments, in chronological order.
+   * */
+  std::vector<std::uint64_t> m_segments;
+
+  std::array<std::FILE*, column_count> m_files{};
+
+  std::optional<std::uint64_t> m_segment;
+};
@@ -0,0 +1,308 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace {
+
+auto
+escape_label_value(const std::string& value) -> std::string
+{
+  std::string out;
+
+  out.reserve(value.size());
+
+  for (const auto c : value) {
+    if (c == '\\') {
+      out += "\\\\";
+    } else if (c == '"') {
+      out += "\\\"";
+    } else if (c == '\n') {
+      out += "\\n";
+    } else {
+      out += c;
+    }
+  }
+
+  return out;
+}
+
+auto
+format_labels(const metrics_registry::label_list& labels) -> std::string
+{
+  std::string out;
+
+  for (const auto& l : labels) {
+    if (!out.empty()) {
+      out += ',';
+    }
+    out += l.first + "=\"" + escape_label_value(l.second) + "\"";
+  }
+
+  return out;
+}
+
+/**
+ * @brief Gets the name of the counter of the allocations in a histogram, such as "sentinel_pipeline_stage_allocations"
+ *        for "sentinel_pipeline_stage_seconds".
+ * */
+auto
+get_allocation_counter_name(const std::string& histogram_name) -> std::string
+{
+  const std::string suffix{ "_seconds" };
+
+  auto name = histogram_name;
+
+  if ((name.size() > suffix.size()) && (name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)) {
+    name.resize(name.size() - suffix.size());
+  }
+
+  return name + "_allocations_total";
+}
+
+/**
+ * @brief Removes the series whose metric has been destroyed, such as the ones of closed connections.
+ * */
+template<typename Series>
+void
+remove_expired(std::vector<Series>& entries)
+{
+  auto it = std::remove_if(entries.begin(), entries.end(), [](const auto& s) { return s.metric.expired(); });
+
+  entries.erase(it, entries.end());
+}
+
+} // namespace
+
+auto
+latency_histogram::get_snapshot() const -> snapshot
+{
+  snapshot result;
+
+  for (std::size_t i = 0; i < bucket_count; i++) {
+    result.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+    result.count += result.buckets[i];
+  }
+
+  result.sum = m_sum.load(std::memory_order_relaxed);
+
+  result.allocations = m_allocations.load(std::memory_order_relaxed);
+
+  return result;
+}
+
+auto
+latency_histogram::get_upper_bound(const std::size_t bucket) -> double
+{
+  return static_cast<double>(std::uint64_t(1) << bucket) * 1.0e-6;
+}
+
+auto
+metrics_registry::add_histogram(const std::string& name, const std::string& help, const label_list& labels)
+  -> std::shared_ptr<latency_histogram>
+{
+  auto h = std::make_shared<latency_histogram>();
+
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  auto& f = m_families[name];
+
+  f.help = help;
+
+  /* Expired series are also removed here, so that they do not pile up when the metrics are never exported. */
+  remove_expired(f.entries);
+
+  f.entries.emplace_back(series<latency_histogram>{ format_labels(labels), h });
+
+  return h;
+}
+
+auto
+metrics_registry::add_counter(const std::string& name, const std::string& help, const label_list& labels)
+  -> std::shared_ptr<metrics_counter>
+{
+  auto c = std::make_shared<metrics_counter>();
+
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  auto& f = m_counter_families[name];
+
+  f.help = help;
+
+  remove_expired(f.entries);
+
+  f.entries.emplace_back(series<metrics_counter>{ format_labels(labels), c });
+
+  return c;
+}
+
+auto
+metrics_registry::export_text() -> std::string
+{
+  std::ostringstream out;
+
+  /* The allocation counters are separate metric families, so they are written after the histograms. */
+  std::ostringstream allocations;
+
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  for (auto& [name, f] : m_families) {
+
+    /* The histograms of closed connections are removed here, since they are not exported anymore. */
+    remove_expired(f.entries);
+
+    if (f.entries.empty()) {
+      continue;
+    }
+
+    out << "# HELP " << name << ' ' << f.help << '\n';
+    out << "# TYPE " << name << " histogram\n";
+
+    const auto allocation_name = get_allocation_counter_name(name);
+
+    if (allocation_counter::enabled) {
+      allocations << "# HELP " << allocation_name << " The heap allocations made in " << name << ".\n";
+      allocations << "# TYPE " << allocation_name << " counter\n";
+    }
+
+    for (const auto& s : f.entries) {
+
+      auto h = s.metric.lock();
+
+      if (!h) {
+        continue;
+      }
+
+      const auto snap = h->get_snapshot();
+
+      const auto prefix = s.labels.empty() ? std::string() : (s.labels + ",");
+
+      std::uint64_t cumulative{};
+
+      for (std::size_t i = 0; i < latency_histogram::bucket_count; i++) {
+
+        cumulative += snap.buckets[i];
+
+        out << name << "_bucket{" << prefix << "le=\"";
+
+        if ((i + 1) < latency_histogram::bucket_count) {
+          out << latency_histogram::get_upper_bound(i);
+        } else {
+          out << "+Inf";
+        }
+
+        out << "\"} " << cumulative << '\n';
+      }
+
+      const auto labels = s.labels.empty() ? std::string() : ("{" + s.labels + "}");
+
+      out << name << "_sum" << labels << ' ' << (static_cast<double>(snap.sum) * 1.0e-9) << '\n';
+      out << name << "_count" << labels << ' ' << snap.count << '\n';
+
+      if (allocation_counter::enabled) {
+        allocations << allocation_name << labels << ' ' << snap.allocations << '\n';
+      }
+    }
+  }
+
+  out << allocations.str();
+
+  for (auto& [name, f] : m_counter_families) {
+
+    remove_expired(f.entries);
+
+    if (f.entries.empty()) {
+      continue;
+    }
+
+    out << "# HELP " << name << ' ' << f.help << '\n';
+    out << "# TYPE " << name << " counter\n";
+
+    for (const auto& s : f.entries) {
+
+      auto c = s.metric.lock();
+
+      if (!c) {
+        continue;
+      }
+
+      const auto labels = s.labels.empty() ? std::string() : ("{" + s.labels + "}");
+
+      out << name << labels << ' ' << c->get() << '\n';
+    }
+  }
+
+  return out.str();
+}
+
+auto
+metrics_registry::get_series_count() -> std::size_t
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  std::size_t count{};
+
+  for (const auto& f : m_families) {
+    count += f.second.entries.size();
+  }
+
+  for (const auto& f : m_counter_families) {
+    count += f.second.entries.size();
+  }
+
+  return count;
+}
+
+auto
+add_stage_histogram(metrics_registry& metrics, const char* pipeline, const std::uint32_t sensor_id, const char* stage)
+  -> std::shared_ptr<latency_histogram>
+{
+  auto h = metrics.add_histogram(
+    "sentinel_pipeline_stage_seconds",
+    "The time that each stage of a pipeline takes per frame or period.",
+    { { "pipeline", pipeline }, { "sensor", std::to_string(sensor_id) }, { "stage", stage } });
+
+  h->set_trace_label(tracer::add_label(stage, pipeline, { { "sensor", std::to_string(sensor_id) } }));
+
+  return h;
+}
+
+auto
+add_handoff_histogram(metrics_registry& metrics, const char* pipeline, const std::string& sensor)
+  -> std::shared_ptr<latency_histogram>
+{
+  auto h = metrics.add_histogram("sentinel_pipeline_handoff_seconds",
+                                 "The time that the output of a pipeline waits for the IO loop to pick it up.",
+                                 { { "pipeline", pipeline }, { "sensor", sensor } });
+
+  h->set_trace_label(tracer::add_label("handoff", pipeline, { { "sensor", sensor } }));
+
+  return h;
+}
+
+auto
+add_write_histogram(metrics_registry& metrics, const char* server, const std::uint64_t client_id)
+  -> std::shared_ptr<latency_histogram>
+{
+  auto h = metrics.add_histogram("sentinel_client_write_seconds",
+                                 "The time to write a message or response to the socket of a client.",
+                                 { { "server", server }, { "client", std::to_string(client_id) } });
+
+  /* The spans of every client share one label, since a label is kept for as long as the server runs. */
+  h->set_trace_label(tracer::add_label("write", server, {}));
+
+  return h;
+}
+
+auto
+add_queue_wait_histogram(metrics_registry& metrics, const char* server, const std::uint64_t client_id)
+  -> std::shared_ptr<latency_histogram>
+{
+  auto h = metrics.add_histogram("sentinel_client_queue_wait_seconds",
+                                 "The time that the oldest queued message of a client waits to be sent.",
+                                 { { "server", server }, { "client", std::to_string(client_id) } });
+
+  h->set_trace_label(tracer::add_label("queue", server, {}));
+
+  return h;
+}
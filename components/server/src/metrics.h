@@ -0,0 +1,263 @@
+#pragma once
+
+#include "allocation_counter.h"
+#include "trace.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Gets the time to measure durations with, in nanoseconds. Unlike @ref sentinel::get_clock_time, this is
+ *        monotonic.
+ * */
+inline auto
+get_metrics_time() -> std::uint64_t
+{
+  using namespace std::chrono;
+
+  return static_cast<std::uint64_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+/**
+ * @brief A histogram of durations, which may be recorded from any thread without locking.
+ *
+ * @details The buckets double in size, from one microsecond up to about eight seconds, so that finding the bucket of a
+ *          duration only takes a bit scan. Recording a duration is two relaxed atomic additions.
+ * */
+class latency_histogram final
+{
+public:
+  /**
+   * @brief The number of buckets, the last of which holds every duration that is too long for the others.
+   * */
+  static constexpr std::size_t bucket_count{ 25 };
+
+  struct snapshot final
+  {
+    std::array<std::uint64_t, bucket_count> buckets{};
+
+    std::uint64_t count{};
+
+    /**
+     * @brief The sum of the durations, in nanoseconds.
+     * */
+    std::uint64_t sum{};
+
+    /**
+     * @brief The number of heap allocations that were made in the recorded durations, which is only counted when
+     *        @ref allocation_counter::enabled is true.
+     * */
+    std::uint64_t allocations{};
+  };
+
+  /**
+   * @brief Records a duration, in nanoseconds.
+   * */
+  void record(const std::uint64_t duration) noexcept
+  {
+    m_buckets[get_bucket(duration)].fetch_add(1, std::memory_order_relaxed);
+
+    m_sum.fetch_add(duration, std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Records the time from @p start (as given by @ref get_metrics_time) until now. If tracing is enabled, this
+   *        is also recorded as a span.
+   *
+   * @details If allocations are counted, the allocations that the calling thread made since it last recorded a duration
+   *          (into any histogram) are added to this one. Since the stages of a pipeline are recorded one after the
+   *          other, each allocation of a pipeline thread ends up in the stage that made it (or, for allocations made
+   *          between stages, in the stage after them).
+   *
+   * @return The current time, so that the next stage can be timed from it.
+   * */
+  auto record_since(const std::uint64_t start) noexcept -> std::uint64_t
+  {
+    const auto now = get_metrics_time();
+
+    record((now > start) ? (now - start) : 0);
+
+    if constexpr (allocation_counter::enabled) {
+      m_allocations.fetch_add(allocation_counter::take_thread_count(), std::memory_order_relaxed);
+    }
+
+    if (m_trace_label != 0) {
+      tracer::record(m_trace_label, start, now);
+    }
+
+    return now;
+  }
+
+  /**
+   * @brief Sets the label (as given by @ref tracer::add_label) of the spans that @ref record_since records.
+   *
+   * @note This should be called before the histogram is shared with other threads.
+   * */
+  void set_trace_label(const std::uint32_t label) { m_trace_label = label; }
+
+  auto get_snapshot() const -> snapshot;
+
+  /**
+   * @brief Gets the bucket that a duration falls in.
+   * */
+  static auto get_bucket(std::uint64_t duration) noexcept -> std::size_t
+  {
+    const auto us = duration / 1000;
+
+    if (us == 0) {
+      return 0;
+    }
+
+    const auto bucket = static_cast<std::size_t>(64 - __builtin_clzll(us));
+
+    return (bucket < (bucket_count - 1)) ? bucket : (bucket_count - 1);
+  }
+
+  /**
+   * @brief Gets the upper bound of a bucket, in seconds. The last bucket has no upper bound.
+   * */
+  static auto get_upper_bound(std::size_t bucket) -> double;
+
+private:
+  std::array<std::atomic<std::uint64_t>, bucket_count> m_buckets{};
+
+  std::atomic<std::uint64_t> m_sum{};
+
+  std::atomic<std::uint64_t> m_allocations{};
+
+  std::uint32_t m_trace_label{};
+};
+
+/**
+ * @brief A count of events, which may be added to from any thread without locking.
+ * */
+class metrics_counter final
+{
+public:
+  void add(const std::uint64_t count) noexcept { m_value.fetch_add(count, std::memory_order_relaxed); }
+
+  auto get() const noexcept -> std::uint64_t { return m_value.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<std::uint64_t> m_value{};
+};
+
+/**
+ * @brief Keeps track of the histograms and counters of the server, so that they can be exported in the Prometheus text
+ *        format.
+ *
+ * @details The registry only holds weak references, so a metric is exported for as long as its owner (such as a client
+ *          connection) keeps it alive.
+ * */
+class metrics_registry final
+{
+public:
+  using label_list = std::vector<std::pair<std::string, std::string>>;
+
+  /**
+   * @brief Adds a histogram.
+   *
+   * @param name The name of the metric family, which should end with "_seconds".
+   *
+   * @param help The description of the metric family.
+   *
+   * @param labels The labels that tell this histogram apart from the others in its family.
+   *
+   * @note This takes a lock, so it should not be called for every sample.
+   * */
+  auto add_histogram(const std::string& name, const std::string& help, const label_list& labels)
+    -> std::shared_ptr<latency_histogram>;
+
+  /**
+   * @brief Adds a counter.
+   *
+   * @param name The name of the metric family, which should end with "_total".
+   *
+   * @param help The description of the metric family.
+   *
+   * @param labels The labels that tell this counter apart from the others in its family.
+   *
+   * @note This takes a lock, so it should not be called for every sample.
+   * */
+  auto add_counter(const std::string& name, const std::string& help, const label_list& labels)
+    -> std::shared_ptr<metrics_counter>;
+
+  /**
+   * @brief Formats every histogram and counter that is still alive in the Prometheus text format.
+   * */
+  auto export_text() -> std::string;
+
+  /**
+   * @brief Gets the number of series that the registry keeps, including the ones whose metric has been destroyed but
+   *        which have not been removed yet.
+   * */
+  auto get_series_count() -> std::size_t;
+
+private:
+  template<typename T>
+  struct series final
+  {
+    std::string labels;
+
+    std::weak_ptr<T> metric;
+  };
+
+  template<typename T>
+  struct family final
+  {
+    std::string help;
+
+    std::vector<series<T>> entries;
+  };
+
+  std::mutex m_lock;
+
+  std::map<std::string, family<latency_histogram>> m_families;
+
+  std::map<std::string, family<metrics_counter>> m_counter_families;
+};
+
+/**
+ * @brief Adds the histogram of one stage of a pipeline, such as capturing or encoding.
+ *
+ * @param pipeline The kind of pipeline, which is "video" or "audio".
+ * */
+auto
+add_stage_histogram(metrics_registry& metrics, const char* pipeline, std::uint32_t sensor_id, const char* stage)
+  -> std::shared_ptr<latency_histogram>;
+
+/**
+ * @brief Adds the histogram of the time that the output of a pipeline (or a group of them) waits for the IO loop.
+ * */
+auto
+add_handoff_histogram(metrics_registry& metrics, const char* pipeline, const std::string& sensor)
+  -> std::shared_ptr<latency_histogram>;
+
+/**
+ * @brief Adds the histogram of the time it takes to write to the socket of a client, from when the write is started
+ *        until it completes.
+ *
+ * @param server The server that the client is connected to, which is "tcp" or "http".
+ *
+ * @param client_id The ID of the client, which is unique within its server.
+ * */
+auto
+add_write_histogram(metrics_registry& metrics, const char* server, std::uint64_t client_id)
+  -> std::shared_ptr<latency_histogram>;
+
+/**
+ * @brief Adds the histogram of the time that messages wait in the queue of a client.
+ * */
+auto
+add_queue_wait_histogram(metrics_registry& metrics, const char* server, std::uint64_t client_id)
+  -> std::shared_ptr<latency_histogram>;
@@ -2,15 +2,17 @@
 
 #include <alsa/asoundlib.h>
 
+#include <cerrno>
+
 namespace {
 
 class microphone_device_impl final : public microphone_device
 {
 public:
-  explicit microphone_device_impl(const char* device, const unsigned int sampling_rate)
+  microphone_device_impl(const char* device, const unsigned int sampling_rate, const bool nonblocking)
     : m_sampling_rate(sampling_rate)
   {
-    if (snd_pcm_open(&m_handle, device, SND_PCM_STREAM_CAPTURE, 0) < 0) {
+    if (snd_pcm_open(&m_handle, device, SND_PCM_STREAM_CAPTURE, nonblocking ? SND_PCM_NONBLOCK : 0) < 0) {
       return;
     }
 
@@ -63,6 +65,8 @@ public:
       return;
     }
 
+    snd_pcm_hw_params_get_period_size(hw_params, &m_period_size, nullptr);
+
     snd_pcm_hw_params_free(hw_params);
 
     if (snd_pcm_prepare(m_handle) < 0) {
@@ -80,22 +84,64 @@ public:
     }
   }
 
-  auto is_open() const -> bool override { return m_open; }
+  auto is_open() const -> bool override { return m_open && !m_failed; }
 
   auto get_rate() const -> std::uint32_t override { return m_sampling_rate; }
 
-  auto read() -> std::vector<std::int16_t> override
+  auto get_period_size() const -> std::size_t override { return static_cast<std::size_t>(m_period_size); }
+
+  auto read(std::int16_t* samples) -> std::size_t override
   {
-    std::vector<std::int16_t> buffer(m_period_size);
+    const auto read_size = snd_pcm_readi(m_handle, samples, m_period_size);
 
-    const auto read_size = snd_pcm_readi(m_handle, &buffer[0], m_period_size);
     if (read_size < 0) {
-      return buffer;
+
+      if (read_size == -EAGAIN) {
+        return 0;
+      }
+
+      if (read_size == -EPIPE) {
+        m_overruns++;
+      }
+
+      if (snd_pcm_recover(m_handle, static_cast<int>(read_size), /* silent */ 1) < 0) {
+        /* The device is gone (for example, it was unplugged) and has to be opened again. */
+        m_failed = true;
+      }
+
+      return 0;
     }
 
-    buffer.resize(static_cast<std::size_t>(read_size));
+    return static_cast<std::size_t>(read_size);
+  }
+
+  auto get_overruns() const -> std::uint64_t override { return m_overruns; }
 
-    return buffer;
+  void get_poll_descriptors(std::vector<pollfd>& fds) override
+  {
+    const auto count = snd_pcm_poll_descriptors_count(m_handle);
+
+    if (count <= 0) {
+      return;
+    }
+
+    const auto offset = fds.size();
+
+    fds.resize(offset + static_cast<std::size_t>(count));
+
+    snd_pcm_poll_descriptors(m_handle, &fds[offset], static_cast<unsigned int>(count));
+  }
+
+  auto is_ready(pollfd* fds, const std::size_t count) -> bool override
+  {
+    unsigned short revents{};
+
+    if (snd_pcm_poll_descriptors_revents(m_handle, fds, static_cast<unsigned int>(count), &revents) < 0) {
+      return false;
+    }
+
+    /* Errors (such as an overrun) are also handled by reading, which recovers the device. */
+    return (revents & (POLLIN | POLLERR)) != 0;
   }
 
 private:
@@ -103,15 +149,20 @@ private:
 
   bool m_open{ false };
 
+  bool m_failed{ false };
+
   unsigned int m_sampling_rate{ 44100 };
 
   snd_pcm_uframes_t m_period_size{ 1024 };
+
+  std::uint64_t m_overruns{};
 };
 
 } // namespace
 
 auto
-microphone_device::create(const char* device, const unsigned int sampling_rate) -> std::unique_ptr<microphone_device>
+microphone_device::create(const char* device, const unsigned int sampling_rate, const bool nonblocking)
+  -> std::unique_ptr<microphone_device>
 {
-  return std::make_unique<microphone_device_impl>(device, sampling_rate);
+  return std::make_unique<microphone_device_impl>(device, sampling_rate, nonblocking);
 }
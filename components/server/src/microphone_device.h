@@ -1,20 +1,130 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <vector>
 
+#include <cstddef>
 #include <cstdint>
 
+#include <poll.h>
+
+/**
+ * @brief The signals that a synthetic microphone can generate.
+ * */
+enum class microphone_signal
+{
+  /**
+   * @brief A sine wave.
+   * */
+  tone,
+
+  /**
+   * @brief Quiet white noise, like a room where nothing happens.
+   * */
+  noise,
+
+  /**
+   * @brief Quiet white noise with a loud burst every few seconds, which the event detector should pick up.
+   * */
+  events
+};
+
 class microphone_device
 {
 public:
-  static auto create(const char* device, unsigned int sampling_rate) -> std::unique_ptr<microphone_device>;
+  /**
+   * @brief Opens a capture device.
+   *
+   * @param nonblocking Whether or not reads should return immediately when no samples are available, in which case the
+   *                    device is meant to be waited on with its poll descriptors.
+   * */
+  static auto create(const char* device, unsigned int sampling_rate, bool nonblocking = false)
+    -> std::unique_ptr<microphone_device>;
+
+  /**
+   * @brief Creates a device that plays back the samples of a WAV file, so that the audio pipeline can be run without
+   *        sound hardware.
+   *
+   * @param path The path of a 16-bit PCM WAV file, whose channels are mixed down to one.
+   *
+   * @param period_size The number of samples to produce in each period.
+   *
+   * @param realtime Whether to produce the periods at the rate of the file. Otherwise, they are produced as fast as
+   *                 they are read.
+   *
+   * @param loop Whether to start over at the end of the file. Otherwise, the device is finished at the end of it.
+   *
+   * @param nonblocking See @ref microphone_device::create.
+   * */
+  static auto create_replay(const std::string& path,
+                            std::size_t period_size,
+                            bool realtime,
+                            bool loop,
+                            bool nonblocking = false) -> std::unique_ptr<microphone_device>;
+
+  /**
+   * @brief Creates a device that generates a signal, which is the same every time it is created.
+   *
+   * @param frequency The frequency of the tone, in hertz, which is also used for the bursts of the events signal.
+   *
+   * @note The other parameters are the same as for @ref microphone_device::create_replay.
+   * */
+  static auto create_synthetic(microphone_signal signal,
+                               float frequency,
+                               unsigned int sampling_rate,
+                               std::size_t period_size,
+                               bool realtime,
+                               bool nonblocking = false) -> std::unique_ptr<microphone_device>;
 
   virtual ~microphone_device() = default;
 
+  /**
+   * @brief Indicates whether the device was opened, and has not failed since.
+   * */
   virtual auto is_open() const -> bool = 0;
 
   virtual auto get_rate() const -> std::uint32_t = 0;
 
-  virtual auto read() -> std::vector<std::int16_t> = 0;
+  /**
+   * @brief Gets the number of samples in each period, which is the most that @ref microphone_device::read reads at
+   *        once.
+   * */
+  virtual auto get_period_size() const -> std::size_t = 0;
+
+  /**
+   * @brief Reads the next period of samples.
+   *
+   * @param samples Where to put the samples, which must have room for a whole period.
+   *
+   * @return The number of samples that were read. This is zero if the device had to be recovered from an error, or if
+   *         the device is non-blocking and no samples are available.
+   * */
+  virtual auto read(std::int16_t* samples) -> std::size_t = 0;
+
+  /**
+   * @brief Gets the number of times that samples were lost because they were not read in time.
+   * */
+  virtual auto get_overruns() const -> std::uint64_t = 0;
+
+  /**
+   * @brief Adds the descriptors to wait on for samples to a list.
+   * */
+  virtual void get_poll_descriptors(std::vector<pollfd>& fds) = 0;
+
+  /**
+   * @brief Indicates whether samples can be read, after the descriptors from
+   *        @ref microphone_device::get_poll_descriptors were polled.
+   *
+   * @param fds The descriptors of this device, with the events that were returned.
+   *
+   * @param count The number of descriptors of this device.
+   * */
+  virtual auto is_ready(pollfd* fds, std::size_t count) -> bool = 0;
+
+  /**
+   * @brief Indicates whether the device has no more samples to produce, which is only the case for a recording that
+   *        does not loop.
+   * */
+  virtual auto is_finished() const -> bool { return false; }
 };
@@ -1,47 +1,489 @@
 #include "microphone_pipeline.h"
 
+#include "audio_event_detector.h"
+#include "audio_features.h"
+#include "audio_storage.h"
 #include "clock.h"
+#include "metrics.h"
 #include "microphone_device.h"
+#include "period_ring.h"
 
 #include <sentinel/proto.h>
 
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <thread>
+
+#include <cmath>
+
 namespace {
 
+/**
+ * @brief The number of sample messages that may be referenced at once, before the ring has to allocate more. The
+ *        client queues hold on to up to 16 messages each, so this leaves room for the ones that are being sent.
+ * */
+constexpr std::size_t ring_slots{ 64 };
+
+/**
+ * @brief How long to wait before opening a device again, after it could not be opened or it failed, in microseconds.
+ * */
+constexpr std::uint64_t retry_interval{ 5'000'000 };
+
+/**
+ * @brief The longest time to sleep at once while waiting to open a device again in blocking mode, in microseconds.
+ * */
+constexpr std::uint64_t max_retry_sleep{ 100'000 };
+
+/**
+ * @brief The shortest time between two log messages about overruns, so that a device that keeps overrunning does not
+ *        flood the log.
+ * */
+constexpr std::chrono::seconds overrun_report_interval{ 60 };
+
+/**
+ * @brief The most periods to read each time that a device is polled, so that one device cannot starve the others.
+ * */
+constexpr std::size_t max_periods_per_poll{ 16 };
+
 class microphone_pipeline_impl final : public microphone_pipeline
 {
 public:
-  explicit microphone_pipeline_impl(const config::microphone_config& cfg)
+  microphone_pipeline_impl(const config::microphone_config& cfg,
+                           std::shared_ptr<audio_storage> storage,
+                           metrics_registry& metrics)
     : m_config(cfg)
+    , m_storage(std::move(storage))
+    , m_features(cfg.level_bands)
+    , m_capture_time(add_stage_histogram(metrics, "audio", cfg.sensor_id, "capture"))
+    , m_analysis_time(add_stage_histogram(metrics, "audio", cfg.sensor_id, "analysis"))
+    , m_encode_time(add_stage_histogram(metrics, "audio", cfg.sensor_id, "encode"))
+    , m_storage_time(add_stage_histogram(metrics, "audio", cfg.sensor_id, "storage"))
+    , m_device_overrun_count(add_overrun_counter(metrics, cfg.sensor_id, "device"))
+    , m_ring_overrun_count(add_overrun_counter(metrics, cfg.sensor_id, "ring"))
   {
+    if (m_storage) {
+      m_storage->start();
+    }
+
+    if (cfg.events_enabled) {
+      m_detector.emplace(cfg.event_on_threshold, cfg.event_off_threshold, cfg.event_flux_threshold, cfg.event_hold);
+    }
   }
 
   auto loop(bool& should_close) -> std::vector<std::shared_ptr<sentinel::proto::outbound_message>> override
   {
     if (!m_device) {
-      m_device = microphone_device::create(m_config.name.c_str(), m_config.rate);
 
-      if (!m_device->is_open()) {
-        should_close = true;
+      const auto now = sentinel::get_clock_time();
+
+      if (now < m_retry_time) {
+        /* The wait is done in steps, so that the pipeline can still be closed in the meantime. */
+        const auto wait = std::min<std::uint64_t>(m_retry_time - now, max_retry_sleep);
+        std::this_thread::sleep_for(std::chrono::microseconds(wait));
         return {};
       }
 
-      m_sample_rate = m_device->get_rate();
+      if (!open_device(/* nonblocking */ false)) {
+        m_retry_time = now + retry_interval;
+        return {};
+      }
+    }
+
+    std::vector<std::shared_ptr<sentinel::proto::outbound_message>> messages;
+
+    read_period(messages);
+
+    if (m_device->is_finished()) {
+      spdlog::info("Microphone '{}' has played back all of its audio.", m_config.name);
+      should_close = true;
+    } else if (!m_device->is_open()) {
+      spdlog::error("Microphone '{}' failed, it will be opened again.", m_config.name);
+      m_device.reset();
+      m_retry_time = sentinel::get_clock_time() + retry_interval;
     }
 
-    const auto samples = m_device->read();
+    return messages;
+  }
+
+  auto get_poll_descriptors(std::vector<pollfd>& fds, int& timeout) -> bool override
+  {
+    if (!m_device) {
+
+      const auto now = sentinel::get_clock_time();
+
+      if ((now < m_retry_time) || !open_device(/* nonblocking */ true)) {
+
+        if (now >= m_retry_time) {
+          m_retry_time = now + retry_interval;
+        }
+
+        timeout = std::min(timeout, static_cast<int>((m_retry_time - now) / 1000) + 1);
+
+        return true;
+      }
+    }
+
+    m_device->get_poll_descriptors(fds);
+
+    return true;
+  }
+
+  auto poll(pollfd* fds, const std::size_t count, bool& should_close)
+    -> std::vector<std::shared_ptr<sentinel::proto::outbound_message>> override
+  {
+    std::vector<std::shared_ptr<sentinel::proto::outbound_message>> messages;
+
+    if (!m_device || !m_device->is_ready(fds, count)) {
+      return messages;
+    }
+
+    /* Every period that is available is read, so that the device does not fall behind. */
+    for (std::size_t i = 0; i < max_periods_per_poll; i++) {
+      if (!read_period(messages)) {
+        break;
+      }
+    }
+
+    if (m_device->is_finished()) {
+      spdlog::info("Microphone '{}' has played back all of its audio.", m_config.name);
+      should_close = true;
+    } else if (!m_device->is_open()) {
+      spdlog::error("Microphone '{}' failed, it will be opened again.", m_config.name);
+      m_device.reset();
+      m_retry_time = sentinel::get_clock_time() + retry_interval;
+    }
+
+    return messages;
+  }
+
+protected:
+  /**
+   * @brief Opens the device and sets up the period ring for it.
+   *
+   * @return True on success, false if the device could not be opened.
+   * */
+  auto open_device(const bool nonblocking) -> bool
+  {
+    m_device = create_device(nonblocking);
+
+    if (!m_device->is_open()) {
+      m_device.reset();
+      return false;
+    }
 
-    const auto buffer_duration = static_cast<float>(samples.size()) / static_cast<float>(m_sample_rate);
+    m_sample_rate = m_device->get_rate();
+
+    const auto period_size = m_device->get_period_size();
+
+    const auto periods_per_slot = get_periods_per_message(period_size);
+
+    if (is_gated() && (period_size > 0)) {
+      const auto pre_roll_samples = static_cast<double>(m_config.event_pre_roll) * static_cast<double>(m_sample_rate);
+      const auto message_samples = static_cast<double>(period_size * periods_per_slot);
+      m_pre_roll_messages = static_cast<std::size_t>(std::ceil(pre_roll_samples / message_samples));
+      m_pre_roll.reserve(m_pre_roll_messages + 1);
+    }
+
+    /* The messages held for the pre-roll also need slots. */
+    m_ring.emplace(ring_slots + m_pre_roll_messages, period_size, periods_per_slot, m_config.adpcm_enabled);
+
+    /* The new device and ring count their overruns from zero. */
+    m_device_overruns = 0;
+
+    m_ring_overruns = 0;
+
+    return true;
+  }
+
+  auto create_device(const bool nonblocking) const -> std::unique_ptr<microphone_device>
+  {
+    if (!m_config.replay_path.empty()) {
+      return microphone_device::create_replay(
+        m_config.replay_path, m_config.replay_period_size, m_config.replay_realtime, m_config.replay_loop, nonblocking);
+    }
+
+    if (!m_config.replay_signal.empty()) {
+
+      auto signal = microphone_signal::tone;
+
+      if (m_config.replay_signal == "noise") {
+        signal = microphone_signal::noise;
+      } else if (m_config.replay_signal == "events") {
+        signal = microphone_signal::events;
+      }
+
+      return microphone_device::create_synthetic(signal,
+                                                 m_config.replay_frequency,
+                                                 m_config.rate,
+                                                 m_config.replay_period_size,
+                                                 m_config.replay_realtime,
+                                                 nonblocking);
+    }
+
+    return microphone_device::create(m_config.name.c_str(), m_config.rate, nonblocking);
+  }
+
+  /**
+   * @brief Reads a period from the device and processes it.
+   *
+   * @param messages The list to add the resulting messages to.
+   *
+   * @return False if no samples were read.
+   * */
+  auto read_period(std::vector<std::shared_ptr<sentinel::proto::outbound_message>>& messages) -> bool
+  {
+    auto* samples = m_ring->acquire();
+
+    const auto t = get_metrics_time();
+
+    const auto size = m_device->read(samples);
+
+    report_overruns();
+
+    if (size == 0) {
+      return false;
+    }
+
+    process_period(samples, size, m_capture_time->record_since(t), messages);
+
+    return true;
+  }
+
+  /**
+   * @param t The time that the period was read, as given by @ref get_metrics_time.
+   * */
+  void process_period(const std::int16_t* samples,
+                      const std::size_t size,
+                      std::uint64_t t,
+                      std::vector<std::shared_ptr<sentinel::proto::outbound_message>>& messages)
+  {
+    const auto buffer_duration = static_cast<float>(size) / static_cast<float>(m_sample_rate);
 
     const auto time = sentinel::get_clock_time() - static_cast<std::uint64_t>(buffer_duration * 1.0e6);
 
-    auto msg = sentinel::proto::writer::create_microphone_update(
-      samples.data(), samples.size(), m_sample_rate, time, m_config.sensor_id);
+    auto level = update_level(samples, size, time);
+    if (level) {
+      messages.emplace_back(stamp_message(std::move(level), m_level_time));
+    }
+
+    const auto event_changed = m_detector && m_detector->update(samples, size, m_sample_rate);
+
+    const auto event_active = !m_detector || m_detector->is_active();
+
+    if (event_changed) {
+      messages.emplace_back(
+        stamp_message(sentinel::proto::writer::create_microphone_event(event_active, time, m_config.sensor_id), time));
+    }
+
+    t = m_analysis_time->record_since(t);
+
+    m_ring->append(size, time);
+
+    /* The message is sent early when an event starts or ends, so that the gating applies from this period on. */
+    if (m_ring->has_room() && !event_changed) {
+      return;
+    }
+
+    const auto message_time = m_ring->get_pending_time();
+
+    const auto message_size = static_cast<std::uint32_t>(m_ring->get_pending_samples());
+
+    const auto* message_samples = m_ring->get_pending_data();
+
+    auto samples_message = m_ring->commit(m_sample_rate, m_config.sensor_id);
+
+    t = m_encode_time->record_since(t);
 
-    std::vector<std::shared_ptr<sentinel::proto::outbound_message>> buffers;
+    if (!is_gated() || event_active) {
+      flush_pre_roll(messages);
+    }
+
+    const auto stream = !is_gated() || !m_config.event_gate_stream || event_active;
+
+    const auto store = !is_gated() || !m_config.event_gate_storage || event_active;
+
+    if (m_storage && store) {
+      m_storage->store(message_time, m_sample_rate, message_samples, message_size);
+      m_storage_time->record_since(t);
+    }
+
+    if (!stream || !store) {
+      hold_message(samples_message, message_time, message_size);
+    }
+
+    if (stream) {
+      messages.emplace_back(stamp_message(std::move(samples_message), message_time));
+    }
+  }
+
+  /**
+   * @brief Gets the number of periods to pack into each sample message, according to the coalescing configuration.
+   * */
+  auto get_periods_per_message(const std::size_t period_size) const -> std::size_t
+  {
+    if (period_size == 0) {
+      return 1;
+    }
+
+    const auto rate = static_cast<double>(m_sample_rate);
+
+    const auto target_samples = std::max(static_cast<double>(m_config.coalesce_duration) * rate,
+                                         static_cast<double>(m_config.coalesce_bytes / sizeof(std::int16_t)));
+
+    const auto max_samples = static_cast<double>(m_config.coalesce_max_latency) * rate;
+
+    const auto target = static_cast<std::size_t>(std::ceil(target_samples / static_cast<double>(period_size)));
+
+    const auto max = static_cast<std::size_t>(std::floor(max_samples / static_cast<double>(period_size)));
 
-    buffers.emplace_back(msg);
+    return std::max<std::size_t>(std::min(target, max), 1);
+  }
+
+  struct held_message final
+  {
+    std::shared_ptr<sentinel::proto::outbound_message> message;
 
-    return buffers;
+    std::uint64_t time{};
+
+    std::uint32_t size{};
+  };
+
+  /**
+   * @brief Indicates whether streaming or storage is limited to acoustic events.
+   * */
+  auto is_gated() const -> bool
+  {
+    return m_detector.has_value() && (m_config.event_gate_stream || m_config.event_gate_storage);
+  }
+
+  /**
+   * @brief Holds on to a sample message that was not streamed or stored, so that it can be if an event starts soon
+   *        after.
+   * */
+  void hold_message(const std::shared_ptr<sentinel::proto::outbound_message>& message,
+                   const std::uint64_t time,
+                   const std::uint32_t size)
+  {
+    if (m_pre_roll_messages == 0) {
+      return;
+    }
+
+    if (m_pre_roll.size() >= m_pre_roll_messages) {
+      m_pre_roll.erase(m_pre_roll.begin());
+    }
+
+    m_pre_roll.emplace_back(held_message{ message, time, size });
+  }
+
+  /**
+   * @brief Streams and stores the sample messages that were held from before an event.
+   * */
+  void flush_pre_roll(std::vector<std::shared_ptr<sentinel::proto::outbound_message>>& messages)
+  {
+    for (auto& p : m_pre_roll) {
+
+      if (m_storage && m_config.event_gate_storage) {
+        const auto* samples = p.message->buffer->data() + sentinel::proto::writer::microphone_update_samples_offset;
+        m_storage->store(p.time, m_sample_rate, reinterpret_cast<const std::int16_t*>(samples), p.size);
+      }
+
+      if (m_config.event_gate_stream) {
+        messages.emplace_back(stamp_message(std::move(p.message), p.time));
+      }
+    }
+
+    m_pre_roll.clear();
+  }
+
+  /**
+   * @brief Adds a period to the sound level, and composes a level update once it covers the configured interval.
+   *
+   * @return The level update, or null if the interval is not over yet.
+   * */
+  auto update_level(const std::int16_t* samples, const std::size_t size, const std::uint64_t time)
+    -> std::shared_ptr<sentinel::proto::outbound_message>
+  {
+    if (m_features.get_sample_count() == 0) {
+      m_level_time = time;
+    }
+
+    m_features.add(samples, size, m_sample_rate);
+
+    const auto interval_samples =
+      static_cast<std::uint64_t>(m_config.level_interval * static_cast<float>(m_sample_rate));
+
+    if (m_features.get_sample_count() < interval_samples) {
+      return nullptr;
+    }
+
+    const auto& bands = m_features.get_bands();
+
+    auto msg = sentinel::proto::writer::create_microphone_level(m_features.get_peak(),
+                                                                m_features.get_rms(),
+                                                                bands.data(),
+                                                                static_cast<std::uint32_t>(bands.size()),
+                                                                m_level_time,
+                                                                m_config.sensor_id);
+
+    m_features.reset();
+
+    return msg;
+  }
+
+  static auto add_overrun_counter(metrics_registry& metrics, const std::uint32_t sensor_id, const char* source)
+    -> std::shared_ptr<metrics_counter>
+  {
+    return metrics.add_counter("sentinel_audio_overruns_total",
+                               "The number of periods that were lost by a microphone device, or that the period ring "
+                               "had to allocate for, since the server started.",
+                               { { "sensor", std::to_string(sensor_id) }, { "source", source } });
+  }
+
+  /**
+   * @brief Counts the periods that were lost by the device, or that the ring had to allocate for, and logs a summary of
+   *        them at most once per @ref overrun_report_interval.
+   * */
+  void report_overruns()
+  {
+    const auto device_overruns = m_device->get_overruns();
+
+    const auto ring_overruns = m_ring->get_overruns();
+
+    if ((device_overruns == m_device_overruns) && (ring_overruns == m_ring_overruns)) {
+      return;
+    }
+
+    m_device_overrun_count->add(device_overruns - m_device_overruns);
+
+    m_ring_overrun_count->add(ring_overruns - m_ring_overruns);
+
+    m_unreported_device_overruns += device_overruns - m_device_overruns;
+
+    m_unreported_ring_overruns += ring_overruns - m_ring_overruns;
+
+    m_device_overruns = device_overruns;
+
+    m_ring_overruns = ring_overruns;
+
+    const auto now = std::chrono::steady_clock::now();
+
+    if (now < m_next_overrun_report) {
+      return;
+    }
+
+    spdlog::warn("Microphone '{}' overruns since the last report: {} in the device, {} in the period ring.",
+                 m_config.name,
+                 m_unreported_device_overruns,
+                 m_unreported_ring_overruns);
+
+    m_unreported_device_overruns = 0;
+
+    m_unreported_ring_overruns = 0;
+
+    m_next_overrun_report = now + overrun_report_interval;
   }
 
 private:
@@ -49,13 +491,77 @@ private:
 
   std::unique_ptr<microphone_device> m_device;
 
+  std::shared_ptr<audio_storage> m_storage;
+
+  std::optional<period_ring> m_ring;
+
+  audio_features m_features;
+
+  std::optional<audio_event_detector> m_detector;
+
+  /**
+   * @brief The time spent reading a period from the device, analyzing it (level and event detection), composing the
+   *        sample messages and storing the samples.
+   *
+   * @note Reading includes waiting for the device, unless the pipeline is polled.
+   * */
+  std::shared_ptr<latency_histogram> m_capture_time;
+
+  std::shared_ptr<latency_histogram> m_analysis_time;
+
+  std::shared_ptr<latency_histogram> m_encode_time;
+
+  std::shared_ptr<latency_histogram> m_storage_time;
+
+  /**
+   * @brief The most recent sample messages that were not streamed or stored, oldest first.
+   * */
+  std::vector<held_message> m_pre_roll;
+
+  /**
+   * @brief The number of sample messages to hold for the pre-roll.
+   * */
+  std::size_t m_pre_roll_messages{};
+
+  /**
+   * @brief The time of the first period in the current level update.
+   * */
+  std::uint64_t m_level_time{};
+
+  std::shared_ptr<metrics_counter> m_device_overrun_count;
+
+  std::shared_ptr<metrics_counter> m_ring_overrun_count;
+
+  /**
+   * @brief The overrun counts of the current device and ring, as of the last time they were checked.
+   * */
+  std::uint64_t m_device_overruns{};
+
+  std::uint64_t m_ring_overruns{};
+
+  /**
+   * @brief The overruns since the last log message about them.
+   * */
+  std::uint64_t m_unreported_device_overruns{};
+
+  std::uint64_t m_unreported_ring_overruns{};
+
+  std::chrono::steady_clock::time_point m_next_overrun_report;
+
   std::uint32_t m_sample_rate{};
+
+  /**
+   * @brief When to try opening the device again, after it could not be opened or it failed.
+   * */
+  std::uint64_t m_retry_time{};
 };
 
 } // namespace
 
 auto
-microphone_pipeline::create(const config::microphone_config& cfg) -> std::unique_ptr<microphone_pipeline>
+microphone_pipeline::create(const config::microphone_config& cfg,
+                            std::shared_ptr<audio_storage> storage,
+                            metrics_registry& metrics) -> std::unique_ptr<microphone_pipeline>
 {
-  return std::make_unique<microphone_pipeline_impl>(cfg);
+  return std::make_unique<microphone_pipeline_impl>(cfg, std::move(storage), metrics);
 }
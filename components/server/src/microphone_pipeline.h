@@ -5,10 +5,25 @@
 #include "config.h"
 #include "pipeline.h"
 
+class audio_storage;
+class metrics_registry;
+
 class microphone_pipeline : public pipeline
 {
 public:
-  static auto create(const config::microphone_config& cfg) -> std::unique_ptr<microphone_pipeline>;
+  /**
+   * @brief Creates a new microphone pipeline.
+   *
+   * @param cfg The configuration of the microphone.
+   *
+   * @param storage The storage to put the audio into, or null if the audio is not stored. It is started by the
+   *                pipeline.
+   *
+   * @param metrics The registry to add the timing of each stage to.
+   * */
+  static auto create(const config::microphone_config& cfg,
+                     std::shared_ptr<audio_storage> storage,
+                     metrics_registry& metrics) -> std::unique_ptr<microphone_pipeline>;
 
   virtual ~microphone_pipeline() = default;
 };
@@ -0,0 +1,128 @@
+#include "period_ring.h"
+
+#include <algorithm>
+
+namespace {
+
+constexpr auto samples_offset = sentinel::proto::writer::microphone_update_samples_offset;
+
+} // namespace
+
+period_ring::period_ring(const std::size_t slot_count,
+                         const std::size_t period_size,
+                         const std::size_t periods_per_slot,
+                         const bool compressed)
+  : m_period_size(period_size)
+  , m_capacity(period_size * std::max<std::size_t>(periods_per_slot, 1))
+  , m_compressed(compressed)
+{
+  m_slots.resize(std::max<std::size_t>(slot_count, 1));
+
+  for (auto& slot : m_slots) {
+    slot = make_slot();
+  }
+}
+
+auto
+period_ring::make_slot() const -> std::shared_ptr<sentinel::proto::outbound_message>
+{
+  const std::vector<std::int16_t> silence(m_capacity);
+
+  const auto size = static_cast<std::uint32_t>(silence.size());
+
+  auto slot = sentinel::proto::writer::create_microphone_update(silence.data(), size, 0, 0, 0);
+
+  if (m_compressed) {
+    sentinel::proto::adpcm_encoder encoder;
+    slot->compressed =
+      sentinel::proto::writer::create_microphone_adpcm_update(encoder, silence.data(), size, 0, 0, 0);
+  }
+
+  return slot;
+}
+
+auto
+period_ring::is_free(const std::shared_ptr<sentinel::proto::outbound_message>& slot) -> bool
+{
+  const auto& compressed = slot->compressed;
+
+  /* The compressed message may be referenced on its own, by the clients that accept it. */
+  if (compressed && ((compressed.use_count() != 1) || (compressed->buffer.use_count() != 1))) {
+    return false;
+  }
+
+  return (slot.use_count() == 1) && (slot->buffer.use_count() == 1);
+}
+
+auto
+period_ring::acquire() -> std::int16_t*
+{
+  auto& slot = m_slots[m_next];
+
+  if (m_pending == 0) {
+
+    if (!is_free(slot)) {
+      m_overruns++;
+      slot = make_slot();
+    }
+
+    /* The message may have been shrunk to a partial slot, but the memory for a whole one is still there. */
+    slot->buffer->resize(samples_offset + (m_capacity * sizeof(std::int16_t)));
+  }
+
+  return reinterpret_cast<std::int16_t*>(slot->buffer->data() + samples_offset) + m_pending;
+}
+
+void
+period_ring::append(const std::size_t size, const std::uint64_t time)
+{
+  if (m_pending == 0) {
+    m_pending_time = time;
+  }
+
+  m_pending = std::min(m_pending + size, m_capacity);
+}
+
+auto
+period_ring::get_pending_data() const -> const std::int16_t*
+{
+  const auto& buffer = *m_slots[m_next]->buffer;
+
+  return reinterpret_cast<const std::int16_t*>(buffer.data() + samples_offset);
+}
+
+auto
+period_ring::commit(const std::uint32_t sample_rate, const std::uint32_t sensor_id)
+  -> std::shared_ptr<sentinel::proto::outbound_message>
+{
+  auto slot = m_slots[m_next];
+
+  m_next = (m_next + 1) % m_slots.size();
+
+  const auto size = static_cast<std::uint32_t>(m_pending);
+
+  sentinel::proto::writer::complete_microphone_update(*slot->buffer, size, sample_rate, m_pending_time, sensor_id);
+
+  if (slot->compressed) {
+
+    const auto* samples = reinterpret_cast<const std::int16_t*>(slot->buffer->data() + samples_offset);
+
+    sentinel::proto::writer::complete_microphone_adpcm_update(
+      *slot->compressed->buffer, m_encoder, samples, size, sample_rate, m_pending_time, sensor_id);
+  }
+
+  m_pending = 0;
+
+  return slot;
+}
+
+auto
+period_ring::commit(const std::uint32_t size,
+                    const std::uint32_t sample_rate,
+                    const std::uint64_t time,
+                    const std::uint32_t sensor_id) -> std::shared_ptr<sentinel::proto::outbound_message>
+{
+  append(size, time);
+
+  return commit(sample_rate, sensor_id);
+}
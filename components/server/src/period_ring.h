@@ -0,0 +1,142 @@
+#pragma once
+
+#include <sentinel/proto.h>
+
+#include <memory>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief A ring of preallocated microphone update messages, which audio periods are captured straight into.
+ *
+ * @details Each slot is a complete message with room for a whole period. The device reads into the sample area of a
+ *          slot, the rest of the message is filled in around the samples, and the message itself is published. Once
+ *          every reference to the message has been dropped, the slot is used again, so no memory is allocated per
+ *          period.
+ *
+ *          If the next slot is still referenced when it is needed (because the messages are consumed more slowly than
+ *          they are produced), a new message is allocated in its place and an overrun is counted. The old message
+ *          remains valid for as long as it is referenced.
+ *
+ *          A slot may also hold several consecutive periods, so that fewer (but larger) messages are published. Periods
+ *          are appended to the slot until it is committed.
+ *
+ *          If compression is enabled, each slot also holds a preallocated IMA-ADPCM message, which the samples are
+ *          encoded into when the slot is committed. It is published as the compressed encoding of the slot's message.
+ *
+ * @note This class is not thread safe, it is meant to be used by the capture thread only.
+ * */
+class period_ring final
+{
+public:
+  /**
+   * @brief Constructs a new period ring.
+   *
+   * @param slot_count The number of messages in the ring.
+   *
+   * @param period_size The maximum number of samples in a period.
+   *
+   * @param periods_per_slot The number of periods that each message has room for.
+   *
+   * @param compressed Whether or not to encode each message with IMA-ADPCM too.
+   * */
+  period_ring(std::size_t slot_count,
+              std::size_t period_size,
+              std::size_t periods_per_slot = 1,
+              bool compressed = false);
+
+  /**
+   * @brief Gets the sample area after the periods that were appended to the current slot, which has room for a whole
+   *        period.
+   *
+   * @note This must only be called if @ref period_ring::has_room is true.
+   * */
+  auto acquire() -> std::int16_t*;
+
+  /**
+   * @brief Adds a period that was written into the area returned by @ref period_ring::acquire to the current slot.
+   *
+   * @param size The number of samples that were written.
+   *
+   * @param time The time of the first sample, which becomes the time of the message if it is the first period.
+   * */
+  void append(std::size_t size, std::uint64_t time);
+
+  /**
+   * @brief Indicates whether the current slot has room for another period.
+   * */
+  auto has_room() const -> bool { return (m_pending + m_period_size) <= m_capacity; }
+
+  /**
+   * @brief Gets the number of samples that were appended to the current slot.
+   * */
+  auto get_pending_samples() const -> std::size_t { return m_pending; }
+
+  /**
+   * @brief Gets the time of the first sample in the current slot.
+   * */
+  auto get_pending_time() const -> std::uint64_t { return m_pending_time; }
+
+  /**
+   * @brief Gets the samples that were appended to the current slot.
+   * */
+  auto get_pending_data() const -> const std::int16_t*;
+
+  /**
+   * @brief Completes the message of the current slot, with every period that was appended to it.
+   *
+   * @return The message, which may be published. If compression is enabled, it carries the compressed encoding of the
+   *         samples.
+   * */
+  auto commit(std::uint32_t sample_rate, std::uint32_t sensor_id) -> std::shared_ptr<sentinel::proto::outbound_message>;
+
+  /**
+   * @brief Appends a single period and completes the message.
+   *
+   * @param size The number of samples that were written into the slot.
+   *
+   * @return The message, which may be published.
+   * */
+  auto commit(std::uint32_t size, std::uint32_t sample_rate, std::uint64_t time, std::uint32_t sensor_id)
+    -> std::shared_ptr<sentinel::proto::outbound_message>;
+
+  /**
+   * @brief Gets the number of times that a slot was still referenced when it was needed again.
+   * */
+  auto get_overruns() const -> std::uint64_t { return m_overruns; }
+
+protected:
+  auto make_slot() const -> std::shared_ptr<sentinel::proto::outbound_message>;
+
+  static auto is_free(const std::shared_ptr<sentinel::proto::outbound_message>& slot) -> bool;
+
+private:
+  const std::size_t m_period_size{};
+
+  /**
+   * @brief The number of samples that each message has room for.
+   * */
+  const std::size_t m_capacity{};
+
+  const bool m_compressed{};
+
+  /**
+   * @brief Encodes every message (whether or not it is streamed), so that the stream stays continuous.
+   * */
+  sentinel::proto::adpcm_encoder m_encoder;
+
+  std::vector<std::shared_ptr<sentinel::proto::outbound_message>> m_slots;
+
+  std::size_t m_next{};
+
+  /**
+   * @brief The number of samples that were appended to the current slot.
+   * */
+  std::size_t m_pending{};
+
+  std::uint64_t m_pending_time{};
+
+  std::uint64_t m_overruns{};
+};
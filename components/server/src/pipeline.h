@@ -1,11 +1,15 @@
 #pragma once
 
+#include "clock.h"
+
 #include <sentinel/proto.h>
 
 #include <vector>
 
 #include <cstdint>
 
+#include <poll.h>
+
 class pipeline
 {
 public:
@@ -23,4 +27,60 @@ public:
    * @param should_close May be set by the pipeline, in which case it will be closed before the next iteration.
    * */
   virtual auto loop(bool& should_close) -> std::vector<std::shared_ptr<sentinel::proto::outbound_message>> = 0;
+
+  /**
+   * @brief Adds the descriptors that the pipeline waits on to a list, so that it can share a capture thread with other
+   *        pipelines instead of blocking in @ref pipeline::loop.
+   *
+   * @param fds The list to add the descriptors to.
+   *
+   * @param timeout Lowered to the most milliseconds to wait before @ref pipeline::poll has to be called, even if none
+   *                of the descriptors have an event (for example, to retry opening a device).
+   *
+   * @return False if the pipeline cannot be polled, in which case it needs a thread of its own.
+   * */
+  virtual auto get_poll_descriptors(std::vector<pollfd>& fds, int& timeout) -> bool { return false; }
+
+  /**
+   * @brief Iterates the pipeline after its descriptors were polled. Unlike @ref pipeline::loop, this does not block.
+   *
+   * @param fds The descriptors that were added by @ref pipeline::get_poll_descriptors, with the events that were
+   *            returned.
+   *
+   * @param count The number of descriptors that were added.
+   *
+   * @param should_close May be set by the pipeline, in which case it will not be polled again.
+   * */
+  virtual auto poll(pollfd* fds, std::size_t count, bool& should_close)
+    -> std::vector<std::shared_ptr<sentinel::proto::outbound_message>>
+  {
+    return {};
+  }
+
+  /**
+   * @brief Sets whether or not the messages of the pipeline are sent with timing stamps, so that clients can measure
+   *        the latency of each hop.
+   *
+   * @note This has to be called before the pipeline is iterated.
+   * */
+  void set_timing_stamps_enabled(const bool enabled) { m_timing_stamps_enabled = enabled; }
+
+protected:
+  /**
+   * @brief Wraps a message in a timed message (if timing stamps are enabled), which is stamped as encoded now.
+   *
+   * @param captured The time that the data in the message was captured, in microseconds since Unix epoch.
+   * */
+  auto stamp_message(std::shared_ptr<sentinel::proto::outbound_message> msg, const std::uint64_t captured) const
+    -> std::shared_ptr<sentinel::proto::outbound_message>
+  {
+    if (!m_timing_stamps_enabled) {
+      return msg;
+    }
+
+    return sentinel::proto::writer::create_timed(*msg, captured, sentinel::get_clock_time());
+  }
+
+private:
+  bool m_timing_stamps_enabled{ false };
 };
@@ -1,5 +1,8 @@
 #include "pipeline_runner.h"
 
+#include "metrics.h"
+#include "thread_name.h"
+
 namespace {
 
 auto
@@ -10,13 +13,15 @@ to_handle(uv_async_t* handle) -> uv_handle_t*
 
 } // namespace
 
-pipeline_runner::pipeline_runner(uv_loop_t* loop, std::unique_ptr<pipeline> p)
-  : m_thread(&pipeline_runner::run_pipeline, this)
-  , m_pipeline(std::move(p))
+pipeline_runner::pipeline_runner(uv_loop_t* loop, std::unique_ptr<pipeline> p, const char* thread_name)
+  : m_pipeline(std::move(p))
 {
   uv_async_init(loop, &m_handle, on_async_update);
 
   uv_handle_set_data(to_handle(&m_handle), this);
+
+  /* The thread is started last, since it uses the pipeline and the async handle right away. */
+  m_thread = std::thread(&pipeline_runner::run_pipeline, this, std::string(thread_name));
 }
 
 void
@@ -38,23 +43,32 @@ pipeline_runner::get_self(uv_handle_t* handle) -> pipeline_runner*
 }
 
 void
-pipeline_runner::run_pipeline()
+pipeline_runner::run_pipeline(const std::string& thread_name)
 {
+  set_thread_name(thread_name.c_str());
+
   while (!m_should_close.load()) {
 
     auto should_close = false;
 
     auto outs = m_pipeline->loop(should_close);
 
-    {
-      std::lock_guard<std::mutex> lock(m_lock);
+    if (!outs.empty()) {
+
+      {
+        std::lock_guard<std::mutex> lock(m_lock);
 
-      for (auto& out : outs) {
-        m_outputs.emplace_back(std::move(out));
+        if (m_outputs.empty()) {
+          m_output_time = get_metrics_time();
+        }
+
+        for (auto& out : outs) {
+          m_outputs.emplace_back(std::move(out));
+        }
       }
-    }
 
-    uv_async_send(&m_handle);
+      uv_async_send(&m_handle);
+    }
 
     if (should_close) {
       break;
@@ -67,12 +81,21 @@ pipeline_runner::on_async_update(uv_async_t* handle)
 {
   auto* self = get_self(to_handle(handle));
 
-  std::vector<std::shared_ptr<sentinel::proto::outbound_message>> outs;
+  auto& outs = self->m_received;
+
+  std::uint64_t output_time{};
 
   {
     std::lock_guard<std::mutex> lock(self->m_lock);
 
-    outs = std::move(self->m_outputs);
+    /* The vectors are swapped instead of moved, so that both keep their capacity and the handoff does not allocate. */
+    std::swap(outs, self->m_outputs);
+
+    output_time = self->m_output_time;
+  }
+
+  if (self->m_handoff_time && !outs.empty()) {
+    self->m_handoff_time->record_since(output_time);
   }
 
   for (auto& out : outs) {
@@ -80,6 +103,8 @@ pipeline_runner::on_async_update(uv_async_t* handle)
       obs->observe_telemetry(out);
     }
   }
+
+  outs.clear();
 }
 
 void
@@ -87,3 +112,9 @@ pipeline_runner::add_telemetry_observer(telemetry_observer* o)
 {
   m_observers.emplace_back(o);
 }
+
+void
+pipeline_runner::set_handoff_histogram(std::shared_ptr<latency_histogram> h)
+{
+  m_handoff_time = std::move(h);
+}
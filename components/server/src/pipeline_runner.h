@@ -4,11 +4,14 @@
 
 #include <atomic>
 #include <mutex>
+#include <string>
 #include <thread>
 
 #include "pipeline.h"
 #include "telemetry_observer.h"
 
+class latency_histogram;
+
 /**
  * @brief Used for running a pipeline in asynchronously.
  * */
@@ -21,8 +24,10 @@ public:
    * @param loop The loop to construct the thread interface to.
    *
    * @param p The pipeline to run asynchronously.
+   *
+   * @param thread_name The name to give the worker thread.
    * */
-  explicit pipeline_runner(uv_loop_t* loop, std::unique_ptr<pipeline> p);
+  explicit pipeline_runner(uv_loop_t* loop, std::unique_ptr<pipeline> p, const char* thread_name = "pipeline");
 
   /**
    * @brief Closes the runner and the pipeline.
@@ -36,6 +41,13 @@ public:
    * */
   void add_telemetry_observer(telemetry_observer* o);
 
+  /**
+   * @brief Sets the histogram to record the time that the output of the pipelines waits for the IO loop in.
+   *
+   * @note This must be called from the IO loop, and the histogram is only used from there.
+   * */
+  void set_handoff_histogram(std::shared_ptr<latency_histogram> h);
+
 protected:
   static auto get_self(uv_handle_t* handle) -> pipeline_runner*;
 
@@ -47,7 +59,7 @@ protected:
   /**
    * @note This is the entrypoint of the worker thread.
    * */
-  void run_pipeline();
+  void run_pipeline(const std::string& thread_name);
 
 private:
   /**
@@ -70,6 +82,18 @@ private:
    * */
   std::vector<std::shared_ptr<sentinel::proto::outbound_message>> m_outputs;
 
+  /**
+   * @brief The outputs that the IO loop took from @ref pipeline_runner::m_outputs, which is only used from the IO loop.
+   * */
+  std::vector<std::shared_ptr<sentinel::proto::outbound_message>> m_received;
+
+  /**
+   * @brief When the oldest of the outputs was added, as given by @ref get_metrics_time.
+   * */
+  std::uint64_t m_output_time{};
+
+  std::shared_ptr<latency_histogram> m_handoff_time;
+
   /**
    * @brief The observers to listen to telemetry with.
    * */
@@ -0,0 +1,278 @@
+#include "program.h"
+
+#include "audio_storage.h"
+#include "camera_storage.h"
+#include "capture_group.h"
+#include "clock.h"
+#include "config.h"
+#include "http_server.h"
+#include "microphone_pipeline.h"
+#include "pipeline_runner.h"
+#include "server.h"
+#include "storage_http_handler.h"
+#include "trace.h"
+#include "video_pipeline.h"
+
+#include <spdlog/spdlog.h>
+
+#include <csignal>
+
+namespace {
+
+auto
+to_handle(uv_signal_t* handle) -> uv_handle_t*
+{
+  return reinterpret_cast<uv_handle_t*>(handle);
+}
+
+auto
+to_handle(uv_async_t* handle) -> uv_handle_t*
+{
+  return reinterpret_cast<uv_handle_t*>(handle);
+}
+
+} // namespace
+
+program::program()
+{
+  uv_loop_init(&m_loop);
+
+  uv_handle_set_data(to_handle(&m_signal), this);
+  uv_signal_init(&m_loop, &m_signal);
+
+  uv_handle_set_data(to_handle(&m_trace_signal), this);
+  uv_signal_init(&m_loop, &m_trace_signal);
+
+  uv_async_init(&m_loop, &m_stop, on_stop);
+  uv_handle_set_data(to_handle(&m_stop), this);
+
+  m_server = server::create(&m_loop, m_metrics);
+
+  m_http_server = http_server::create(&m_loop, m_metrics);
+}
+
+program::~program()
+{
+  uv_loop_close(&m_loop);
+}
+
+void
+program::add_file(std::string path, std::string content_type, std::vector<std::uint8_t> data)
+{
+  m_http_server->add_file(std::move(path), std::move(content_type), std::move(data));
+}
+
+void
+program::add_telemetry_observer(telemetry_observer* o)
+{
+  m_observers.emplace_back(o);
+}
+
+void
+program::run(const config& cfg)
+{
+  m_http_server->add_file("/config.json", "application/json", cfg.export_dashboard_config());
+
+  m_timing_stamps_enabled = cfg.timing_stamps_enabled;
+
+  auto storage_handler = storage_http_handler::create();
+
+  for (const auto& camera_cfg : cfg.cameras) {
+
+    camera_storage storage;
+
+    if (camera_cfg.storage_enabled) {
+      storage = camera_storage::create(camera_cfg);
+      storage_handler->add_camera(camera_cfg.sensor_id, storage);
+    }
+
+    auto p = video_pipeline::create(camera_cfg, std::move(storage), m_metrics);
+
+    p->set_timing_stamps_enabled(cfg.timing_stamps_enabled);
+
+    auto runner = std::make_unique<pipeline_runner>(&m_loop, std::move(p), "video");
+
+    runner->set_handoff_histogram(add_handoff_histogram(m_metrics, "video", std::to_string(camera_cfg.sensor_id)));
+
+    runner->add_telemetry_observer(this);
+
+    m_pipeline_runners.emplace_back(std::move(runner));
+  }
+
+  std::vector<std::unique_ptr<pipeline>> audio_pipelines;
+
+  for (const auto& microphone_cfg : cfg.microphones) {
+
+    std::shared_ptr<audio_storage> storage;
+
+    if (microphone_cfg.storage_enabled) {
+      storage = audio_storage::create(microphone_cfg);
+      storage_handler->add_microphone(microphone_cfg.sensor_id, storage);
+    }
+
+    auto p = microphone_pipeline::create(microphone_cfg, std::move(storage), m_metrics);
+
+    p->set_timing_stamps_enabled(cfg.timing_stamps_enabled);
+
+    if (cfg.shared_audio_capture) {
+      audio_pipelines.emplace_back(std::move(p));
+      continue;
+    }
+
+    auto runner = std::make_unique<pipeline_runner>(&m_loop, std::move(p), "audio");
+
+    runner->set_handoff_histogram(add_handoff_histogram(m_metrics, "audio", std::to_string(microphone_cfg.sensor_id)));
+
+    runner->add_telemetry_observer(this);
+
+    m_pipeline_runners.emplace_back(std::move(runner));
+  }
+
+  if (!audio_pipelines.empty()) {
+
+    auto group = std::make_unique<capture_group>(&m_loop, std::move(audio_pipelines));
+
+    group->set_handoff_histogram(add_handoff_histogram(m_metrics, "audio", "shared"));
+
+    group->add_telemetry_observer(this);
+
+    m_capture_groups.emplace_back(std::move(group));
+  }
+
+  m_http_server->add_handler(std::move(storage_handler));
+
+  uv_signal_start(&m_signal, on_signal, SIGINT);
+
+  if (cfg.trace_enabled) {
+    tracer::set_enabled(true);
+  }
+
+  m_trace_path = cfg.trace_path;
+
+  uv_signal_start(&m_trace_signal, on_trace_signal, SIGUSR1);
+
+  /* A client that disconnects while a response is being written would otherwise kill the process. The write fails
+   * with EPIPE instead, which closes the client. */
+  std::signal(SIGPIPE, SIG_IGN);
+
+  if (cfg.tcp_server_enabled) {
+    m_server->setup(cfg.server_ip.c_str(), cfg.tcp_server_port);
+  }
+
+  if (cfg.http_server_enabled) {
+    m_http_server->setup(cfg.server_ip.c_str(), cfg.http_server_port);
+  }
+
+  spdlog::info("Starting IO loop.");
+
+  uv_run(&m_loop, UV_RUN_DEFAULT);
+
+  shutdown();
+}
+
+void
+program::stop()
+{
+  uv_async_send(&m_stop);
+}
+
+auto
+program::get_self(uv_handle_t* handle) -> program*
+{
+  return static_cast<program*>(uv_handle_get_data(handle));
+}
+
+void
+program::on_signal(uv_signal_t* signal, int /* signum */)
+{
+  spdlog::info("Caught signal, stopping loop.");
+
+  auto* self = get_self(to_handle(signal));
+
+  uv_stop(&self->m_loop);
+}
+
+void
+program::on_trace_signal(uv_signal_t* signal, int /* signum */)
+{
+  auto* self = get_self(to_handle(signal));
+
+  if (tracer::save(self->m_trace_path)) {
+    spdlog::info("Saved trace to '{}'.", self->m_trace_path);
+  } else {
+    spdlog::error("Failed to save trace to '{}'.", self->m_trace_path);
+  }
+}
+
+void
+program::on_stop(uv_async_t* handle)
+{
+  auto* self = get_self(to_handle(handle));
+
+  uv_stop(&self->m_loop);
+}
+
+void
+program::observe_telemetry(std::shared_ptr<sentinel::proto::outbound_message>& msg)
+{
+  const auto type_index = static_cast<std::size_t>(msg->type);
+
+  if (type_index < m_sequences.size()) {
+
+    msg->sequence = ++m_sequences[type_index];
+
+    if (msg->compressed) {
+      msg->compressed->sequence = msg->sequence;
+    }
+  }
+
+  if (m_timing_stamps_enabled) {
+
+    using sentinel::proto::timing_stamp;
+
+    const auto now = sentinel::get_clock_time();
+
+    sentinel::proto::set_timing_stamp(msg->buffer->data(), msg->buffer->size(), timing_stamp::enqueued, now);
+
+    if (msg->compressed) {
+      auto& buffer = *msg->compressed->buffer;
+      sentinel::proto::set_timing_stamp(buffer.data(), buffer.size(), timing_stamp::enqueued, now);
+    }
+  }
+
+  for (auto* obs : m_observers) {
+    obs->observe_telemetry(msg);
+  }
+
+  m_server->publish_telemetry(msg);
+
+  m_http_server->publish_telemetry(msg);
+}
+
+void
+program::shutdown()
+{
+  m_server->close();
+
+  m_http_server->close();
+
+  uv_signal_stop(&m_signal);
+
+  uv_close(to_handle(&m_signal), nullptr);
+
+  uv_signal_stop(&m_trace_signal);
+
+  uv_close(to_handle(&m_trace_signal), nullptr);
+
+  uv_close(to_handle(&m_stop), nullptr);
+
+  for (auto& r : m_pipeline_runners) {
+    r->close();
+  }
+
+  for (auto& g : m_capture_groups) {
+    g->close();
+  }
+
+  uv_run(&m_loop, UV_RUN_DEFAULT);
+}
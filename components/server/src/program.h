@@ -0,0 +1,115 @@
+#pragma once
+
+#include <uv.h>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include "metrics.h"
+#include "telemetry_observer.h"
+
+class capture_group;
+struct config;
+class http_server;
+class pipeline_runner;
+class server;
+
+/**
+ * @brief Runs the pipelines and servers of a configuration on an IO loop.
+ *
+ * @note This is what the server executable runs, and is also run in-process by the benchmark harness.
+ * */
+class program final : public telemetry_observer
+{
+public:
+  program();
+
+  program(const program&) = delete;
+
+  program(program&&) = delete;
+
+  auto operator=(const program&) -> program& = delete;
+
+  auto operator=(program&&) -> program& = delete;
+
+  ~program() override;
+
+  /**
+   * @brief Adds a file for the HTTP server to serve, such as the files of the dashboard.
+   * */
+  void add_file(std::string path, std::string content_type, std::vector<std::uint8_t> data);
+
+  /**
+   * @brief Adds an observer for the telemetry of every pipeline, which is called on the IO loop.
+   *
+   * @note This must be called before @ref program::run.
+   * */
+  void add_telemetry_observer(telemetry_observer* o);
+
+  /**
+   * @brief Starts the pipelines and servers, and runs the IO loop until an interrupt signal is caught or
+   *        @ref program::stop is called.
+   * */
+  void run(const config& cfg);
+
+  /**
+   * @brief Stops the IO loop, which makes @ref program::run return.
+   *
+   * @note This may be called from any thread.
+   * */
+  void stop();
+
+protected:
+  static auto get_self(uv_handle_t* handle) -> program*;
+
+  static void on_signal(uv_signal_t* signal, int signum);
+
+  static void on_trace_signal(uv_signal_t* signal, int signum);
+
+  static void on_stop(uv_async_t* handle);
+
+  void observe_telemetry(std::shared_ptr<sentinel::proto::outbound_message>& msg) override;
+
+  void shutdown();
+
+private:
+  uv_loop_t m_loop{};
+
+  uv_signal_t m_signal{};
+
+  /**
+   * @brief Saves the trace to @ref m_trace_path on SIGUSR1.
+   * */
+  uv_signal_t m_trace_signal{};
+
+  std::string m_trace_path;
+
+  bool m_timing_stamps_enabled{ false };
+
+  /**
+   * @brief The last sequence number of each message type, which is carried by the version 2 headers so that clients
+   *        can tell when messages were dropped.
+   * */
+  std::array<std::uint32_t, sentinel::proto::message_type_count> m_sequences{};
+
+  uv_async_t m_stop{};
+
+  /**
+   * @brief The timing of the pipelines and client connections, which is served by the HTTP server.
+   * */
+  metrics_registry m_metrics;
+
+  std::unique_ptr<server> m_server;
+
+  std::unique_ptr<http_server> m_http_server;
+
+  std::vector<std::unique_ptr<pipeline_runner>> m_pipeline_runners;
+
+  std::vector<std::unique_ptr<capture_group>> m_capture_groups;
+
+  std::vector<telemetry_observer*> m_observers;
+};
@@ -0,0 +1,352 @@
+#include "microphone_device.h"
+
+#include "wav_header.h"
+
+#include <spdlog/spdlog.h>
+
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <random>
+
+#include <cmath>
+
+namespace {
+
+/**
+ * @brief The most periods that can be waiting to be read before they are dropped, like the buffer of a sound card.
+ * */
+constexpr std::uint64_t max_pending_periods{ 8 };
+
+constexpr float tone_amplitude{ 8000.0f };
+
+constexpr float noise_deviation{ 100.0f };
+
+/**
+ * @brief The time from the start of one burst of the events signal to the next, and the length of each burst.
+ * */
+constexpr float event_interval{ 5.0f };
+
+constexpr float event_duration{ 0.5f };
+
+constexpr float two_pi{ 6.28318530718f };
+
+/**
+ * @brief Produces periods of samples from a source other than a sound card, either at the sampling rate of the source
+ *        or as fast as they are read.
+ *
+ * @details The pacing is done with a timer descriptor, which is what the device is polled with. When the samples are
+ *          produced as fast as possible, an event descriptor that is always readable is polled instead.
+ * */
+class paced_microphone_device : public microphone_device
+{
+public:
+  paced_microphone_device(const std::size_t period_size, const bool realtime, const bool nonblocking)
+    : m_period_size(std::max<std::size_t>(period_size, 1))
+    , m_realtime(realtime)
+    , m_nonblocking(nonblocking)
+  {
+  }
+
+  paced_microphone_device(const paced_microphone_device&) = delete;
+
+  paced_microphone_device(paced_microphone_device&&) = delete;
+
+  auto operator=(const paced_microphone_device&) -> paced_microphone_device& = delete;
+
+  auto operator=(paced_microphone_device&&) -> paced_microphone_device& = delete;
+
+  ~paced_microphone_device() override
+  {
+    if (m_fd >= 0) {
+      ::close(m_fd);
+    }
+  }
+
+  auto is_open() const -> bool override { return m_fd >= 0; }
+
+  auto get_rate() const -> std::uint32_t override { return m_rate; }
+
+  auto get_period_size() const -> std::size_t override { return m_period_size; }
+
+  auto read(std::int16_t* samples) -> std::size_t override
+  {
+    if (!is_open() || m_finished) {
+      return 0;
+    }
+
+    if (m_realtime) {
+
+      if (m_pending == 0) {
+        if (!m_nonblocking) {
+          pollfd fd{ m_fd, POLLIN, 0 };
+          ::poll(&fd, 1, -1);
+        }
+        update_pending();
+      }
+
+      if (m_pending == 0) {
+        return 0;
+      }
+
+      m_pending--;
+    }
+
+    const auto size = fill(samples, m_period_size);
+
+    if (size == 0) {
+      m_finished = true;
+    }
+
+    return size;
+  }
+
+  auto get_overruns() const -> std::uint64_t override { return m_overruns; }
+
+  void get_poll_descriptors(std::vector<pollfd>& fds) override
+  {
+    if (is_open()) {
+      fds.emplace_back(pollfd{ m_fd, POLLIN, 0 });
+    }
+  }
+
+  auto is_ready(pollfd* fds, const std::size_t count) -> bool override
+  {
+    return (count > 0) && ((fds[0].revents & POLLIN) != 0);
+  }
+
+  auto is_finished() const -> bool override { return m_finished; }
+
+protected:
+  /**
+   * @brief Produces the next samples.
+   *
+   * @return The number of samples that were produced, which is zero once the source has run out.
+   * */
+  virtual auto fill(std::int16_t* samples, std::size_t size) -> std::size_t = 0;
+
+  /**
+   * @brief Starts producing periods, once the sampling rate of the source is known.
+   * */
+  void start(const std::uint32_t rate)
+  {
+    m_rate = rate;
+
+    if (!m_realtime) {
+      m_fd = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+      return;
+    }
+
+    m_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (m_fd < 0) {
+      return;
+    }
+
+    const auto period_ns = static_cast<long>((1'000'000'000.0 * static_cast<double>(m_period_size)) / rate);
+
+    itimerspec spec{};
+    spec.it_interval.tv_sec = period_ns / 1'000'000'000;
+    spec.it_interval.tv_nsec = period_ns % 1'000'000'000;
+    spec.it_value = spec.it_interval;
+
+    if (timerfd_settime(m_fd, 0, &spec, nullptr) < 0) {
+      ::close(m_fd);
+      m_fd = -1;
+    }
+  }
+
+  /**
+   * @brief Adds the periods that have elapsed since the last time, and drops the ones that were not read in time.
+   * */
+  void update_pending()
+  {
+    std::uint64_t expirations{};
+
+    if (::read(m_fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+      return;
+    }
+
+    m_pending += expirations;
+
+    if (m_pending > max_pending_periods) {
+      m_pending = max_pending_periods;
+      m_overruns++;
+    }
+  }
+
+private:
+  std::size_t m_period_size{};
+
+  bool m_realtime{ true };
+
+  bool m_nonblocking{ false };
+
+  bool m_finished{ false };
+
+  int m_fd{ -1 };
+
+  std::uint32_t m_rate{};
+
+  /**
+   * @brief The number of periods that are due, but were not read yet.
+   * */
+  std::uint64_t m_pending{};
+
+  std::uint64_t m_overruns{};
+};
+
+class wav_microphone_device final : public paced_microphone_device
+{
+public:
+  wav_microphone_device(const std::string& path,
+                        const std::size_t period_size,
+                        const bool realtime,
+                        const bool loop,
+                        const bool nonblocking)
+    : paced_microphone_device(period_size, realtime, nonblocking)
+    , m_loop(loop)
+  {
+    std::uint32_t rate{};
+
+    if (!read_wav_file(path, rate, m_samples) || m_samples.empty()) {
+      spdlog::error("Failed to read the samples of '{}' to play them back.", path);
+      return;
+    }
+
+    const auto duration = static_cast<double>(m_samples.size()) / static_cast<double>(rate);
+
+    spdlog::info("Playing back {:.1f} seconds of audio from '{}'.", duration, path);
+
+    start(rate);
+  }
+
+protected:
+  auto fill(std::int16_t* samples, const std::size_t size) -> std::size_t override
+  {
+    std::size_t offset{};
+
+    while (offset < size) {
+
+      if (m_position >= m_samples.size()) {
+        if (!m_loop) {
+          break;
+        }
+        m_position = 0;
+      }
+
+      const auto count = std::min(size - offset, m_samples.size() - m_position);
+
+      std::copy(m_samples.begin() + m_position, m_samples.begin() + m_position + count, samples + offset);
+
+      m_position += count;
+
+      offset += count;
+    }
+
+    return offset;
+  }
+
+private:
+  std::vector<std::int16_t> m_samples;
+
+  std::size_t m_position{};
+
+  bool m_loop{ true };
+};
+
+class synthetic_microphone_device final : public paced_microphone_device
+{
+public:
+  synthetic_microphone_device(const microphone_signal signal,
+                              const float frequency,
+                              const unsigned int sampling_rate,
+                              const std::size_t period_size,
+                              const bool realtime,
+                              const bool nonblocking)
+    : paced_microphone_device(period_size, realtime, nonblocking)
+    , m_signal(signal)
+    , m_phase_step(two_pi * frequency / static_cast<float>(sampling_rate))
+    , m_event_interval(static_cast<std::uint64_t>(event_interval * static_cast<float>(sampling_rate)))
+    , m_event_duration(static_cast<std::uint64_t>(event_duration * static_cast<float>(sampling_rate)))
+  {
+    start(sampling_rate);
+  }
+
+protected:
+  auto fill(std::int16_t* samples, const std::size_t size) -> std::size_t override
+  {
+    for (std::size_t i = 0; i < size; i++) {
+      samples[i] = static_cast<std::int16_t>(std::clamp(next_sample(), -32768.0f, 32767.0f));
+    }
+
+    return size;
+  }
+
+  auto next_sample() -> float
+  {
+    const auto tone = std::sin(m_phase);
+
+    /* The phase is wrapped, so that it does not lose precision over a long run. */
+    m_phase = std::fmod(m_phase + m_phase_step, two_pi);
+
+    const auto position = m_position++;
+
+    switch (m_signal) {
+      case microphone_signal::tone:
+        return tone_amplitude * tone;
+      case microphone_signal::noise:
+        break;
+      case microphone_signal::events:
+        if ((position % m_event_interval) < m_event_duration) {
+          return tone_amplitude * tone + m_noise(m_rng) * 20.0f;
+        }
+        break;
+    }
+
+    return m_noise(m_rng);
+  }
+
+private:
+  microphone_signal m_signal{ microphone_signal::tone };
+
+  float m_phase_step{};
+
+  float m_phase{};
+
+  std::uint64_t m_position{};
+
+  std::uint64_t m_event_interval{ 1 };
+
+  std::uint64_t m_event_duration{};
+
+  std::mt19937 m_rng{ 0 };
+
+  std::normal_distribution<float> m_noise{ 0.0f, noise_deviation };
+};
+
+} // namespace
+
+auto
+microphone_device::create_replay(const std::string& path,
+                                 const std::size_t period_size,
+                                 const bool realtime,
+                                 const bool loop,
+                                 const bool nonblocking) -> std::unique_ptr<microphone_device>
+{
+  return std::make_unique<wav_microphone_device>(path, period_size, realtime, loop, nonblocking);
+}
+
+auto
+microphone_device::create_synthetic(const microphone_signal signal,
+                                    const float frequency,
+                                    const unsigned int sampling_rate,
+                                    const std::size_t period_size,
+                                    const bool realtime,
+                                    const bool nonblocking) -> std::unique_ptr<microphone_device>
+{
+  return std::make_unique<synthetic_microphone_device>(
+    signal, frequency, sampling_rate, period_size, realtime, nonblocking);
+}
@@ -0,0 +1,257 @@
+#include "video_device.h"
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include "clock.h"
+#include "image.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#include <cstdint>
+#include <cstdlib>
+
+namespace {
+
+/**
+ * @brief The longest time to wait between two recorded frames. Stored frames may be hours apart (for example, when
+ *        they were only stored around events), which is not worth waiting for.
+ * */
+constexpr std::chrono::microseconds max_frame_gap{ 5'000'000 };
+
+/**
+ * @brief The frame rate to assume for video files that do not have one.
+ * */
+constexpr double default_frame_rate{ 30.0 };
+
+class replay_video_device final : public video_device
+{
+public:
+  replay_video_device(const std::string& path, const bool realtime, const bool loop)
+    : m_path(path)
+    , m_realtime(realtime)
+    , m_loop(loop)
+  {
+  }
+
+  auto open(int, int, int) -> bool override
+  {
+    m_finished = false;
+
+    m_next_frame = 0;
+
+    m_frames.clear();
+
+    if (std::filesystem::is_directory(m_path)) {
+      scan_directory();
+      if (m_frames.empty()) {
+        spdlog::error("No '<timestamp>.jpg' frames were found in '{}' to play back.", m_path);
+        return false;
+      }
+      spdlog::info("Playing back {} frames from '{}'.", m_frames.size(), m_path);
+    } else {
+      if (!m_video.open(m_path, cv::CAP_ANY)) {
+        spdlog::error("Failed to open '{}' to play it back.", m_path);
+        return false;
+      }
+      const auto fps = m_video.get(cv::CAP_PROP_FPS);
+      const auto rate = (fps > 0.0) ? fps : default_frame_rate;
+      m_video_interval = std::chrono::microseconds(static_cast<std::int64_t>(1'000'000.0 / rate));
+      spdlog::info("Playing back '{}' at {} frames per second.", m_path, rate);
+    }
+
+    m_deadline = std::chrono::steady_clock::now();
+
+    return true;
+  }
+
+  auto read_frame() -> std::optional<image> override
+  {
+    if (m_finished) {
+      return std::nullopt;
+    }
+
+    cv::Mat frame;
+
+    std::chrono::microseconds gap{};
+
+    if (!m_frames.empty()) {
+      if (!read_stored_frame(frame, gap)) {
+        return std::nullopt;
+      }
+    } else if (!read_video_frame(frame)) {
+      return std::nullopt;
+    } else {
+      gap = m_video_interval;
+    }
+
+    if (m_realtime) {
+      wait(gap);
+    }
+
+    image img;
+
+    /* The frames are stamped with the time they are played back at, so that they are not mistaken for the originals
+     * when they are stored again. */
+    img.time = sentinel::get_clock_time();
+
+    img.assign(std::move(frame));
+
+    return img;
+  }
+
+  void set_manual_exposure_enabled(bool) override {}
+
+  void set_exposure(float) override {}
+
+  auto get_exposure() const -> float override { return 0.0f; }
+
+  auto is_finished() const -> bool override { return m_finished; }
+
+protected:
+  struct stored_frame final
+  {
+    std::uint64_t time{};
+
+    std::string path;
+  };
+
+  void scan_directory()
+  {
+    std::error_code ec;
+
+    for (const auto& entry : std::filesystem::directory_iterator(m_path, ec)) {
+
+      const auto& p = entry.path();
+
+      if (!entry.is_regular_file() || (p.extension() != ".jpg")) {
+        continue;
+      }
+
+      const auto stem = p.stem().string();
+
+      char* end{ nullptr };
+
+      const auto time = std::strtoull(stem.c_str(), &end, 10);
+
+      if (stem.empty() || (*end != '\0')) {
+        continue;
+      }
+
+      m_frames.emplace_back(stored_frame{ time, p.string() });
+    }
+
+    std::sort(m_frames.begin(), m_frames.end(), [](const stored_frame& a, const stored_frame& b) {
+      return a.time < b.time;
+    });
+  }
+
+  /**
+   * @brief Reads the next stored frame, skipping over the ones that cannot be decoded.
+   *
+   * @param gap Is assigned the time between the recording of this frame and the one before it.
+   * */
+  auto read_stored_frame(cv::Mat& frame, std::chrono::microseconds& gap) -> bool
+  {
+    /* Bounds the number of attempts, in case none of the frames can be decoded. */
+    for (std::size_t attempt = 0; attempt < m_frames.size(); attempt++) {
+
+      if (m_next_frame >= m_frames.size()) {
+        if (!m_loop) {
+          m_finished = true;
+          return false;
+        }
+        m_next_frame = 0;
+      }
+
+      const auto& current = m_frames[m_next_frame];
+
+      gap = (m_next_frame > 0) ? std::chrono::microseconds(current.time - m_frames[m_next_frame - 1].time)
+                               : std::chrono::microseconds(0);
+
+      m_next_frame++;
+
+      frame = cv::imread(current.path, cv::IMREAD_COLOR);
+
+      if (!frame.empty()) {
+        return true;
+      }
+
+      spdlog::warn("Failed to decode stored frame '{}', skipping it.", current.path);
+    }
+
+    m_finished = true;
+
+    return false;
+  }
+
+  auto read_video_frame(cv::Mat& frame) -> bool
+  {
+    if (m_video.read(frame)) {
+      return true;
+    }
+
+    if (m_loop && m_video.set(cv::CAP_PROP_POS_FRAMES, 0) && m_video.read(frame)) {
+      return true;
+    }
+
+    m_finished = true;
+
+    return false;
+  }
+
+  /**
+   * @brief Waits until the frame is due, relative to the one before it.
+   *
+   * @note If playback falls behind (for example, because decoding is slower than the recording), the schedule is
+   *       restarted instead of producing a burst of frames to catch up.
+   * */
+  void wait(const std::chrono::microseconds gap)
+  {
+    const auto now = std::chrono::steady_clock::now();
+
+    m_deadline += std::min(gap, max_frame_gap);
+
+    if (m_deadline < now) {
+      m_deadline = now;
+      return;
+    }
+
+    std::this_thread::sleep_until(m_deadline);
+  }
+
+private:
+  std::string m_path;
+
+  bool m_realtime{ true };
+
+  bool m_loop{ true };
+
+  bool m_finished{ false };
+
+  std::vector<stored_frame> m_frames;
+
+  std::size_t m_next_frame{};
+
+  cv::VideoCapture m_video;
+
+  std::chrono::microseconds m_video_interval{};
+
+  std::chrono::steady_clock::time_point m_deadline;
+};
+
+} // namespace
+
+auto
+video_device::create_replay(const std::string& path, const bool realtime, const bool loop)
+  -> std::unique_ptr<video_device>
+{
+  return std::make_unique<replay_video_device>(path, realtime, loop);
+}
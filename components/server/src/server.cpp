@@ -1,5 +1,6 @@
 #include "server.h"
 
+#include "clock.h"
 #include "image.h"
 
 #include <sentinel/proto.h>
@@ -39,7 +40,8 @@ class client final
 public:
   using close_cb = void (*)(void* data, client* c);
 
-  client(uv_loop_t* loop)
+  client(uv_loop_t* loop, std::shared_ptr<latency_histogram> write_time)
+    : m_write_time(std::move(write_time))
   {
     uv_handle_set_data(to_handle(&m_socket), this);
 
@@ -82,24 +84,35 @@ public:
     auto data = encode_message(img, sensor_id, 0.5f);
 
     write_operation::send(
-      reinterpret_cast<uv_stream_t*>(&m_socket), std::move(*data->buffer), this, on_image_write_complete);
+      reinterpret_cast<uv_stream_t*>(&m_socket), std::move(*data->buffer), this, on_image_write_complete, m_write_time);
 
     m_ready = false;
   }
 
-  void publish_telemetry(std::shared_ptr<sentinel::proto::outbound_message>& msg)
+  void publish_telemetry(const std::shared_ptr<sentinel::proto::outbound_message>& msg)
   {
     if (!m_ready) {
       return;
     }
 
-    /* TODO : remove copy */
+    if (msg->type == sentinel::proto::message_type::microphone_update) {
 
-    std::vector<std::uint8_t> copy = *msg->buffer;
+      if (!m_samples_subscribed) {
+        return;
+      }
+
+      if (m_adpcm_accepted && msg->compressed) {
+        write_operation::send(
+          reinterpret_cast<uv_stream_t*>(&m_socket), msg->compressed->buffer, nullptr, nullptr, m_write_time);
+        return;
+      }
+    }
 
-    write_operation::send(reinterpret_cast<uv_stream_t*>(&m_socket), std::move(copy), nullptr, nullptr);
+    write_operation::send(reinterpret_cast<uv_stream_t*>(&m_socket), msg->buffer, nullptr, nullptr, m_write_time);
   }
 
+  auto get_protocol_version() const -> sentinel::proto::protocol_version { return m_version; }
+
 protected:
   static auto get_self(uv_handle_t* handle) -> client* { return static_cast<client*>(uv_handle_get_data(handle)); }
 
@@ -146,22 +159,82 @@ protected:
 
   void attempt_unpack_message()
   {
-    const auto result = sentinel::proto::read(reinterpret_cast<const std::uint8_t*>(m_read_buffer.data()), m_read_size);
+    /* A client may send several messages at once, such as a protocol request, a subscription and a ready message right
+     * after it connects, so this keeps going until there is no complete message left. */
+    while (true) {
+      const auto result =
+        sentinel::proto::read(reinterpret_cast<const std::uint8_t*>(m_read_buffer.data()), m_read_size);
+
+      if (result.payload_ready) {
+        handle_message(result, reinterpret_cast<const std::uint8_t*>(m_read_buffer.data()) + result.payload_offset);
+      }
 
-    if (result.payload_ready) {
-      handle_message(result);
-    }
+      m_read_size -= result.cull_size;
 
-    m_read_size -= result.cull_size;
+      m_read_buffer.erase(m_read_buffer.begin(), m_read_buffer.begin() + result.cull_size);
 
-    m_read_buffer.erase(m_read_buffer.begin(), m_read_buffer.begin() + result.cull_size);
+      if (!result.payload_ready) {
+        break;
+      }
+    }
   }
 
-  void handle_message(const sentinel::proto::read_result& res)
+  void handle_message(const sentinel::proto::read_result& res, const std::uint8_t* payload)
   {
     if (res.type_id == "ready") {
       m_ready = true;
+    } else if (res.type_id == "protocol") {
+      handle_protocol_request(payload, res.payload_size);
+    } else if (res.type_id == "subscription") {
+      handle_subscription(payload, res.payload_size);
+    }
+  }
+
+  /**
+   * @brief Sets which of the optional messages are sent to the client, like the "pcm" and "adpcm" query parameters of
+   *        the HTTP server.
+   * */
+  void handle_subscription(const std::uint8_t* payload, const std::size_t payload_size)
+  {
+    std::uint32_t flags{};
+
+    if (payload_size < sizeof(flags)) {
+      return;
     }
+
+    std::memcpy(&flags, payload, sizeof(flags));
+
+    m_samples_subscribed = (flags & sentinel::proto::subscription_pcm) != 0;
+
+    m_adpcm_accepted = (flags & sentinel::proto::subscription_adpcm) != 0;
+  }
+
+  /**
+   * @brief Chooses the newest protocol version that both the client and the server support, and tells the client
+   *        which one it is. The reply is the last message that the client receives in the old framing.
+   * */
+  void handle_protocol_request(const std::uint8_t* payload, const std::size_t payload_size)
+  {
+    std::uint32_t requested{};
+
+    if (payload_size < sizeof(requested)) {
+      return;
+    }
+
+    std::memcpy(&requested, payload, sizeof(requested));
+
+    using sentinel::proto::protocol_version;
+
+    const auto chosen = (requested >= static_cast<std::uint32_t>(protocol_version::v2)) ? protocol_version::v2
+                                                                                        : protocol_version::v1;
+
+    auto reply = sentinel::proto::writer::create_protocol_update(chosen);
+
+    write_operation::send(reinterpret_cast<uv_stream_t*>(&m_socket), std::move(*reply->buffer), nullptr, nullptr);
+
+    m_version = chosen;
+
+    spdlog::info("Client is using protocol version {}.", static_cast<std::uint32_t>(chosen));
   }
 
 private:
@@ -177,13 +250,28 @@ private:
 
   bool m_ready{ true };
 
+  sentinel::proto::protocol_version m_version{ sentinel::proto::protocol_version::v1 };
+
+  /**
+   * @brief Whether or not the client asked for the audio samples of the microphones.
+   * */
+  bool m_samples_subscribed{ false };
+
+  /**
+   * @brief Whether or not the client accepts the ADPCM encoding of the audio samples.
+   * */
+  bool m_adpcm_accepted{ false };
+
   float m_anomaly_threshold{ 0 };
+
+  std::shared_ptr<latency_histogram> m_write_time;
 };
 
 class server_impl final : public server
 {
 public:
-  explicit server_impl(uv_loop_t* loop)
+  server_impl(uv_loop_t* loop, metrics_registry& metrics)
+    : m_metrics(metrics)
   {
     uv_handle_set_data(to_handle(&m_socket), this);
 
@@ -214,11 +302,24 @@ public:
       return false;
     }
 
-    spdlog::info("Server is listening for incoming connections at '{}:{}'.", ip, port);
+    spdlog::info("Server is listening for incoming connections at '{}:{}'.", ip, get_port());
 
     return true;
   }
 
+  auto get_port() const -> int override
+  {
+    sockaddr_in address{};
+
+    int size = sizeof(address);
+
+    if (uv_tcp_getsockname(&m_socket, reinterpret_cast<sockaddr*>(&address), &size) != 0) {
+      return 0;
+    }
+
+    return ntohs(address.sin_port);
+  }
+
   void close() override
   {
     if (!uv_is_closing(to_handle(&m_socket))) {
@@ -240,8 +341,44 @@ public:
 
   void publish_telemetry(std::shared_ptr<sentinel::proto::outbound_message>& msg) override
   {
+    if (m_clients.empty()) {
+      return;
+    }
+
+    /* The clients share the buffer of the message instead of each getting a copy, so it is stamped once for all of
+     * them, before any of the writes start. */
+    const auto written_time = sentinel::get_clock_time();
+
+    sentinel::proto::set_timing_stamp(
+      msg->buffer->data(), msg->buffer->size(), sentinel::proto::timing_stamp::written, written_time);
+
+    if (msg->compressed) {
+      sentinel::proto::set_timing_stamp(msg->compressed->buffer->data(),
+                                        msg->compressed->buffer->size(),
+                                        sentinel::proto::timing_stamp::written,
+                                        written_time);
+    }
+
+    /* The version 2 message is only made if a client negotiated it, and then only once for all of those clients. */
+    std::shared_ptr<sentinel::proto::outbound_message> v2;
+
+    auto v2_failed = false;
+
     for (auto& c : m_clients) {
-      c->publish_telemetry(msg);
+
+      if (c->get_protocol_version() == sentinel::proto::protocol_version::v1) {
+        c->publish_telemetry(msg);
+        continue;
+      }
+
+      if (!v2 && !v2_failed) {
+        v2 = sentinel::proto::writer::create_v2(*msg);
+        v2_failed = !v2;
+      }
+
+      if (v2) {
+        c->publish_telemetry(v2);
+      }
     }
   }
 
@@ -260,7 +397,9 @@ protected:
 
     auto* self = get_self(to_handle(server));
 
-    auto c = std::make_unique<client>(uv_handle_get_loop(to_handle(&self->m_socket)));
+    auto write_time = add_write_histogram(self->m_metrics, "tcp", self->m_next_client_id++);
+
+    auto c = std::make_unique<client>(uv_handle_get_loop(to_handle(&self->m_socket)), std::move(write_time));
 
     c->set_close_callback(self, on_client_close);
 
@@ -296,12 +435,16 @@ private:
   std::vector<std::unique_ptr<client>> m_clients;
 
   std::string m_socket_address;
+
+  metrics_registry& m_metrics;
+
+  std::uint64_t m_next_client_id{};
 };
 
 } // namespace
 
 auto
-server::create(uv_loop_t* loop) -> std::unique_ptr<server>
+server::create(uv_loop_t* loop, metrics_registry& metrics) -> std::unique_ptr<server>
 {
-  return std::make_unique<server_impl>(loop);
+  return std::make_unique<server_impl>(loop, metrics);
 }
@@ -8,10 +8,15 @@
 
 struct image;
 
+class metrics_registry;
+
 class server
 {
 public:
-  static auto create(uv_loop_t* loop) -> std::unique_ptr<server>;
+  /**
+   * @param metrics The registry to add the timing of each client connection to.
+   * */
+  static auto create(uv_loop_t* loop, metrics_registry& metrics) -> std::unique_ptr<server>;
 
   server() = default;
 
@@ -29,6 +34,13 @@ public:
 
   virtual auto setup(const char* ip, int port) -> bool = 0;
 
+  /**
+   * @brief Gets the port that the server is listening on, which is chosen by the system if it was set up with zero.
+   *
+   * @return The port, or zero if the server is not listening.
+   * */
+  virtual auto get_port() const -> int = 0;
+
   virtual void publish_telemetry(std::shared_ptr<sentinel::proto::outbound_message>& msg) = 0;
 
   virtual void publish_frame(const image& img, const std::uint32_t sensor_id, const float anomaly_level) = 0;
@@ -0,0 +1,256 @@
+#include "storage_compactor.h"
+
+#include "background_task.h"
+#include "clock.h"
+#include "jpeg_header.h"
+#include "metadata_log.h"
+#include "storage_index.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+/**
+ * @brief The number of index entries to look at, each time the index is queried.
+ * */
+constexpr std::size_t batch_size{ 256 };
+
+/**
+ * @brief The amount of time to wait after all tiers have been compacted, before checking again.
+ * */
+constexpr std::chrono::seconds pass_interval{ 60 };
+
+auto
+seconds_to_usec(const float seconds) -> std::uint64_t
+{
+  return static_cast<std::uint64_t>(std::max(static_cast<double>(seconds), 0.0) * 1000 * 1000);
+}
+
+class storage_compactor_impl final
+  : public storage_compactor
+  , public background_task
+{
+public:
+  storage_compactor_impl(std::shared_ptr<storage_index> index,
+                         std::shared_ptr<metadata_log> metadata,
+                         const std::vector<config::storage_tier_config>& tiers,
+                         const float quality,
+                         const float rate)
+    : background_task(rate)
+    , m_compaction(std::move(index), std::move(metadata), tiers, quality)
+  {
+    start();
+  }
+
+  ~storage_compactor_impl() override { stop(); }
+
+protected:
+  void run() override
+  {
+    const std::function<bool()> throttle = [this]() -> bool { return background_task::throttle(); };
+
+    while (true) {
+
+      if (!m_compaction.run_pass(sentinel::get_clock_time(), throttle)) {
+        return;
+      }
+
+      if (!wait_until(clock_type::now() + pass_interval)) {
+        return;
+      }
+    }
+  }
+
+private:
+  storage_compaction m_compaction;
+};
+
+} // namespace
+
+storage_compaction::storage_compaction(std::shared_ptr<storage_index> index,
+                                       std::shared_ptr<metadata_log> metadata,
+                                       const std::vector<config::storage_tier_config>& tiers,
+                                       const float quality)
+  : m_index(std::move(index))
+  , m_metadata(std::move(metadata))
+  , m_jpeg_quality(std::clamp(static_cast<int>(quality * 100), 0, 100))
+{
+  for (const auto& t : tiers) {
+    m_tiers.emplace_back(tier{ seconds_to_usec(t.age), seconds_to_usec(t.interval), t.width, t.height });
+  }
+
+  auto cmp = [](const tier& l, const tier& r) -> bool { return l.age < r.age; };
+
+  std::sort(m_tiers.begin(), m_tiers.end(), cmp);
+}
+
+auto
+storage_compaction::run_pass(const std::uint64_t now, const std::function<bool()>& throttle) -> bool
+{
+  /* The oldest tier goes first, since it frees up the most space. */
+  for (std::size_t i = m_tiers.size(); i > 0; i--) {
+    if (!compact_tier(i - 1, now, throttle)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+auto
+storage_compaction::compact_tier(const std::size_t tier_index,
+                                 const std::uint64_t now,
+                                 const std::function<bool()>& throttle) -> bool
+{
+  auto& t = m_tiers[tier_index];
+
+  if (now < t.age) {
+    return true;
+  }
+
+  const auto end = now - t.age;
+
+  /* Frames that are old enough for the next tier are handled by that tier instead. */
+  const auto next = tier_index + 1;
+
+  if ((next < m_tiers.size()) && (now >= m_tiers[next].age)) {
+    t.done_until = std::max(t.done_until, now - m_tiers[next].age);
+  }
+
+  while (t.done_until < end) {
+
+    const auto entries = m_index->query(t.done_until, end - 1, 0, batch_size);
+
+    if (entries.empty()) {
+      t.done_until = end;
+      break;
+    }
+
+    for (const auto& e : entries) {
+
+      switch (compact_frame(t, e.time, throttle)) {
+        case frame_result::done:
+          break;
+        case frame_result::deferred:
+          return true;
+        case frame_result::stopped:
+          return false;
+      }
+
+      t.done_until = e.time + 1;
+    }
+  }
+
+  return true;
+}
+
+auto
+storage_compaction::compact_frame(tier& t, const std::uint64_t time, const std::function<bool()>& throttle)
+  -> frame_result
+{
+  const auto too_close = t.last_kept.has_value() && (time < (t.last_kept.value() + t.interval));
+
+  if (too_close) {
+
+    if (!throttle()) {
+      return frame_result::stopped;
+    }
+
+    const auto result = m_index->erase(time);
+
+    if (result == storage_index::change_result::leased) {
+      return frame_result::deferred;
+    }
+
+    if ((result == storage_index::change_result::done) && m_metadata) {
+      m_metadata->update_size(time, 0);
+    }
+
+    return frame_result::done;
+  }
+
+  if ((t.width >= 0) && (t.height >= 0)) {
+
+    if (!throttle()) {
+      return frame_result::stopped;
+    }
+
+    if (!shrink(t, time)) {
+      return frame_result::deferred;
+    }
+  }
+
+  /* This is only set once the frame is done with, so that a deferred frame is not thinned out against itself. */
+  t.last_kept = time;
+
+  return frame_result::done;
+}
+
+auto
+storage_compaction::shrink(const tier& t, const std::uint64_t time) -> bool
+{
+  const auto path = m_index->get_path(time);
+
+  std::uint16_t w{};
+  std::uint16_t h{};
+
+  if (!read_jpeg_size(path, w, h) || ((w <= t.width) && (h <= t.height))) {
+    return true;
+  }
+
+  const auto frame = cv::imread(path, cv::IMREAD_COLOR);
+
+  if (frame.empty()) {
+    return true;
+  }
+
+  cv::Mat small_frame;
+
+  cv::resize(frame, small_frame, cv::Size(t.width, t.height), 0, 0, cv::INTER_AREA);
+
+  std::vector<std::uint8_t> data;
+
+  if (!cv::imencode(".jpg", small_frame, data, { cv::IMWRITE_JPEG_QUALITY, m_jpeg_quality })) {
+    return true;
+  }
+
+  /* The frame is written to a separate file first, so that readers never see a partially written frame. */
+  const auto tmp_path = path + ".tmp";
+
+  std::ofstream file(tmp_path, std::ios::binary);
+
+  file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+  file.close();
+
+  const auto size = static_cast<std::uint32_t>(data.size());
+
+  const auto result = file ? m_index->replace(storage_index::entry{ time, size }, tmp_path)
+                           : storage_index::change_result::failed;
+
+  if (result != storage_index::change_result::done) {
+    std::error_code error;
+    std::filesystem::remove(tmp_path, error);
+    return result != storage_index::change_result::leased;
+  }
+
+  if (m_metadata) {
+    m_metadata->update_size(time, size);
+  }
+
+  return true;
+}
+
+auto
+storage_compactor::create(std::shared_ptr<storage_index> index,
+                          std::shared_ptr<metadata_log> metadata,
+                          std::vector<config::storage_tier_config> tiers,
+                          float quality,
+                          float rate) -> std::unique_ptr<storage_compactor>
+{
+  return std::make_unique<storage_compactor_impl>(std::move(index), std::move(metadata), tiers, quality, rate);
+}
@@ -0,0 +1,151 @@
+#pragma once
+
+#include "config.h"
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+class metadata_log;
+class storage_index;
+
+/**
+ * @brief The work of a storage compactor, done one pass at a time on the calling thread.
+ *
+ * @details Frames that are being read (see @ref storage_index::lease) are not rewritten or deleted. When one is found,
+ *          its tier stops where it is, and carries on from that frame in the next pass.
+ * */
+class storage_compaction final
+{
+public:
+  /**
+   * @brief Constructs a new compaction.
+   *
+   * @param index The index of the frames to compact.
+   *
+   * @param metadata The metadata of the frames, which is kept up to date with the frames. May be null.
+   *
+   * @param tiers The tiers to compact frames into, in any order.
+   *
+   * @param quality The quality to encode shrunk frames at, between zero and one.
+   * */
+  storage_compaction(std::shared_ptr<storage_index> index,
+                     std::shared_ptr<metadata_log> metadata,
+                     const std::vector<config::storage_tier_config>& tiers,
+                     float quality);
+
+  /**
+   * @brief Compacts the frames that have aged into each tier since the last pass.
+   *
+   * @param now The current time, in terms of microseconds since Unix epoch.
+   *
+   * @param throttle Called before each file operation. If it returns false, the pass stops.
+   *
+   * @return False if the pass was stopped by the throttle, true otherwise.
+   * */
+  auto run_pass(std::uint64_t now, const std::function<bool()>& throttle) -> bool;
+
+  /**
+   * @brief Gets the time before which every frame has been compacted into a tier.
+   *
+   * @param tier_index The index of the tier, with the tiers sorted from youngest to oldest.
+   * */
+  auto get_done_until(std::size_t tier_index) const -> std::uint64_t { return m_tiers.at(tier_index).done_until; }
+
+protected:
+  struct tier final
+  {
+    std::uint64_t age{};
+
+    std::uint64_t interval{};
+
+    int width{ -1 };
+
+    int height{ -1 };
+
+    /**
+     * @brief Every frame before this time has already been compacted into this tier.
+     * */
+    std::uint64_t done_until{};
+
+    /**
+     * @brief The time of the last frame that was kept in this tier.
+     * */
+    std::optional<std::uint64_t> last_kept;
+  };
+
+  enum class frame_result
+  {
+    done,
+
+    /**
+     * @brief The frame is being read, so the tier has to wait for the next pass.
+     * */
+    deferred,
+
+    /**
+     * @brief The throttle stopped the pass.
+     * */
+    stopped
+  };
+
+  /**
+   * @return False if the pass was stopped by the throttle, true otherwise.
+   * */
+  auto compact_tier(std::size_t tier_index, std::uint64_t now, const std::function<bool()>& throttle) -> bool;
+
+  auto compact_frame(tier& t, std::uint64_t time, const std::function<bool()>& throttle) -> frame_result;
+
+  /**
+   * @return False if the frame is being read, true otherwise (even if the frame could not be shrunk).
+   * */
+  auto shrink(const tier& t, std::uint64_t time) -> bool;
+
+private:
+  std::shared_ptr<storage_index> m_index;
+
+  std::shared_ptr<metadata_log> m_metadata;
+
+  std::vector<tier> m_tiers;
+
+  const int m_jpeg_quality{};
+};
+
+/**
+ * @brief Thins out (and optionally shrinks) stored frames as they get older, according to a set of age tiers.
+ *
+ * @details Compaction runs on a background thread with a low CPU and IO priority. It works through the index
+ *          incrementally, remembering how far each tier has gotten, and limits the number of file operations per second
+ *          so that it does not compete with capture for the disk.
+ * */
+class storage_compactor
+{
+public:
+  /**
+   * @brief Creates a new compactor, which starts running immediately.
+   *
+   * @param index The index of the frames to compact.
+   *
+   * @param metadata The metadata of the frames, which is kept up to date with the frames. May be null.
+   *
+   * @param tiers The tiers to compact frames into, in any order.
+   *
+   * @param quality The quality to encode shrunk frames at, between zero and one.
+   *
+   * @param rate The maximum number of file operations per second.
+   * */
+  static auto create(std::shared_ptr<storage_index> index,
+                     std::shared_ptr<metadata_log> metadata,
+                     std::vector<config::storage_tier_config> tiers,
+                     float quality,
+                     float rate) -> std::unique_ptr<storage_compactor>;
+
+  /**
+   * @brief Stops compaction, waiting for the current file operation to finish.
+   * */
+  virtual ~storage_compactor() = default;
+};
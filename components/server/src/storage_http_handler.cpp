@@ -0,0 +1,661 @@
+#include "storage_http_handler.h"
+
+#include "audio_storage.h"
+#include "avi_clip.h"
+#include "metadata_log.h"
+#include "storage_index.h"
+#include "thumbnail_store.h"
+#include "wav_header.h"
+
+#include <sentinel/proto.h>
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <optional>
+
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+/**
+ * @brief The maximum number of frames that may be requested at once.
+ * */
+constexpr std::uint64_t max_frame_limit{ 100000 };
+
+/**
+ * @brief The maximum number of bytes to send from a thumbnail segment at once.
+ * */
+constexpr std::uint64_t max_thumbnail_run{ 4 * 1024 * 1024 };
+
+/**
+ * @brief The maximum number of bytes to send from an audio segment at once.
+ * */
+constexpr std::uint64_t max_audio_run{ 4 * 1024 * 1024 };
+
+struct storage_path final
+{
+  std::uint32_t sensor_id{};
+
+  std::string resource;
+};
+
+/**
+ * @brief Parses paths of the form "/api/storage/<sensor_id>/<resource>".
+ * */
+auto
+parse_storage_path(const std::string& path) -> std::optional<storage_path>
+{
+  const std::string prefix{ "/api/storage/" };
+
+  if (path.compare(0, prefix.size(), prefix) != 0) {
+    return std::nullopt;
+  }
+
+  const auto id_begin = prefix.size();
+
+  const auto id_end = path.find('/', id_begin);
+
+  if ((id_end == std::string::npos) || (id_end == id_begin)) {
+    return std::nullopt;
+  }
+
+  const auto id_str = path.substr(id_begin, id_end - id_begin);
+
+  char* end{ nullptr };
+
+  const auto id = std::strtoul(id_str.c_str(), &end, 10);
+
+  if ((end == nullptr) || (*end != 0) || (id > std::numeric_limits<std::uint32_t>::max())) {
+    return std::nullopt;
+  }
+
+  return storage_path{ static_cast<std::uint32_t>(id), path.substr(id_end + 1) };
+}
+
+struct range_query final
+{
+  std::uint64_t from{};
+
+  std::uint64_t to{};
+
+  std::uint64_t step{};
+
+  std::uint64_t limit{};
+};
+
+auto
+parse_range_query(const http_request& req, range_query& q, const std::uint64_t default_limit = 1000) -> bool
+{
+  if (!req.get_u64("from", 0, q.from) || !req.get_u64("to", std::numeric_limits<std::uint64_t>::max(), q.to) ||
+      !req.get_u64("step", 0, q.step) || !req.get_u64("limit", default_limit, q.limit)) {
+    return false;
+  }
+
+  return (q.from <= q.to) && (q.limit <= max_frame_limit);
+}
+
+/**
+ * @brief Streams stored frames as a series of camera update messages.
+ * */
+class frame_body final : public http_body
+{
+public:
+  frame_body(std::shared_ptr<storage_index> index,
+             std::shared_ptr<void> lease,
+             const std::uint32_t sensor_id,
+             std::vector<storage_index::entry> entries)
+    : m_index(std::move(index))
+    , m_lease(std::move(lease))
+    , m_sensor_id(sensor_id)
+    , m_entries(std::move(entries))
+  {
+    const auto prefix_size = sentinel::proto::writer::create_rgb_camera_update_prefix(0, 0, 0).size();
+
+    for (const auto& e : m_entries) {
+      m_size += prefix_size + e.size;
+    }
+  }
+
+  auto get_size() const -> std::size_t override { return m_size; }
+
+  auto next(http_body_chunk& chunk) -> bool override
+  {
+    if (m_next >= m_entries.size()) {
+      return false;
+    }
+
+    const auto& e = m_entries[m_next];
+
+    chunk.data = sentinel::proto::writer::create_rgb_camera_update_prefix(e.size, e.time, m_sensor_id);
+    chunk.file_path = m_index->get_path(e.time);
+    chunk.file_offset = 0;
+    chunk.file_size = e.size;
+
+    m_next++;
+
+    return true;
+  }
+
+private:
+  std::shared_ptr<storage_index> m_index;
+
+  /**
+   * @brief Keeps the frames from being compacted while they are sent.
+   * */
+  std::shared_ptr<void> m_lease;
+
+  std::uint32_t m_sensor_id{};
+
+  std::vector<storage_index::entry> m_entries;
+
+  std::size_t m_next{};
+
+  std::size_t m_size{};
+};
+
+/**
+ * @brief Streams thumbnails straight out of their segment files.
+ *
+ * @details Since the segment files already consist of camera update messages, thumbnails that are next to each other
+ *          in a segment file are sent as a single region of the file.
+ * */
+class thumbnail_body final : public http_body
+{
+public:
+  thumbnail_body(std::shared_ptr<thumbnail_store> store, std::vector<thumbnail_store::entry> entries)
+    : m_store(std::move(store))
+    , m_entries(std::move(entries))
+  {
+    for (const auto& e : m_entries) {
+      m_size += e.size;
+    }
+  }
+
+  auto get_size() const -> std::size_t override { return m_size; }
+
+  auto next(http_body_chunk& chunk) -> bool override
+  {
+    if (m_next >= m_entries.size()) {
+      return false;
+    }
+
+    const auto& first = m_entries[m_next];
+
+    std::uint64_t run_size = first.size;
+
+    m_next++;
+
+    while (m_next < m_entries.size()) {
+
+      const auto& e = m_entries[m_next];
+
+      const auto adjacent = (e.segment == first.segment) && (e.offset == (first.offset + run_size));
+
+      if (!adjacent || ((run_size + e.size) > max_thumbnail_run)) {
+        break;
+      }
+
+      run_size += e.size;
+
+      m_next++;
+    }
+
+    chunk.file_path = m_store->get_segment_path(first.segment);
+    chunk.file_offset = first.offset;
+    chunk.file_size = static_cast<std::size_t>(run_size);
+
+    return true;
+  }
+
+private:
+  std::shared_ptr<thumbnail_store> m_store;
+
+  std::vector<thumbnail_store::entry> m_entries;
+
+  std::size_t m_next{};
+
+  std::size_t m_size{};
+};
+
+/**
+ * @brief Streams stored audio as a WAV file, straight out of the segment files.
+ * */
+class audio_body final : public http_body
+{
+public:
+  audio_body(std::shared_ptr<audio_storage> storage, std::vector<audio_storage::region> regions, std::uint32_t rate)
+    : m_storage(std::move(storage))
+    , m_regions(std::move(regions))
+  {
+    std::uint64_t data_size{};
+
+    for (const auto& r : m_regions) {
+      data_size += r.size;
+    }
+
+    const auto header = make_wav_header(rate, static_cast<std::uint32_t>(data_size));
+
+    m_header.assign(header.begin(), header.end());
+
+    m_size = static_cast<std::size_t>(wav_header_size + data_size);
+  }
+
+  auto get_size() const -> std::size_t override { return m_size; }
+
+  auto next(http_body_chunk& chunk) -> bool override
+  {
+    const auto first = !m_header_sent;
+
+    m_header_sent = true;
+
+    chunk.data.clear();
+
+    if (first) {
+      chunk.data = m_header;
+    }
+
+    chunk.file_path.clear();
+    chunk.file_offset = 0;
+    chunk.file_size = 0;
+
+    if (m_next >= m_regions.size()) {
+      return first;
+    }
+
+    auto& r = m_regions[m_next];
+
+    const auto run_size = std::min(r.size, max_audio_run);
+
+    chunk.file_path = m_storage->get_segment_path(r.segment);
+    chunk.file_offset = r.offset;
+    chunk.file_size = static_cast<std::size_t>(run_size);
+
+    r.offset += run_size;
+    r.size -= run_size;
+
+    if (r.size == 0) {
+      m_next++;
+    }
+
+    return true;
+  }
+
+private:
+  std::shared_ptr<audio_storage> m_storage;
+
+  std::vector<audio_storage::region> m_regions;
+
+  std::vector<std::uint8_t> m_header;
+
+  bool m_header_sent{ false };
+
+  std::size_t m_next{};
+
+  std::size_t m_size{};
+};
+
+/**
+ * @brief Queries the metadata log in the thread pool, since the query reads from disk, and sends the rows as JSON.
+ * */
+class events_body final : public http_body
+{
+public:
+  events_body(std::shared_ptr<metadata_log> metadata, const metadata_log::predicate& p, const std::size_t max_rows)
+    : m_metadata(std::move(metadata))
+    , m_predicate(p)
+    , m_max_rows(max_rows)
+  {
+  }
+
+  void prepare() override
+  {
+    const auto rows = m_metadata->query(m_predicate, m_max_rows);
+
+    auto to_json = [](const float score) -> nlohmann::json {
+      return std::isnan(score) ? nlohmann::json(nullptr) : nlohmann::json(score);
+    };
+
+    auto frames = nlohmann::json::array();
+
+    for (const auto& r : rows) {
+      nlohmann::json frame;
+      frame["time"] = r.time;
+      frame["filter_score"] = to_json(r.filter_score);
+      frame["anomaly_score"] = to_json(r.anomaly_score);
+      frame["detections"] = r.detections;
+      frame["size"] = r.size;
+      frames.emplace_back(std::move(frame));
+    }
+
+    nlohmann::json root;
+
+    root["frames"] = std::move(frames);
+
+    const auto content = root.dump();
+
+    m_content.assign(content.begin(), content.end());
+  }
+
+  auto get_size() const -> std::size_t override { return m_content.size(); }
+
+  auto next(http_body_chunk& chunk) -> bool override
+  {
+    if (m_sent) {
+      return false;
+    }
+
+    chunk.data = std::move(m_content);
+
+    m_sent = true;
+
+    return true;
+  }
+
+private:
+  std::shared_ptr<metadata_log> m_metadata;
+
+  metadata_log::predicate m_predicate;
+
+  std::size_t m_max_rows{};
+
+  std::vector<std::uint8_t> m_content;
+
+  bool m_sent{ false };
+};
+
+class storage_http_handler_impl final : public storage_http_handler
+{
+public:
+  void add_camera(const std::uint32_t sensor_id, camera_storage storage) override
+  {
+    m_cameras[sensor_id] = std::move(storage);
+  }
+
+  void add_microphone(const std::uint32_t sensor_id, std::shared_ptr<audio_storage> storage) override
+  {
+    m_microphones[sensor_id] = std::move(storage);
+  }
+
+  auto handle_get(const http_request& req, http_response& res) -> bool override
+  {
+    const auto path = parse_storage_path(req.path);
+    if (!path) {
+      return false;
+    }
+
+    auto mic_it = m_microphones.find(path->sensor_id);
+    if ((mic_it != m_microphones.end()) && (path->resource == "audio")) {
+      get_audio(mic_it->second, req, res);
+      return true;
+    }
+
+    auto it = m_cameras.find(path->sensor_id);
+    if (it == m_cameras.end()) {
+      res.status = 404;
+      return true;
+    }
+
+    const auto& storage = it->second;
+
+    if (path->resource == "frames") {
+      get_frames(path->sensor_id, storage.index, req, res);
+    } else if (path->resource == "timestamps") {
+      get_timestamps(storage.index, req, res);
+    } else if (path->resource == "clip") {
+      get_clip(storage.index, req, res);
+    } else if (path->resource == "thumbnails") {
+      get_thumbnails(storage.thumbnails, req, res);
+    } else if (path->resource == "timelapse") {
+      get_timelapse(storage.timelapse, req, res);
+    } else if (path->resource == "events") {
+      get_events(storage.metadata, req, res);
+    } else {
+      res.status = 404;
+    }
+
+    return true;
+  }
+
+protected:
+  static void get_frames(const std::uint32_t sensor_id,
+                         const std::shared_ptr<storage_index>& index,
+                         const http_request& req,
+                         http_response& res)
+  {
+    range_query q;
+
+    if (!parse_range_query(req, q)) {
+      res.status = 400;
+      return;
+    }
+
+    /* The lease goes first, so that the sizes in the query stay valid while the frames are sent. */
+    auto lease = index->lease(q.from, q.to);
+
+    auto entries = index->query(q.from, q.to, q.step, static_cast<std::size_t>(q.limit));
+
+    res.status = 200;
+    res.content_type = "application/octet-stream";
+    res.body = std::make_unique<frame_body>(index, std::move(lease), sensor_id, std::move(entries));
+  }
+
+  static void get_clip(const std::shared_ptr<storage_index>& index, const http_request& req, http_response& res)
+  {
+    range_query q;
+
+    if (!parse_range_query(req, q, max_frame_limit)) {
+      res.status = 400;
+      return;
+    }
+
+    auto lease = index->lease(q.from, q.to);
+
+    auto entries = index->query(q.from, q.to, q.step, static_cast<std::size_t>(q.limit));
+
+    auto clip = std::make_unique<avi_clip>(index, std::move(entries), std::move(lease));
+
+    if (clip->get_file_size() > avi_clip::max_size) {
+      res.status = 413;
+      return;
+    }
+
+    res.status = 200;
+    res.content_type = "video/x-msvideo";
+    res.body = std::move(clip);
+  }
+
+  static void get_thumbnails(const std::vector<std::shared_ptr<thumbnail_store>>& thumbnails,
+                             const http_request& req,
+                             http_response& res)
+  {
+    range_query q;
+
+    std::uint64_t level{};
+
+    if (!parse_range_query(req, q) || !req.get_u64("level", 0, level)) {
+      res.status = 400;
+      return;
+    }
+
+    if (level >= thumbnails.size()) {
+      res.status = 404;
+      return;
+    }
+
+    const auto& store = thumbnails[static_cast<std::size_t>(level)];
+
+    auto entries = store->query(q.from, q.to, q.step, static_cast<std::size_t>(q.limit));
+
+    res.status = 200;
+    res.content_type = "application/octet-stream";
+    res.body = std::make_unique<thumbnail_body>(store, std::move(entries));
+  }
+
+  static void get_timelapse(const std::shared_ptr<thumbnail_store>& timelapse,
+                            const http_request& req,
+                            http_response& res)
+  {
+    if (!timelapse) {
+      res.status = 404;
+      return;
+    }
+
+    range_query q;
+
+    if (!parse_range_query(req, q, max_frame_limit)) {
+      res.status = 400;
+      return;
+    }
+
+    auto entries = timelapse->query(q.from, q.to, q.step, static_cast<std::size_t>(q.limit));
+
+    res.status = 200;
+    res.content_type = "application/octet-stream";
+    res.body = std::make_unique<thumbnail_body>(timelapse, std::move(entries));
+  }
+
+  static void get_timestamps(const std::shared_ptr<storage_index>& index, const http_request& req, http_response& res)
+  {
+    range_query q;
+
+    if (!parse_range_query(req, q)) {
+      res.status = 400;
+      return;
+    }
+
+    const auto entries = index->query(q.from, q.to, q.step, static_cast<std::size_t>(q.limit));
+
+    auto frames = nlohmann::json::array();
+
+    for (const auto& e : entries) {
+      nlohmann::json frame;
+      frame["time"] = e.time;
+      frame["size"] = e.size;
+      frames.emplace_back(std::move(frame));
+    }
+
+    nlohmann::json root;
+
+    root["frames"] = std::move(frames);
+
+    res = http_response::from_string(200, "application/json", root.dump());
+  }
+
+  static void get_events(const std::shared_ptr<metadata_log>& metadata, const http_request& req, http_response& res)
+  {
+    if (!metadata) {
+      res.status = 404;
+      return;
+    }
+
+    range_query q;
+
+    const auto nan = std::numeric_limits<float>::quiet_NaN();
+
+    float min_filter_score{};
+
+    float min_anomaly_score{};
+
+    std::uint64_t min_detections{};
+
+    if (!parse_range_query(req, q) || !req.get_float("min_filter_score", nan, min_filter_score) ||
+        !req.get_float("min_anomaly_score", nan, min_anomaly_score) ||
+        !req.get_u64("min_detections", 0, min_detections) ||
+        (min_detections > std::numeric_limits<std::uint16_t>::max())) {
+      res.status = 400;
+      return;
+    }
+
+    metadata_log::predicate p;
+
+    p.from = q.from;
+
+    p.to = q.to;
+
+    if (!std::isnan(min_filter_score)) {
+      p.min_filter_score = min_filter_score;
+    }
+
+    if (!std::isnan(min_anomaly_score)) {
+      p.min_anomaly_score = min_anomaly_score;
+    }
+
+    if (min_detections > 0) {
+      p.min_detections = static_cast<std::uint16_t>(min_detections);
+    }
+
+    res.status = 200;
+    res.content_type = "application/json";
+    res.body = std::make_unique<events_body>(metadata, p, static_cast<std::size_t>(q.limit));
+  }
+
+  static void get_audio(const std::shared_ptr<audio_storage>& storage, const http_request& req, http_response& res)
+  {
+    std::uint64_t from{};
+
+    std::uint64_t to{};
+
+    if (!req.get_u64("from", 0, from) || !req.get_u64("to", std::numeric_limits<std::uint64_t>::max(), to) ||
+        (from > to)) {
+      res.status = 400;
+      return;
+    }
+
+    auto regions = storage->query(from, to);
+
+    const auto rate = regions.empty() ? 0 : regions.front().rate;
+
+    std::string extra_fields;
+
+    if (!regions.empty()) {
+      extra_fields += "X-Audio-Time: " + std::to_string(regions.front().time) + "\r\n";
+    }
+
+    /* A WAV file has no way of describing gaps, so only the first run of audio without gaps is sent. The client can
+     * request the rest of the time range starting from where the next run begins. */
+    std::size_t run_length = regions.empty() ? 0 : 1;
+
+    while ((run_length < regions.size()) && regions[run_length].follows(regions[run_length - 1])) {
+      run_length++;
+    }
+
+    if (run_length < regions.size()) {
+      extra_fields += "X-Next-Audio-Time: " + std::to_string(regions[run_length].time) + "\r\n";
+      regions.resize(run_length);
+    }
+
+    std::uint64_t data_size{};
+
+    for (const auto& r : regions) {
+      data_size += r.size;
+    }
+
+    /* The sizes in a WAV header are 32-bit. */
+    if ((data_size + wav_header_size) > std::numeric_limits<std::uint32_t>::max()) {
+      res.status = 413;
+      return;
+    }
+
+    res.status = 200;
+    res.content_type = "audio/wav";
+    res.extra_fields = std::move(extra_fields);
+    res.body = std::make_unique<audio_body>(storage, std::move(regions), rate);
+  }
+
+private:
+  std::map<std::uint32_t, camera_storage> m_cameras;
+
+  std::map<std::uint32_t, std::shared_ptr<audio_storage>> m_microphones;
+};
+
+} // namespace
+
+auto
+storage_http_handler::create() -> std::unique_ptr<storage_http_handler>
+{
+  return std::make_unique<storage_http_handler_impl>();
+}
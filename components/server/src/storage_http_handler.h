@@ -0,0 +1,79 @@
+#pragma once
+
+#include "camera_storage.h"
+#include "http_handler.h"
+
+#include <memory>
+
+#include <cstdint>
+
+class audio_storage;
+
+/**
+ * @brief Serves the frames that cameras have put into storage.
+ *
+ * @details The following endpoints are served, where the times are in microseconds since Unix epoch:
+ *
+ *   /api/storage/<sensor_id>/frames?from=<time>&to=<time>&step=<time>&limit=<count>
+ *
+ *     Responds with one "rgb_camera::update" message per frame, which can be decoded with the protocol library. The JPEG
+ *     data is sent straight from the stored files, without being decoded or re-encoded.
+ *
+ *   /api/storage/<sensor_id>/timestamps?from=<time>&to=<time>&step=<time>&limit=<count>
+ *
+ *     Responds with a JSON document that lists the time and size of each frame, without the frame data.
+ *
+ *   /api/storage/<sensor_id>/clip?from=<time>&to=<time>&step=<time>&limit=<count>
+ *
+ *     Responds with a Motion JPEG AVI file made from the stored JPEG data, which starts streaming immediately.
+ *
+ *   /api/storage/<sensor_id>/thumbnails?from=<time>&to=<time>&step=<time>&limit=<count>&level=<index>
+ *
+ *     Responds with one "rgb_camera::update" message per thumbnail, the same way as the frames endpoint. The level is the
+ *     index of the thumbnail size, where zero is the largest.
+ *
+ *   /api/storage/<sensor_id>/timelapse?from=<time>&to=<time>&step=<time>&limit=<count>
+ *
+ *     Responds with one "rgb_camera::update" message per timelapse frame, the same way as the frames endpoint. Since a
+ *     day of timelapse is kept in a single file, this is usually a single sequential read.
+ *
+ *   /api/storage/<sensor_id>/events?from=<time>&to=<time>&limit=<count>&min_filter_score=<score>
+ *                                   &min_anomaly_score=<score>&min_detections=<count>
+ *
+ *     Responds with a JSON document that lists the metadata of each stored frame that matches every given minimum.
+ *     Scores that were not computed for a frame are null. Only the metadata log is read, so this is much faster than
+ *     going through the frames.
+ *
+ *   /api/storage/<sensor_id>/audio?from=<time>&to=<time>
+ *
+ *     Responds with a WAV file of the audio that a microphone has stored within the time range, which is sent straight
+ *     from the stored files. Only the first run of audio without gaps (or changes in the sampling rate) is included.
+ *     The "X-Audio-Time" header field holds the time of its first sample. If there is more audio in the time range
+ *     after a gap, the "X-Next-Audio-Time" header field holds the time that it starts at, which can be used as the
+ *     "from" parameter of the next request.
+ * */
+class storage_http_handler : public http_handler
+{
+public:
+  static auto create() -> std::unique_ptr<storage_http_handler>;
+
+  ~storage_http_handler() override = default;
+
+  /**
+   * @brief Makes the stored frames of a camera available.
+   *
+   * @param sensor_id The ID of the camera.
+   *
+   * @param storage The storage that the camera puts its frames into.
+   * */
+  virtual void add_camera(std::uint32_t sensor_id, camera_storage storage) = 0;
+
+  /**
+   * @brief Makes the stored audio of a microphone available.
+   *
+   * @param sensor_id The ID of the microphone.
+   *
+   * @param storage The storage that the microphone puts its audio into.
+   * */
+  virtual void add_microphone(std::uint32_t sensor_id, std::shared_ptr<audio_storage> storage) = 0;
+};
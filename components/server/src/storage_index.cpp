@@ -0,0 +1,267 @@
+#include "storage_index.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+
+namespace {
+
+auto
+time_less(const storage_index::entry& e, const std::uint64_t time) -> bool
+{
+  return e.time < time;
+}
+
+} // namespace
+
+storage_index::storage_index(std::string directory)
+  : m_directory(std::move(directory))
+{
+}
+
+auto
+storage_index::get_path(const std::uint64_t time) const -> std::string
+{
+  std::ostringstream path_stream;
+
+  if (!m_directory.empty()) {
+    path_stream << m_directory << '/';
+  }
+
+  path_stream << time;
+
+  path_stream << ".jpg";
+
+  return path_stream.str();
+}
+
+void
+storage_index::scan()
+{
+  std::deque<entry> entries;
+
+  for (const auto& dir_entry : std::filesystem::directory_iterator(m_directory)) {
+
+    const auto entry_path = dir_entry.path();
+
+    if (entry_path.extension().string() != ".jpg") {
+      continue;
+    }
+
+    std::istringstream in_stream(entry_path.stem().string());
+
+    std::uint64_t timestamp{};
+
+    if (!(in_stream >> timestamp)) {
+      continue;
+    }
+
+    entries.emplace_back(entry{ timestamp, static_cast<std::uint32_t>(dir_entry.file_size()) });
+  }
+
+  auto cmp = [](const entry& l, const entry& r) -> bool { return l.time < r.time; };
+
+  std::sort(entries.begin(), entries.end(), cmp);
+
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  m_entries = std::move(entries);
+}
+
+void
+storage_index::add(const entry& e)
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  if (m_entries.empty() || (m_entries.back().time < e.time)) {
+    m_entries.emplace_back(e);
+    return;
+  }
+
+  auto it = std::lower_bound(m_entries.begin(), m_entries.end(), e.time, time_less);
+
+  if ((it != m_entries.end()) && (it->time == e.time)) {
+    *it = e;
+    return;
+  }
+
+  m_entries.insert(it, e);
+}
+
+auto
+storage_index::update(const entry& e) -> bool
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  auto it = std::lower_bound(m_entries.begin(), m_entries.end(), e.time, time_less);
+
+  if ((it == m_entries.end()) || (it->time != e.time)) {
+    return false;
+  }
+
+  *it = e;
+
+  return true;
+}
+
+auto
+storage_index::remove(const std::uint64_t time) -> bool
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  auto it = std::lower_bound(m_entries.begin(), m_entries.end(), time, time_less);
+
+  if ((it == m_entries.end()) || (it->time != time)) {
+    return false;
+  }
+
+  m_entries.erase(it);
+
+  return true;
+}
+
+auto
+storage_index::remove_before(const std::uint64_t time) -> std::vector<entry>
+{
+  std::vector<entry> removed;
+
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  /* The frames are removed oldest first, so retention stops at a leased frame instead of skipping over it. */
+  while (!m_entries.empty() && (m_entries.front().time < time) && !is_leased(m_entries.front().time)) {
+    removed.emplace_back(m_entries.front());
+    m_entries.pop_front();
+  }
+
+  return removed;
+}
+
+auto
+storage_index::lease(const std::uint64_t from, const std::uint64_t to) -> std::shared_ptr<void>
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  const auto id = m_next_lease_id++;
+
+  m_leases.emplace(id, std::make_pair(from, to));
+
+  return std::shared_ptr<void>(nullptr, [this, id](void*) { release(id); });
+}
+
+void
+storage_index::release(const std::uint64_t lease_id)
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  m_leases.erase(lease_id);
+}
+
+auto
+storage_index::is_leased(const std::uint64_t time) const -> bool
+{
+  for (const auto& l : m_leases) {
+    if ((l.second.first <= time) && (time <= l.second.second)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+auto
+storage_index::replace(const entry& e, const std::string& replacement_path) -> change_result
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  auto it = std::lower_bound(m_entries.begin(), m_entries.end(), e.time, time_less);
+
+  if ((it == m_entries.end()) || (it->time != e.time)) {
+    return change_result::missing;
+  }
+
+  if (is_leased(e.time)) {
+    return change_result::leased;
+  }
+
+  /* The rename happens under the lock, so that a reader cannot take a lease and query the old size in between. */
+  std::error_code error;
+
+  std::filesystem::rename(replacement_path, get_path(e.time), error);
+
+  if (error) {
+    return change_result::failed;
+  }
+
+  *it = e;
+
+  return change_result::done;
+}
+
+auto
+storage_index::erase(const std::uint64_t time) -> change_result
+{
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    auto it = std::lower_bound(m_entries.begin(), m_entries.end(), time, time_less);
+
+    if ((it == m_entries.end()) || (it->time != time)) {
+      return change_result::missing;
+    }
+
+    if (is_leased(time)) {
+      return change_result::leased;
+    }
+
+    m_entries.erase(it);
+  }
+
+  /* Once the frame is out of the index, no new reader can find it, so the file is deleted without the lock. */
+  std::error_code error;
+
+  std::filesystem::remove(get_path(time), error);
+
+  return change_result::done;
+}
+
+auto
+storage_index::query(const std::uint64_t from,
+                     const std::uint64_t to,
+                     const std::uint64_t step,
+                     const std::size_t max_entries) const -> std::vector<entry>
+{
+  std::vector<entry> result;
+
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  auto it = std::lower_bound(m_entries.begin(), m_entries.end(), from, time_less);
+
+  while ((it != m_entries.end()) && (it->time <= to) && (result.size() < max_entries)) {
+
+    result.emplace_back(*it);
+
+    if (step == 0) {
+      ++it;
+      continue;
+    }
+
+    const auto next_time = it->time + step;
+
+    if (next_time < it->time) {
+      break;
+    }
+
+    /* Skip ahead with a binary search rather than visiting every frame in between. */
+    it = std::lower_bound(it + 1, m_entries.end(), next_time, time_less);
+  }
+
+  return result;
+}
+
+auto
+storage_index::size() const -> std::size_t
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  return m_entries.size();
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Keeps track of the frames that a camera has put into storage, sorted by the time they were taken at.
+ *
+ * @note This class is thread safe. It is written to by the pipeline thread and queried from the IO loop.
+ * */
+class storage_index final
+{
+public:
+  struct entry final
+  {
+    /**
+     * @brief The time the frame was taken at, in terms of microseconds since Unix epoch.
+     * */
+    std::uint64_t time{};
+
+    /**
+     * @brief The number of bytes in the frame file.
+     * */
+    std::uint32_t size{};
+  };
+
+  /**
+   * @brief The outcome of changing a frame that may be in use.
+   * */
+  enum class change_result
+  {
+    /**
+     * @brief The frame was changed.
+     * */
+    done,
+
+    /**
+     * @brief The frame is not in the index.
+     * */
+    missing,
+
+    /**
+     * @brief The frame is being read, so it was left as it is.
+     * */
+    leased,
+
+    /**
+     * @brief The file of the frame could not be changed.
+     * */
+    failed
+  };
+
+  /**
+   * @brief Constructs a new storage index.
+   *
+   * @param directory The directory that the frames are stored in.
+   * */
+  explicit storage_index(std::string directory);
+
+  auto get_directory() const -> const std::string& { return m_directory; }
+
+  /**
+   * @brief Gets the path of the file that contains the frame taken at a certain time.
+   * */
+  auto get_path(std::uint64_t time) const -> std::string;
+
+  /**
+   * @brief Replaces the contents of the index with the frames that exist in the storage directory.
+   * */
+  void scan();
+
+  /**
+   * @brief Adds a frame to the index.
+   *
+   * @note Frames are expected to be added in chronological order, but out of order frames are still sorted.
+   * */
+  void add(const entry& e);
+
+  /**
+   * @brief Changes the size of a frame that is already in the index, such as after it was rewritten.
+   *
+   * @return True if the frame was in the index, false otherwise.
+   * */
+  auto update(const entry& e) -> bool;
+
+  /**
+   * @brief Removes a frame from the index.
+   *
+   * @return True if the frame was in the index, false otherwise.
+   * */
+  auto remove(std::uint64_t time) -> bool;
+
+  /**
+   * @brief Removes all frames that were taken before a certain time, up to the first frame that is leased.
+   *
+   * @details The leased frame and the ones after it are left in the index, so that a later call removes them once the
+   *          lease is released.
+   *
+   * @return The entries that were removed, so that the caller may delete the files.
+   * */
+  auto remove_before(std::uint64_t time) -> std::vector<entry>;
+
+  /**
+   * @brief Marks the frames in a time range as being read, so that they are not rewritten or deleted by
+   *        @ref storage_index::replace, @ref storage_index::erase or @ref storage_index::remove_before until the
+   *        lease is released.
+   *
+   * @details The lease should be taken before querying the frames that are going to be read, so that the sizes in the
+   *          query results stay valid for as long as the lease is held.
+   *
+   * @return The lease, which is released when the last copy of it is destroyed. It must be released before the index
+   *         is destroyed.
+   * */
+  auto lease(std::uint64_t from, std::uint64_t to) -> std::shared_ptr<void>;
+
+  /**
+   * @brief Replaces the file of a frame with another file, unless the frame is leased.
+   *
+   * @param e The frame to replace, with the size of the replacement.
+   *
+   * @param replacement_path The path of the file to rename over the frame file. It is left in place if the frame is
+   *                         not replaced.
+   * */
+  auto replace(const entry& e, const std::string& replacement_path) -> change_result;
+
+  /**
+   * @brief Removes a frame from the index and deletes its file, unless the frame is leased.
+   * */
+  auto erase(std::uint64_t time) -> change_result;
+
+  /**
+   * @brief Finds the frames within a time range.
+   *
+   * @param from The earliest time to include.
+   *
+   * @param to The latest time to include.
+   *
+   * @param step The minimum amount of time between each frame in the result. Zero means every frame is included.
+   *
+   * @param max_entries The maximum number of frames to return.
+   *
+   * @return The frames in the time range, in chronological order.
+   * */
+  auto query(std::uint64_t from, std::uint64_t to, std::uint64_t step, std::size_t max_entries) const
+    -> std::vector<entry>;
+
+  /**
+   * @brief Gets the number of frames in the index.
+   * */
+  auto size() const -> std::size_t;
+
+protected:
+  /**
+   * @note The lock must be held when calling this function.
+   * */
+  auto is_leased(std::uint64_t time) const -> bool;
+
+  void release(std::uint64_t lease_id);
+
+private:
+  const std::string m_directory;
+
+  mutable std::mutex m_lock;
+
+  std::deque<entry> m_entries;
+
+  /**
+   * @brief The time ranges of the leases that are held, by lease ID.
+   * */
+  std::map<std::uint64_t, std::pair<std::uint64_t, std::uint64_t>> m_leases;
+
+  std::uint64_t m_next_lease_id{};
+};
@@ -0,0 +1,27 @@
+#pragma once
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+/**
+ * @brief Names the calling thread, so that the threads of each stage can be told apart in tools like top and in the
+ *        CPU time reported by the benchmark harness.
+ *
+ * @param name The name of the thread, which is cut off after 15 characters.
+ * */
+inline void
+set_thread_name(const char* name)
+{
+#ifdef __linux__
+  char truncated[16]{};
+
+  for (int i = 0; (i < 15) && (name[i] != 0); i++) {
+    truncated[i] = name[i];
+  }
+
+  pthread_setname_np(pthread_self(), truncated);
+#else
+  (void)name;
+#endif
+}
@@ -0,0 +1,398 @@
+#include "thumbnail_store.h"
+
+#include <sentinel/proto.h>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <set>
+#include <sstream>
+
+#include <cstring>
+
+namespace {
+
+auto
+time_less(const thumbnail_store::entry& e, const std::uint64_t time) -> bool
+{
+  return e.time < time;
+}
+
+auto
+get_segment(const std::uint64_t time, const std::uint64_t segment_duration) -> std::uint64_t
+{
+  return time - (time % segment_duration);
+}
+
+/**
+ * @brief Appends a thumbnail message to a segment file.
+ * */
+auto
+write_message(std::FILE* file,
+              const std::uint64_t time,
+              const std::uint32_t sensor_id,
+              const std::vector<std::uint8_t>& jpeg) -> bool
+{
+  const auto prefix =
+    sentinel::proto::writer::create_rgb_camera_update_prefix(static_cast<std::uint32_t>(jpeg.size()), time, sensor_id);
+
+  if (std::fwrite(prefix.data(), 1, prefix.size(), file) != prefix.size()) {
+    return false;
+  }
+
+  if (std::fwrite(jpeg.data(), 1, jpeg.size(), file) != jpeg.size()) {
+    return false;
+  }
+
+  /* The message has to reach the page cache before it is added to the index, since it may be mapped right away. */
+  return std::fflush(file) == 0;
+}
+
+} // namespace
+
+auto
+thumbnail_store::create_pyramid(const config::camera_config& cfg) -> std::vector<std::shared_ptr<thumbnail_store>>
+{
+  auto sizes = cfg.storage_thumbnail_sizes;
+
+  auto cmp = [](const config::size_config& l, const config::size_config& r) -> bool {
+    return (l.width * l.height) > (r.width * r.height);
+  };
+
+  std::sort(sizes.begin(), sizes.end(), cmp);
+
+  std::vector<std::shared_ptr<thumbnail_store>> pyramid;
+
+  for (const auto& s : sizes) {
+
+    std::ostringstream dir_stream;
+
+    dir_stream << cfg.storage_path << "/thumbnails/" << s.width << 'x' << s.height;
+
+    pyramid.emplace_back(std::make_shared<thumbnail_store>(dir_stream.str(), cfg.sensor_id, s.width, s.height));
+  }
+
+  return pyramid;
+}
+
+thumbnail_store::thumbnail_store(std::string directory,
+                                 const std::uint32_t sensor_id,
+                                 const int width,
+                                 const int height,
+                                 const std::uint64_t segment_duration)
+  : m_directory(std::move(directory))
+  , m_sensor_id(sensor_id)
+  , m_width(width)
+  , m_height(height)
+  , m_segment_duration(segment_duration)
+{
+}
+
+thumbnail_store::~thumbnail_store()
+{
+  close_segment();
+}
+
+auto
+thumbnail_store::get_segment_path(const std::uint64_t segment) const -> std::string
+{
+  std::ostringstream path_stream;
+
+  path_stream << m_directory << '/' << segment << ".seg";
+
+  return path_stream.str();
+}
+
+void
+thumbnail_store::scan()
+{
+  std::error_code error;
+
+  std::filesystem::create_directories(m_directory, error);
+
+  if (error) {
+    spdlog::error("Failed to create thumbnail directory '{}'.", m_directory);
+    return;
+  }
+
+  std::deque<entry> entries;
+
+  for (const auto& dir_entry : std::filesystem::directory_iterator(m_directory)) {
+
+    const auto entry_path = dir_entry.path();
+
+    if (entry_path.extension().string() != ".seg") {
+      continue;
+    }
+
+    std::istringstream in_stream(entry_path.stem().string());
+
+    std::uint64_t segment{};
+
+    if (!(in_stream >> segment)) {
+      continue;
+    }
+
+    if (!scan_segment(segment, entries)) {
+      spdlog::warn("Failed to read thumbnail segment '{}'.", entry_path.string());
+    }
+  }
+
+  auto cmp = [](const entry& l, const entry& r) -> bool { return l.time < r.time; };
+
+  std::sort(entries.begin(), entries.end(), cmp);
+
+  std::lock_guard<std::mutex> write_lock(m_write_lock);
+
+  close_segment();
+
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  m_entries = std::move(entries);
+}
+
+auto
+thumbnail_store::scan_segment(const std::uint64_t segment, std::deque<entry>& entries) const -> bool
+{
+  const auto path = get_segment_path(segment);
+
+  std::error_code error;
+
+  const auto file_size = std::filesystem::file_size(path, error);
+
+  if (error) {
+    return false;
+  }
+
+  auto* file = std::fopen(path.c_str(), "rb");
+
+  if (!file) {
+    return false;
+  }
+
+  const auto prefix_size = sentinel::proto::writer::create_rgb_camera_update_prefix(0, 0, 0).size();
+
+  std::vector<std::uint8_t> prefix(prefix_size);
+
+  std::uint64_t offset{};
+
+  while (std::fread(prefix.data(), 1, prefix.size(), file) == prefix.size()) {
+
+    std::uint32_t type_size{};
+    std::uint32_t payload_size{};
+    std::memcpy(&type_size, prefix.data(), 4);
+    std::memcpy(&payload_size, prefix.data() + 4, 4);
+
+    const auto message_size = static_cast<std::uint64_t>(8) + type_size + payload_size;
+
+    if ((8 + type_size + 16) != prefix_size) {
+      break;
+    }
+
+    std::uint32_t jpeg_size{};
+    std::uint64_t time{};
+    std::memcpy(&jpeg_size, prefix.data() + 8 + type_size, 4);
+    std::memcpy(&time, prefix.data() + 8 + type_size + 4, 8);
+
+    if (((prefix_size + jpeg_size) != message_size) || ((offset + message_size) > file_size)) {
+      break;
+    }
+
+    if (std::fseek(file, static_cast<long>(jpeg_size), SEEK_CUR) != 0) {
+      break;
+    }
+
+    entries.emplace_back(entry{ time, segment, offset, static_cast<std::uint32_t>(message_size) });
+
+    offset += message_size;
+  }
+
+  std::fclose(file);
+
+  if (file_size > offset) {
+    /* Either the last message is incomplete or the file is corrupt, so cut off whatever could not be read. */
+    spdlog::warn("Truncating thumbnail segment '{}' from {} to {} bytes.", path, file_size, offset);
+    std::filesystem::resize_file(path, offset, error);
+  }
+
+  return !error;
+}
+
+void
+thumbnail_store::close_segment()
+{
+  if (m_segment_file) {
+    std::fclose(m_segment_file);
+    m_segment_file = nullptr;
+  }
+}
+
+auto
+thumbnail_store::add(const std::uint64_t time, const std::vector<std::uint8_t>& jpeg) -> bool
+{
+  const auto segment = get_segment(time, m_segment_duration);
+
+  /* Queries only wait for the index to be changed at the end, not for the message to be written. */
+  std::lock_guard<std::mutex> write_lock(m_write_lock);
+
+  std::FILE* file{ nullptr };
+
+  std::uint64_t offset{};
+
+  if (m_segment_file && (m_segment == segment)) {
+    file = m_segment_file;
+    offset = m_segment_size;
+  } else {
+
+    file = std::fopen(get_segment_path(segment).c_str(), "ab");
+
+    if (!file) {
+      return false;
+    }
+
+    std::fseek(file, 0, SEEK_END);
+
+    offset = static_cast<std::uint64_t>(std::ftell(file));
+
+    if (!m_segment_file || (segment > m_segment)) {
+      /* Thumbnails are usually added in order, so the newest segment is kept open. Older segments are only written to
+       * when filling in missing thumbnails. */
+      close_segment();
+      m_segment_file = file;
+      m_segment = segment;
+      m_segment_size = offset;
+    }
+  }
+
+  const auto success = write_message(file, time, m_sensor_id, jpeg);
+
+  if (file == m_segment_file) {
+    if (success) {
+      m_segment_size += static_cast<std::uint64_t>(std::ftell(file)) - offset;
+    } else {
+      close_segment();
+    }
+  } else {
+    std::fclose(file);
+  }
+
+  if (!success) {
+    /* A partial message would hide every message that is appended after it, so it is cut off right away. */
+    std::error_code error;
+    std::filesystem::resize_file(get_segment_path(segment), offset, error);
+    return false;
+  }
+
+  const auto message_size = sentinel::proto::writer::create_rgb_camera_update_prefix(0, 0, 0).size() + jpeg.size();
+
+  const entry e{ time, segment, offset, static_cast<std::uint32_t>(message_size) };
+
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  if (m_entries.empty() || (m_entries.back().time < time)) {
+    m_entries.emplace_back(e);
+    return true;
+  }
+
+  auto it = std::lower_bound(m_entries.begin(), m_entries.end(), time, time_less);
+
+  if ((it != m_entries.end()) && (it->time == time)) {
+    *it = e;
+  } else {
+    m_entries.insert(it, e);
+  }
+
+  return true;
+}
+
+auto
+thumbnail_store::contains(const std::uint64_t time) const -> bool
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  auto it = std::lower_bound(m_entries.begin(), m_entries.end(), time, time_less);
+
+  return (it != m_entries.end()) && (it->time == time);
+}
+
+void
+thumbnail_store::remove_before(const std::uint64_t time)
+{
+  std::set<std::uint64_t> segments;
+
+  {
+    std::lock_guard<std::mutex> write_lock(m_write_lock);
+
+    if (m_segment_file && ((m_segment + m_segment_duration) <= time)) {
+      close_segment();
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    while (!m_entries.empty() && (m_entries.front().time < time)) {
+      segments.emplace(m_entries.front().segment);
+      m_entries.pop_front();
+    }
+  }
+
+  for (const auto segment : segments) {
+    if ((segment + m_segment_duration) <= time) {
+      std::error_code error;
+      std::filesystem::remove(get_segment_path(segment), error);
+    }
+  }
+}
+
+auto
+thumbnail_store::query(const std::uint64_t from,
+                       const std::uint64_t to,
+                       const std::uint64_t step,
+                       const std::size_t max_entries) const -> std::vector<entry>
+{
+  std::vector<entry> result;
+
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  auto it = std::lower_bound(m_entries.begin(), m_entries.end(), from, time_less);
+
+  while ((it != m_entries.end()) && (it->time <= to) && (result.size() < max_entries)) {
+
+    result.emplace_back(*it);
+
+    if (step == 0) {
+      ++it;
+      continue;
+    }
+
+    const auto next_time = it->time + step;
+
+    if (next_time < it->time) {
+      break;
+    }
+
+    it = std::lower_bound(it + 1, m_entries.end(), next_time, time_less);
+  }
+
+  return result;
+}
+
+auto
+thumbnail_store::size() const -> std::size_t
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  return m_entries.size();
+}
+
+auto
+thumbnail_store::get_last_time() const -> std::optional<std::uint64_t>
+{
+  std::lock_guard<std::mutex> lock(m_lock);
+
+  if (m_entries.empty()) {
+    return std::nullopt;
+  }
+
+  return m_entries.back().time;
+}
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "config.h"
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/**
+ * @brief Stores small versions of the stored frames, packed densely into segment files.
+ *
+ * @details Each segment file covers a fixed amount of time and consists of "rgb_camera::update" messages, one per
+ *          thumbnail, written back to back. Thumbnails that are next to each other in time are usually next to each
+ *          other in the file, so a whole timeline of them can be served with a single sequential read and without any
+ *          reformatting.
+ *
+ * @note This class is thread safe. It is written to by the pipeline thread and queried from the IO loop.
+ * */
+class thumbnail_store final
+{
+public:
+  struct entry final
+  {
+    /**
+     * @brief The time the frame was taken at, in terms of microseconds since Unix epoch.
+     * */
+    std::uint64_t time{};
+
+    /**
+     * @brief The start time of the segment that the thumbnail is in.
+     * */
+    std::uint64_t segment{};
+
+    /**
+     * @brief The offset of the thumbnail message within the segment file.
+     * */
+    std::uint64_t offset{};
+
+    /**
+     * @brief The size of the thumbnail message, including the message header.
+     * */
+    std::uint32_t size{};
+  };
+
+  /**
+   * @brief The amount of time covered by each segment file of a thumbnail size, in microseconds.
+   * */
+  static constexpr std::uint64_t default_segment_duration{ 3600ULL * 1000 * 1000 };
+
+  /**
+   * @brief Creates one thumbnail store for each thumbnail size in a camera configuration, from largest to smallest.
+   * */
+  static auto create_pyramid(const config::camera_config& cfg) -> std::vector<std::shared_ptr<thumbnail_store>>;
+
+  /**
+   * @brief Constructs a new thumbnail store.
+   *
+   * @param directory The directory to put the segment files into.
+   *
+   * @param sensor_id The sensor ID to put into the thumbnail messages.
+   *
+   * @param width The width of the thumbnails.
+   *
+   * @param height The height of the thumbnails.
+   *
+   * @param segment_duration The amount of time covered by each segment file, in microseconds.
+   * */
+  thumbnail_store(std::string directory,
+                  std::uint32_t sensor_id,
+                  int width,
+                  int height,
+                  std::uint64_t segment_duration = default_segment_duration);
+
+  thumbnail_store(const thumbnail_store&) = delete;
+
+  thumbnail_store(thumbnail_store&&) = delete;
+
+  auto operator=(const thumbnail_store&) -> thumbnail_store& = delete;
+
+  auto operator=(thumbnail_store&&) -> thumbnail_store& = delete;
+
+  ~thumbnail_store();
+
+  auto get_width() const -> int { return m_width; }
+
+  auto get_height() const -> int { return m_height; }
+
+  auto get_segment_duration() const -> std::uint64_t { return m_segment_duration; }
+
+  /**
+   * @brief Gets the path of a segment file.
+   *
+   * @param segment The start time of the segment.
+   * */
+  auto get_segment_path(std::uint64_t segment) const -> std::string;
+
+  /**
+   * @brief Replaces the contents of the index with the thumbnails that exist in the segment files.
+   *
+   * @note A message that was only partially written (for example, because of a power loss) is cut off the end of its
+   *       segment file, so that new messages can be appended after the last complete one.
+   * */
+  void scan();
+
+  /**
+   * @brief Appends a thumbnail to the segment file for its time.
+   *
+   * @param time The time of the frame that the thumbnail was made from.
+   *
+   * @param jpeg The JPEG data of the thumbnail.
+   *
+   * @return True on success, false if the thumbnail could not be written.
+   * */
+  auto add(std::uint64_t time, const std::vector<std::uint8_t>& jpeg) -> bool;
+
+  /**
+   * @brief Indicates whether or not there is a thumbnail for a frame.
+   * */
+  auto contains(std::uint64_t time) const -> bool;
+
+  /**
+   * @brief Removes the thumbnails that were taken before a certain time, deleting segment files that become empty.
+   * */
+  void remove_before(std::uint64_t time);
+
+  /**
+   * @brief Finds the thumbnails within a time range, the same way that @ref storage_index::query does.
+   * */
+  auto query(std::uint64_t from, std::uint64_t to, std::uint64_t step, std::size_t max_entries) const
+    -> std::vector<entry>;
+
+  /**
+   * @brief Gets the number of thumbnails in the index.
+   * */
+  auto size() const -> std::size_t;
+
+  /**
+   * @brief Gets the time of the newest thumbnail, if there are any.
+   * */
+  auto get_last_time() const -> std::optional<std::uint64_t>;
+
+protected:
+  auto scan_segment(std::uint64_t segment, std::deque<entry>& entries) const -> bool;
+
+  void close_segment();
+
+private:
+  const std::string m_directory;
+
+  const std::uint32_t m_sensor_id{};
+
+  const int m_width{};
+
+  const int m_height{};
+
+  const std::uint64_t m_segment_duration{};
+
+  /**
+   * @brief Held while writing to the segment files, so that writers take turns without holding up queries. It is
+   *        always locked before @ref thumbnail_store::m_lock, when both are needed.
+   * */
+  std::mutex m_write_lock;
+
+  /**
+   * @brief Protects the index, and is only held long enough to read from it or change it.
+   * */
+  mutable std::mutex m_lock;
+
+  std::deque<entry> m_entries;
+
+  /* The members below are protected by the write lock. */
+
+  /**
+   * @brief The segment file that is currently open for appending.
+   * */
+  std::FILE* m_segment_file{ nullptr };
+
+  std::uint64_t m_segment{};
+
+  std::uint64_t m_segment_size{};
+};
@@ -0,0 +1,198 @@
+#include "timelapse_builder.h"
+
+#include "background_task.h"
+#include "clock.h"
+#include "jpeg_header.h"
+#include "storage_index.h"
+#include "thumbnail_store.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
+namespace {
+
+/**
+ * @brief The maximum number of timelapse frames per second to make, when catching up on frames that were stored before.
+ * */
+constexpr float catch_up_rate{ 10.0f };
+
+/**
+ * @brief The longest amount of time to wait before checking the index for new frames again.
+ * */
+constexpr std::chrono::seconds max_poll_interval{ 60 };
+
+class timelapse_builder_impl final
+  : public timelapse_builder
+  , public background_task
+{
+public:
+  timelapse_builder_impl(std::shared_ptr<storage_index> index,
+                         std::shared_ptr<thumbnail_store> timelapse,
+                         const std::uint64_t interval,
+                         const std::uint64_t delay,
+                         const float quality)
+    : background_task(catch_up_rate)
+    , m_build(std::move(index), std::move(timelapse), interval, delay, quality)
+  {
+    start();
+  }
+
+  ~timelapse_builder_impl() override { stop(); }
+
+protected:
+  void run() override
+  {
+    const std::function<bool()> throttle = [this]() -> bool { return background_task::throttle(); };
+
+    while (true) {
+
+      const auto now = sentinel::get_clock_time();
+
+      if (!m_build.run_pass(now, throttle)) {
+        return;
+      }
+
+      if (m_build.get_added() > 0) {
+        spdlog::info("Added {} frames to the timelapse.", m_build.get_added());
+      }
+
+      clock_type::duration wait = max_poll_interval;
+
+      const auto wake_time = m_build.get_wake_time();
+
+      if (wake_time.has_value()) {
+        const std::chrono::microseconds remaining((wake_time.value() > now) ? (wake_time.value() - now) : 0);
+        wait = std::min<clock_type::duration>(remaining, max_poll_interval);
+      }
+
+      if (!wait_until(clock_type::now() + wait)) {
+        return;
+      }
+    }
+  }
+
+private:
+  timelapse_build m_build;
+};
+
+} // namespace
+
+timelapse_build::timelapse_build(std::shared_ptr<storage_index> index,
+                                 std::shared_ptr<thumbnail_store> timelapse,
+                                 const std::uint64_t interval,
+                                 const std::uint64_t delay,
+                                 const float quality)
+  : m_index(std::move(index))
+  , m_timelapse(std::move(timelapse))
+  , m_interval(std::max<std::uint64_t>(interval, 1))
+  , m_delay(delay)
+  , m_jpeg_quality(std::clamp(static_cast<int>(quality * 100), 0, 100))
+{
+  const auto last_time = m_timelapse->get_last_time();
+
+  if (last_time.has_value()) {
+    m_next = get_interval_start(last_time.value()) + m_interval;
+  }
+}
+
+auto
+timelapse_build::run_pass(const std::uint64_t now, const std::function<bool()>& throttle) -> bool
+{
+  /* Frames taken before this time have all been stored, if they are going to be stored at all. */
+  const auto settled = (now > m_delay) ? (now - m_delay) : 0;
+
+  m_wake_time.reset();
+
+  m_added = 0;
+
+  while (true) {
+
+    const auto entries = m_index->query(m_next, std::numeric_limits<std::uint64_t>::max(), 0, 1);
+
+    if (entries.empty()) {
+      return true;
+    }
+
+    const auto time = entries.front().time;
+
+    m_next = get_interval_start(time);
+
+    if ((m_next + m_interval) > settled) {
+      m_wake_time = m_next + m_interval + m_delay;
+      return true;
+    }
+
+    if (!throttle()) {
+      return false;
+    }
+
+    if (add_frame(time)) {
+      m_added++;
+    }
+
+    m_next += m_interval;
+  }
+}
+
+auto
+timelapse_build::add_frame(const std::uint64_t time) -> bool
+{
+  const auto path = m_index->get_path(time);
+
+  const auto w = m_timelapse->get_width();
+
+  const auto h = m_timelapse->get_height();
+
+  if ((w <= 0) || (h <= 0)) {
+    return read_file(path) && m_timelapse->add(time, m_buffer);
+  }
+
+  const auto frame = read_reduced_jpeg(path, w, h);
+
+  if (frame.empty()) {
+    return false;
+  }
+
+  cv::Mat small_frame;
+
+  cv::resize(frame, small_frame, cv::Size(w, h), 0, 0, cv::INTER_AREA);
+
+  if (!cv::imencode(".jpg", small_frame, m_buffer, { cv::IMWRITE_JPEG_QUALITY, m_jpeg_quality })) {
+    return false;
+  }
+
+  return m_timelapse->add(time, m_buffer);
+}
+
+auto
+timelapse_build::read_file(const std::string& path) -> bool
+{
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+
+  if (!file) {
+    return false;
+  }
+
+  m_buffer.resize(static_cast<std::size_t>(file.tellg()));
+
+  file.seekg(0);
+
+  file.read(reinterpret_cast<char*>(m_buffer.data()), static_cast<std::streamsize>(m_buffer.size()));
+
+  return !m_buffer.empty() && !!file;
+}
+
+auto
+timelapse_builder::create(std::shared_ptr<storage_index> index,
+                          std::shared_ptr<thumbnail_store> timelapse,
+                          const std::uint64_t interval,
+                          const std::uint64_t delay,
+                          const float quality) -> std::unique_ptr<timelapse_builder>
+{
+  return std::make_unique<timelapse_builder_impl>(std::move(index), std::move(timelapse), interval, delay, quality);
+}
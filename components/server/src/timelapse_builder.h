@@ -0,0 +1,119 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+class storage_index;
+class thumbnail_store;
+
+/**
+ * @brief The work of a timelapse builder, done one pass at a time on the calling thread.
+ * */
+class timelapse_build final
+{
+public:
+  /**
+   * @brief Constructs a new timelapse build, which continues after the last frame that is already in the timelapse.
+   *
+   * @note The parameters are the same as those of @ref timelapse_builder::create.
+   * */
+  timelapse_build(std::shared_ptr<storage_index> index,
+                  std::shared_ptr<thumbnail_store> timelapse,
+                  std::uint64_t interval,
+                  std::uint64_t delay,
+                  float quality);
+
+  /**
+   * @brief Adds a frame to the timelapse for each interval that no more frames can be stored into.
+   *
+   * @param now The current time, in terms of microseconds since Unix epoch.
+   *
+   * @param throttle Called before each frame is added. If it returns false, the pass stops.
+   *
+   * @return False if the pass was stopped by the throttle, true otherwise.
+   * */
+  auto run_pass(std::uint64_t now, const std::function<bool()>& throttle) -> bool;
+
+  /**
+   * @brief Gets the time at which the next stored frame can be added, or nothing if no newer frame has been stored yet.
+   * */
+  auto get_wake_time() const -> std::optional<std::uint64_t> { return m_wake_time; }
+
+  /**
+   * @brief Gets the number of frames that were added to the timelapse by the last pass.
+   * */
+  auto get_added() const -> std::size_t { return m_added; }
+
+protected:
+  auto get_interval_start(const std::uint64_t time) const -> std::uint64_t { return time - (time % m_interval); }
+
+  auto add_frame(std::uint64_t time) -> bool;
+
+  auto read_file(const std::string& path) -> bool;
+
+private:
+  std::shared_ptr<storage_index> m_index;
+
+  std::shared_ptr<thumbnail_store> m_timelapse;
+
+  const std::uint64_t m_interval{};
+
+  const std::uint64_t m_delay{};
+
+  const int m_jpeg_quality{};
+
+  /**
+   * @brief The start of the first interval that may still need a frame.
+   * */
+  std::uint64_t m_next{};
+
+  std::optional<std::uint64_t> m_wake_time;
+
+  std::size_t m_added{};
+
+  std::vector<std::uint8_t> m_buffer;
+};
+
+/**
+ * @brief Builds a timelapse out of the stored frames, by picking the first stored frame of each interval and appending
+ *        it to a thumbnail store.
+ *
+ * @details The timelapse is built incrementally on a background thread. It continues from the last frame that is
+ *          already in the timelapse, so frames stored while the server was not running (or before the timelapse was
+ *          enabled) are caught up on at startup. An interval is only added once no more frames can be stored into it.
+ * */
+class timelapse_builder
+{
+public:
+  /**
+   * @brief Creates a new timelapse builder, which starts running immediately.
+   *
+   * @param index The index of the stored frames to build the timelapse out of.
+   *
+   * @param timelapse The store to put the timelapse frames into. If its width and height are not positive, the stored
+   *                  frames are copied into it without being decoded.
+   *
+   * @param interval The time between the frames of the timelapse, in microseconds.
+   *
+   * @param delay How long it may take for a frame to be stored after it was taken, in microseconds. This is the length
+   *              of the pre-roll, since those frames are only stored once an event occurs.
+   *
+   * @param quality The quality to encode resized frames at, between zero and one.
+   * */
+  static auto create(std::shared_ptr<storage_index> index,
+                     std::shared_ptr<thumbnail_store> timelapse,
+                     std::uint64_t interval,
+                     std::uint64_t delay,
+                     float quality) -> std::unique_ptr<timelapse_builder>;
+
+  /**
+   * @brief Stops the builder, waiting for the current frame to finish.
+   * */
+  virtual ~timelapse_builder() = default;
+};
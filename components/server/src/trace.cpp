@@ -0,0 +1,288 @@
+#include "trace.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+#ifdef __linux__
+#include <pthread.h>
+#endif
+
+namespace {
+
+struct label final
+{
+  std::string name;
+
+  std::string category;
+
+  tracer::arg_list args;
+};
+
+/**
+ * @brief One span in a thread buffer. The fields are atomic so that they can be read while the thread overwrites
+ *        them, which the reader detects and discards.
+ * */
+struct span final
+{
+  std::atomic<std::uint32_t> label{};
+
+  std::atomic<std::uint64_t> start{};
+
+  std::atomic<std::uint64_t> end{};
+};
+
+class thread_buffer final
+{
+public:
+  thread_buffer(const std::uint32_t id, std::string name)
+    : m_id(id)
+    , m_name(std::move(name))
+  {
+  }
+
+  void add(const std::uint32_t label, const std::uint64_t start, const std::uint64_t end) noexcept
+  {
+    const auto index = m_head.load(std::memory_order_relaxed);
+
+    /* The slot is claimed before it is written, so that a reader can tell if it copied a slot while it was being
+     * overwritten. */
+    m_claimed.store(index + 1, std::memory_order_relaxed);
+
+    std::atomic_thread_fence(std::memory_order_release);
+
+    auto& s = m_spans[index % tracer::buffer_size];
+
+    s.label.store(label, std::memory_order_relaxed);
+
+    s.start.store(start, std::memory_order_relaxed);
+
+    s.end.store(end, std::memory_order_relaxed);
+
+    m_head.store(index + 1, std::memory_order_release);
+  }
+
+  struct copied_span final
+  {
+    std::uint32_t label{};
+
+    std::uint64_t start{};
+
+    std::uint64_t end{};
+  };
+
+  auto copy() const -> std::vector<copied_span>
+  {
+    const auto head = m_head.load(std::memory_order_acquire);
+
+    const auto first = (head > tracer::buffer_size) ? (head - tracer::buffer_size) : 0;
+
+    std::vector<copied_span> result;
+
+    result.reserve(head - first);
+
+    for (auto i = first; i < head; i++) {
+
+      const auto& s = m_spans[i % tracer::buffer_size];
+
+      result.emplace_back(copied_span{ s.label.load(std::memory_order_relaxed),
+                                       s.start.load(std::memory_order_relaxed),
+                                       s.end.load(std::memory_order_relaxed) });
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    /* Span i is overwritten by span (i + buffer_size), so any span that may have been overwritten since it was copied
+     * is dropped. */
+    const auto claimed = m_claimed.load(std::memory_order_relaxed);
+
+    const auto valid_first = (claimed > tracer::buffer_size) ? (claimed - tracer::buffer_size) : 0;
+
+    const auto overwritten = std::min<std::uint64_t>((valid_first > first) ? (valid_first - first) : 0, result.size());
+
+    result.erase(result.begin(), result.begin() + static_cast<std::ptrdiff_t>(overwritten));
+
+    return result;
+  }
+
+  auto get_id() const -> std::uint32_t { return m_id; }
+
+  auto get_name() const -> const std::string& { return m_name; }
+
+private:
+  std::uint32_t m_id{};
+
+  std::string m_name;
+
+  std::array<span, tracer::buffer_size> m_spans;
+
+  std::atomic<std::uint64_t> m_head{};
+
+  std::atomic<std::uint64_t> m_claimed{};
+};
+
+/**
+ * @brief Owns the labels and the buffers of every thread. The buffers outlive their threads, so that the spans of a
+ *        thread that has exited can still be exported.
+ * */
+struct trace_state final
+{
+  std::mutex lock;
+
+  std::vector<label> labels;
+
+  std::vector<std::unique_ptr<thread_buffer>> buffers;
+};
+
+auto
+get_state() -> trace_state&
+{
+  static trace_state state;
+
+  return state;
+}
+
+auto
+get_current_thread_name() -> std::string
+{
+#ifdef __linux__
+  char name[16]{};
+
+  if (pthread_getname_np(pthread_self(), name, sizeof(name)) == 0) {
+    return name;
+  }
+#endif
+
+  return "thread";
+}
+
+auto
+get_thread_buffer() -> thread_buffer*
+{
+  thread_local thread_buffer* buffer{ nullptr };
+
+  if (!buffer) {
+
+    auto& state = get_state();
+
+    std::lock_guard<std::mutex> lock(state.lock);
+
+    const auto id = static_cast<std::uint32_t>(state.buffers.size() + 1);
+
+    state.buffers.emplace_back(new thread_buffer(id, get_current_thread_name()));
+
+    buffer = state.buffers.back().get();
+  }
+
+  return buffer;
+}
+
+} // namespace
+
+std::atomic<bool> tracer::s_enabled{ false };
+
+void
+tracer::set_enabled(const bool enabled)
+{
+  s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+auto
+tracer::add_label(std::string name, std::string category, arg_list args) -> std::uint32_t
+{
+  auto& state = get_state();
+
+  std::lock_guard<std::mutex> lock(state.lock);
+
+  for (std::size_t i = 0; i < state.labels.size(); i++) {
+
+    const auto& l = state.labels[i];
+
+    if ((l.name == name) && (l.category == category) && (l.args == args)) {
+      return static_cast<std::uint32_t>(i + 1);
+    }
+  }
+
+  state.labels.emplace_back(label{ std::move(name), std::move(category), std::move(args) });
+
+  return static_cast<std::uint32_t>(state.labels.size());
+}
+
+void
+tracer::record_impl(const std::uint32_t label, const std::uint64_t start, const std::uint64_t end) noexcept
+{
+  get_thread_buffer()->add(label, start, end);
+}
+
+auto
+tracer::export_json() -> std::string
+{
+  auto& state = get_state();
+
+  std::lock_guard<std::mutex> lock(state.lock);
+
+  auto events = nlohmann::json::array();
+
+  for (const auto& buffer : state.buffers) {
+
+    nlohmann::json thread_name;
+    thread_name["ph"] = "M";
+    thread_name["name"] = "thread_name";
+    thread_name["pid"] = 1;
+    thread_name["tid"] = buffer->get_id();
+    thread_name["args"]["name"] = buffer->get_name();
+    events.emplace_back(std::move(thread_name));
+
+    for (const auto& s : buffer->copy()) {
+
+      if ((s.label == 0) || (s.label > state.labels.size())) {
+        continue;
+      }
+
+      const auto& l = state.labels[s.label - 1];
+
+      nlohmann::json e;
+      e["ph"] = "X";
+      e["name"] = l.name;
+      e["cat"] = l.category;
+      e["pid"] = 1;
+      e["tid"] = buffer->get_id();
+      e["ts"] = static_cast<double>(s.start) * 1.0e-3;
+      e["dur"] = static_cast<double>((s.end > s.start) ? (s.end - s.start) : 0) * 1.0e-3;
+
+      auto args = nlohmann::json::object();
+
+      for (const auto& a : l.args) {
+        args[a.first] = a.second;
+      }
+
+      e["args"] = std::move(args);
+
+      events.emplace_back(std::move(e));
+    }
+  }
+
+  nlohmann::json root;
+  root["traceEvents"] = std::move(events);
+  root["displayTimeUnit"] = "ms";
+
+  return root.dump();
+}
+
+auto
+tracer::save(const std::string& path) -> bool
+{
+  std::ofstream file(path, std::ios::binary);
+
+  if (!file.good()) {
+    return false;
+  }
+
+  file << export_json();
+
+  return file.good();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cstdint>
+
+/**
+ * @brief Records spans of time (such as one stage of one frame) into a buffer per thread, so that they can be exported
+ *        in the Chrome trace-event format and viewed in a tool like Perfetto or chrome://tracing.
+ *
+ * @details Each thread writes to its own ring buffer without locking, which holds the most recent @ref buffer_size
+ *          spans. While tracing is disabled, recording a span is a single relaxed load.
+ * */
+class tracer final
+{
+public:
+  using arg_list = std::vector<std::pair<std::string, std::string>>;
+
+  /**
+   * @brief The number of spans that are kept per thread.
+   * */
+  static constexpr std::size_t buffer_size{ 16384 };
+
+  static auto is_enabled() noexcept -> bool { return s_enabled.load(std::memory_order_relaxed); }
+
+  static void set_enabled(bool enabled);
+
+  /**
+   * @brief Adds a kind of span, such as the encoding stage of one camera.
+   *
+   * @param name The name that the spans are shown with.
+   *
+   * @param category The category of the spans, such as the pipeline or server they are from.
+   *
+   * @param args The arguments that are attached to each span, such as the sensor ID.
+   *
+   * @return The ID to record the spans with, which is never zero. Adding a label that was added before returns the same
+   *         ID, so that labels which are added repeatedly (such as the ones of client connections) do not pile up.
+   *
+   * @note This takes a lock, so it should be called ahead of time and not for every span.
+   * */
+  static auto add_label(std::string name, std::string category, arg_list args) -> std::uint32_t;
+
+  /**
+   * @brief Records a span on the calling thread, if tracing is enabled.
+   *
+   * @param label The ID returned by @ref add_label.
+   *
+   * @param start The start of the span, as given by @ref get_metrics_time.
+   *
+   * @param end The end of the span, as given by @ref get_metrics_time.
+   * */
+  static void record(const std::uint32_t label, const std::uint64_t start, const std::uint64_t end) noexcept
+  {
+    if (is_enabled()) {
+      record_impl(label, start, end);
+    }
+  }
+
+  /**
+   * @brief Exports the spans of every thread as a Chrome trace-event JSON document.
+   *
+   * @note This may be called from any thread, while spans are being recorded.
+   * */
+  static auto export_json() -> std::string;
+
+  /**
+   * @brief Exports the spans to a file.
+   *
+   * @return True on success, false on failure.
+   * */
+  static auto save(const std::string& path) -> bool;
+
+private:
+  static void record_impl(std::uint32_t label, std::uint64_t start, std::uint64_t end) noexcept;
+
+  static std::atomic<bool> s_enabled;
+};
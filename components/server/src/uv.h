@@ -1,7 +1,10 @@
 #pragma once
 
+#include "metrics.h"
+
 #include <spdlog/spdlog.h>
 
+#include <memory>
 #include <vector>
 
 #include <uv.h>
@@ -37,42 +40,124 @@ class write_operation final
 public:
   using complete_cb = void (*)(void*, bool success);
 
-  static void send(uv_stream_t* socket, std::vector<std::uint8_t> data, void* cb_data, complete_cb cb_func)
+  /**
+   * @brief The most operations that each thread keeps around to reuse, once they are done.
+   * */
+  static constexpr std::size_t max_pooled{ 256 };
+
+  /**
+   * @param write_time If not null, the time from now until the write completes is recorded in this histogram.
+   * */
+  static void send(uv_stream_t* socket,
+                   std::vector<std::uint8_t> data,
+                   void* cb_data,
+                   complete_cb cb_func,
+                   std::shared_ptr<latency_histogram> write_time = nullptr)
   {
-    auto* op = new write_operation(std::move(data), cb_data, cb_func);
+    auto* op = acquire(cb_data, cb_func, std::move(write_time));
 
-    if (!op->send(socket)) {
-      spdlog::error("Failed to send message.");
-      if (cb_func) {
-        cb_func(cb_data, false);
-      }
+    op->m_data = std::move(data);
+
+    op->start(socket, op->m_data);
+  }
+
+  /**
+   * @brief Sends a buffer without copying it, which is kept alive until the write completes. This is used for sending
+   *        the same message to many clients.
+   *
+   * @note The buffer must not be modified until the write completes.
+   * */
+  static void send(uv_stream_t* socket,
+                   std::shared_ptr<const std::vector<std::uint8_t>> data,
+                   void* cb_data,
+                   complete_cb cb_func,
+                   std::shared_ptr<latency_histogram> write_time = nullptr)
+  {
+    auto* op = acquire(cb_data, cb_func, std::move(write_time));
+
+    op->m_shared_data = std::move(data);
+
+    op->start(socket, *op->m_shared_data);
+  }
+
+protected:
+  write_operation() { uv_handle_set_data(to_handle(&m_handle), this); }
+
+  /**
+   * @brief Takes an operation from the pool of the calling thread, so that a write does not allocate once the pool has
+   *        as many operations as there are writes in flight.
+   * */
+  static auto acquire(void* cb_data, complete_cb cb_func, std::shared_ptr<latency_histogram> write_time)
+    -> write_operation*
+  {
+    auto& pool = get_pool();
+
+    write_operation* op{ nullptr };
+
+    if (pool.empty()) {
+      op = new write_operation();
+    } else {
+      op = pool.back().release();
+      pool.pop_back();
+    }
+
+    op->m_cb_data = cb_data;
+    op->m_cb_func = cb_func;
+    op->m_write_time = std::move(write_time);
+    op->m_start_time = op->m_write_time ? get_metrics_time() : 0;
+
+    return op;
+  }
+
+  static void release(write_operation* op)
+  {
+    op->m_data = std::vector<std::uint8_t>();
+    op->m_shared_data.reset();
+    op->m_write_time.reset();
+
+    auto& pool = get_pool();
+
+    if (pool.size() < max_pooled) {
+      pool.emplace_back(op);
+    } else {
       delete op;
     }
   }
 
-protected:
-  write_operation(std::vector<std::uint8_t> data, void* cb_data, complete_cb cb_func)
-    : m_data(std::move(data))
-    , m_cb_data(cb_data)
-    , m_cb_func(cb_func)
+  static auto get_pool() -> std::vector<std::unique_ptr<write_operation>>&
   {
-    m_buffer.base = reinterpret_cast<char*>(&m_data[0]);
-    m_buffer.len = m_data.size();
+    thread_local std::vector<std::unique_ptr<write_operation>> pool;
 
-    uv_handle_set_data(to_handle(&m_handle), this);
+    return pool;
   }
 
-  auto send(uv_stream_t* socket) -> bool { return uv_write(&m_handle, socket, &m_buffer, 1, on_write_complete) == 0; }
+  void start(uv_stream_t* socket, const std::vector<std::uint8_t>& data)
+  {
+    m_buffer.base = reinterpret_cast<char*>(const_cast<std::uint8_t*>(data.data()));
+    m_buffer.len = data.size();
+
+    if (uv_write(&m_handle, socket, &m_buffer, 1, on_write_complete) != 0) {
+      spdlog::error("Failed to send message.");
+      if (m_cb_func) {
+        m_cb_func(m_cb_data, false);
+      }
+      release(this);
+    }
+  }
 
   static void on_write_complete(uv_write_t* handle, const int status)
   {
     auto* self = static_cast<write_operation*>(uv_handle_get_data(to_handle(handle)));
 
+    if (self->m_write_time && (status == 0)) {
+      self->m_write_time->record_since(self->m_start_time);
+    }
+
     if (self->m_cb_func) {
       self->m_cb_func(self->m_cb_data, status == 0);
     }
 
-    delete self;
+    release(self);
 
     if (status != 0) {
       spdlog::error("Failed to complete write operation ({}).", uv_strerror(status));
@@ -82,6 +167,8 @@ protected:
 private:
   std::vector<std::uint8_t> m_data;
 
+  std::shared_ptr<const std::vector<std::uint8_t>> m_shared_data;
+
   uv_buf_t m_buffer{};
 
   uv_write_t m_handle{};
@@ -89,4 +176,8 @@ private:
   void* m_cb_data{ nullptr };
 
   complete_cb m_cb_func{ nullptr };
+
+  std::shared_ptr<latency_histogram> m_write_time;
+
+  std::uint64_t m_start_time{};
 };
@@ -1,13 +1,11 @@
 #include "video_device.h"
 
+#include <opencv2/core.hpp>
 #include <opencv2/videoio.hpp>
 
 #include "clock.h"
 #include "image.h"
 
-#include <random>
-#include <vector>
-
 namespace {
 
 class video_device_impl final : public video_device
@@ -47,27 +45,11 @@ public:
       return std::nullopt;
     }
 
-    const auto t = sentinel::get_clock_time();
-
     image img;
 
-    img.time = t;
-
-    img.resize(frame.cols, frame.rows, 3);
-
-    for (std::size_t i = 0; i < (frame.cols * frame.rows); i++) {
-
-      const auto x = i % frame.cols;
-      const auto y = i / frame.cols;
-
-      const auto pixel = frame.at<cv::Vec3b>(y, x);
-
-      img.data.at(i * 3 + 0) = pixel[2];
-      img.data.at(i * 3 + 1) = pixel[1];
-      img.data.at(i * 3 + 2) = pixel[0];
-    }
+    img.time = sentinel::get_clock_time();
 
-    img.frame = std::move(frame);
+    img.assign(std::move(frame));
 
     return img;
   }
@@ -87,31 +69,23 @@ public:
   virtual auto get_exposure() const -> float override { return m_handle.get(cv::CAP_PROP_EXPOSURE); }
 
 protected:
+  /**
+   * @brief Produces a frame of noise, which stands in for the frames of a device that could not be opened.
+   *
+   * @note The noise is only generated once, since it is only a placeholder.
+   * */
   auto create_bad_image() -> image
   {
-    const int w = m_frame_width;
-
-    const int h = m_frame_height;
+    if (m_bad_frame.empty()) {
+      m_bad_frame = cv::Mat(m_frame_height, m_frame_width, CV_8UC3);
+      cv::randu(m_bad_frame, cv::Scalar(0), cv::Scalar(256));
+    }
 
     image img;
 
     img.time = sentinel::get_clock_time();
 
-    img.resize(w, h, 3);
-
-    std::uniform_int_distribution<int> dist(0, 255);
-
-    for (int i = 0; i < (w * h); i++) {
-
-      const auto r = dist(m_rng);
-      const auto g = dist(m_rng);
-      const auto b = dist(m_rng);
-
-      img.data[i * 3 + 0] = r;
-      img.data[i * 3 + 1] = g;
-      img.data[i * 3 + 2] = b;
-      img.frame.at<cv::Vec3b>(i) = cv::Vec3b(b, g, r);
-    }
+    img.assign(m_bad_frame.clone());
 
     return img;
   }
@@ -119,7 +93,7 @@ protected:
 private:
   cv::VideoCapture m_handle;
 
-  std::mt19937 m_rng{ 0 };
+  cv::Mat m_bad_frame;
 
   int m_frame_width{ 640 };
 
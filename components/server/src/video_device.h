@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <optional>
+#include <string>
 
 struct image;
 
@@ -10,6 +11,19 @@ class video_device
 public:
   static auto create() -> std::unique_ptr<video_device>;
 
+  /**
+   * @brief Creates a device that plays back recorded frames, so that the rest of the server can be run (and
+   *        benchmarked) without a camera.
+   *
+   * @param path Either a directory of '<timestamp>.jpg' files, as written by the frame storage, or a video file.
+   *
+   * @param realtime Whether to wait between frames for as long as they were apart when recorded. Otherwise, the frames
+   *                 are read as fast as possible.
+   *
+   * @param loop Whether to start over after the last frame. Otherwise, the device is finished after the last frame.
+   * */
+  static auto create_replay(const std::string& path, bool realtime, bool loop) -> std::unique_ptr<video_device>;
+
   virtual ~video_device() = default;
 
   virtual auto open(int device_index, int frame_w, int frame_h) -> bool = 0;
@@ -21,4 +35,10 @@ public:
   virtual void set_exposure(float exposure) = 0;
 
   virtual auto get_exposure() const -> float = 0;
+
+  /**
+   * @brief Indicates whether the device has no more frames to produce, which is only the case for a recording that
+   *        does not loop.
+   * */
+  virtual auto is_finished() const -> bool { return false; }
 };
@@ -32,7 +32,7 @@ public:
   {
   }
 
-  auto filter(const image& input) -> bool
+  auto filter(const image& input) -> bool override
   {
     int input_w{ m_input_w };
     int input_h{ m_input_h };
@@ -73,6 +73,8 @@ public:
       output = 1.0f / (1.0f + std::exp(-output));
     }
 
+    m_last_score = output;
+
     auto image_class = output >= static_cast<float>(m_threshold);
 
     if (m_max_time >= 0.0) {
@@ -92,6 +94,8 @@ public:
     return image_class;
   }
 
+  auto get_last_score() const -> float override { return m_last_score; }
+
 private:
   cv::dnn::Net m_network;
 
@@ -101,6 +105,8 @@ private:
 
   std::optional<std::uint64_t> m_last_frame_time;
 
+  float m_last_score{};
+
   const double m_max_time{ -1 };
 
   const double m_threshold{ 0.5 };
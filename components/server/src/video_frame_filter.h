@@ -43,4 +43,9 @@ public:
    * @return True if the image should be passed through the rest of the system, false otherwise.
    * */
   virtual auto filter(const image& input) -> bool = 0;
+
+  /**
+   * @brief Gets the output of the model for the last image that was filtered, after the sigmoid function (if enabled).
+   * */
+  virtual auto get_last_score() const -> float = 0;
 };
@@ -2,19 +2,54 @@
 
 #include "clock.h"
 #include "image.h"
+#include "metadata_log.h"
+#include "metrics.h"
 #include "video_device.h"
 #include "video_frame_filter.h"
 #include "video_storage.h"
 
 #include <sentinel/proto.h>
 
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
 namespace {
 
+/**
+ * @brief How long to wait after the first failed read, which doubles with each consecutive failure.
+ * */
+constexpr std::chrono::milliseconds min_failure_delay{ 100 };
+
+constexpr std::chrono::milliseconds max_failure_delay{ 5000 };
+
+/**
+ * @brief The number of consecutive failed reads after which the device is opened again.
+ * */
+constexpr int reopen_failures{ 3 };
+
+/**
+ * @brief How often to try opening a device again, while placeholder frames are produced in its place.
+ * */
+constexpr std::chrono::seconds reopen_interval{ 10 };
+
+/**
+ * @brief The time between placeholder frames, which are produced while the device cannot be opened.
+ * */
+constexpr std::chrono::milliseconds placeholder_interval{ 200 };
+
 class video_pipeline_impl final : public video_pipeline
 {
 public:
-  explicit video_pipeline_impl(const config::camera_config& cfg)
+  video_pipeline_impl(const config::camera_config& cfg, camera_storage storage, metrics_registry& metrics)
     : m_config(cfg)
+    , m_camera_storage(std::move(storage))
+    , m_capture_time(add_stage_histogram(metrics, "video", cfg.sensor_id, "capture"))
+    , m_filter_time(add_stage_histogram(metrics, "video", cfg.sensor_id, "filter"))
+    , m_storage_time(add_stage_histogram(metrics, "video", cfg.sensor_id, "storage"))
+    , m_encode_time(add_stage_histogram(metrics, "video", cfg.sensor_id, "encode"))
   {
   }
 
@@ -22,12 +57,10 @@ public:
   {
     if (m_config.storage_enabled) {
       if (!m_storage) {
-        m_storage = video_storage::create(m_config.storage_path,
-                                          m_config.storage_quality,
-                                          m_config.storage_days,
-                                          m_config.storage_width,
-                                          m_config.storage_height,
-                                          m_config.storage_rate);
+        if (!m_camera_storage.index) {
+          m_camera_storage = camera_storage::create(m_config);
+        }
+        m_storage = video_storage::create(m_camera_storage, m_config);
       }
     }
 
@@ -46,34 +79,99 @@ public:
 
     if (!m_device) {
 
-      m_device = video_device::create();
+      m_device = m_config.replay_path.empty()
+                   ? video_device::create()
+                   : video_device::create_replay(m_config.replay_path, m_config.replay_realtime, m_config.replay_loop);
 
       m_opened = m_device->open(m_config.device_index, m_config.frame_width, m_config.frame_height);
+
+      m_open_time = std::chrono::steady_clock::now();
     }
 
+    if (!m_opened) {
+      /* The placeholder frames would otherwise be produced as fast as the thread can go. */
+      std::this_thread::sleep_for(placeholder_interval);
+
+      if ((std::chrono::steady_clock::now() - m_open_time) >= reopen_interval) {
+        m_device.reset();
+        return {};
+      }
+    }
+
+    auto t = get_metrics_time();
+
     auto img = m_device->read_frame();
 
     if (!img.has_value()) {
+      if (m_device->is_finished()) {
+        spdlog::info("Camera '{}' has played back all of its frames.", m_config.name);
+        should_close = true;
+        return {};
+      }
+      handle_read_failure();
       return {};
     }
 
-    if (m_frame_filter && !m_frame_filter->filter(img.value())) {
-      return {};
+    m_failures = 0;
+
+    t = m_capture_time->record_since(t);
+
+    const auto passed = !m_frame_filter || m_frame_filter->filter(img.value());
+
+    if (m_frame_filter) {
+      t = m_filter_time->record_since(t);
     }
 
     if (m_storage) {
-      m_storage->store(img.value());
+
+      frame_metadata metadata;
+
+      if (m_frame_filter) {
+        metadata.filter_score = m_frame_filter->get_last_score();
+      }
+
+      /* Rejected frames are still offered to storage, since they may end up in the pre-roll or post-roll of an event. */
+      m_storage->store(img.value(), passed, metadata);
+
+      t = m_storage_time->record_since(t);
+    }
+
+    if (!passed) {
+      return {};
     }
 
     auto msg = sentinel::proto::writer::create_rgb_camera_update(img->data.data(),
                                                                  img->width,
                                                                  img->height,
-                                                                 sentinel::get_clock_time(),
+                                                                 img->time,
                                                                  m_config.sensor_id,
                                                                  {},
                                                                  m_config.jpeg_quality);
 
-    return { std::move(msg) };
+    m_encode_time->record_since(t);
+
+    return { stamp_message(std::move(msg), img->time) };
+  }
+
+protected:
+  /**
+   * @brief Waits before the next read, so that a failed device is not read in a tight loop, and opens the device again
+   *        if it keeps failing.
+   * */
+  void handle_read_failure()
+  {
+    m_failures++;
+
+    const auto shift = std::min(m_failures - 1, 6);
+
+    const auto delay = std::min(min_failure_delay * (1 << shift), max_failure_delay);
+
+    std::this_thread::sleep_for(delay);
+
+    if (m_failures >= reopen_failures) {
+      spdlog::warn("Camera '{}' failed to read {} frames in a row, opening it again.", m_config.name, m_failures);
+      m_device.reset();
+    }
   }
 
 private:
@@ -81,17 +179,39 @@ private:
 
   std::unique_ptr<video_device> m_device;
 
+  camera_storage m_camera_storage;
+
   std::unique_ptr<video_storage> m_storage;
 
   std::unique_ptr<video_frame_filter> m_frame_filter;
 
+  /**
+   * @brief The time spent reading a frame from the device (which includes waiting for it), filtering it, storing it and
+   *        encoding it for the clients.
+   * */
+  std::shared_ptr<latency_histogram> m_capture_time;
+
+  std::shared_ptr<latency_histogram> m_filter_time;
+
+  std::shared_ptr<latency_histogram> m_storage_time;
+
+  std::shared_ptr<latency_histogram> m_encode_time;
+
   bool m_opened{ false };
+
+  std::chrono::steady_clock::time_point m_open_time;
+
+  /**
+   * @brief The number of consecutive reads that failed.
+   * */
+  int m_failures{};
 };
 
 } // namespace
 
 auto
-video_pipeline::create(const config::camera_config& cfg) -> std::unique_ptr<video_pipeline>
+video_pipeline::create(const config::camera_config& cfg, camera_storage storage, metrics_registry& metrics)
+  -> std::unique_ptr<video_pipeline>
 {
-  return std::make_unique<video_pipeline_impl>(cfg);
+  return std::make_unique<video_pipeline_impl>(cfg, std::move(storage), metrics);
 }
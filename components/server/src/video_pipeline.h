@@ -2,13 +2,28 @@
 
 #include <memory>
 
+#include "camera_storage.h"
 #include "config.h"
 #include "pipeline.h"
 
+class metrics_registry;
+
 class video_pipeline : public pipeline
 {
 public:
-  static auto create(const config::camera_config& cfg) -> std::unique_ptr<video_pipeline>;
+  /**
+   * @brief Creates a new video pipeline.
+   *
+   * @param cfg The configuration of the camera.
+   *
+   * @param storage The storage to put frames into. This is only used if storage is enabled.
+   *
+   * @param metrics The registry to add the timing of each stage to.
+   *
+   * @return A new video pipeline.
+   * */
+  static auto create(const config::camera_config& cfg, camera_storage storage, metrics_registry& metrics)
+    -> std::unique_ptr<video_pipeline>;
 
   virtual ~video_pipeline() = default;
 };
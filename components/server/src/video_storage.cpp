@@ -1,14 +1,26 @@
 #include "video_storage.h"
 
+#include "background_task.h"
+#include "clock.h"
 #include "image.h"
+#include "jpeg_header.h"
+#include "metadata_log.h"
+#include "storage_compactor.h"
+#include "storage_index.h"
+#include "timelapse_builder.h"
+#include "thumbnail_store.h"
 
 #include <opencv2/opencv.hpp>
 
+#include <spdlog/spdlog.h>
+
 #include <algorithm>
+#include <deque>
 #include <filesystem>
+#include <fstream>
 #include <limits>
 #include <optional>
-#include <sstream>
+#include <vector>
 
 namespace {
 
@@ -29,119 +41,407 @@ get_max_dt(const float days) -> std::uint64_t
   return static_cast<std::uint64_t>(static_cast<double>(days) * 24 * 60 * 60 * 1000 * 1000);
 }
 
-class video_storage_impl final : public video_storage
+auto
+seconds_to_usec(const float seconds) -> std::uint64_t
+{
+  if (seconds <= 0) {
+    return 0;
+  }
+
+  return static_cast<std::uint64_t>(static_cast<double>(seconds) * 1000 * 1000);
+}
+
+/**
+ * @brief A frame that has been encoded, but not yet written to storage.
+ * */
+struct encoded_frame final
+{
+  std::uint64_t time{};
+
+  std::vector<std::uint8_t> data;
+
+  frame_metadata metadata;
+
+  /**
+   * @brief The encoded thumbnails of the frame, one for each thumbnail store.
+   * */
+  std::vector<std::vector<std::uint8_t>> thumbnails;
+};
+
+/**
+ * @brief Encodes a thumbnail of a frame for each level of a thumbnail pyramid.
+ *
+ * @details Each level is shrunk from the one before it, which is cheaper than shrinking the frame for every level.
+ * */
+auto
+encode_thumbnails(const cv::Mat& frame,
+                  const std::vector<std::shared_ptr<thumbnail_store>>& pyramid,
+                  const int jpeg_quality,
+                  std::vector<std::vector<std::uint8_t>>& thumbnails) -> bool
+{
+  thumbnails.resize(pyramid.size());
+
+  cv::Mat level = frame;
+
+  for (std::size_t i = 0; i < pyramid.size(); i++) {
+
+    cv::Mat next_level;
+
+    cv::resize(level, next_level, cv::Size(pyramid[i]->get_width(), pyramid[i]->get_height()), 0, 0, cv::INTER_AREA);
+
+    if (!cv::imencode(".jpg", next_level, thumbnails[i], { cv::IMWRITE_JPEG_QUALITY, jpeg_quality })) {
+      return false;
+    }
+
+    level = next_level;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Makes thumbnails for the frames that were stored before thumbnails were enabled.
+ * */
+class thumbnail_backfill final : public background_task
 {
 public:
-  explicit video_storage_impl(std::string path,
-                              const float quality,
-                              const float days,
-                              const int storage_width,
-                              const int storage_height,
-                              const float rate)
-    : m_path(std::move(path))
-    , m_quality(quality)
-    , m_days(days)
-    , m_max_dt(get_max_dt(days))
-    , m_storage_width(storage_width)
-    , m_storage_height(storage_height)
-    , m_rate(rate)
+  thumbnail_backfill(std::shared_ptr<storage_index> index,
+                     std::vector<std::shared_ptr<thumbnail_store>> thumbnails,
+                     const int jpeg_quality,
+                     const float rate,
+                     const std::uint64_t until)
+    : background_task(rate)
+    , m_index(std::move(index))
+    , m_thumbnails(std::move(thumbnails))
+    , m_jpeg_quality(jpeg_quality)
+    , m_until(until)
+  {
+    start();
+  }
+
+  ~thumbnail_backfill() override { stop(); }
+
+protected:
+  void run() override
   {
-    for (const auto entry : std::filesystem::directory_iterator(m_path)) {
+    constexpr std::size_t batch_size{ 256 };
+
+    std::uint64_t from{};
+
+    std::size_t count{};
+
+    while (from < m_until) {
 
-      const auto entry_path = entry.path();
+      const auto entries = m_index->query(from, m_until - 1, 0, batch_size);
 
-      if (entry_path.extension().string() != ".jpg") {
-        continue;
+      if (entries.empty()) {
+        break;
       }
 
-      std::istringstream in_stream(entry_path.stem().string());
+      for (const auto& e : entries) {
+
+        from = e.time + 1;
+
+        if (!needs_thumbnails(e.time)) {
+          continue;
+        }
 
-      std::uint64_t timestamp{};
+        if (!throttle()) {
+          return;
+        }
 
-      if (!(in_stream >> timestamp)) {
-        continue;
+        if (backfill(e.time)) {
+          count++;
+        }
       }
+    }
 
-      m_existing_paths.emplace_back(timestamp, entry_path.string());
+    if (count > 0) {
+      spdlog::info("Made thumbnails for {} stored frames.", count);
     }
+  }
 
-    using entry_type = std::pair<std::uint64_t, std::string>;
+  auto needs_thumbnails(const std::uint64_t time) const -> bool
+  {
+    for (const auto& t : m_thumbnails) {
+      if (!t->contains(time)) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  auto backfill(const std::uint64_t time) -> bool
+  {
+    const auto& largest = m_thumbnails.front();
+
+    const auto frame = read_reduced_jpeg(m_index->get_path(time), largest->get_width(), largest->get_height());
+
+    if (frame.empty() || !encode_thumbnails(frame, m_thumbnails, m_jpeg_quality, m_buffers)) {
+      return false;
+    }
 
-    auto cmp = [](const entry_type& l, const entry_type& r) -> bool { return l.first < r.first; };
+    for (std::size_t i = 0; i < m_thumbnails.size(); i++) {
+      if (!m_thumbnails[i]->contains(time)) {
+        m_thumbnails[i]->add(time, m_buffers[i]);
+      }
+    }
 
-    std::sort(m_existing_paths.begin(), m_existing_paths.end(), cmp);
+    return true;
   }
 
-  void store(const image& img) override
+private:
+  std::shared_ptr<storage_index> m_index;
+
+  std::vector<std::shared_ptr<thumbnail_store>> m_thumbnails;
+
+  const int m_jpeg_quality{};
+
+  /**
+   * @brief Frames taken at or after this time are stored with thumbnails already.
+   * */
+  const std::uint64_t m_until{};
+
+  std::vector<std::vector<std::uint8_t>> m_buffers;
+};
+
+class video_storage_impl final : public video_storage
+{
+public:
+  video_storage_impl(camera_storage storage, const config::camera_config& cfg)
+    : m_index(std::move(storage.index))
+    , m_thumbnails(std::move(storage.thumbnails))
+    , m_metadata(std::move(storage.metadata))
+    , m_timelapse(std::move(storage.timelapse))
+    , m_quality(cfg.storage_quality)
+    , m_days(cfg.storage_days)
+    , m_max_dt(get_max_dt(cfg.storage_days))
+    , m_storage_width(cfg.storage_width)
+    , m_storage_height(cfg.storage_height)
+    , m_rate(cfg.storage_rate)
+    , m_pre_roll(seconds_to_usec(cfg.storage_pre_roll))
+    , m_post_roll(seconds_to_usec(cfg.storage_post_roll))
+    , m_pre_roll_max_bytes(cfg.storage_pre_roll_max_bytes)
+    , m_thumbnail_quality(clamp<int>(static_cast<int>(cfg.storage_thumbnail_quality * 100), 0, 100))
+  {
+    m_index->scan();
+
+    for (auto& t : m_thumbnails) {
+      t->scan();
+    }
+
+    if (m_metadata) {
+      m_metadata->scan();
+    }
+
+    if (m_timelapse) {
+      m_timelapse->scan();
+    }
+
+    if (!cfg.storage_tiers.empty()) {
+      m_compactor = storage_compactor::create(
+        m_index, m_metadata, cfg.storage_tiers, cfg.storage_quality, cfg.storage_compaction_rate);
+    }
+
+    if (!m_thumbnails.empty() && (cfg.storage_thumbnail_backfill_rate > 0)) {
+      m_thumbnail_backfill = std::make_unique<thumbnail_backfill>(
+        m_index, m_thumbnails, m_thumbnail_quality, cfg.storage_thumbnail_backfill_rate, sentinel::get_clock_time());
+    }
+
+    if (m_timelapse) {
+      m_timelapse_builder = timelapse_builder::create(m_index,
+                                                      m_timelapse,
+                                                      seconds_to_usec(cfg.storage_timelapse_interval),
+                                                      m_pre_roll,
+                                                      cfg.storage_timelapse_quality);
+    }
+  }
+
+  void store(const image& img, const bool event, const frame_metadata& metadata) override
   {
     if (img.frame.empty()) {
       return;
     }
 
+    const auto t = img.time;
+
+    if (event) {
+      m_post_roll_end = std::max(m_post_roll_end, t + m_post_roll);
+    }
+
+    const auto active = event || (t < m_post_roll_end);
+
+    if (active) {
+      flush_pre_roll();
+    } else if (m_pre_roll == 0) {
+      /* Nothing is kept in memory, so there's no need to encode the frame. */
+      return;
+    }
+
     if (m_last_time.has_value()) {
       const auto last_t = m_last_time.value();
-      const auto t = img.time;
       const auto elapsed = static_cast<double>(t - last_t) * 1.0e-6;
       if (elapsed < (1.0 / m_rate)) {
         return;
       }
     }
 
-    std::ostringstream path_stream;
-    if (!m_path.empty()) {
-      path_stream << m_path << '/';
-    }
-    path_stream << img.time;
-    path_stream << ".jpg";
+    m_last_time = t;
 
-    auto path = path_stream.str();
+    encoded_frame f{ t, std::move(m_spare_buffer), metadata };
 
-    if ((m_storage_width < 0) || (m_storage_height < 0)) {
-      store(std::move(path), img.frame, img.time);
-      m_last_time = img.time;
+    m_spare_buffer = std::vector<std::uint8_t>();
+
+    if (!encode(img.frame, f)) {
+      return;
+    }
+
+    if (active) {
+      write(f);
+      m_spare_buffer = std::move(f.data);
       return;
     }
 
-    cv::Mat frame;
-    cv::resize(img.frame, frame, cv::Size(m_storage_width, m_storage_height));
-    store(std::move(path), frame, img.time);
+    m_pre_roll_bytes += get_size(f);
+
+    m_pre_roll_frames.emplace_back(std::move(f));
 
-    m_last_time = img.time;
+    trim_pre_roll(t);
   }
 
 protected:
-  void store(std::string path, const cv::Mat& frame, const std::uint64_t t)
+  auto encode(const cv::Mat& frame, encoded_frame& f) -> bool
   {
     const int jpeg_quality{ clamp<int>(static_cast<int>(m_quality * 100), 0, 100) };
 
-    cv::imwrite(path, frame, { cv::IMWRITE_JPEG_QUALITY, jpeg_quality });
+    if (!encode_thumbnails(frame, m_thumbnails, m_thumbnail_quality, f.thumbnails)) {
+      return false;
+    }
+
+    if ((m_storage_width < 0) || (m_storage_height < 0)) {
+      return cv::imencode(".jpg", frame, f.data, { cv::IMWRITE_JPEG_QUALITY, jpeg_quality });
+    }
 
-    m_existing_paths.emplace_back(t, std::move(path));
+    cv::resize(frame, m_resize_buffer, cv::Size(m_storage_width, m_storage_height));
 
-    remove_old_entries(t);
+    return cv::imencode(".jpg", m_resize_buffer, f.data, { cv::IMWRITE_JPEG_QUALITY, jpeg_quality });
   }
 
-  void remove_old_entries(const std::uint64_t last_frame_t)
+  static auto get_size(const encoded_frame& f) -> std::size_t
   {
-    while (!m_existing_paths.empty()) {
+    auto size = f.data.size();
+
+    for (const auto& t : f.thumbnails) {
+      size += t.size();
+    }
+
+    return size;
+  }
+
+  void write(const encoded_frame& f)
+  {
+    const auto path = m_index->get_path(f.time);
+
+    std::ofstream file(path, std::ios::binary);
+
+    file.write(reinterpret_cast<const char*>(f.data.data()), static_cast<std::streamsize>(f.data.size()));
+
+    file.close();
+
+    if (!file) {
+      std::error_code error;
+      std::filesystem::remove(path, error);
+      return;
+    }
+
+    m_index->add(storage_index::entry{ f.time, static_cast<std::uint32_t>(f.data.size()) });
+
+    for (std::size_t i = 0; (i < m_thumbnails.size()) && (i < f.thumbnails.size()); i++) {
+      m_thumbnails[i]->add(f.time, f.thumbnails[i]);
+    }
+
+    if (m_metadata) {
+      m_metadata->append(metadata_log::row{ f.time,
+                                            f.metadata.filter_score,
+                                            f.metadata.anomaly_score,
+                                            f.metadata.detections,
+                                            static_cast<std::uint32_t>(f.data.size()) });
+    }
+
+    remove_old_entries(f.time);
+  }
+
+  void flush_pre_roll()
+  {
+    for (const auto& f : m_pre_roll_frames) {
+      write(f);
+    }
 
-      auto it = m_existing_paths.begin();
+    if (!m_pre_roll_frames.empty()) {
+      m_spare_buffer = std::move(m_pre_roll_frames.back().data);
+    }
+
+    m_pre_roll_frames.clear();
+
+    m_pre_roll_bytes = 0;
+  }
+
+  /**
+   * @brief Drops the frames that are too old, or that put the pre-roll over its memory budget.
+   * */
+  void trim_pre_roll(const std::uint64_t t)
+  {
+    while (!m_pre_roll_frames.empty()) {
 
-      const auto frame_t = it->first;
+      auto& front = m_pre_roll_frames.front();
 
-      const auto dt = (frame_t > last_frame_t) ? static_cast<std::uint64_t>(0) : (last_frame_t - frame_t);
+      const auto too_old = (front.time + m_pre_roll) < t;
 
-      if (dt > m_max_dt) {
-        std::filesystem::remove(it->second);
-        m_existing_paths.erase(it);
-      } else {
+      if (!too_old && (m_pre_roll_bytes <= m_pre_roll_max_bytes)) {
         break;
       }
+
+      m_pre_roll_bytes -= get_size(front);
+
+      m_spare_buffer = std::move(front.data);
+
+      m_pre_roll_frames.pop_front();
+    }
+  }
+
+  void remove_old_entries(const std::uint64_t last_frame_t)
+  {
+    if (last_frame_t <= m_max_dt) {
+      return;
+    }
+
+    for (const auto& e : m_index->remove_before(last_frame_t - m_max_dt)) {
+      std::error_code error;
+      std::filesystem::remove(m_index->get_path(e.time), error);
+    }
+
+    for (auto& t : m_thumbnails) {
+      t->remove_before(last_frame_t - m_max_dt);
+    }
+
+    if (m_metadata) {
+      m_metadata->remove_before(last_frame_t - m_max_dt);
+    }
+
+    if (m_timelapse) {
+      m_timelapse->remove_before(last_frame_t - m_max_dt);
     }
   }
 
 private:
-  std::string m_path;
+  std::shared_ptr<storage_index> m_index;
+
+  std::vector<std::shared_ptr<thumbnail_store>> m_thumbnails;
+
+  std::shared_ptr<metadata_log> m_metadata;
+
+  std::shared_ptr<thumbnail_store> m_timelapse;
 
   const float m_quality{ 0.5f };
 
@@ -153,18 +453,48 @@ private:
 
   int m_storage_height{ -1 };
 
-  std::vector<std::pair<std::uint64_t, std::string>> m_existing_paths;
-
   float m_rate{ 1 };
 
+  const std::uint64_t m_pre_roll{};
+
+  const std::uint64_t m_post_roll{};
+
+  const std::size_t m_pre_roll_max_bytes{};
+
+  const int m_thumbnail_quality{};
+
   std::optional<std::uint64_t> m_last_time;
+
+  /**
+   * @brief The time at which the post-roll of the last event ends.
+   * */
+  std::uint64_t m_post_roll_end{};
+
+  /**
+   * @brief The most recent frames that were not part of an event, oldest first.
+   * */
+  std::deque<encoded_frame> m_pre_roll_frames;
+
+  std::size_t m_pre_roll_bytes{};
+
+  /**
+   * @brief A buffer from a frame that is no longer needed, which is reused to avoid reallocating it for each frame.
+   * */
+  std::vector<std::uint8_t> m_spare_buffer;
+
+  cv::Mat m_resize_buffer;
+
+  std::unique_ptr<storage_compactor> m_compactor;
+
+  std::unique_ptr<thumbnail_backfill> m_thumbnail_backfill;
+
+  std::unique_ptr<timelapse_builder> m_timelapse_builder;
 };
 
 } // namespace
 
 auto
-video_storage::create(std::string path, float quality, float days, int storage_width, int storage_height, float rate)
-  -> std::unique_ptr<video_storage>
+video_storage::create(camera_storage storage, const config::camera_config& cfg) -> std::unique_ptr<video_storage>
 {
-  return std::make_unique<video_storage_impl>(std::move(path), quality, days, storage_width, storage_height, rate);
+  return std::make_unique<video_storage_impl>(std::move(storage), cfg);
 }
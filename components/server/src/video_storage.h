@@ -1,10 +1,12 @@
 #pragma once
 
+#include "camera_storage.h"
 #include "config.h"
 
 #include <chrono>
 #include <memory>
 
+struct frame_metadata;
 struct image;
 
 class video_storage
@@ -14,10 +16,29 @@ public:
 
   using time_point = typename clock_type::time_point;
 
-  static auto create(std::string path, float quality, float days, int storage_width, int storage_height, float rate)
-    -> std::unique_ptr<video_storage>;
+  /**
+   * @brief Creates a new video storage.
+   *
+   * @param storage The storage of the camera. The index, thumbnail stores and metadata log are filled with what
+   *                already exists on disk.
+   *
+   * @param cfg The configuration of the camera, which contains the storage options.
+   *
+   * @return A new video storage instance.
+   * */
+  static auto create(camera_storage storage, const config::camera_config& cfg) -> std::unique_ptr<video_storage>;
 
   virtual ~video_storage() = default;
 
-  virtual void store(const image& img) = 0;
+  /**
+   * @brief Offers a frame to the storage.
+   *
+   * @param img The frame to store.
+   *
+   * @param event Whether or not the frame is part of an event. Frames outside of an event are only stored if they are
+   *              within the pre-roll or post-roll of one.
+   *
+   * @param metadata The metadata of the frame, which is put into the metadata log if the frame is stored.
+   * */
+  virtual void store(const image& img, bool event, const frame_metadata& metadata) = 0;
 };
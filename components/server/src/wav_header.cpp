@@ -0,0 +1,167 @@
+#include "wav_header.h"
+
+#include <fstream>
+
+#include <cstring>
+
+namespace {
+
+void
+le16(std::uint8_t* ptr, const std::uint16_t value)
+{
+  ptr[0] = static_cast<std::uint8_t>(value);
+  ptr[1] = static_cast<std::uint8_t>(value >> 8);
+}
+
+void
+le32(std::uint8_t* ptr, const std::uint32_t value)
+{
+  le16(ptr, static_cast<std::uint16_t>(value));
+  le16(ptr + 2, static_cast<std::uint16_t>(value >> 16));
+}
+
+auto
+le16(const std::uint8_t* ptr) -> std::uint16_t
+{
+  return static_cast<std::uint16_t>(ptr[0] | (ptr[1] << 8));
+}
+
+auto
+le32(const std::uint8_t* ptr) -> std::uint32_t
+{
+  return static_cast<std::uint32_t>(le16(ptr)) | (static_cast<std::uint32_t>(le16(ptr + 2)) << 16);
+}
+
+constexpr std::uint16_t channels{ 1 };
+
+constexpr std::uint16_t bits_per_sample{ 16 };
+
+} // namespace
+
+auto
+make_wav_header(const std::uint32_t rate, const std::uint32_t data_size) -> std::array<std::uint8_t, wav_header_size>
+{
+  std::array<std::uint8_t, wav_header_size> header{};
+
+  auto* ptr = header.data();
+
+  constexpr std::uint16_t block_align{ channels * (bits_per_sample / 8) };
+
+  std::memcpy(ptr, "RIFF", 4);
+  le32(ptr + 4, static_cast<std::uint32_t>(wav_header_size - 8) + data_size);
+  std::memcpy(ptr + 8, "WAVEfmt ", 8);
+  le32(ptr + 16, 16);
+  le16(ptr + 20, 1 /* PCM */);
+  le16(ptr + 22, channels);
+  le32(ptr + 24, rate);
+  le32(ptr + 28, rate * block_align);
+  le16(ptr + 32, block_align);
+  le16(ptr + 34, bits_per_sample);
+  std::memcpy(ptr + 36, "data", 4);
+  le32(ptr + 40, data_size);
+
+  return header;
+}
+
+auto
+read_wav_header(const std::string& path, std::uint32_t& rate, std::uint32_t& data_size) -> bool
+{
+  std::ifstream file(path, std::ios::binary);
+
+  std::uint8_t header[wav_header_size]{};
+
+  if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+    return false;
+  }
+
+  if ((std::memcmp(header, "RIFF", 4) != 0) || (std::memcmp(header + 8, "WAVEfmt ", 8) != 0) ||
+      (std::memcmp(header + 36, "data", 4) != 0)) {
+    return false;
+  }
+
+  if ((le16(header + 20) != 1) || (le16(header + 22) != channels) || (le16(header + 34) != bits_per_sample)) {
+    return false;
+  }
+
+  rate = le32(header + 24);
+
+  data_size = le32(header + 40);
+
+  return rate > 0;
+}
+
+auto
+read_wav_file(const std::string& path, std::uint32_t& rate, std::vector<std::int16_t>& samples) -> bool
+{
+  std::ifstream file(path, std::ios::binary);
+
+  std::uint8_t riff[12]{};
+
+  if (!file.read(reinterpret_cast<char*>(riff), sizeof(riff)) || (std::memcmp(riff, "RIFF", 4) != 0) ||
+      (std::memcmp(riff + 8, "WAVE", 4) != 0)) {
+    return false;
+  }
+
+  std::uint16_t file_channels{};
+
+  std::uint8_t chunk[8]{};
+
+  while (file.read(reinterpret_cast<char*>(chunk), sizeof(chunk))) {
+
+    const auto chunk_size = le32(chunk + 4);
+
+    if (std::memcmp(chunk, "fmt ", 4) == 0) {
+
+      std::uint8_t fmt[16]{};
+
+      if ((chunk_size < sizeof(fmt)) || !file.read(reinterpret_cast<char*>(fmt), sizeof(fmt))) {
+        return false;
+      }
+
+      if ((le16(fmt) != 1) || (le16(fmt + 14) != bits_per_sample)) {
+        return false;
+      }
+
+      file_channels = le16(fmt + 2);
+
+      rate = le32(fmt + 4);
+
+      file.seekg(chunk_size - sizeof(fmt), std::ios::cur);
+
+    } else if (std::memcmp(chunk, "data", 4) == 0) {
+
+      if ((file_channels == 0) || (rate == 0)) {
+        return false;
+      }
+
+      std::vector<std::int16_t> interleaved(chunk_size / sizeof(std::int16_t));
+
+      /* The size is left out (or too large) in files that were not closed properly, so a short read is accepted. */
+      file.read(reinterpret_cast<char*>(interleaved.data()), interleaved.size() * sizeof(std::int16_t));
+
+      const auto frames = static_cast<std::size_t>(file.gcount()) / (sizeof(std::int16_t) * file_channels);
+
+      samples.resize(frames);
+
+      for (std::size_t i = 0; i < frames; i++) {
+
+        std::int32_t sum{};
+
+        for (std::size_t c = 0; c < file_channels; c++) {
+          const auto* ptr = reinterpret_cast<const std::uint8_t*>(&interleaved[i * file_channels + c]);
+          sum += static_cast<std::int16_t>(le16(ptr));
+        }
+
+        samples[i] = static_cast<std::int16_t>(sum / file_channels);
+      }
+
+      return true;
+
+    } else {
+      /* Chunks are padded to an even size. */
+      file.seekg(chunk_size + (chunk_size & 1), std::ios::cur);
+    }
+  }
+
+  return false;
+}
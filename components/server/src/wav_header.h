@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+/**
+ * @brief The size of the header that @ref make_wav_header produces, which is also where the samples start.
+ * */
+constexpr std::uint64_t wav_header_size{ 44 };
+
+/**
+ * @brief Makes the header of a WAV file containing mono, 16-bit PCM samples.
+ *
+ * @param rate The sampling rate, in samples per second.
+ *
+ * @param data_size The number of bytes of samples that follow the header.
+ * */
+auto
+make_wav_header(std::uint32_t rate, std::uint32_t data_size) -> std::array<std::uint8_t, wav_header_size>;
+
+/**
+ * @brief Reads the header of a WAV file that was made with @ref make_wav_header.
+ *
+ * @param path The path of the WAV file.
+ *
+ * @param rate The sampling rate, in samples per second.
+ *
+ * @param data_size The number of bytes of samples, according to the header.
+ *
+ * @return True on success, false if the file could not be read or is not a mono, 16-bit PCM file with the samples
+ *         right after the header.
+ * */
+auto
+read_wav_header(const std::string& path, std::uint32_t& rate, std::uint32_t& data_size) -> bool;
+
+/**
+ * @brief Reads all of the samples of a 16-bit PCM WAV file, which (unlike @ref read_wav_header) may come from other
+ *        programs, with any number of channels and with other chunks around the samples.
+ *
+ * @param path The path of the WAV file.
+ *
+ * @param rate The sampling rate, in samples per second.
+ *
+ * @param samples The samples, with the channels mixed down to one.
+ *
+ * @return True on success, false if the file could not be read or is not a 16-bit PCM file.
+ * */
+auto
+read_wav_file(const std::string& path, std::uint32_t& rate, std::vector<std::int16_t>& samples) -> bool;
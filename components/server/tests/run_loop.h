@@ -0,0 +1,57 @@
+#pragma once
+
+#include <uv.h>
+
+#include <cstdint>
+
+/**
+ * @brief Runs a loop until a condition is met, or until a timeout expires so that a test does not hang when what it
+ *        waits for never happens.
+ *
+ * @param timeout The longest time to wait, in milliseconds.
+ *
+ * @return True if the condition was met, false if the timeout expired first.
+ * */
+template<typename Condition>
+auto
+run_loop_until(uv_loop_t* loop, Condition condition, const std::uint64_t timeout = 10000) -> bool
+{
+  struct timeout_timer final
+  {
+    uv_timer_t handle{};
+
+    bool expired{ false };
+
+    bool closed{ false };
+  };
+
+  timeout_timer timer;
+
+  auto* handle = reinterpret_cast<uv_handle_t*>(&timer.handle);
+
+  uv_timer_init(loop, &timer.handle);
+
+  uv_handle_set_data(handle, &timer);
+
+  auto on_timeout = [](uv_timer_t* t) {
+    static_cast<timeout_timer*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(t)))->expired = true;
+  };
+
+  uv_timer_start(&timer.handle, on_timeout, timeout, 0);
+
+  auto met = condition();
+
+  while (!met && !timer.expired) {
+    uv_run(loop, UV_RUN_ONCE);
+    met = condition();
+  }
+
+  /* The timer is on the stack, so it has to be done closing before returning. */
+  uv_close(handle, [](uv_handle_t* h) { static_cast<timeout_timer*>(uv_handle_get_data(h))->closed = true; });
+
+  while (!timer.closed) {
+    uv_run(loop, UV_RUN_NOWAIT);
+  }
+
+  return met;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <filesystem>
+#include <string>
+
+#include <unistd.h>
+
+/**
+ * @brief A test fixture with an empty directory for the files of the test, which is removed when the test ends.
+ *
+ * @details The name of the directory is unique to the process and the test, so that the tests may be run in parallel
+ *          and by more than one user at a time.
+ * */
+class temp_directory_test : public testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    static std::atomic<unsigned> counter{ 0 };
+
+    const auto* info = testing::UnitTest::GetInstance()->current_test_info();
+
+    const std::string prefix = std::string("sentinel_") + info->test_suite_name() + "_" + std::to_string(getpid());
+
+    for (;;) {
+      /* A directory that is left over from an earlier process with the same ID is skipped. */
+      const auto path = std::filesystem::temp_directory_path() / (prefix + "_" + std::to_string(counter++));
+      if (std::filesystem::create_directory(path)) {
+        m_directory = path.string();
+        break;
+      }
+    }
+  }
+
+  void TearDown() override
+  {
+    if (!m_directory.empty()) {
+      std::error_code ec;
+      std::filesystem::remove_all(m_directory, ec);
+    }
+  }
+
+  std::string m_directory;
+};
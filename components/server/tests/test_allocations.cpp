@@ -0,0 +1,256 @@
+#include <gtest/gtest.h>
+
+#include "../src/allocation_counter.h"
+#include "../src/metrics.h"
+#include "../src/server.h"
+#include "../src/video_pipeline.h"
+#include "run_loop.h"
+#include "temp_directory.h"
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <uv.h>
+
+#include <array>
+#include <string>
+
+namespace {
+
+/**
+ * @brief A client of the TCP server, which counts the bytes that it receives without allocating.
+ * */
+class test_client final
+{
+public:
+  explicit test_client(uv_loop_t* loop)
+  {
+    uv_tcp_init(loop, &m_socket);
+
+    uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_socket), this);
+  }
+
+  void connect(const int port)
+  {
+    sockaddr_in address{};
+
+    uv_ip4_addr("127.0.0.1", port, &address);
+
+    uv_tcp_connect(&m_connect, &m_socket, reinterpret_cast<const sockaddr*>(&address), on_connect);
+  }
+
+  void close() { uv_close(reinterpret_cast<uv_handle_t*>(&m_socket), nullptr); }
+
+  auto get_received() const -> std::size_t { return m_received; }
+
+protected:
+  static auto get_self(uv_handle_t* handle) -> test_client*
+  {
+    return static_cast<test_client*>(uv_handle_get_data(handle));
+  }
+
+  static void on_connect(uv_connect_t* req, const int status)
+  {
+    if (status == 0) {
+      uv_read_start(req->handle, on_alloc, on_read);
+    }
+  }
+
+  static void on_alloc(uv_handle_t* handle, size_t, uv_buf_t* buf)
+  {
+    auto* self = get_self(handle);
+
+    buf->base = self->m_buffer.data();
+
+    buf->len = self->m_buffer.size();
+  }
+
+  static void on_read(uv_stream_t* stream, const ssize_t read_size, const uv_buf_t*)
+  {
+    if (read_size > 0) {
+      get_self(reinterpret_cast<uv_handle_t*>(stream))->m_received += static_cast<std::size_t>(read_size);
+    }
+  }
+
+private:
+  uv_tcp_t m_socket{};
+
+  uv_connect_t m_connect{};
+
+  std::array<char, 65536> m_buffer{};
+
+  std::size_t m_received{};
+};
+
+/**
+ * @brief Gets the allocations counted in one stage of the video pipeline, from the exported metrics.
+ * */
+auto
+get_stage_allocations(metrics_registry& metrics, const std::string& stage) -> std::uint64_t
+{
+  const std::string series{ "sentinel_pipeline_stage_allocations_total{pipeline=\"video\",sensor=\"1\",stage=\"" +
+                            stage + "\"} " };
+
+  const auto text = metrics.export_text();
+
+  const auto offset = text.find(series);
+
+  return (offset == std::string::npos) ? 0 : std::stoull(text.substr(offset + series.size()));
+}
+
+class Allocations : public temp_directory_test
+{
+protected:
+  struct result final
+  {
+    std::uint64_t frames{};
+
+    /**
+     * @brief The allocations of the encode stage, which composes the message of the frame.
+     * */
+    std::uint64_t encode{};
+
+    /**
+     * @brief The allocations made from when the message is given to the server until every client has received it.
+     * */
+    std::uint64_t fan_out{};
+  };
+
+  void SetUp() override
+  {
+    if (!allocation_counter::enabled) {
+      GTEST_SKIP() << "The server was built without ENABLE_ALLOCATION_COUNTING.";
+    }
+
+    temp_directory_test::SetUp();
+
+    for (int i = 0; i < 3; i++) {
+      const auto path = m_directory + "/" + std::to_string(1000 * (i + 1)) + ".jpg";
+      cv::imwrite(path, cv::Mat(48, 64, CV_8UC3, cv::Scalar(10 * (i + 1))));
+    }
+  }
+
+  /**
+   * @brief Sends frames from a replayed camera to the clients, and counts the allocations of the frames that are sent
+   *        after the warm-up.
+   * */
+  void run(const std::size_t client_count, result& r)
+  {
+    config::camera_config cfg;
+    cfg.sensor_id = 1;
+    cfg.replay_path = m_directory;
+    cfg.replay_realtime = false;
+    cfg.replay_loop = true;
+    cfg.storage_enabled = false;
+
+    metrics_registry metrics;
+
+    auto p = video_pipeline::create(cfg, camera_storage{}, metrics);
+
+    uv_loop_t loop{};
+
+    uv_loop_init(&loop);
+
+    auto s = server::create(&loop, metrics);
+
+    /* The system picks a free port, so that the test does not collide with anything else that is listening. */
+    ASSERT_TRUE(s->setup("127.0.0.1", 0));
+
+    std::vector<std::unique_ptr<test_client>> clients;
+
+    for (std::size_t i = 0; i < client_count; i++) {
+      clients.emplace_back(new test_client(&loop));
+      clients.back()->connect(s->get_port());
+    }
+
+    const auto all_received = [&](const std::vector<std::size_t>& expected) -> bool {
+      for (std::size_t i = 0; i < clients.size(); i++) {
+        if (clients[i]->get_received() < expected[i]) {
+          return false;
+        }
+      }
+      return true;
+    };
+
+    std::vector<std::size_t> expected(clients.size());
+
+    const auto send_frame = [&]() -> std::uint64_t {
+      auto should_close = false;
+
+      auto msgs = p->loop(should_close);
+
+      if (msgs.size() != 1) {
+        ADD_FAILURE() << "The pipeline did not produce a frame.";
+        return 0;
+      }
+
+      const auto start = allocation_counter::get_thread_count();
+
+      for (std::size_t i = 0; i < clients.size(); i++) {
+        expected[i] = clients[i]->get_received() + msgs[0]->buffer->size();
+      }
+
+      s->publish_telemetry(msgs[0]);
+
+      if (!run_loop_until(&loop, [&]() -> bool { return all_received(expected); })) {
+        ADD_FAILURE() << "The clients did not receive the frame.";
+      }
+
+      return allocation_counter::get_thread_count() - start;
+    };
+
+    /* The server only sends to the clients that it accepted, so frames are sent until each client has one. */
+    const std::vector<std::size_t> first_frame(clients.size(), 1);
+
+    for (int i = 0; (i < 100) && !all_received(first_frame); i++) {
+      auto should_close = false;
+      auto msgs = p->loop(should_close);
+      ASSERT_EQ(msgs.size(), 1);
+      s->publish_telemetry(msgs[0]);
+      run_loop_until(&loop, [&]() -> bool { return all_received(first_frame); }, 100);
+    }
+
+    ASSERT_TRUE(all_received(first_frame)) << "The clients did not connect.";
+
+    /* The warm-up grows the buffers and pools that are reused afterwards. */
+    for (int i = 0; i < 10; i++) {
+      send_frame();
+    }
+
+    const auto encode_start = get_stage_allocations(metrics, "encode");
+
+    for (r.frames = 0; r.frames < 30; r.frames++) {
+      r.fan_out += send_frame();
+    }
+
+    r.encode = get_stage_allocations(metrics, "encode") - encode_start;
+
+    for (auto& c : clients) {
+      c->close();
+    }
+
+    s->close();
+
+    uv_run(&loop, UV_RUN_DEFAULT);
+
+    s.reset();
+
+    uv_loop_close(&loop);
+  }
+};
+
+} // namespace
+
+TEST_F(Allocations, SendsFramesToClientsWithoutAllocating)
+{
+  for (const std::size_t client_count : { 1, 8 }) {
+
+    result r;
+
+    ASSERT_NO_FATAL_FAILURE(run(client_count, r));
+
+    /* The buffer of the message, the message and the shared buffer pointer. */
+    EXPECT_LE(r.encode, r.frames * 3) << client_count << " clients";
+
+    EXPECT_EQ(r.fan_out, 0) << client_count << " clients";
+  }
+}
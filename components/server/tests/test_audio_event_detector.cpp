@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+
+#include "../src/audio_event_detector.h"
+
+#include <random>
+#include <vector>
+
+namespace {
+
+constexpr std::uint32_t rate{ 8000 };
+
+constexpr std::size_t period_size{ 800 };
+
+auto
+make_noise(std::mt19937& rng, const int amplitude) -> std::vector<std::int16_t>
+{
+  std::uniform_int_distribution<int> dist(-amplitude, amplitude);
+
+  std::vector<std::int16_t> samples(period_size);
+
+  for (auto& s : samples) {
+    s = static_cast<std::int16_t>(dist(rng));
+  }
+
+  return samples;
+}
+
+} // namespace
+
+TEST(AudioEventDetector, StartsAndEndsWithHysteresis)
+{
+  std::mt19937 rng(0);
+
+  audio_event_detector detector(12.0f, 6.0f, 100.0f, 0.5f);
+
+  /* Two seconds of background noise, which becomes the noise floor. */
+  for (int i = 0; i < 20; i++) {
+    const auto samples = make_noise(rng, 100);
+    EXPECT_FALSE(detector.update(samples.data(), samples.size(), rate));
+  }
+
+  EXPECT_FALSE(detector.is_active());
+
+  const auto floor = detector.get_noise_floor();
+
+  /* A loud sound, 40 dB above the background. */
+  auto samples = make_noise(rng, 10000);
+  EXPECT_TRUE(detector.update(samples.data(), samples.size(), rate));
+  EXPECT_TRUE(detector.is_active());
+
+  /* The noise floor does not follow the event. */
+  for (int i = 0; i < 10; i++) {
+    samples = make_noise(rng, 10000);
+    EXPECT_FALSE(detector.update(samples.data(), samples.size(), rate));
+  }
+
+  EXPECT_NEAR(detector.get_noise_floor(), floor, 1.0e-3f);
+
+  /* The event continues until the level has been near the floor for the hold time (five periods). */
+  for (int i = 0; i < 4; i++) {
+    samples = make_noise(rng, 100);
+    EXPECT_FALSE(detector.update(samples.data(), samples.size(), rate));
+    EXPECT_TRUE(detector.is_active());
+  }
+
+  samples = make_noise(rng, 100);
+  EXPECT_TRUE(detector.update(samples.data(), samples.size(), rate));
+  EXPECT_FALSE(detector.is_active());
+}
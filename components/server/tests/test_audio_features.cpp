@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+
+#include "../src/audio_features.h"
+
+#include <cmath>
+
+TEST(AudioFeatures, PeakAndRms)
+{
+  audio_features features(0);
+
+  const std::int16_t samples[4]{ 16384, -16384, 16384, -16384 };
+  features.add(samples, 4, 8000);
+
+  EXPECT_EQ(features.get_sample_count(), 4);
+  EXPECT_FLOAT_EQ(features.get_peak(), 0.5f);
+  EXPECT_FLOAT_EQ(features.get_rms(), 0.5f);
+  EXPECT_TRUE(features.get_bands().empty());
+
+  features.reset();
+  EXPECT_EQ(features.get_sample_count(), 0);
+  EXPECT_FLOAT_EQ(features.get_peak(), 0.0f);
+  EXPECT_FLOAT_EQ(features.get_rms(), 0.0f);
+}
+
+TEST(AudioFeatures, ToneEnergyIsInItsBand)
+{
+  constexpr std::uint32_t rate{ 8000 };
+
+  /* Falls exactly on a bin, so that none of its energy leaks into the other bands. */
+  constexpr double frequency{ 1000.0 };
+
+  std::vector<std::int16_t> samples(1024);
+
+  for (std::size_t i = 0; i < samples.size(); i++) {
+    samples[i] = static_cast<std::int16_t>(16384.0 * std::cos(2.0 * 3.14159265358979323846 * frequency * i / rate));
+  }
+
+  audio_features features(4);
+  features.add(samples.data(), samples.size(), rate);
+  features.add(samples.data(), samples.size(), rate);
+
+  const auto& bands = features.get_bands();
+  ASSERT_EQ(bands.size(), 4);
+
+  /* With bands from 50 Hz to 4 kHz, the third one covers 1 kHz. */
+  EXPECT_NEAR(bands[0], 0.0f, 1.0e-6f);
+  EXPECT_NEAR(bands[1], 0.0f, 1.0e-6f);
+  EXPECT_NEAR(bands[2], 0.125f, 1.0e-3f);
+  EXPECT_NEAR(bands[3], 0.0f, 1.0e-6f);
+
+  EXPECT_NEAR(features.get_rms() * features.get_rms(), bands[2], 1.0e-3f);
+}
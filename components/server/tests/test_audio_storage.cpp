@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+
+#include "../src/audio_storage.h"
+#include "../src/wav_header.h"
+#include "temp_directory.h"
+
+#include <limits>
+
+namespace {
+
+constexpr auto max_time = std::numeric_limits<std::uint64_t>::max();
+
+constexpr std::uint32_t rate{ 8000 };
+
+constexpr std::uint64_t segment_duration{ 60ULL * 1000 * 1000 };
+
+class AudioStorage : public temp_directory_test
+{};
+
+} // namespace
+
+TEST_F(AudioStorage, StoreAndQuery)
+{
+  /* Recent enough to not be removed by the retention policy. */
+  const std::uint64_t t0 = 4000000000000000ULL;
+
+  const std::vector<std::int16_t> period(800, 1);
+
+  {
+    audio_storage storage(m_directory, segment_duration, max_time / 2);
+    storage.start();
+
+    /* 2.5 seconds of audio, in periods of 0.1 seconds. */
+    for (std::uint64_t i = 0; i < 25; i++) {
+      storage.store(t0 + (i * 100000), rate, period.data(), period.size());
+    }
+
+    /* A gap of a second, which starts a new segment. */
+    for (std::uint64_t i = 0; i < 5; i++) {
+      storage.store(t0 + 3500000 + (i * 100000), rate, period.data(), period.size());
+    }
+  }
+
+  audio_storage storage(m_directory, segment_duration, max_time / 2);
+  storage.start();
+
+  auto regions = storage.query(0, max_time);
+  ASSERT_EQ(regions.size(), 2);
+  EXPECT_EQ(regions[0].segment, t0);
+  EXPECT_EQ(regions[0].rate, rate);
+  EXPECT_EQ(regions[0].offset, wav_header_size);
+  EXPECT_EQ(regions[0].size, 25 * period.size() * sizeof(std::int16_t));
+  EXPECT_EQ(regions[1].segment, t0 + 3500000);
+  EXPECT_EQ(regions[1].size, 5 * period.size() * sizeof(std::int16_t));
+  EXPECT_EQ(regions[0].time, t0);
+  EXPECT_EQ(regions[0].get_end_time(), t0 + 2500000);
+  EXPECT_EQ(regions[1].time, t0 + 3500000);
+  EXPECT_FALSE(regions[1].follows(regions[0]));
+
+  std::uint32_t header_rate{};
+  std::uint32_t data_size{};
+  ASSERT_TRUE(read_wav_header(storage.get_segment_path(t0), header_rate, data_size));
+  EXPECT_EQ(header_rate, rate);
+  EXPECT_EQ(data_size, regions[0].size);
+
+  /* One second into the first segment, until just before the second one. */
+  regions = storage.query(t0 + 1000000, t0 + 3000000);
+  ASSERT_EQ(regions.size(), 1);
+  EXPECT_EQ(regions[0].offset, wav_header_size + (rate * sizeof(std::int16_t)));
+  EXPECT_EQ(regions[0].time, t0 + 1000000);
+  EXPECT_EQ(regions[0].size, (25 * period.size() - rate) * sizeof(std::int16_t));
+
+  EXPECT_EQ(storage.get_dropped_samples(), 0);
+}
+
+TEST_F(AudioStorage, SegmentsWithoutGapsFollowEachOther)
+{
+  const std::uint64_t t0 = 4000000000000000ULL;
+
+  const std::vector<std::int16_t> period(800, 1);
+
+  {
+    audio_storage storage(m_directory, 1000000, max_time / 2);
+    storage.start();
+
+    /* 2.5 seconds of audio, which is split into segments of a second. */
+    for (std::uint64_t i = 0; i < 25; i++) {
+      storage.store(t0 + (i * 100000), rate, period.data(), period.size());
+    }
+  }
+
+  audio_storage storage(m_directory, 1000000, max_time / 2);
+  storage.start();
+
+  const auto regions = storage.query(0, max_time);
+  ASSERT_EQ(regions.size(), 3);
+  EXPECT_TRUE(regions[1].follows(regions[0]));
+  EXPECT_TRUE(regions[2].follows(regions[1]));
+  EXPECT_EQ(regions[2].get_end_time(), t0 + 2500000);
+}
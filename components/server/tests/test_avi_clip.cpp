@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+
+#include "../src/avi_clip.h"
+#include "temp_directory.h"
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+class AviClip : public temp_directory_test
+{
+protected:
+  /**
+   * @brief Writes a frame file that starts with a start-of-frame segment and is padded out to the given size.
+   * */
+  void write_frame(const std::uint64_t time, const std::size_t size)
+  {
+    std::vector<std::uint8_t> data{ 0xff, 0xd8, 0xff, 0xc0, 0x00, 0x11, 0x08, 0x00, 0x30, 0x00, 0x40 };
+
+    data.resize(size, static_cast<std::uint8_t>(time));
+
+    std::ofstream file(m_index->get_path(time), std::ios::binary);
+
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+    m_frames.emplace_back(data);
+  }
+
+  void SetUp() override
+  {
+    temp_directory_test::SetUp();
+
+    m_index = std::make_shared<storage_index>(m_directory);
+
+    /* An odd size, to check that chunks are padded to an even size. */
+    write_frame(1000000, 31);
+    write_frame(1100000, 40);
+    write_frame(1200000, 33);
+
+    m_index->scan();
+  }
+
+  /**
+   * @brief Produces the whole clip in memory.
+   * */
+  static auto write_clip(avi_clip& clip) -> std::vector<std::uint8_t>
+  {
+    auto* file = std::tmpfile();
+
+    EXPECT_TRUE(write_http_body(clip, file));
+
+    std::vector<std::uint8_t> data(static_cast<std::size_t>(std::ftell(file)));
+
+    std::rewind(file);
+
+    EXPECT_EQ(std::fread(data.data(), 1, data.size(), file), data.size());
+
+    std::fclose(file);
+
+    return data;
+  }
+
+  static auto u32_at(const std::vector<std::uint8_t>& data, const std::size_t offset) -> std::uint32_t
+  {
+    std::uint32_t value{};
+    if ((offset + sizeof(value)) > data.size()) {
+      ADD_FAILURE() << "Offset " << offset << " is past the end of the clip.";
+      return value;
+    }
+    std::memcpy(&value, data.data() + offset, sizeof(value));
+    return value;
+  }
+
+  static auto fourcc_at(const std::vector<std::uint8_t>& data, const std::size_t offset) -> std::string
+  {
+    if ((offset + 4) > data.size()) {
+      ADD_FAILURE() << "Offset " << offset << " is past the end of the clip.";
+      return std::string();
+    }
+    return std::string(reinterpret_cast<const char*>(data.data() + offset), 4);
+  }
+
+  std::shared_ptr<storage_index> m_index;
+
+  std::vector<std::vector<std::uint8_t>> m_frames;
+};
+
+} // namespace
+
+TEST_F(AviClip, Layout)
+{
+  avi_clip clip(m_index, m_index->query(0, 2000000, 0, 100));
+
+  const auto data = write_clip(clip);
+
+  ASSERT_EQ(data.size(), clip.get_file_size());
+
+  EXPECT_EQ(fourcc_at(data, 0), "RIFF");
+  EXPECT_EQ(u32_at(data, 4), data.size() - 8);
+  EXPECT_EQ(fourcc_at(data, 8), "AVI ");
+
+  EXPECT_EQ(fourcc_at(data, 12), "LIST");
+  EXPECT_EQ(fourcc_at(data, 20), "hdrl");
+  /* The header list ends where the movie list begins. */
+  EXPECT_EQ(20 + u32_at(data, 16), 212);
+
+  EXPECT_EQ(fourcc_at(data, 24), "avih");
+  EXPECT_EQ(u32_at(data, 32), 100000);
+  EXPECT_EQ(u32_at(data, 48), 3);
+  EXPECT_EQ(u32_at(data, 60), 40);
+  /* The frame size is read from the first frame. */
+  EXPECT_EQ(u32_at(data, 64), 64);
+  EXPECT_EQ(u32_at(data, 68), 48);
+
+  EXPECT_EQ(fourcc_at(data, 212), "LIST");
+  EXPECT_EQ(fourcc_at(data, 220), "movi");
+
+  const std::size_t movi = 220;
+
+  const auto idx1 = movi + u32_at(data, 216);
+
+  /* Each chunk holds the frame file as-is, padded to an even size. */
+  auto offset = movi + 4;
+
+  for (const auto& frame : m_frames) {
+    EXPECT_EQ(fourcc_at(data, offset), "00dc");
+    ASSERT_EQ(u32_at(data, offset + 4), frame.size());
+    EXPECT_TRUE(std::equal(frame.begin(), frame.end(), data.begin() + static_cast<std::ptrdiff_t>(offset + 8)));
+    offset += 8 + frame.size() + (frame.size() & 1);
+  }
+
+  ASSERT_EQ(offset, idx1);
+
+  EXPECT_EQ(fourcc_at(data, idx1), "idx1");
+  EXPECT_EQ(u32_at(data, idx1 + 4), m_frames.size() * 16);
+  EXPECT_EQ(idx1 + 8 + (m_frames.size() * 16), data.size());
+
+  /* The index entries point at the chunks, relative to the start of the movie list. */
+  for (std::size_t i = 0; i < m_frames.size(); i++) {
+    const auto entry = idx1 + 8 + (i * 16);
+    EXPECT_EQ(fourcc_at(data, entry), "00dc");
+    const auto chunk = movi + u32_at(data, entry + 8);
+    EXPECT_EQ(fourcc_at(data, chunk), "00dc");
+    EXPECT_EQ(u32_at(data, chunk + 4), u32_at(data, entry + 12));
+    EXPECT_EQ(u32_at(data, entry + 12), m_frames[i].size());
+  }
+}
+
+TEST_F(AviClip, EmptyClip)
+{
+  avi_clip clip(m_index, {});
+
+  const auto data = write_clip(clip);
+
+  ASSERT_EQ(data.size(), clip.get_file_size());
+  EXPECT_EQ(u32_at(data, 48), 0);
+  EXPECT_EQ(fourcc_at(data, 224), "idx1");
+  EXPECT_EQ(u32_at(data, 228), 0);
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include "../src/capture_group.h"
+
+#include <unistd.h>
+
+namespace {
+
+/**
+ * @brief A pipeline that produces a message whenever a byte can be read from a pipe.
+ * */
+class pipe_pipeline final : public pipeline
+{
+public:
+  explicit pipe_pipeline(const int fd)
+    : m_fd(fd)
+  {
+  }
+
+  auto loop(bool&) -> std::vector<std::shared_ptr<sentinel::proto::outbound_message>> override { return {}; }
+
+  auto get_poll_descriptors(std::vector<pollfd>& fds, int&) -> bool override
+  {
+    fds.emplace_back(pollfd{ m_fd, POLLIN, 0 });
+    return true;
+  }
+
+  auto poll(pollfd* fds, const std::size_t count, bool&)
+    -> std::vector<std::shared_ptr<sentinel::proto::outbound_message>> override
+  {
+    if ((count != 1) || !(fds[0].revents & POLLIN)) {
+      return {};
+    }
+
+    char c{};
+    [[maybe_unused]] const auto result = read(m_fd, &c, 1);
+
+    return { std::make_shared<sentinel::proto::outbound_message>() };
+  }
+
+private:
+  int m_fd{ -1 };
+};
+
+class observer final : public telemetry_observer
+{
+public:
+  explicit observer(uv_loop_t* loop)
+    : m_loop(loop)
+  {
+  }
+
+  void observe_telemetry(std::shared_ptr<sentinel::proto::outbound_message>&) override
+  {
+    m_count++;
+    uv_stop(m_loop);
+  }
+
+  auto count() const -> int { return m_count; }
+
+private:
+  uv_loop_t* m_loop{ nullptr };
+
+  int m_count{};
+};
+
+} // namespace
+
+TEST(CaptureGroup, PollsPipelines)
+{
+  int fds[2]{ -1, -1 };
+  ASSERT_EQ(pipe(fds), 0);
+
+  uv_loop_t loop{};
+
+  uv_loop_init(&loop);
+
+  std::vector<std::unique_ptr<pipeline>> pipelines;
+  pipelines.emplace_back(std::make_unique<pipe_pipeline>(fds[0]));
+
+  capture_group group(&loop, std::move(pipelines));
+
+  observer obs(&loop);
+
+  group.add_telemetry_observer(&obs);
+
+  const char c{ 'x' };
+  ASSERT_EQ(write(fds[1], &c, 1), 1);
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+
+  EXPECT_EQ(obs.count(), 1);
+
+  group.close();
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+
+  uv_loop_close(&loop);
+
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
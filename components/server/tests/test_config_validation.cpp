@@ -35,3 +35,48 @@ TEST(Config, ValidateDuplicateMicrophoneNames)
 
   EXPECT_THROW(cfg.validate(), std::runtime_error);
 }
+
+namespace {
+
+/**
+ * @brief Validates a camera with one storage tier.
+ * */
+void
+validate_storage_tier(const float age, const float interval, const int width = -1, const int height = -1)
+{
+  config::camera_config cam;
+  cam.name = "camera 0";
+  cam.storage_tiers.emplace_back(config::storage_tier_config{ age, interval, width, height });
+
+  config cfg;
+
+  cfg.cameras.emplace_back(cam);
+
+  cfg.validate();
+}
+
+} // namespace
+
+TEST(Config, ValidateStorageTier)
+{
+  EXPECT_NO_THROW(validate_storage_tier(60, 10));
+  EXPECT_NO_THROW(validate_storage_tier(60, 0, 320, 240));
+}
+
+TEST(Config, ValidateStorageTierAge)
+{
+  EXPECT_THROW(validate_storage_tier(0, 10), std::runtime_error);
+  EXPECT_THROW(validate_storage_tier(-60, 10), std::runtime_error);
+}
+
+TEST(Config, ValidateStorageTierInterval)
+{
+  EXPECT_THROW(validate_storage_tier(60, -1), std::runtime_error);
+}
+
+TEST(Config, ValidateStorageTierSize)
+{
+  EXPECT_THROW(validate_storage_tier(60, 10, 0, 0), std::runtime_error);
+  EXPECT_THROW(validate_storage_tier(60, 10, 320, 0), std::runtime_error);
+  EXPECT_THROW(validate_storage_tier(60, 10, -2, 240), std::runtime_error);
+}
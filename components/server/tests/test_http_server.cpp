@@ -0,0 +1,197 @@
+#include <gtest/gtest.h>
+
+#include "../src/http_handler.h"
+#include "../src/http_server.h"
+#include "../src/metrics.h"
+#include "run_loop.h"
+
+#include <uv.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief A body that is sent in several pieces, each of which takes a separate write.
+ * */
+class piece_body final : public http_body
+{
+public:
+  explicit piece_body(std::vector<std::string> pieces)
+    : m_pieces(std::move(pieces))
+  {
+  }
+
+  auto get_size() const -> std::size_t override
+  {
+    std::size_t size{};
+    for (const auto& p : m_pieces) {
+      size += p.size();
+    }
+    return size;
+  }
+
+  auto next(http_body_chunk& chunk) -> bool override
+  {
+    if (m_next >= m_pieces.size()) {
+      return false;
+    }
+    const auto& p = m_pieces[m_next++];
+    chunk.data.assign(p.begin(), p.end());
+    return true;
+  }
+
+private:
+  std::vector<std::string> m_pieces;
+
+  std::size_t m_next{};
+};
+
+class test_handler final : public http_handler
+{
+public:
+  auto handle_get(const http_request& req, http_response& res) -> bool override
+  {
+    if (req.path == "/streamed") {
+      res.content_type = "text/plain";
+      res.body = std::make_unique<piece_body>(std::vector<std::string>{ "aaaa", "bbbb", "cccc" });
+      return true;
+    }
+
+    if (req.path == "/small") {
+      res = http_response::from_string(200, "text/plain", "small");
+      return true;
+    }
+
+    return false;
+  }
+};
+
+/**
+ * @brief A client that sends raw bytes to the HTTP server and keeps everything that it receives.
+ * */
+class test_client final
+{
+public:
+  explicit test_client(uv_loop_t* loop)
+  {
+    uv_tcp_init(loop, &m_socket);
+
+    uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_socket), this);
+  }
+
+  /**
+   * @brief Connects to the server and sends the data in a single write.
+   * */
+  void send(const int port, std::string data)
+  {
+    m_request = std::move(data);
+
+    sockaddr_in address{};
+
+    uv_ip4_addr("127.0.0.1", port, &address);
+
+    uv_tcp_connect(&m_connect, &m_socket, reinterpret_cast<const sockaddr*>(&address), on_connect);
+  }
+
+  void close() { uv_close(reinterpret_cast<uv_handle_t*>(&m_socket), nullptr); }
+
+  auto get_received() const -> const std::string& { return m_received; }
+
+protected:
+  static auto get_self(uv_handle_t* handle) -> test_client*
+  {
+    return static_cast<test_client*>(uv_handle_get_data(handle));
+  }
+
+  static void on_connect(uv_connect_t* req, const int status)
+  {
+    if (status != 0) {
+      return;
+    }
+
+    auto* self = get_self(reinterpret_cast<uv_handle_t*>(req->handle));
+
+    uv_buf_t buf = uv_buf_init(self->m_request.data(), static_cast<unsigned int>(self->m_request.size()));
+
+    uv_write(&self->m_write, req->handle, &buf, 1, nullptr);
+
+    uv_read_start(req->handle, on_alloc, on_read);
+  }
+
+  static void on_alloc(uv_handle_t* handle, size_t, uv_buf_t* buf)
+  {
+    auto* self = get_self(handle);
+
+    buf->base = self->m_buffer.data();
+
+    buf->len = self->m_buffer.size();
+  }
+
+  static void on_read(uv_stream_t* stream, const ssize_t read_size, const uv_buf_t* buf)
+  {
+    if (read_size > 0) {
+      get_self(reinterpret_cast<uv_handle_t*>(stream))->m_received.append(buf->base, static_cast<std::size_t>(read_size));
+    }
+  }
+
+private:
+  uv_tcp_t m_socket{};
+
+  uv_connect_t m_connect{};
+
+  uv_write_t m_write{};
+
+  std::string m_request;
+
+  std::array<char, 4096> m_buffer{};
+
+  std::string m_received;
+};
+
+} // namespace
+
+TEST(HttpServer, PipelinedRequestsWaitForStreamedBody)
+{
+  uv_loop_t loop{};
+
+  uv_loop_init(&loop);
+
+  metrics_registry metrics;
+
+  auto s = http_server::create(&loop, metrics);
+
+  s->add_handler(std::make_unique<test_handler>());
+
+  ASSERT_TRUE(s->setup("127.0.0.1", 0));
+
+  test_client client(&loop);
+
+  /* The requests arrive together, so the ones after the first are already read while its body is being sent. */
+  client.send(s->get_port(),
+              "GET /streamed HTTP/1.1\r\n\r\n"
+              "GET /small HTTP/1.1\r\n\r\n"
+              "GET /streamed HTTP/1.1\r\n\r\n");
+
+  const std::string streamed{ "HTTP/1.1 200\r\nContent-Type: text/plain\r\nContent-Length: 12\r\n\r\naaaabbbbcccc" };
+
+  const std::string small{ "HTTP/1.1 200\r\nContent-Type: text/plain\r\nContent-Length: 5\r\n\r\nsmall" };
+
+  const auto expected = streamed + small + streamed;
+
+  EXPECT_TRUE(run_loop_until(&loop, [&]() { return client.get_received().size() >= expected.size(); }));
+
+  EXPECT_EQ(client.get_received(), expected);
+
+  client.close();
+
+  s->close();
+
+  uv_run(&loop, UV_RUN_DEFAULT);
+
+  s.reset();
+
+  EXPECT_EQ(uv_loop_close(&loop), 0);
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include "../src/metadata_log.h"
+#include "temp_directory.h"
+
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+namespace {
+
+class MetadataLog : public temp_directory_test
+{};
+
+constexpr auto nan = std::numeric_limits<float>::quiet_NaN();
+
+} // namespace
+
+TEST_F(MetadataLog, QueryPredicates)
+{
+  const auto t0 = metadata_log::segment_duration * 10;
+
+  {
+    metadata_log log(m_directory);
+    log.scan();
+    EXPECT_TRUE(log.append(metadata_log::row{ t0, 0.1f, nan, 0, 100 }));
+    EXPECT_TRUE(log.append(metadata_log::row{ t0 + 1, 0.9f, 0.5f, 2, 200 }));
+    EXPECT_TRUE(log.append(metadata_log::row{ t0 + 2, 0.8f, nan, 0, 300 }));
+    EXPECT_TRUE(log.append(metadata_log::row{ t0 + metadata_log::segment_duration, 0.95f, 0.1f, 1, 400 }));
+  }
+
+  metadata_log log(m_directory);
+  log.scan();
+
+  EXPECT_EQ(log.query(metadata_log::predicate{}, 100).size(), 4);
+
+  metadata_log::predicate p;
+  p.min_filter_score = 0.5f;
+  auto rows = log.query(p, 100);
+  ASSERT_EQ(rows.size(), 3);
+  EXPECT_EQ(rows[0].time, t0 + 1);
+  EXPECT_EQ(rows[0].size, 200);
+  EXPECT_EQ(rows[2].time, t0 + metadata_log::segment_duration);
+
+  p.min_detections = 1;
+  p.to = t0 + 2;
+  rows = log.query(p, 100);
+  ASSERT_EQ(rows.size(), 1);
+  EXPECT_EQ(rows[0].detections, 2);
+  EXPECT_FLOAT_EQ(rows[0].anomaly_score, 0.5f);
+
+  EXPECT_EQ(log.query(metadata_log::predicate{}, 2).size(), 2);
+}
+
+TEST_F(MetadataLog, ScanTruncatesPartialRow)
+{
+  const auto t0 = metadata_log::segment_duration * 10;
+
+  {
+    metadata_log log(m_directory);
+    log.scan();
+    EXPECT_TRUE(log.append(metadata_log::row{ t0, 0.1f, nan, 0, 100 }));
+    EXPECT_TRUE(log.append(metadata_log::row{ t0 + 1, 0.2f, nan, 0, 100 }));
+  }
+
+  metadata_log log(m_directory);
+
+  /* Simulates a row that was cut off before its time value was written. */
+  {
+    std::ofstream file(log.get_column_path(t0, 1), std::ios::binary | std::ios::app);
+    const float score{ 0.3f };
+    file.write(reinterpret_cast<const char*>(&score), sizeof(score));
+  }
+
+  log.scan();
+
+  EXPECT_EQ(std::filesystem::file_size(log.get_column_path(t0, 1)), 2 * sizeof(float));
+  EXPECT_TRUE(log.append(metadata_log::row{ t0 + 2, 0.4f, nan, 0, 100 }));
+
+  const auto rows = log.query(metadata_log::predicate{}, 100);
+  ASSERT_EQ(rows.size(), 3);
+  EXPECT_FLOAT_EQ(rows[2].filter_score, 0.4f);
+
+  log.remove_before(t0 + metadata_log::segment_duration);
+  EXPECT_TRUE(log.query(metadata_log::predicate{}, 100).empty());
+}
+
+TEST_F(MetadataLog, UpdateSize)
+{
+  const auto t0 = metadata_log::segment_duration * 10;
+
+  metadata_log log(m_directory);
+  log.scan();
+
+  for (std::uint64_t i = 0; i < 4; i++) {
+    EXPECT_TRUE(log.append(metadata_log::row{ t0 + i, 0.5f, nan, 0, 100 }));
+  }
+
+  EXPECT_TRUE(log.update_size(t0 + 1, 40));
+  EXPECT_TRUE(log.update_size(t0 + 2, 0));
+  EXPECT_FALSE(log.update_size(t0 + 10, 40));
+  EXPECT_FALSE(log.update_size(t0 + metadata_log::segment_duration, 40));
+
+  /* Rows can still be appended after a row was changed. */
+  EXPECT_TRUE(log.append(metadata_log::row{ t0 + 4, 0.5f, nan, 0, 100 }));
+
+  const auto rows = log.query(metadata_log::predicate{}, 100);
+
+  /* The row with a size of zero belongs to a deleted frame. */
+  ASSERT_EQ(rows.size(), 4);
+  EXPECT_EQ(rows[0].size, 100);
+  EXPECT_EQ(rows[1].time, t0 + 1);
+  EXPECT_EQ(rows[1].size, 40);
+  EXPECT_FLOAT_EQ(rows[1].filter_score, 0.5f);
+  EXPECT_EQ(rows[2].time, t0 + 3);
+  EXPECT_EQ(rows[3].time, t0 + 4);
+}
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+
+#include "../src/metrics.h"
+
+TEST(LatencyHistogram, PlacesDurationsInBuckets)
+{
+  EXPECT_EQ(latency_histogram::get_bucket(0), 0);
+  EXPECT_EQ(latency_histogram::get_bucket(999), 0);
+  EXPECT_EQ(latency_histogram::get_bucket(1000), 1);
+  EXPECT_EQ(latency_histogram::get_bucket(1999), 1);
+  EXPECT_EQ(latency_histogram::get_bucket(2000), 2);
+  EXPECT_EQ(latency_histogram::get_bucket(1000000), 10);
+  EXPECT_EQ(latency_histogram::get_bucket(1000000000000ULL), latency_histogram::bucket_count - 1);
+
+  latency_histogram h;
+  h.record(500);
+  h.record(1500);
+  h.record(1500);
+
+  const auto snap = h.get_snapshot();
+  EXPECT_EQ(snap.count, 3);
+  EXPECT_EQ(snap.sum, 3500);
+  EXPECT_EQ(snap.buckets[0], 1);
+  EXPECT_EQ(snap.buckets[1], 2);
+}
+
+TEST(MetricsRegistry, ExportsCumulativeBuckets)
+{
+  metrics_registry metrics;
+
+  auto h = add_stage_histogram(metrics, "video", 3, "encode");
+  h->record(500);
+  h->record(1500);
+
+  const auto text = metrics.export_text();
+
+  const std::string name = "sentinel_pipeline_stage_seconds";
+  const std::string labels = "pipeline=\"video\",sensor=\"3\",stage=\"encode\"";
+
+  EXPECT_NE(text.find("# TYPE " + name + " histogram\n"), std::string::npos);
+  EXPECT_NE(text.find(name + "_bucket{" + labels + ",le=\"1e-06\"} 1\n"), std::string::npos);
+  EXPECT_NE(text.find(name + "_bucket{" + labels + ",le=\"2e-06\"} 2\n"), std::string::npos);
+  EXPECT_NE(text.find(name + "_bucket{" + labels + ",le=\"+Inf\"} 2\n"), std::string::npos);
+  EXPECT_NE(text.find(name + "_sum{" + labels + "} 2e-06\n"), std::string::npos);
+  EXPECT_NE(text.find(name + "_count{" + labels + "} 2\n"), std::string::npos);
+}
+
+TEST(MetricsRegistry, DropsReleasedHistograms)
+{
+  metrics_registry metrics;
+
+  auto a = add_write_histogram(metrics, "http", 0);
+  auto b = add_write_histogram(metrics, "http", 1);
+
+  EXPECT_NE(metrics.export_text().find("client=\"0\""), std::string::npos);
+
+  a.reset();
+
+  const auto text = metrics.export_text();
+  EXPECT_EQ(text.find("client=\"0\""), std::string::npos);
+  EXPECT_NE(text.find("client=\"1\""), std::string::npos);
+
+  b.reset();
+
+  EXPECT_TRUE(metrics.export_text().empty());
+}
+
+TEST(MetricsRegistry, DropsReleasedSeriesWithoutExporting)
+{
+  metrics_registry metrics;
+
+  const auto kept = add_write_histogram(metrics, "tcp", 0);
+
+  /* Clients connect and disconnect, while the metrics are never scraped. */
+  for (std::uint64_t client_id = 1; client_id <= 100; client_id++) {
+    add_write_histogram(metrics, "tcp", client_id);
+    metrics.add_counter("sentinel_test_total", "A test counter.", { { "client", std::to_string(client_id) } });
+  }
+
+  /* The kept histogram, and the last histogram and counter that were added. */
+  EXPECT_EQ(metrics.get_series_count(), 3);
+}
+
+TEST(MetricsRegistry, ExportsCounters)
+{
+  metrics_registry metrics;
+
+  auto c = metrics.add_counter("sentinel_test_total", "A test counter.", { { "sensor", "1" } });
+
+  c->add(3);
+  c->add(2);
+
+  const auto text = metrics.export_text();
+
+  EXPECT_NE(text.find("# TYPE sentinel_test_total counter\n"), std::string::npos);
+  EXPECT_NE(text.find("sentinel_test_total{sensor=\"1\"} 5\n"), std::string::npos);
+
+  c.reset();
+
+  EXPECT_TRUE(metrics.export_text().empty());
+}
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+
+#include "../src/period_ring.h"
+
+#include <cstring>
+
+TEST(PeriodRing, ReusesReleasedSlots)
+{
+  period_ring ring(2, 4);
+
+  auto* samples = ring.acquire();
+  const std::int16_t period[3]{ 1, 2, 3 };
+  std::memcpy(samples, period, sizeof(period));
+  auto msg = ring.commit(3, 8000, 42, 7);
+
+  const auto* buffer = msg->buffer.get();
+  const auto* data = buffer->data();
+  EXPECT_EQ(buffer->size(), sentinel::proto::writer::microphone_update_samples_offset + sizeof(period));
+
+  const auto expected = sentinel::proto::writer::create_microphone_update(period, 3, 8000, 42, 7);
+  EXPECT_EQ(*msg->buffer, *expected->buffer);
+  EXPECT_EQ(msg->type_hash, expected->type_hash);
+
+  msg.reset();
+
+  ring.acquire();
+  ring.commit(4, 8000, 43, 7);
+
+  /* The first slot has been released, so it is reused without reallocating its buffer. */
+  ring.acquire();
+  msg = ring.commit(4, 8000, 44, 7);
+  EXPECT_EQ(msg->buffer.get(), buffer);
+  EXPECT_EQ(msg->buffer->data(), data);
+  EXPECT_EQ(ring.get_overruns(), 0);
+}
+
+TEST(PeriodRing, CountsOverruns)
+{
+  period_ring ring(2, 4);
+
+  std::vector<std::shared_ptr<sentinel::proto::outbound_message>> held;
+
+  for (int i = 0; i < 3; i++) {
+    ring.acquire();
+    held.emplace_back(ring.commit(4, 8000, 0, 0));
+  }
+
+  EXPECT_EQ(ring.get_overruns(), 1);
+  EXPECT_NE(held[0]->buffer, held[2]->buffer);
+}
+
+TEST(PeriodRing, CoalescesPeriods)
+{
+  period_ring ring(2, 2, 3);
+
+  for (std::int16_t i = 0; i < 3; i++) {
+    ASSERT_TRUE(ring.has_room());
+    auto* samples = ring.acquire();
+    samples[0] = i * 2;
+    samples[1] = i * 2 + 1;
+    ring.append(2, 100 + i);
+  }
+
+  EXPECT_FALSE(ring.has_room());
+  EXPECT_EQ(ring.get_pending_samples(), 6);
+  EXPECT_EQ(ring.get_pending_time(), 100);
+
+  auto msg = ring.commit(8000, 7);
+
+  const std::int16_t expected_samples[6]{ 0, 1, 2, 3, 4, 5 };
+  const auto expected = sentinel::proto::writer::create_microphone_update(expected_samples, 6, 8000, 100, 7);
+  EXPECT_EQ(*msg->buffer, *expected->buffer);
+  EXPECT_TRUE(ring.has_room());
+  EXPECT_EQ(ring.get_pending_samples(), 0);
+}
+
+TEST(PeriodRing, CompressesIntoReusedSlots)
+{
+  period_ring ring(2, 4, 1, true);
+
+  const std::int16_t first[4]{ 100, -200, 300, -400 };
+  const std::int16_t second[3]{ 500, -600, 700 };
+
+  sentinel::proto::adpcm_encoder encoder;
+
+  std::memcpy(ring.acquire(), first, sizeof(first));
+  auto msg = ring.commit(4, 8000, 42, 7);
+
+  ASSERT_TRUE(msg->compressed);
+  auto expected = sentinel::proto::writer::create_microphone_adpcm_update(encoder, first, 4, 8000, 42, 7);
+  EXPECT_EQ(*msg->compressed->buffer, *expected->buffer);
+  EXPECT_EQ(msg->compressed->type_hash, expected->type_hash);
+
+  const auto* compressed_data = msg->compressed->buffer->data();
+
+  msg.reset();
+
+  std::memcpy(ring.acquire(), first, sizeof(first));
+  ring.commit(4, 8000, 43, 7);
+  sentinel::proto::writer::create_microphone_adpcm_update(encoder, first, 4, 8000, 43, 7);
+
+  /* The first slot's compressed message is reused, and the encoder carries over from the previous message. */
+  std::memcpy(ring.acquire(), second, sizeof(second));
+  msg = ring.commit(3, 8000, 44, 7);
+
+  expected = sentinel::proto::writer::create_microphone_adpcm_update(encoder, second, 3, 8000, 44, 7);
+  EXPECT_EQ(*msg->compressed->buffer, *expected->buffer);
+  EXPECT_EQ(msg->compressed->buffer->data(), compressed_data);
+  EXPECT_EQ(ring.get_overruns(), 0);
+}
+
+TEST(PeriodRing, HeldCompressedMessagesAreNotReused)
+{
+  period_ring ring(1, 4, 1, true);
+
+  ring.acquire();
+  const auto compressed = ring.commit(4, 8000, 0, 0)->compressed;
+
+  ring.acquire();
+  const auto msg = ring.commit(4, 8000, 1, 0);
+
+  EXPECT_EQ(ring.get_overruns(), 1);
+  EXPECT_NE(msg->compressed, compressed);
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include "../src/microphone_device.h"
+#include "../src/wav_header.h"
+#include "temp_directory.h"
+
+#include <fstream>
+
+#include <cstdlib>
+
+namespace {
+
+class ReplayMicrophoneDevice : public temp_directory_test
+{
+protected:
+  void SetUp() override
+  {
+    temp_directory_test::SetUp();
+
+    m_path = m_directory + "/replay.wav";
+  }
+
+  void write_wav(const std::vector<std::int16_t>& samples, const std::uint32_t rate)
+  {
+    const auto data_size = static_cast<std::uint32_t>(samples.size() * sizeof(std::int16_t));
+    const auto header = make_wav_header(rate, data_size);
+    std::ofstream file(m_path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    file.write(reinterpret_cast<const char*>(samples.data()), data_size);
+  }
+
+  std::string m_path;
+};
+
+} // namespace
+
+TEST_F(ReplayMicrophoneDevice, PlaysWavFile)
+{
+  std::vector<std::int16_t> samples(10);
+  for (std::size_t i = 0; i < samples.size(); i++) {
+    samples[i] = static_cast<std::int16_t>(i * 100);
+  }
+  write_wav(samples, 8000);
+
+  auto dev = microphone_device::create_replay(m_path, 4, /* realtime */ false, /* loop */ false);
+  ASSERT_TRUE(dev->is_open());
+  EXPECT_EQ(dev->get_rate(), 8000u);
+  EXPECT_EQ(dev->get_period_size(), 4u);
+
+  std::int16_t period[4]{};
+  std::vector<std::int16_t> played;
+  for (int i = 0; i < 4; i++) {
+    const auto size = dev->read(period);
+    played.insert(played.end(), period, period + size);
+  }
+
+  EXPECT_EQ(played, samples);
+  EXPECT_TRUE(dev->is_finished());
+}
+
+TEST_F(ReplayMicrophoneDevice, LoopsWavFile)
+{
+  write_wav({ 1, 2, 3 }, 8000);
+
+  auto dev = microphone_device::create_replay(m_path, 4, /* realtime */ false, /* loop */ true);
+  ASSERT_TRUE(dev->is_open());
+
+  std::int16_t period[4]{};
+  ASSERT_EQ(dev->read(period), 4u);
+  EXPECT_EQ(period[0], 1);
+  EXPECT_EQ(period[3], 1);
+  EXPECT_FALSE(dev->is_finished());
+}
+
+TEST(SyntheticMicrophoneDevice, GeneratesTone)
+{
+  auto dev = microphone_device::create_synthetic(microphone_signal::tone, 1000.0f, 48000, 480, false);
+  ASSERT_TRUE(dev->is_open());
+
+  std::vector<std::int16_t> period(dev->get_period_size());
+  ASSERT_EQ(dev->read(period.data()), period.size());
+
+  int peak = 0;
+  for (const auto s : period) {
+    peak = std::max(peak, std::abs(static_cast<int>(s)));
+  }
+  EXPECT_GT(peak, 7000);
+  EXPECT_LE(peak, 8000);
+}
+
+TEST(SyntheticMicrophoneDevice, PacesPeriodsInRealtime)
+{
+  auto dev = microphone_device::create_synthetic(microphone_signal::noise, 0.0f, 8000, 80, true, true);
+  ASSERT_TRUE(dev->is_open());
+
+  std::vector<std::int16_t> period(dev->get_period_size());
+
+  /* The first period is not due until 10 ms have passed. */
+  EXPECT_EQ(dev->read(period.data()), 0u);
+
+  std::vector<pollfd> fds;
+  dev->get_poll_descriptors(fds);
+  ASSERT_EQ(fds.size(), 1u);
+  ASSERT_EQ(::poll(fds.data(), fds.size(), 1000), 1);
+  EXPECT_TRUE(dev->is_ready(fds.data(), fds.size()));
+  EXPECT_EQ(dev->read(period.data()), period.size());
+}
@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include "../src/image.h"
+#include "../src/video_device.h"
+#include "temp_directory.h"
+
+#include <opencv2/imgcodecs.hpp>
+
+
+namespace {
+
+class ReplayVideoDevice : public temp_directory_test
+{
+protected:
+  void SetUp() override
+  {
+    temp_directory_test::SetUp();
+
+    /* Written out of order, with a file that is not a frame, to check that they are sorted and filtered. */
+    write_frame(3000, 30);
+    write_frame(1000, 10);
+    write_frame(2000, 20);
+    cv::imwrite(m_directory + "/notes.jpg", cv::Mat(4, 8, CV_8UC3, cv::Scalar(0)));
+  }
+
+  void write_frame(const std::uint64_t time, const int value)
+  {
+    cv::imwrite(m_directory + "/" + std::to_string(time) + ".jpg", cv::Mat(4, 8, CV_8UC3, cv::Scalar(value)));
+  }
+};
+
+} // namespace
+
+TEST_F(ReplayVideoDevice, PlaysStoredFramesInOrder)
+{
+  auto dev = video_device::create_replay(m_directory, false, false);
+  ASSERT_TRUE(dev->open(0, 640, 480));
+
+  int last_value = 0;
+
+  for (int i = 0; i < 3; i++) {
+    auto img = dev->read_frame();
+    ASSERT_TRUE(img.has_value());
+    EXPECT_EQ(img->width, 8u);
+    EXPECT_EQ(img->height, 4u);
+    EXPECT_EQ(img->data.size(), 8u * 4u * 3u);
+    /* The values only increase if the frames are played back by their timestamp. */
+    EXPECT_GT(img->frame.at<cv::Vec3b>(0, 0)[0], last_value);
+    last_value = img->frame.at<cv::Vec3b>(0, 0)[0];
+  }
+
+  EXPECT_FALSE(dev->read_frame().has_value());
+  EXPECT_TRUE(dev->is_finished());
+}
+
+TEST_F(ReplayVideoDevice, Loops)
+{
+  auto dev = video_device::create_replay(m_directory, false, true);
+  ASSERT_TRUE(dev->open(0, 640, 480));
+
+  for (int i = 0; i < 7; i++) {
+    EXPECT_TRUE(dev->read_frame().has_value());
+  }
+
+  EXPECT_FALSE(dev->is_finished());
+}
+
+TEST_F(ReplayVideoDevice, FailsWithoutFrames)
+{
+  auto dev = video_device::create_replay(m_directory + "/missing", false, true);
+  EXPECT_FALSE(dev->open(0, 640, 480));
+}
@@ -0,0 +1,249 @@
+#include <gtest/gtest.h>
+
+#include "../src/metrics.h"
+#include "../src/server.h"
+#include "run_loop.h"
+
+#include <sentinel/proto.h>
+
+#include <uv.h>
+
+#include <array>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief A client of the TCP server, which sends a subscription when it connects and keeps the types of the messages
+ *        that it receives.
+ * */
+class test_client final
+{
+public:
+  test_client(uv_loop_t* loop, const std::uint32_t subscriptions)
+    : m_subscriptions(subscriptions)
+  {
+    uv_tcp_init(loop, &m_socket);
+
+    uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_socket), this);
+  }
+
+  void connect(const int port)
+  {
+    sockaddr_in address{};
+
+    uv_ip4_addr("127.0.0.1", port, &address);
+
+    uv_tcp_connect(&m_connect, &m_socket, reinterpret_cast<const sockaddr*>(&address), on_connect);
+  }
+
+  void close() { uv_close(reinterpret_cast<uv_handle_t*>(&m_socket), nullptr); }
+
+  auto count(const std::string& type) const -> std::size_t
+  {
+    std::size_t n{};
+
+    for (const auto& t : m_types) {
+      n += (t == type) ? 1 : 0;
+    }
+
+    return n;
+  }
+
+protected:
+  static auto get_self(uv_handle_t* handle) -> test_client*
+  {
+    return static_cast<test_client*>(uv_handle_get_data(handle));
+  }
+
+  static void on_connect(uv_connect_t* req, const int status)
+  {
+    if (status != 0) {
+      return;
+    }
+
+    auto* self = get_self(reinterpret_cast<uv_handle_t*>(req->handle));
+
+    if (self->m_subscriptions != 0) {
+      self->m_subscription = sentinel::proto::writer::create_subscription_update(self->m_subscriptions)->buffer;
+
+      auto buf = uv_buf_init(reinterpret_cast<char*>(self->m_subscription->data()),
+                             static_cast<unsigned int>(self->m_subscription->size()));
+
+      uv_write(&self->m_write, req->handle, &buf, 1, nullptr);
+    }
+
+    uv_read_start(req->handle, on_alloc, on_read);
+  }
+
+  static void on_alloc(uv_handle_t* handle, size_t, uv_buf_t* buf)
+  {
+    auto* self = get_self(handle);
+
+    buf->base = self->m_buffer.data();
+
+    buf->len = self->m_buffer.size();
+  }
+
+  static void on_read(uv_stream_t* stream, const ssize_t read_size, const uv_buf_t*)
+  {
+    if (read_size <= 0) {
+      return;
+    }
+
+    auto* self = get_self(reinterpret_cast<uv_handle_t*>(stream));
+
+    self->m_received.insert(self->m_received.end(), self->m_buffer.data(), self->m_buffer.data() + read_size);
+
+    while (true) {
+      const auto res = sentinel::proto::read(self->m_received.data(), self->m_received.size());
+
+      if (res.payload_ready) {
+        self->m_types.emplace_back(res.type_id);
+      }
+
+      self->m_received.erase(self->m_received.begin(), self->m_received.begin() + res.cull_size);
+
+      if (!res.payload_ready) {
+        break;
+      }
+    }
+  }
+
+private:
+  uv_tcp_t m_socket{};
+
+  uv_connect_t m_connect{};
+
+  uv_write_t m_write{};
+
+  std::uint32_t m_subscriptions{};
+
+  std::shared_ptr<std::vector<std::uint8_t>> m_subscription;
+
+  std::array<char, 65536> m_buffer{};
+
+  std::vector<std::uint8_t> m_received;
+
+  std::vector<std::string> m_types;
+};
+
+class Server : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    uv_loop_init(&m_loop);
+
+    m_server = server::create(&m_loop, m_metrics);
+
+    /* The system picks a free port, so that the test does not collide with anything else that is listening. */
+    ASSERT_TRUE(m_server->setup("127.0.0.1", 0));
+  }
+
+  void TearDown() override
+  {
+    for (auto& c : m_clients) {
+      c->close();
+    }
+
+    m_server->close();
+
+    uv_run(&m_loop, UV_RUN_DEFAULT);
+
+    m_server.reset();
+
+    uv_loop_close(&m_loop);
+  }
+
+  auto connect(const std::uint32_t subscriptions) -> test_client*
+  {
+    m_clients.emplace_back(new test_client(&m_loop, subscriptions));
+
+    m_clients.back()->connect(m_server->get_port());
+
+    return m_clients.back().get();
+  }
+
+  /**
+   * @brief Publishes a microphone update (with its ADPCM encoding) followed by a temperature update, and waits for
+   *        the client to receive the temperature update.
+   * */
+  auto publish(const test_client& c) -> bool
+  {
+    const std::vector<std::int16_t> samples(64, 100);
+
+    auto mic = sentinel::proto::writer::create_microphone_update(samples.data(), samples.size(), 16000, 0, 1);
+
+    sentinel::proto::adpcm_encoder encoder;
+
+    mic->compressed =
+      sentinel::proto::writer::create_microphone_adpcm_update(encoder, samples.data(), samples.size(), 16000, 0, 1);
+
+    m_server->publish_telemetry(mic);
+
+    auto temperature = sentinel::proto::writer::create_temperature_update(20.0f, 0, 1);
+
+    m_server->publish_telemetry(temperature);
+
+    const auto expected = c.count("temperature::update") + 1;
+
+    return run_loop_until(&m_loop, [&]() -> bool { return c.count("temperature::update") >= expected; }, 100);
+  }
+
+  /**
+   * @brief Publishes until the client has received a message, since the server only sends to the clients that it
+   *        accepted and only applies a subscription once it has read it.
+   * */
+  void publish_until_received(const test_client& c, const std::string& type)
+  {
+    for (int i = 0; (i < 100) && (c.count(type) == 0); i++) {
+      publish(c);
+    }
+  }
+
+  uv_loop_t m_loop{};
+
+  metrics_registry m_metrics;
+
+  std::unique_ptr<server> m_server;
+
+  std::vector<std::unique_ptr<test_client>> m_clients;
+};
+
+} // namespace
+
+TEST_F(Server, ClientsWithoutSubscriptionGetNoSamples)
+{
+  auto* c = connect(0);
+
+  publish_until_received(*c, "temperature::update");
+
+  ASSERT_TRUE(publish(*c));
+
+  EXPECT_EQ(c->count("microphone::update"), 0);
+  EXPECT_EQ(c->count("microphone::adpcm"), 0);
+}
+
+TEST_F(Server, ClientsSubscribedToSamplesGetPcm)
+{
+  auto* c = connect(sentinel::proto::subscription_pcm);
+
+  publish_until_received(*c, "microphone::update");
+
+  ASSERT_GT(c->count("microphone::update"), 0);
+
+  EXPECT_EQ(c->count("microphone::adpcm"), 0);
+}
+
+TEST_F(Server, ClientsAcceptingAdpcmGetCompressedSamples)
+{
+  auto* c = connect(sentinel::proto::subscription_pcm | sentinel::proto::subscription_adpcm);
+
+  publish_until_received(*c, "microphone::adpcm");
+
+  ASSERT_GT(c->count("microphone::adpcm"), 0);
+
+  EXPECT_EQ(c->count("microphone::update"), 0);
+}
@@ -0,0 +1,279 @@
+#include <gtest/gtest.h>
+
+#include "../src/jpeg_header.h"
+#include "../src/metadata_log.h"
+#include "../src/storage_compactor.h"
+#include "../src/storage_index.h"
+#include "temp_directory.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace {
+
+constexpr auto max_time = std::numeric_limits<std::uint64_t>::max();
+
+/**
+ * @brief The time of the first frame, so that frame times can be given in milliseconds.
+ * */
+constexpr std::uint64_t t0{ 1000000000000000ULL };
+
+constexpr auto
+ms(const std::uint64_t value) -> std::uint64_t
+{
+  return t0 + (value * 1000);
+}
+
+class StorageCompactor : public temp_directory_test
+{
+protected:
+  void SetUp() override
+  {
+    temp_directory_test::SetUp();
+
+    m_index = std::make_shared<storage_index>(m_directory);
+
+    m_metadata = std::make_shared<metadata_log>(m_directory + "/metadata");
+
+    m_metadata->scan();
+  }
+
+  /**
+   * @brief Stores a frame that was taken at the given number of milliseconds after the first one.
+   *
+   * @param logged Whether or not to add the frame to the metadata log, which only takes frames in chronological order.
+   * */
+  void store(const std::uint64_t millis, const bool logged = true)
+  {
+    std::vector<std::uint8_t> data;
+
+    ASSERT_TRUE(cv::imencode(".jpg", cv::Mat(48, 64, CV_8UC3, cv::Scalar(128)), data));
+
+    const auto time = ms(millis);
+
+    std::ofstream file(m_index->get_path(time), std::ios::binary);
+
+    file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+
+    const auto size = static_cast<std::uint32_t>(data.size());
+
+    m_index->add(storage_index::entry{ time, size });
+
+    if (logged) {
+      m_metadata->append(metadata_log::row{ time, 0.0f, 0.0f, 0, size });
+    }
+  }
+
+  auto create(const std::vector<config::storage_tier_config>& tiers) const -> storage_compaction
+  {
+    return storage_compaction(m_index, m_metadata, tiers, 0.9f);
+  }
+
+  static auto run_pass(storage_compaction& compaction, const std::uint64_t now) -> bool
+  {
+    return compaction.run_pass(now, []() -> bool { return true; });
+  }
+
+  /**
+   * @brief Gets the times of the stored frames, in milliseconds after the first one.
+   * */
+  auto get_stored() const -> std::vector<std::uint64_t>
+  {
+    std::vector<std::uint64_t> millis;
+    for (const auto& e : m_index->query(0, max_time, 0, 100000)) {
+      millis.emplace_back((e.time - t0) / 1000);
+    }
+    return millis;
+  }
+
+  /**
+   * @brief Checks that the files and the metadata match the index.
+   *
+   * @param unlogged A frame that is in the index, but was never added to the metadata log.
+   * */
+  void expect_consistent(const std::optional<std::uint64_t> unlogged = std::nullopt) const
+  {
+    const auto entries = m_index->query(0, max_time, 0, 100000);
+
+    const auto rows = m_metadata->query(metadata_log::predicate{}, 100000);
+
+    std::size_t next_row{};
+
+    for (const auto& e : entries) {
+
+      EXPECT_EQ(std::filesystem::file_size(m_index->get_path(e.time)), e.size);
+
+      if (unlogged && (e.time == ms(unlogged.value()))) {
+        continue;
+      }
+
+      ASSERT_LT(next_row, rows.size());
+      EXPECT_EQ(rows[next_row].time, e.time);
+      EXPECT_EQ(rows[next_row].size, e.size);
+      next_row++;
+    }
+
+    EXPECT_EQ(next_row, rows.size());
+
+    std::size_t files{};
+
+    for (const auto& dir_entry : std::filesystem::directory_iterator(m_directory)) {
+      files += dir_entry.is_regular_file() ? 1 : 0;
+    }
+
+    EXPECT_EQ(files, entries.size());
+  }
+
+  std::shared_ptr<storage_index> m_index;
+
+  std::shared_ptr<metadata_log> m_metadata;
+};
+
+} // namespace
+
+TEST_F(StorageCompactor, FramesAreThinnedByTheirTier)
+{
+  /* Two frames per second, for two hundred seconds. */
+  for (std::uint64_t i = 0; i < 400; i++) {
+    store(i * 500);
+  }
+
+  auto compaction = create({ { 100.0f, 10.0f }, { 10.0f, 1.0f } });
+
+  ASSERT_TRUE(run_pass(compaction, ms(200000)));
+
+  std::vector<std::uint64_t> expected;
+
+  /* Older than 100 seconds: one frame every ten seconds. */
+  for (std::uint64_t t = 0; t < 100000; t += 10000) {
+    expected.emplace_back(t);
+  }
+
+  /* Between 10 and 100 seconds old: one frame every second. */
+  for (std::uint64_t t = 100000; t < 190000; t += 1000) {
+    expected.emplace_back(t);
+  }
+
+  /* Younger than 10 seconds: every frame. */
+  for (std::uint64_t t = 190000; t < 200000; t += 500) {
+    expected.emplace_back(t);
+  }
+
+  EXPECT_EQ(get_stored(), expected);
+
+  /* The tiers are sorted from youngest to oldest. */
+  EXPECT_EQ(compaction.get_done_until(0), ms(190000));
+  EXPECT_EQ(compaction.get_done_until(1), ms(100000));
+
+  expect_consistent();
+}
+
+TEST_F(StorageCompactor, PassesResumeWhereTheLastOneEnded)
+{
+  for (std::uint64_t i = 0; i <= 15; i++) {
+    store(i * 400);
+  }
+
+  auto compaction = create({ { 10.0f, 1.0f } });
+
+  ASSERT_TRUE(run_pass(compaction, ms(13000)));
+
+  EXPECT_EQ(compaction.get_done_until(0), ms(3000));
+  EXPECT_EQ(get_stored(),
+            (std::vector<std::uint64_t>{ 0, 1200, 2400, 3200, 3600, 4000, 4400, 4800, 5200, 5600, 6000 }));
+
+  /* A frame that shows up late, behind where the tier has gotten to, is left alone. */
+  store(200, false);
+
+  ASSERT_TRUE(run_pass(compaction, ms(16000)));
+
+  EXPECT_EQ(compaction.get_done_until(0), ms(6000));
+
+  /* The frame at 3200 is too close to the one kept at 2400, which was found in the previous pass. */
+  EXPECT_EQ(get_stored(), (std::vector<std::uint64_t>{ 0, 200, 1200, 2400, 3600, 4800, 6000 }));
+
+  expect_consistent(200);
+}
+
+TEST_F(StorageCompactor, FramesAreShrunk)
+{
+  store(0);
+  store(1000);
+  store(2000);
+
+  auto compaction = create({ { 10.0f, 0.0f, 32, 24 } });
+
+  /* The frame being read keeps its size, and everything after it waits for the next pass. */
+  auto lease = m_index->lease(ms(1000), ms(1000));
+
+  const auto before = m_index->query(0, max_time, 0, 10);
+
+  ASSERT_TRUE(run_pass(compaction, ms(20000)));
+
+  EXPECT_EQ(compaction.get_done_until(0), ms(0) + 1);
+
+  auto entries = m_index->query(0, max_time, 0, 10);
+
+  ASSERT_EQ(entries.size(), 3);
+  EXPECT_NE(entries[0].size, before[0].size);
+  EXPECT_EQ(entries[1].size, before[1].size);
+  EXPECT_EQ(entries[2].size, before[2].size);
+
+  lease.reset();
+
+  ASSERT_TRUE(run_pass(compaction, ms(20000)));
+
+  EXPECT_EQ(compaction.get_done_until(0), ms(10000));
+
+  for (const auto& e : m_index->query(0, max_time, 0, 10)) {
+    std::uint16_t w{};
+    std::uint16_t h{};
+    ASSERT_TRUE(read_jpeg_size(m_index->get_path(e.time), w, h));
+    EXPECT_EQ(w, 32);
+    EXPECT_EQ(h, 24);
+  }
+
+  expect_consistent();
+}
+
+TEST_F(StorageCompactor, LeasedFramesAreNotRemoved)
+{
+  for (std::uint64_t i = 0; i < 4; i++) {
+    store(i * 500);
+  }
+
+  auto compaction = create({ { 10.0f, 1.0f } });
+
+  auto lease = m_index->lease(ms(500), ms(500));
+
+  ASSERT_TRUE(run_pass(compaction, ms(20000)));
+
+  EXPECT_EQ(get_stored(), (std::vector<std::uint64_t>{ 0, 500, 1000, 1500 }));
+
+  /* Once the lease is released, the next pass picks up from the frame that was being read. */
+  lease.reset();
+
+  ASSERT_TRUE(run_pass(compaction, ms(20000)));
+
+  EXPECT_EQ(get_stored(), (std::vector<std::uint64_t>{ 0, 1000 }));
+
+  expect_consistent();
+}
+
+TEST_F(StorageCompactor, ThrottleStopsThePass)
+{
+  for (std::uint64_t i = 0; i < 4; i++) {
+    store(i * 500);
+  }
+
+  auto compaction = create({ { 10.0f, 1.0f } });
+
+  EXPECT_FALSE(compaction.run_pass(ms(20000), []() -> bool { return false; }));
+
+  EXPECT_EQ(get_stored(), (std::vector<std::uint64_t>{ 0, 500, 1000, 1500 }));
+}
@@ -0,0 +1,185 @@
+#include <gtest/gtest.h>
+
+#include "../src/storage_index.h"
+#include "temp_directory.h"
+
+#include <filesystem>
+#include <fstream>
+#include <limits>
+
+namespace {
+
+constexpr auto max_time = std::numeric_limits<std::uint64_t>::max();
+
+void
+fill_index(storage_index& index)
+{
+  for (std::uint64_t t = 1; t <= 10; t++) {
+    index.add(storage_index::entry{ t * 100, static_cast<std::uint32_t>(t) });
+  }
+}
+
+class StorageIndexFiles : public temp_directory_test
+{};
+
+void
+write_file(const std::string& path, const std::string& content)
+{
+  std::ofstream file(path, std::ios::binary);
+  file << content;
+}
+
+} // namespace
+
+TEST(StorageIndex, GetPath)
+{
+  storage_index index("frames");
+
+  EXPECT_EQ(index.get_path(1234), "frames/1234.jpg");
+}
+
+TEST(StorageIndex, QueryRange)
+{
+  storage_index index("frames");
+
+  fill_index(index);
+
+  const auto entries = index.query(250, 500, 0, 100);
+
+  ASSERT_EQ(entries.size(), 3);
+  EXPECT_EQ(entries[0].time, 300);
+  EXPECT_EQ(entries[1].time, 400);
+  EXPECT_EQ(entries[2].time, 500);
+  EXPECT_EQ(entries[2].size, 5);
+}
+
+TEST(StorageIndex, QueryStep)
+{
+  storage_index index("frames");
+
+  fill_index(index);
+
+  const auto entries = index.query(0, max_time, 250, 100);
+
+  ASSERT_EQ(entries.size(), 4);
+  EXPECT_EQ(entries[0].time, 100);
+  EXPECT_EQ(entries[1].time, 400);
+  EXPECT_EQ(entries[2].time, 700);
+  EXPECT_EQ(entries[3].time, 1000);
+}
+
+TEST(StorageIndex, QueryLimit)
+{
+  storage_index index("frames");
+
+  fill_index(index);
+
+  EXPECT_EQ(index.query(0, max_time, 0, 4).size(), 4);
+}
+
+TEST(StorageIndex, AddOutOfOrder)
+{
+  storage_index index("frames");
+
+  fill_index(index);
+
+  index.add(storage_index::entry{ 150, 42 });
+
+  const auto entries = index.query(100, 200, 0, 100);
+
+  ASSERT_EQ(entries.size(), 3);
+  EXPECT_EQ(entries[1].time, 150);
+  EXPECT_EQ(entries[1].size, 42);
+}
+
+TEST(StorageIndex, RemoveBefore)
+{
+  storage_index index("frames");
+
+  fill_index(index);
+
+  const auto removed = index.remove_before(350);
+
+  ASSERT_EQ(removed.size(), 3);
+  EXPECT_EQ(removed[2].time, 300);
+  EXPECT_EQ(index.size(), 7);
+  EXPECT_TRUE(index.remove(400));
+  EXPECT_FALSE(index.remove(400));
+  EXPECT_EQ(index.size(), 6);
+}
+
+TEST(StorageIndex, RemoveBeforeStopsAtLeasedFrames)
+{
+  storage_index index("frames");
+
+  fill_index(index);
+
+  auto lease = index.lease(300, 500);
+
+  const auto removed = index.remove_before(650);
+
+  ASSERT_EQ(removed.size(), 2);
+  EXPECT_EQ(removed[1].time, 200);
+  EXPECT_EQ(index.size(), 8);
+
+  /* The rest are removed once the lease is released. */
+  lease.reset();
+
+  EXPECT_EQ(index.remove_before(650).size(), 4);
+  EXPECT_EQ(index.size(), 4);
+}
+
+TEST(StorageIndex, Update)
+{
+  storage_index index("frames");
+
+  fill_index(index);
+
+  EXPECT_TRUE(index.update(storage_index::entry{ 200, 5 }));
+  EXPECT_FALSE(index.update(storage_index::entry{ 250, 5 }));
+  EXPECT_EQ(index.size(), 10);
+
+  const auto entries = index.query(200, 200, 0, 10);
+  ASSERT_EQ(entries.size(), 1);
+  EXPECT_EQ(entries[0].size, 5);
+}
+
+TEST_F(StorageIndexFiles, LeasesKeepFramesFromChanging)
+{
+  storage_index index(m_directory);
+
+  for (std::uint64_t t = 1; t <= 3; t++) {
+    write_file(index.get_path(t * 100), "frame");
+    index.add(storage_index::entry{ t * 100, 5 });
+  }
+
+  const auto replacement = m_directory + "/replacement";
+
+  write_file(replacement, "new");
+
+  auto lease = index.lease(100, 200);
+
+  auto second = lease;
+
+  EXPECT_EQ(index.replace(storage_index::entry{ 200, 3 }, replacement), storage_index::change_result::leased);
+  EXPECT_EQ(index.erase(100), storage_index::change_result::leased);
+  EXPECT_EQ(index.erase(250), storage_index::change_result::missing);
+  EXPECT_EQ(index.erase(300), storage_index::change_result::done);
+  EXPECT_FALSE(std::filesystem::exists(index.get_path(300)));
+
+  /* The lease is held until the last copy of it is gone. */
+  lease.reset();
+  EXPECT_EQ(index.erase(100), storage_index::change_result::leased);
+  second.reset();
+
+  EXPECT_EQ(index.replace(storage_index::entry{ 200, 3 }, replacement), storage_index::change_result::done);
+  EXPECT_FALSE(std::filesystem::exists(replacement));
+  EXPECT_EQ(std::filesystem::file_size(index.get_path(200)), 3);
+
+  EXPECT_EQ(index.erase(100), storage_index::change_result::done);
+
+  const auto entries = index.query(0, max_time, 0, 10);
+  ASSERT_EQ(entries.size(), 1);
+  EXPECT_EQ(entries[0].time, 200);
+  EXPECT_EQ(entries[0].size, 3);
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include "../src/thumbnail_store.h"
+#include "temp_directory.h"
+
+#include <filesystem>
+#include <limits>
+
+namespace {
+
+constexpr auto max_time = std::numeric_limits<std::uint64_t>::max();
+
+class ThumbnailStore : public temp_directory_test
+{};
+
+} // namespace
+
+TEST_F(ThumbnailStore, AddAndScan)
+{
+  const std::vector<std::uint8_t> jpeg(100, 0xab);
+
+  const auto t0 = thumbnail_store::default_segment_duration * 10;
+
+  {
+    thumbnail_store store(m_directory, 3, 160, 120);
+    store.scan();
+    EXPECT_TRUE(store.add(t0 + 1, jpeg));
+    EXPECT_TRUE(store.add(t0 + 2, jpeg));
+    EXPECT_TRUE(store.add(t0 + thumbnail_store::default_segment_duration, jpeg));
+    /* Out of order, as when filling in missing thumbnails. */
+    EXPECT_TRUE(store.add(t0, jpeg));
+  }
+
+  thumbnail_store store(m_directory, 3, 160, 120);
+  store.scan();
+
+  const auto entries = store.query(0, max_time, 0, 100);
+  ASSERT_EQ(entries.size(), 4);
+  EXPECT_EQ(entries[0].time, t0);
+  EXPECT_EQ(entries[0].offset, 2 * entries[0].size);
+  EXPECT_EQ(entries[1].offset, 0);
+  EXPECT_EQ(entries[2].offset, entries[1].size);
+  EXPECT_EQ(entries[3].segment, t0 + thumbnail_store::default_segment_duration);
+  EXPECT_TRUE(store.contains(t0 + 2));
+  EXPECT_FALSE(store.contains(t0 + 3));
+}
+
+TEST_F(ThumbnailStore, ScanTruncatesPartialMessage)
+{
+  const std::vector<std::uint8_t> jpeg(100, 0xab);
+
+  std::string segment_path;
+
+  {
+    thumbnail_store store(m_directory, 3, 160, 120);
+    store.scan();
+    EXPECT_TRUE(store.add(1, jpeg));
+    EXPECT_TRUE(store.add(2, jpeg));
+    segment_path = store.get_segment_path(0);
+  }
+
+  const auto full_size = std::filesystem::file_size(segment_path);
+
+  std::filesystem::resize_file(segment_path, full_size - 10);
+
+  thumbnail_store store(m_directory, 3, 160, 120);
+  store.scan();
+
+  EXPECT_EQ(store.size(), 1);
+  EXPECT_EQ(std::filesystem::file_size(segment_path), full_size / 2);
+
+  EXPECT_TRUE(store.add(3, jpeg));
+  EXPECT_EQ(store.query(3, 3, 0, 1).at(0).offset, full_size / 2);
+}
+
+TEST_F(ThumbnailStore, RemoveBefore)
+{
+  const std::vector<std::uint8_t> jpeg(10, 0);
+
+  thumbnail_store store(m_directory, 3, 160, 120);
+  store.scan();
+
+  EXPECT_TRUE(store.add(1, jpeg));
+  EXPECT_TRUE(store.add(thumbnail_store::default_segment_duration + 1, jpeg));
+
+  store.remove_before(thumbnail_store::default_segment_duration + 2);
+
+  EXPECT_EQ(store.size(), 0);
+  EXPECT_FALSE(std::filesystem::exists(store.get_segment_path(0)));
+  EXPECT_TRUE(std::filesystem::exists(store.get_segment_path(thumbnail_store::default_segment_duration)));
+}
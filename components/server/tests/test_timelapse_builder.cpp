@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+
+#include "../src/storage_index.h"
+#include "../src/thumbnail_store.h"
+#include "../src/timelapse_builder.h"
+#include "temp_directory.h"
+
+#include <fstream>
+#include <limits>
+#include <vector>
+
+namespace {
+
+constexpr auto max_time = std::numeric_limits<std::uint64_t>::max();
+
+/**
+ * @brief The start of the first interval, so that frame times can be given in milliseconds.
+ * */
+constexpr std::uint64_t t0{ 1000000000000000ULL };
+
+constexpr std::uint64_t second{ 1000000 };
+
+constexpr auto
+ms(const std::uint64_t value) -> std::uint64_t
+{
+  return t0 + (value * 1000);
+}
+
+class TimelapseBuilder : public temp_directory_test
+{
+protected:
+  void SetUp() override
+  {
+    temp_directory_test::SetUp();
+
+    m_index = std::make_shared<storage_index>(m_directory);
+
+    open_timelapse();
+  }
+
+  /**
+   * @brief Opens the timelapse store the way it is opened at startup. The frames are copied into it as they are.
+   * */
+  void open_timelapse()
+  {
+    m_timelapse = std::make_shared<thumbnail_store>(m_directory + "/timelapse", 1, 0, 0);
+
+    m_timelapse->scan();
+  }
+
+  /**
+   * @brief Stores a frame that was taken at the given number of milliseconds after the first interval started.
+   * */
+  void store(const std::uint64_t millis)
+  {
+    const auto time = ms(millis);
+
+    std::ofstream file(m_index->get_path(time), std::ios::binary);
+
+    file << "frame " << millis;
+
+    m_index->add(storage_index::entry{ time, static_cast<std::uint32_t>(file.tellp()) });
+  }
+
+  auto create(const std::uint64_t delay) const -> timelapse_build
+  {
+    return timelapse_build(m_index, m_timelapse, second, delay, 0.9f);
+  }
+
+  static auto run_pass(timelapse_build& build, const std::uint64_t now) -> bool
+  {
+    return build.run_pass(now, []() -> bool { return true; });
+  }
+
+  /**
+   * @brief Gets the times of the frames in the timelapse, in milliseconds after the first interval started.
+   * */
+  auto get_timelapse() const -> std::vector<std::uint64_t>
+  {
+    std::vector<std::uint64_t> millis;
+    for (const auto& e : m_timelapse->query(0, max_time, 0, 1000)) {
+      millis.emplace_back((e.time - t0) / 1000);
+    }
+    return millis;
+  }
+
+  std::shared_ptr<storage_index> m_index;
+
+  std::shared_ptr<thumbnail_store> m_timelapse;
+};
+
+} // namespace
+
+TEST_F(TimelapseBuilder, FirstFrameOfEachInterval)
+{
+  for (const auto t : { 200, 500, 900, 1300, 1600, 3100, 4000 }) {
+    store(static_cast<std::uint64_t>(t));
+  }
+
+  auto build = create(0);
+
+  ASSERT_TRUE(run_pass(build, ms(5500)));
+
+  /* The interval without a stored frame is skipped. */
+  EXPECT_EQ(get_timelapse(), (std::vector<std::uint64_t>{ 200, 1300, 3100, 4000 }));
+  EXPECT_EQ(build.get_added(), 4);
+
+  /* Nothing newer has been stored. */
+  EXPECT_FALSE(build.get_wake_time().has_value());
+}
+
+TEST_F(TimelapseBuilder, IntervalsWaitForTheDelay)
+{
+  store(500);
+  store(1500);
+  store(2500);
+
+  auto build = create(2 * second);
+
+  /* Frames up to 1.6 seconds have settled, so the second interval could still get an earlier frame. */
+  ASSERT_TRUE(run_pass(build, ms(3600)));
+
+  EXPECT_EQ(get_timelapse(), (std::vector<std::uint64_t>{ 500 }));
+  EXPECT_EQ(build.get_wake_time(), ms(4000));
+
+  /* A frame from the pre-roll of an event is stored after the ones that were taken later. */
+  store(1200);
+
+  ASSERT_TRUE(run_pass(build, ms(4000)));
+
+  EXPECT_EQ(get_timelapse(), (std::vector<std::uint64_t>{ 500, 1200 }));
+  EXPECT_EQ(build.get_wake_time(), ms(5000));
+}
+
+TEST_F(TimelapseBuilder, ResumesAfterRestart)
+{
+  store(500);
+  store(1500);
+
+  {
+    auto build = create(0);
+    ASSERT_TRUE(run_pass(build, ms(10000)));
+  }
+
+  EXPECT_EQ(get_timelapse(), (std::vector<std::uint64_t>{ 500, 1500 }));
+
+  /* The frames that were stored since, while the builder was not running. */
+  store(1700);
+  store(2200);
+  store(3400);
+
+  open_timelapse();
+
+  auto build = create(0);
+
+  ASSERT_TRUE(run_pass(build, ms(10000)));
+
+  /* The interval that already has a frame is not added again. */
+  EXPECT_EQ(get_timelapse(), (std::vector<std::uint64_t>{ 500, 1500, 2200, 3400 }));
+  EXPECT_EQ(build.get_added(), 2);
+}
+
+TEST_F(TimelapseBuilder, ThrottleStopsThePass)
+{
+  store(500);
+  store(1500);
+
+  auto build = create(0);
+
+  EXPECT_FALSE(build.run_pass(ms(10000), []() -> bool { return false; }));
+
+  EXPECT_TRUE(get_timelapse().empty());
+
+  /* The next pass picks up where the stopped one left off. */
+  ASSERT_TRUE(run_pass(build, ms(10000)));
+
+  EXPECT_EQ(get_timelapse(), (std::vector<std::uint64_t>{ 500, 1500 }));
+}
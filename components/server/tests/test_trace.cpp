@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include "../src/metrics.h"
+#include "../src/trace.h"
+
+#include <nlohmann/json.hpp>
+
+#include <thread>
+
+namespace {
+
+auto
+count_spans(const nlohmann::json& root, const std::string& name) -> std::size_t
+{
+  std::size_t count{};
+
+  for (const auto& e : root["traceEvents"]) {
+    if ((e["ph"] == "X") && (e["name"] == name)) {
+      count++;
+    }
+  }
+
+  return count;
+}
+
+} // namespace
+
+TEST(Tracer, RecordsSpansOnlyWhileEnabled)
+{
+  metrics_registry metrics;
+
+  auto h = add_stage_histogram(metrics, "video", 7, "trace_test_encode");
+
+  h->record_since(get_metrics_time());
+
+  tracer::set_enabled(true);
+
+  std::thread([&h] { h->record_since(get_metrics_time()); }).join();
+
+  tracer::set_enabled(false);
+
+  h->record_since(get_metrics_time());
+
+  const auto root = nlohmann::json::parse(tracer::export_json());
+
+  ASSERT_EQ(count_spans(root, "trace_test_encode"), 1);
+
+  for (const auto& e : root["traceEvents"]) {
+    if (e["name"] == "trace_test_encode") {
+      EXPECT_EQ(e["cat"], "video");
+      EXPECT_EQ(e["args"]["sensor"], "7");
+      EXPECT_GE(e["dur"].get<double>(), 0.0);
+    }
+  }
+}
+
+TEST(Tracer, KeepsTheMostRecentSpans)
+{
+  const auto label = tracer::add_label("trace_test_wrap", "test", {});
+
+  tracer::set_enabled(true);
+
+  std::thread([label] {
+    for (std::uint64_t i = 0; i < (tracer::buffer_size + 10); i++) {
+      tracer::record(label, i * 1000, i * 1000 + 500);
+    }
+  }).join();
+
+  tracer::set_enabled(false);
+
+  const auto root = nlohmann::json::parse(tracer::export_json());
+
+  EXPECT_EQ(count_spans(root, "trace_test_wrap"), tracer::buffer_size);
+
+  for (const auto& e : root["traceEvents"]) {
+    if (e["name"] == "trace_test_wrap") {
+      EXPECT_GE(e["ts"].get<double>(), 10.0);
+    }
+  }
+}
+
+TEST(Tracer, ClientConnectionsShareLabels)
+{
+  metrics_registry metrics;
+
+  tracer::set_enabled(true);
+
+  for (std::uint64_t client_id = 1; client_id <= 3; client_id++) {
+    std::thread([&metrics, client_id] {
+      add_write_histogram(metrics, "trace_test_server", client_id)->record_since(get_metrics_time());
+    }).join();
+  }
+
+  tracer::set_enabled(false);
+
+  EXPECT_EQ(tracer::add_label("write", "trace_test_server", {}), tracer::add_label("write", "trace_test_server", {}));
+
+  const auto root = nlohmann::json::parse(tracer::export_json());
+
+  std::size_t spans{};
+
+  for (const auto& e : root["traceEvents"]) {
+    if ((e["ph"] == "X") && (e["cat"] == "trace_test_server")) {
+      EXPECT_EQ(e["name"], "write");
+      spans++;
+    }
+  }
+
+  EXPECT_EQ(spans, 3);
+}
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+
+#include "../src/image.h"
+#include "../src/metadata_log.h"
+#include "../src/storage_index.h"
+#include "../src/video_storage.h"
+#include "temp_directory.h"
+
+#include <limits>
+#include <vector>
+
+namespace {
+
+constexpr auto max_time = std::numeric_limits<std::uint64_t>::max();
+
+/**
+ * @brief The time of the first frame, so that frame times can be given in tenths of a second.
+ * */
+constexpr std::uint64_t t0{ 1000000000000000ULL };
+
+constexpr auto
+frame_time(const std::uint64_t tenths) -> std::uint64_t
+{
+  return t0 + (tenths * 100000);
+}
+
+class VideoStorage : public temp_directory_test
+{
+protected:
+  void SetUp() override
+  {
+    temp_directory_test::SetUp();
+
+    m_config.storage_path = m_directory;
+    m_config.storage_days = -1;
+    m_config.storage_rate = 100;
+    m_config.storage_metadata_enabled = false;
+  }
+
+  auto create() -> std::unique_ptr<video_storage>
+  {
+    m_storage = camera_storage::create(m_config);
+    return video_storage::create(m_storage, m_config);
+  }
+
+  /**
+   * @brief Offers a frame that was taken at the given number of tenths of a second after the first one.
+   * */
+  static void store(video_storage& storage, const std::uint64_t tenths, const bool event)
+  {
+    image img;
+    img.frame = cv::Mat(48, 64, CV_8UC3, cv::Scalar(128));
+    img.time = frame_time(tenths);
+    storage.store(img, event, frame_metadata{});
+  }
+
+  /**
+   * @brief Gets the times of the stored frames, in tenths of a second after the first one.
+   * */
+  auto get_stored() const -> std::vector<std::uint64_t>
+  {
+    std::vector<std::uint64_t> tenths;
+    for (const auto& e : m_storage.index->query(0, max_time, 0, 1000)) {
+      tenths.emplace_back((e.time - t0) / 100000);
+    }
+    return tenths;
+  }
+
+  config::camera_config m_config;
+
+  camera_storage m_storage;
+};
+
+} // namespace
+
+TEST_F(VideoStorage, StoresPreRollAndPostRollAroundEvents)
+{
+  m_config.storage_pre_roll = 0.35f;
+  m_config.storage_post_roll = 0.25f;
+
+  auto storage = create();
+
+  /* Only the frames within the pre-roll of the event are kept by the time it happens. */
+  for (std::uint64_t i = 1; i < 10; i++) {
+    store(*storage, i, false);
+  }
+
+  store(*storage, 10, true);
+  store(*storage, 11, false);
+
+  /* A second event within the post-roll extends it. */
+  store(*storage, 12, true);
+
+  for (std::uint64_t i = 13; i < 17; i++) {
+    store(*storage, i, false);
+  }
+
+  const std::vector<std::uint64_t> expected{ 6, 7, 8, 9, 10, 11, 12, 13, 14 };
+
+  EXPECT_EQ(get_stored(), expected);
+}
+
+TEST_F(VideoStorage, PreRollIsBoundedByBytes)
+{
+  std::uint32_t frame_size{};
+
+  /* Every frame encodes to the same size, which is found by storing one of them. */
+  {
+    auto storage = create();
+    store(*storage, 0, true);
+    const auto entries = m_storage.index->query(0, max_time, 0, 1);
+    ASSERT_EQ(entries.size(), 1);
+    frame_size = entries[0].size;
+  }
+
+  m_config.storage_pre_roll = 10.0f;
+  m_config.storage_pre_roll_max_bytes = (frame_size * 5) / 2;
+
+  auto storage = create();
+
+  for (std::uint64_t i = 1; i < 6; i++) {
+    store(*storage, i, false);
+  }
+
+  store(*storage, 6, true);
+
+  /* The pre-roll only had room for two frames. */
+  const std::vector<std::uint64_t> expected{ 0, 4, 5, 6 };
+
+  EXPECT_EQ(get_stored(), expected);
+}
+
+TEST_F(VideoStorage, NothingIsStoredWithoutEvents)
+{
+  m_config.storage_pre_roll = 1.0f;
+
+  auto storage = create();
+
+  for (std::uint64_t i = 0; i < 20; i++) {
+    store(*storage, i, false);
+  }
+
+  EXPECT_TRUE(get_stored().empty());
+}